@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark for nested Co::Task chains, measuring time and heap
+ * allocations per chain.  Build with -DCO_NO_FRAME_ALLOCATOR to
+ * compare with plain malloc()/free() coroutine frames.
+ */
+
+#include "co/InvokeTask.hxx"
+#include "co/Task.hxx"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using Clock = std::chrono::steady_clock;
+
+static std::size_t n_allocations;
+
+void *
+operator new(std::size_t size)
+{
+	++n_allocations;
+
+	if (size == 0)
+		size = 1;
+
+	void *p = std::malloc(size);
+	if (p == nullptr)
+		throw std::bad_alloc{};
+	return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+static Co::Task<unsigned>
+Chain(unsigned depth)
+{
+	if (depth == 0)
+		co_return 1;
+
+	co_return 1 + co_await Chain(depth - 1);
+}
+
+static Co::InvokeTask
+RunChain(unsigned depth, unsigned &result)
+{
+	result += co_await Chain(depth);
+}
+
+static void
+Bench(unsigned depth, unsigned n)
+{
+	unsigned result = 0;
+
+	const std::size_t old_allocations = n_allocations;
+	const auto start = Clock::now();
+
+	/* one InvokeTask per chain (instead of one loop inside a
+	   coroutine) because without optimization, symmetric
+	   transfer may not be a tail call and the stack would
+	   grow with each iteration; the InvokeTask frame itself
+	   is not recycled and accounts for one allocation per
+	   chain */
+	for (unsigned i = 0; i < n; ++i) {
+		auto task = RunChain(depth, result);
+		task.Start({nullptr, [](void *, std::exception_ptr) noexcept {}});
+	}
+
+	const std::chrono::duration<double> duration = Clock::now() - start;
+	const std::size_t allocations = n_allocations - old_allocations;
+
+	if (result != (depth + 1) * n)
+		std::abort();
+
+	fmt::print("depth={:3}: {:8.1f}ns per chain, {:.2f} allocations per chain\n",
+		   depth, duration.count() * 1e9 / n,
+		   double(allocations) / n);
+}
+
+int
+main(int argc, char **argv) noexcept
+{
+	const unsigned n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+#ifdef CO_NO_FRAME_ALLOCATOR
+	fmt::print("without frame allocator\n");
+#else
+	fmt::print("with frame allocator\n");
+#endif
+
+	for (const unsigned depth : {1U, 4U, 16U, 64U})
+		Bench(depth, n / depth);
+
+	return EXIT_SUCCESS;
+}
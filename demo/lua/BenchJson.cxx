@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark for Lua::SerializeJson(), compared with building a
+ * nlohmann::json tree with Lua::ToJson() and calling dump().
+ */
+
+#include "lua/json/Serialize.hxx"
+#include "lua/json/ToJson.hxx"
+#include "lua/Error.hxx"
+#include "lua/State.hxx"
+#include "util/PrintException.hxx"
+
+#include <nlohmann/json.hpp>
+
+#include <fmt/core.h>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lualib.h>
+}
+
+#include <chrono>
+#include <string>
+
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr unsigned N_ITERATIONS = 10;
+
+template<typename F>
+static void
+Bench(const char *name, F &&f)
+{
+	std::size_t size = 0;
+
+	const auto start = Clock::now();
+
+	for (unsigned i = 0; i < N_ITERATIONS; ++i)
+		size = f().size();
+
+	const std::chrono::duration<double> duration = Clock::now() - start;
+
+	fmt::print("  {}: {:.2f}ms per call, {} bytes\n",
+		   name, duration.count() * 1000 / N_ITERATIONS, size);
+}
+
+static void
+BenchTable(lua_State *L, const char *name, const char *code)
+{
+	if (luaL_dostring(L, code) != 0)
+		throw Lua::PopError(L);
+
+	fmt::print("{}:\n", name);
+
+	Bench("ToJson().dump()", [L]{
+		return Lua::ToJson(L, -1).dump();
+	});
+
+	Bench("SerializeJson()", [L]{
+		std::string json;
+		Lua::SerializeJson(L, -1, json);
+		return json;
+	});
+
+	Bench("SerializeJson(STANDARD)", [L]{
+		std::string json;
+		Lua::SerializeJson(L, -1, json, Lua::JsonDialect::STANDARD);
+		return json;
+	});
+
+	lua_pop(L, 1);
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	const unsigned n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+
+	const Lua::State main{luaL_newstate()};
+	const auto L = main.get();
+	luaL_openlibs(L);
+
+	lua_pushinteger(L, n);
+	lua_setglobal(L, "n");
+
+	BenchTable(L, "integers", R"(
+local t = {}
+for i = 1, n do t[i] = i * 7 end
+return t
+)");
+
+	BenchTable(L, "records", R"(
+local t = {}
+for i = 1, n do
+  t[i] = {id=i, name='item ' .. i, price=i / 8, tags={'a', 'b'}, active=i % 2 == 0}
+end
+return t
+)");
+
+	BenchTable(L, "map", R"(
+local t = {}
+for i = 1, n do t['key' .. i] = 'value "' .. i .. '"\n' end
+return t
+)");
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark for ServerSocket: a client thread floods a loopback
+ * listener with connections and this program measures how many
+ * connections per second the #EventLoop accepts.
+ */
+
+#include "event/Loop.hxx"
+#include "event/net/ServerSocket.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/SocketAddress.hxx"
+#include "net/StaticSocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/PrintException.hxx"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+
+class BenchServer final : public ServerSocket {
+	const std::size_t limit;
+	std::size_t n_accepted = 0;
+
+public:
+	BenchServer(EventLoop &event_loop, std::size_t _limit) noexcept
+		:ServerSocket(event_loop), limit(_limit) {}
+
+	std::size_t GetAccepted() const noexcept {
+		return n_accepted;
+	}
+
+protected:
+	void OnAccept(UniqueSocketDescriptor, SocketAddress) noexcept override {
+		if (++n_accepted == limit)
+			GetEventLoop().Break();
+	}
+
+	void OnAcceptError(std::exception_ptr ep) noexcept override {
+		PrintException(ep);
+		GetEventLoop().Break();
+	}
+};
+
+/**
+ * Connect to the given address in bursts of #burst connections.
+ * Each connect() returns as soon as the connection is in the
+ * server's listen backlog, so the server sees up to #burst pending
+ * connections per wakeup.
+ */
+static void
+RunClient(const IPv4Address address, std::size_t n, std::size_t burst) noexcept
+{
+	std::vector<UniqueSocketDescriptor> sockets;
+	sockets.reserve(burst);
+
+	while (n > 0) {
+		for (std::size_t i = 0; i < burst && n > 0; ++i, --n) {
+			UniqueSocketDescriptor s;
+			if (!s.Create(AF_INET, SOCK_STREAM, 0) ||
+			    !s.Connect(address))
+				return;
+
+			sockets.emplace_back(std::move(s));
+		}
+
+		sockets.clear();
+	}
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	std::size_t n = 20000, burst = 64;
+
+	if (argc > 1)
+		n = strtoul(argv[1], nullptr, 10);
+	if (argc > 2)
+		burst = strtoul(argv[2], nullptr, 10);
+
+	if (argc > 3 || n == 0 || burst == 0) {
+		fmt::print(stderr, "usage: {} [COUNT [BURST]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	EventLoop event_loop;
+
+	BenchServer server{event_loop, n};
+	server.Listen(IPv4Address{IPv4Address::Loopback(), 0});
+
+	const auto local_address = server.GetSocket().GetLocalAddress();
+	const IPv4Address address{IPv4Address::Loopback(),
+				  static_cast<uint16_t>(local_address.GetPort())};
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::thread client{RunClient, address, n, burst};
+	event_loop.Run();
+	client.join();
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	fmt::print("accepted {} connections in {:.3f}s: {:.0f} connections/s\n",
+		   server.GetAccepted(), duration.count(),
+		   server.GetAccepted() / duration.count());
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark for CidrSet: build a set of many random IPv4 and IPv6
+ * networks and measure lookups per second, compared with a linear
+ * scan of #MaskedSocketAddress objects.
+ */
+
+#include "net/CidrSet.hxx"
+#include "net/MaskedSocketAddress.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/IPv6Address.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "util/PrintException.hxx"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+static AllocatedSocketAddress
+RandomAddress(std::mt19937_64 &rng, bool ipv6) noexcept
+{
+	const auto r = rng();
+
+	if (ipv6) {
+		const auto r2 = rng();
+		return AllocatedSocketAddress{IPv6Address{
+			static_cast<uint16_t>(0x2001),
+			static_cast<uint16_t>(r >> 48),
+			static_cast<uint16_t>(r >> 32),
+			static_cast<uint16_t>(r >> 16),
+			static_cast<uint16_t>(r),
+			static_cast<uint16_t>(r2 >> 48),
+			static_cast<uint16_t>(r2 >> 32),
+			static_cast<uint16_t>(r2 >> 16),
+			0,
+		}};
+	} else
+		return AllocatedSocketAddress{IPv4Address{
+			static_cast<uint8_t>(r >> 24),
+			static_cast<uint8_t>(r >> 16),
+			static_cast<uint8_t>(r >> 8),
+			static_cast<uint8_t>(r),
+			0,
+		}};
+}
+
+/**
+ * Generate a random network (with all host bits cleared).
+ */
+static MaskedSocketAddress
+RandomNetwork(std::mt19937_64 &rng, bool ipv6) noexcept
+{
+	const auto address = RandomAddress(rng, ipv6);
+
+	if (ipv6) {
+		const uint_least8_t prefix_length = 32 + rng() % 97;
+		const auto &a = IPv6Address::Cast(address);
+		return {a & IPv6Address::MaskFromPrefix(prefix_length), prefix_length};
+	} else {
+		const uint_least8_t prefix_length = 8 + rng() % 25;
+		const auto &a = IPv4Address::Cast(address);
+		return {a & IPv4Address::MaskFromPrefix(prefix_length), prefix_length};
+	}
+}
+
+template<typename F>
+static void
+Bench(const char *name, std::span<const AllocatedSocketAddress> addresses,
+      F &&f)
+{
+	const auto start = Clock::now();
+
+	std::size_t n_hits = 0;
+	for (const auto &i : addresses)
+		if (f(i))
+			++n_hits;
+
+	const std::chrono::duration<double> duration = Clock::now() - start;
+
+	fmt::print("{}: {} lookups in {:.3f}s = {:.0f} lookups/s ({} hits)\n",
+		   name, addresses.size(), duration.count(),
+		   addresses.size() / duration.count(), n_hits);
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	const std::size_t n_networks = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000;
+	const std::size_t n_lookups = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100000;
+
+	std::mt19937_64 rng{42};
+
+	std::vector<MaskedSocketAddress> list;
+	list.reserve(n_networks);
+
+	CidrSet set;
+
+	for (std::size_t i = 0; i < n_networks; ++i) {
+		list.push_back(RandomNetwork(rng, i % 2 != 0));
+		set.Add(list.back());
+	}
+
+	set.Finish();
+
+	fmt::print("{} networks, {} merged ranges\n", n_networks, set.size());
+
+	std::vector<AllocatedSocketAddress> addresses;
+	addresses.reserve(n_lookups);
+	for (std::size_t i = 0; i < n_lookups; ++i)
+		addresses.push_back(RandomAddress(rng, i % 2 != 0));
+
+	Bench("CidrSet", addresses, [&set](SocketAddress a){
+		return set.Contains(a);
+	});
+
+	/* the linear scan is so slow that only a fraction of the
+	   addresses is looked up */
+	Bench("MaskedSocketAddress",
+	      std::span{addresses}.first(std::min<std::size_t>(addresses.size(), 1000)),
+	      [&list](SocketAddress a){
+		      for (const auto &i : list)
+			      if (i.Matches(a))
+				      return true;
+		      return false;
+	      });
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
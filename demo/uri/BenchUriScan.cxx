@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark for SkipUriChars(): compares the SIMD implementation
+ * with the scalar one on typical request URIs.
+ */
+
+#include "uri/Scan.hxx"
+#include "uri/Escape.hxx"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <string>
+
+#include <stdlib.h>
+
+using std::string_view_literals::operator""sv;
+
+static constexpr std::string_view uris[] = {
+	"/"sv,
+	"/index.html"sv,
+	"/static/js/vendor.3f2a9c1b.chunk.js"sv,
+	"/wp-content/uploads/2023/05/some-rather-long-file-name_with-words-1024x768.jpg"sv,
+	"/api/v2/users/12345/preferences/notifications/email/weekly-digest/settings"sv,
+	"/search/results/page/3/category/electronics%20and%20gadgets/sort/price-ascending"sv,
+};
+
+template<typename F>
+static double
+Measure(std::size_t n, F &&f) noexcept
+{
+	std::size_t sum = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < n; ++i)
+		for (const auto uri : uris)
+			sum += f(uri);
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	/* make sure the loop is not optimized away */
+	if (sum == 0)
+		abort();
+
+	return n * std::size(uris) / duration.count();
+}
+
+int
+main(int argc, char **argv) noexcept
+{
+	std::size_t n = 1000000;
+	if (argc > 1)
+		n = strtoul(argv[1], nullptr, 10);
+
+	if (argc > 2 || n == 0) {
+		fmt::print(stderr, "usage: {} [COUNT]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const double scalar = Measure(n, [](std::string_view uri){
+		return SkipUriCharsScalar(UriCharClass::PATH, uri);
+	});
+
+	const double simd = Measure(n, [](std::string_view uri){
+		return SkipUriChars(UriCharClass::PATH, uri);
+	});
+
+	fmt::print("path scan: scalar {:.0f}/s, SIMD {:.0f}/s ({:.2f}x)\n",
+		   scalar, simd, simd / scalar);
+
+	const double escape = Measure(n, [](std::string_view uri){
+		char buffer[256];
+		return UriEscape(buffer, uri);
+	});
+
+	fmt::print("escape: {:.0f}/s\n", escape);
+
+	return EXIT_SUCCESS;
+}
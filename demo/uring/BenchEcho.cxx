@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark comparing the io_uring modes of the #EventLoop
+ * (classic, COOP_TASKRUN, DEFER_TASKRUN, SQPOLL) on a socket echo
+ * workload: a client sends a small message over a socketpair(), the
+ * server echoes it, and the client waits for the reply before it
+ * sends the next one.
+ *
+ * For each mode, it prints the time per round trip and the number of
+ * system calls per round trip.  The system calls are counted by
+ * running the workload in a child process traced with ptrace(); the
+ * time is measured in a separate (untraced) run.
+ */
+
+#include "event/Loop.hxx"
+#include "event/uring/Config.hxx"
+#include "io/uring/Operation.hxx"
+#include "io/uring/Queue.hxx"
+#include "net/SocketPair.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/BindMethod.hxx"
+#include "util/PrintException.hxx"
+
+#include <fmt/format.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <tuple> // for std::tie()
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+class Step final : public Uring::Operation {
+	using Callback = BoundMethod<void(int res) noexcept>;
+	const Callback callback;
+
+public:
+	explicit Step(Callback _callback) noexcept
+		:callback(_callback) {}
+
+private:
+	/* virtual methods from class Uring::Operation */
+	void OnUringCompletion(int res) noexcept override {
+		callback(res);
+	}
+};
+
+class Echo {
+	EventLoop &event_loop;
+	Uring::Queue &queue;
+
+	UniqueSocketDescriptor client, server;
+
+	std::array<std::byte, 64> message{}, client_buffer, server_buffer;
+
+	Step client_send{BIND_THIS_METHOD(OnClientSend)};
+	Step client_receive{BIND_THIS_METHOD(OnClientReceive)};
+	Step server_send{BIND_THIS_METHOD(OnServerSend)};
+	Step server_receive{BIND_THIS_METHOD(OnServerReceive)};
+
+	unsigned remaining;
+
+	std::exception_ptr error;
+
+public:
+	Echo(EventLoop &_event_loop, unsigned n)
+		:event_loop(_event_loop), queue(*event_loop.GetUring()),
+		 remaining(n)
+	{
+		std::tie(client, server) = CreateSocketPair(SOCK_STREAM);
+	}
+
+	void Run() {
+		StartServerReceive();
+		StartClient();
+		event_loop.Run();
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+private:
+	void Fail(int res, const char *msg) noexcept {
+		error = std::make_exception_ptr(MakeErrno(-res, msg));
+		event_loop.Break();
+	}
+
+	void StartServerReceive() {
+		auto &s = queue.RequireSubmitEntry();
+		io_uring_prep_recv(&s, server.Get(),
+				   server_buffer.data(), server_buffer.size(), 0);
+		queue.Push(s, server_receive);
+	}
+
+	void StartClient() {
+		auto &s1 = queue.RequireSubmitEntry();
+		io_uring_prep_send(&s1, client.Get(),
+				   message.data(), message.size(), 0);
+		queue.Push(s1, client_send);
+
+		auto &s2 = queue.RequireSubmitEntry();
+		io_uring_prep_recv(&s2, client.Get(),
+				   client_buffer.data(), client_buffer.size(),
+				   MSG_WAITALL);
+		queue.Push(s2, client_receive);
+	}
+
+	void OnClientSend(int res) noexcept {
+		if (res < 0)
+			Fail(res, "Client send failed");
+	}
+
+	void OnClientReceive(int res) noexcept {
+		if (res < 0) {
+			Fail(res, "Client receive failed");
+			return;
+		}
+
+		if (--remaining == 0) {
+			/* shut down the server; this cancels its
+			   pending receive */
+			server.Shutdown();
+			return;
+		}
+
+		StartClient();
+	}
+
+	void OnServerReceive(int res) noexcept {
+		if (res <= 0) {
+			if (res < 0 && remaining > 0)
+				Fail(res, "Server receive failed");
+			return;
+		}
+
+		auto &s = queue.RequireSubmitEntry();
+		io_uring_prep_send(&s, server.Get(),
+				   server_buffer.data(), res, 0);
+		queue.Push(s, server_send);
+	}
+
+	void OnServerSend(int res) noexcept {
+		if (res < 0) {
+			Fail(res, "Server send failed");
+			return;
+		}
+
+		StartServerReceive();
+	}
+};
+
+static void
+RunEcho(const Uring::ManagerConfig &config, unsigned n)
+{
+	EventLoop event_loop;
+	event_loop.EnableUring(config);
+
+	Echo echo{event_loop, n};
+	echo.Run();
+}
+
+/**
+ * Run the given function in a child process traced with ptrace()
+ * and return the number of system calls it made (including the ones
+ * needed to exit).
+ */
+template<typename F>
+static uint_least64_t
+CountSyscalls(F &&f)
+{
+	const pid_t pid = fork();
+	if (pid < 0)
+		throw MakeErrno("fork() failed");
+
+	if (pid == 0) {
+		ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+		raise(SIGSTOP);
+
+		try {
+			f();
+			_exit(EXIT_SUCCESS);
+		} catch (...) {
+			PrintException(std::current_exception());
+			_exit(EXIT_FAILURE);
+		}
+	}
+
+	int status;
+	if (waitpid(pid, &status, 0) < 0)
+		throw MakeErrno("waitpid() failed");
+
+	if (!WIFSTOPPED(status))
+		throw std::runtime_error{"Failed to trace the child process"};
+
+	ptrace(PTRACE_SETOPTIONS, pid, nullptr,
+	       PTRACE_O_TRACESYSGOOD|PTRACE_O_EXITKILL);
+
+	/* each system call stops twice: at entry and at exit */
+	uint_least64_t n_stops = 0;
+	int signo = 0;
+
+	while (true) {
+		if (ptrace(PTRACE_SYSCALL, pid, nullptr, signo) < 0)
+			throw MakeErrno("ptrace() failed");
+
+		if (waitpid(pid, &status, 0) < 0)
+			throw MakeErrno("waitpid() failed");
+
+		if (WIFEXITED(status)) {
+			if (WEXITSTATUS(status) != EXIT_SUCCESS)
+				throw std::runtime_error{"Child process failed"};
+			break;
+		}
+
+		if (WIFSIGNALED(status))
+			throw std::runtime_error{"Child process was killed"};
+
+		signo = 0;
+		if (WSTOPSIG(status) == (SIGTRAP|0x80))
+			++n_stops;
+		else
+			/* deliver the signal */
+			signo = WSTOPSIG(status);
+	}
+
+	return (n_stops + 1) / 2;
+}
+
+static void
+Bench(const char *name, const Uring::ManagerConfig &config, unsigned n)
+{
+	try {
+		const auto start = Clock::now();
+		RunEcho(config, n);
+		const std::chrono::duration<double, std::micro> duration = Clock::now() - start;
+
+		/* subtract the setup and teardown cost, which is
+		   measured with a single round trip */
+		const auto base = CountSyscalls([&]{ RunEcho(config, 1); });
+		const auto total = CountSyscalls([&]{ RunEcho(config, n + 1); });
+
+		fmt::print("  {:<16} {:8.2f} us {:8.2f} syscalls per round trip\n",
+			   name, duration.count() / n,
+			   static_cast<double>(total - base) / n);
+	} catch (...) {
+		fmt::print("  {:<16} failed: ", name);
+		PrintException(std::current_exception());
+	}
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	if (argc > 3) {
+		fmt::print(stderr, "Usage: {} [N [SQPOLL_CPU]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n = argc >= 2 ? strtoul(argv[1], nullptr, 10) : 100000;
+	const int sqpoll_cpu = argc >= 3 ? atoi(argv[2]) : -1;
+
+	if (n == 0)
+		throw "Invalid number of round trips";
+
+	Bench("default", {}, n);
+
+	Bench("COOP_TASKRUN", {
+		.task_run = Uring::ManagerConfig::TaskRun::COOP,
+	}, n);
+
+	Bench("DEFER_TASKRUN", {
+		.task_run = Uring::ManagerConfig::TaskRun::DEFER,
+	}, n);
+
+	Bench("SQPOLL", {
+		.sqpoll = true,
+		.sqpoll_cpu = sqpoll_cpu,
+		.sqpoll_idle = std::chrono::milliseconds{100},
+	}, n);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark comparing RecursiveCopy() and RecursiveDelete() with
+ * their io_uring counterparts.  It creates a directory tree with
+ * N_DIRS*N_DIRS directories and N_FILES files in each of them
+ * (100k files by default) inside the given (empty) directory.
+ *
+ * Run it on the filesystem you are interested in (e.g. a network
+ * filesystem) and drop the caches between runs for meaningful
+ * results.
+ */
+
+#include "io/FileAt.hxx"
+#include "io/MakeDirectory.hxx"
+#include "io/Open.hxx"
+#include "io/RecursiveCopy.hxx"
+#include "io/RecursiveDelete.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "io/uring/RecursiveCopy.hxx"
+#include "io/uring/RecursiveDelete.hxx"
+#include "util/PrintException.hxx"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <span>
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+static void
+CreateTree(FileDescriptor parent, const char *name,
+	   unsigned n_dirs, unsigned n_files)
+{
+	static constexpr char data[] = "Hello, world!\n";
+
+	const auto top = MakeDirectory({parent, name});
+
+	for (unsigned i = 0; i < n_dirs; ++i) {
+		const auto a = MakeDirectory({top, fmt::format_int{i}.c_str()});
+
+		for (unsigned j = 0; j < n_dirs; ++j) {
+			const auto b = MakeDirectory({a, fmt::format_int{j}.c_str()});
+
+			for (unsigned k = 0; k < n_files; ++k) {
+				auto fd = OpenWriteOnly({b, fmt::format_int{k}.c_str()},
+							O_CREAT|O_EXCL);
+				fd.FullWrite(std::as_bytes(std::span{data, sizeof(data) - 1}));
+			}
+		}
+	}
+}
+
+template<typename F>
+static void
+Bench(const char *name, F &&f)
+{
+	const auto start = Clock::now();
+	f();
+	const std::chrono::duration<double> duration = Clock::now() - start;
+
+	fmt::print("  {:<24} {:8.3f} s\n", name, duration.count());
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	if (argc < 2 || argc > 4) {
+		fmt::print(stderr, "Usage: {} DIRECTORY [N_DIRS [N_FILES]]\n",
+			   argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n_dirs = argc >= 3 ? strtoul(argv[2], nullptr, 10) : 10;
+	const unsigned n_files = argc >= 4 ? strtoul(argv[3], nullptr, 10) : 1000;
+
+	const auto directory = OpenPath(argv[1], O_DIRECTORY);
+
+	fmt::print("creating {} files\n", n_dirs * n_dirs * n_files);
+	CreateTree(directory, "src", n_dirs, n_files);
+
+	Bench("RecursiveCopy", [&]{
+		RecursiveCopy({directory, "src"}, {directory, "dst1"});
+	});
+
+	Bench("Uring::RecursiveCopy", [&]{
+		Uring::RecursiveCopy({directory, "src"}, {directory, "dst2"});
+	});
+
+	Bench("RecursiveDelete", [&]{
+		RecursiveDelete({directory, "dst1"});
+	});
+
+	Bench("Uring::RecursiveDelete", [&]{
+		Uring::RecursiveDelete({directory, "dst2"});
+	});
+
+	RecursiveDelete({directory, "src"});
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Send a file (or a portion of it selected by a HTTP "Range" header
+ * value such as "bytes=100-199") to a TCP server with
+ * #UringSendFile, e.g.:
+ *
+ *   nc -l 1234 >out & UringSendFile localhost:1234 FILE bytes=100-199
+ */
+
+#include "net/AddressInfo.hxx"
+#include "net/Resolver.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "event/net/BufferedSocket.hxx"
+#include "event/net/ConnectSocket.hxx"
+#include "event/net/UringSendFile.hxx"
+#include "event/Loop.hxx"
+#include "event/ShutdownListener.hxx"
+#include "http/Range.hxx"
+#include "io/Open.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/PrintException.hxx"
+
+#include <liburing.h>
+
+#include <fmt/core.h>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+class SendFile final
+	: ConnectSocketHandler, BufferedSocketHandler, UringSendFileHandler
+{
+	ShutdownListener shutdown_listener;
+	ConnectSocket connect_socket;
+	BufferedSocket socket;
+	UringSendFile send_file;
+
+	UniqueFileDescriptor file;
+	const HttpRangeRequest range;
+
+	std::exception_ptr error;
+
+public:
+	[[nodiscard]]
+	SendFile(EventLoop &event_loop,
+		 UniqueFileDescriptor &&_file, const HttpRangeRequest &_range) noexcept
+		:shutdown_listener(event_loop, BIND_THIS_METHOD(OnShutdown)),
+		 connect_socket(event_loop, *this), socket(event_loop),
+		 send_file(socket, *this),
+		 file(std::move(_file)), range(_range)
+	{
+		shutdown_listener.Enable();
+	}
+
+	auto &GetEventLoop() const noexcept {
+		return socket.GetEventLoop();
+	}
+
+	void Start(SocketAddress address) noexcept {
+		connect_socket.Connect(address, std::chrono::seconds{10});
+	}
+
+	void Finish() {
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+private:
+	void Stop() noexcept {
+		shutdown_listener.Disable();
+		GetEventLoop().SetVolatile();
+	}
+
+	void Close() noexcept {
+		send_file.Cancel();
+		if (socket.IsValid())
+			socket.Close();
+		Stop();
+	}
+
+	void OnShutdown() noexcept {
+		if (connect_socket.IsPending())
+			connect_socket.Cancel();
+		else
+			Close();
+	}
+
+	/* virtual methods from class ConnectSocketHandler */
+	void OnSocketConnectSuccess(UniqueSocketDescriptor fd) noexcept override {
+		socket.Init(fd.Release(), FdType::FD_TCP, std::chrono::minutes{1}, *this);
+		socket.EnableUring(*GetEventLoop().GetUring());
+
+		try {
+			if (!send_file.Start(std::move(file), range)) {
+				fmt::print(stderr, "Nothing to send\n");
+				Close();
+			}
+		} catch (...) {
+			error = std::current_exception();
+			Close();
+		}
+	}
+
+	void OnSocketConnectError(std::exception_ptr e) noexcept override {
+		error = std::move(e);
+		Stop();
+	}
+
+	/* virtual methods from class BufferedSocketHandler */
+	BufferedResult OnBufferedData() override {
+		/* discard the response */
+		socket.DisposeConsumed(socket.ReadBuffer().size());
+		return BufferedResult::OK;
+	}
+
+	bool OnBufferedClosed() noexcept override {
+		Close();
+		return false;
+	}
+
+	bool OnBufferedWrite() override {
+		send_file.OnSocketWritable();
+		return true;
+	}
+
+	void OnBufferedError(std::exception_ptr e) noexcept override {
+		error = std::move(e);
+		Close();
+	}
+
+	/* virtual methods from class UringSendFileHandler */
+	void OnUringSendFileDone() noexcept override {
+		Close();
+	}
+
+	void OnUringSendFileError(std::exception_ptr e) noexcept override {
+		error = std::move(e);
+		Close();
+	}
+};
+
+int
+main(int argc, char **argv) noexcept
+try {
+	if (argc < 3 || argc > 4)
+		throw "Usage: UringSendFile HOST:PORT FILE [RANGE]";
+
+	static constexpr struct addrinfo hints{
+		.ai_flags = AI_ADDRCONFIG,
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+	};
+
+	const auto addresses = Resolve(argv[1], 80, &hints);
+
+	auto file = OpenReadOnly(argv[2]);
+
+	struct stat st;
+	if (fstat(file.Get(), &st) < 0 || !S_ISREG(st.st_mode))
+		throw "Not a regular file";
+
+	HttpRangeRequest range(st.st_size);
+	if (argc > 3) {
+		range.ParseRangeHeader(argv[3]);
+		if (range.type == HttpRangeRequest::Type::INVALID)
+			throw "Range not satisfiable";
+	}
+
+	EventLoop event_loop;
+	event_loop.EnableUring(1024, IORING_SETUP_SINGLE_ISSUER|IORING_SETUP_COOP_TASKRUN);
+
+	SendFile send_file{event_loop, std::move(file), range};
+
+	send_file.Start(addresses.GetBest());
+
+	event_loop.Run();
+
+	send_file.Finish();
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
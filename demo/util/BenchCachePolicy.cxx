@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// author: Max Kellermann <max.kellermann@gmail.com>
+
+/*
+ * Trace-driven hit rate benchmark for the #StaticCache eviction
+ * policies.  The trace is read from the file given on the command
+ * line (one key per line); without a file, a synthetic trace is
+ * generated: Zipf-distributed lookups interrupted by scans over
+ * one-off keys (like a crawler would cause).
+ */
+
+#include "util/StaticCache.hxx"
+#include "util/PrintException.hxx"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+using Trace = std::vector<uint_least64_t>;
+
+static Trace
+LoadTrace(const char *path)
+{
+	std::ifstream file{path};
+	if (!file)
+		throw std::runtime_error{fmt::format("Failed to open {}", path)};
+
+	Trace trace;
+	const std::hash<std::string_view> hash;
+
+	std::string line;
+	while (std::getline(file, line))
+		trace.push_back(hash(line));
+
+	return trace;
+}
+
+static Trace
+GenerateTrace()
+{
+	static constexpr std::size_t N_KEYS = 100000;
+	static constexpr std::size_t N_LOOKUPS = 2000000;
+	static constexpr std::size_t SCAN_INTERVAL = 100000;
+	static constexpr std::size_t SCAN_LENGTH = 20000;
+
+	/* cumulative distribution of a Zipf distribution with
+	   s=0.9 */
+	std::vector<double> cdf;
+	cdf.reserve(N_KEYS);
+	double sum = 0;
+	for (std::size_t i = 1; i <= N_KEYS; ++i) {
+		sum += 1.0 / std::pow(static_cast<double>(i), 0.9);
+		cdf.push_back(sum);
+	}
+
+	std::mt19937_64 rng{42};
+	std::uniform_real_distribution<double> uniform{0, sum};
+
+	Trace trace;
+	trace.reserve(N_LOOKUPS + N_LOOKUPS / SCAN_INTERVAL * SCAN_LENGTH);
+
+	uint_least64_t next_scan_key = N_KEYS;
+
+	for (std::size_t i = 0; i < N_LOOKUPS; ++i) {
+		if (i % SCAN_INTERVAL == SCAN_INTERVAL - 1)
+			for (std::size_t j = 0; j < SCAN_LENGTH; ++j)
+				trace.push_back(next_scan_key++);
+
+		const auto r = uniform(rng);
+		trace.push_back(std::lower_bound(cdf.begin(), cdf.end(), r) - cdf.begin());
+	}
+
+	return trace;
+}
+
+template<std::size_t max_size, typename Policy>
+static void
+Run(const char *name, const Trace &trace)
+{
+	using Cache = StaticCache<uint_least64_t, uint_least64_t,
+				  max_size, max_size * 2 - 1,
+				  std::hash<uint_least64_t>,
+				  std::equal_to<uint_least64_t>,
+				  Policy>;
+	const auto cache = std::make_unique<Cache>();
+
+	std::size_t n_hits = 0;
+
+	const auto start = Clock::now();
+
+	for (const auto key : trace) {
+		if (cache->Get(key) != nullptr)
+			++n_hits;
+		else
+			cache->Put(key, key);
+	}
+
+	const std::chrono::duration<double> duration = Clock::now() - start;
+
+	fmt::print("  {:10}: hit rate {:5.2f}%, {:.1f}ns per lookup\n",
+		   name, 100.0 * n_hits / trace.size(),
+		   duration.count() * 1e9 / trace.size());
+}
+
+template<std::size_t max_size>
+static void
+Run(const Trace &trace)
+{
+	fmt::print("{} items:\n", max_size);
+	Run<max_size, LruCachePolicy>("LRU", trace);
+	Run<max_size, WTinyLfuCachePolicy<>>("W-TinyLFU", trace);
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	const Trace trace = argc > 1
+		? LoadTrace(argv[1])
+		: GenerateTrace();
+
+	fmt::print("{} lookups\n", trace.size());
+
+	Run<1000>(trace);
+	Run<10000>(trace);
+	Run<50000>(trace);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark for the string hash functions djb_hash(), FNV1aHash64()
+ * and WyHash() with various key lengths.
+ */
+
+#include "util/djb_hash.hxx"
+#include "util/FNVHash.hxx"
+#include "util/WyHash.hxx"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Hash this many bytes per key length and function.
+ */
+static constexpr std::size_t TOTAL_BYTES = 256 * 1024 * 1024;
+
+template<typename F>
+static void
+Bench(const char *name, std::span<const std::byte> buffer,
+      std::size_t length, F &&f)
+{
+	const std::size_t n_keys = buffer.size() - length;
+	const std::size_t n = TOTAL_BYTES / length;
+
+	/* accumulate the result so the compiler can't optimize
+	   the calls away */
+	uint_least64_t sum = 0;
+
+	const auto start = Clock::now();
+
+	for (std::size_t i = 0; i < n; ++i)
+		sum += f(buffer.subspan(i % n_keys, length));
+
+	const std::chrono::duration<double> duration = Clock::now() - start;
+
+	fmt::print("  {:<12} {:8.2f} ns/key {:8.2f} GB/s  ({:x})\n",
+		   name,
+		   duration.count() * 1e9 / n,
+		   TOTAL_BYTES / duration.count() / 1e9,
+		   sum & 0xf);
+}
+
+int
+main(int, char **) noexcept
+{
+	/* a buffer with arbitrary data; keys are taken at various
+	   (unaligned) offsets */
+	std::vector<std::byte> buffer(4096 + 64);
+	for (std::size_t i = 0; i < buffer.size(); ++i)
+		buffer[i] = static_cast<std::byte>('a' + i * 7 % 26);
+
+	for (const std::size_t length : {4, 8, 16, 32, 64, 256, 1024, 4096}) {
+		fmt::print("{} bytes:\n", length);
+
+		Bench("djb_hash", buffer, length, [](std::span<const std::byte> s){
+			return djb_hash(s);
+		});
+
+		Bench("FNV1aHash64", buffer, length, [](std::span<const std::byte> s){
+			return FNV1aHash64(s);
+		});
+
+		Bench("WyHash", buffer, length, [](std::span<const std::byte> s){
+			return WyHash(s, 0x123456789abcdefULL);
+		});
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark comparing lookups in #IntrusiveHashSet,
+ * #IntrusiveHashArrayTrie, #FlatPointerSet and #FlatHashMap with
+ * integer keys.  The items are allocated individually on the heap
+ * (in random order), like they would be in a real application.
+ */
+
+#include "util/DeleteDisposer.hxx"
+#include "util/FlatHashMap.hxx"
+#include "util/FlatPointerSet.hxx"
+#include "util/IntrusiveHashArrayTrie.hxx"
+#include "util/IntrusiveHashSet.hxx"
+
+#include <fmt/core.h>
+
+#include <algorithm> // for std::shuffle()
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Perform this many lookups per container and size.
+ */
+static constexpr std::size_t N_LOOKUPS = 8 * 1024 * 1024;
+
+struct KeyHash {
+	constexpr std::size_t operator()(uint64_t key) const noexcept {
+		return key * 0x9e3779b97f4a7c15ULL;
+	}
+};
+
+struct Item final
+	: IntrusiveHashSetHook<>, IntrusiveHashArrayTrieHook<>
+{
+	const uint64_t key;
+	uint64_t value;
+
+	explicit Item(uint64_t _key) noexcept
+		:key(_key), value(_key ^ 0x5555) {}
+
+	struct GetKey {
+		constexpr uint64_t operator()(const Item &item) const noexcept {
+			return item.key;
+		}
+	};
+};
+
+using ItemHashSet =
+	IntrusiveHashSet<Item, 8191,
+			 IntrusiveHashSetOperators<Item, Item::GetKey,
+						   KeyHash, std::equal_to<uint64_t>>>;
+
+using ItemHashArrayTrie =
+	IntrusiveHashArrayTrie<Item,
+			       IntrusiveHashArrayTrieOperators<Item, Item::GetKey,
+							       KeyHash, std::equal_to<uint64_t>>>;
+
+using ItemPointerSet =
+	FlatPointerSet<Item,
+		       IntrusiveHashSetOperators<Item, Item::GetKey,
+						 KeyHash, std::equal_to<uint64_t>>>;
+
+using ItemMap = FlatHashMap<uint64_t, Item *, KeyHash>;
+
+/**
+ * @param keys the keys to look up (hits and misses)
+ */
+template<typename F>
+static void
+Bench(const char *name, const std::vector<uint64_t> &keys, F &&f)
+{
+	/* accumulate the result so the compiler can't optimize
+	   the calls away */
+	uint_least64_t sum = 0;
+
+	const auto start = Clock::now();
+
+	for (std::size_t i = 0; i < N_LOOKUPS; ++i) {
+		const Item *item = f(keys[i % keys.size()]);
+		if (item != nullptr)
+			sum += item->value;
+	}
+
+	const std::chrono::duration<double> duration = Clock::now() - start;
+
+	fmt::print("  {:<24} {:8.2f} ns/lookup  ({:x})\n",
+		   name,
+		   duration.count() * 1e9 / N_LOOKUPS,
+		   sum & 0xf);
+}
+
+static void
+BenchAll(const char *label, const std::vector<uint64_t> &keys,
+	 ItemHashSet &hash_set, ItemHashArrayTrie &trie,
+	 ItemPointerSet &pointer_set, ItemMap &map)
+{
+	fmt::print(" {}:\n", label);
+
+	Bench("IntrusiveHashSet", keys, [&hash_set](uint64_t key) -> const Item * {
+		auto i = hash_set.find(key);
+		return i != hash_set.end() ? &*i : nullptr;
+	});
+
+	Bench("IntrusiveHashArrayTrie", keys, [&trie](uint64_t key) -> const Item * {
+		auto i = trie.find(key);
+		return i != trie.end() ? &*i : nullptr;
+	});
+
+	Bench("FlatPointerSet", keys, [&pointer_set](uint64_t key) -> const Item * {
+		return pointer_set.find(key);
+	});
+
+	Bench("FlatHashMap", keys, [&map](uint64_t key) -> const Item * {
+		const auto *i = map.find(key);
+		return i != nullptr ? i->value : nullptr;
+	});
+}
+
+static void
+BenchSize(std::size_t n_items)
+{
+	fmt::print("{} items:\n", n_items);
+
+	std::mt19937_64 rng{n_items};
+
+	std::vector<uint64_t> keys(n_items), misses(n_items);
+	for (auto &i : keys)
+		i = rng();
+	for (auto &i : misses)
+		i = rng();
+
+	ItemHashSet hash_set;
+	ItemHashArrayTrie trie;
+	ItemPointerSet pointer_set;
+	ItemMap map;
+
+	for (const uint64_t key : keys) {
+		auto *item = new Item(key);
+		hash_set.insert(*item);
+		trie.insert(*item);
+		pointer_set.insert(*item);
+		map.insert(key, item);
+	}
+
+	/* look up in a different order than inserted */
+	std::shuffle(keys.begin(), keys.end(), rng);
+
+	BenchAll("hits", keys, hash_set, trie, pointer_set, map);
+	BenchAll("misses", misses, hash_set, trie, pointer_set, map);
+
+	hash_set.clear();
+	trie.clear();
+	map.clear();
+	pointer_set.clear_and_dispose(DeleteDisposer{});
+}
+
+int
+main(int, char **) noexcept
+{
+	for (const std::size_t n_items : {16, 1024, 100000})
+		BenchSize(n_items);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Benchmark for Was::SimpleServer: sends requests with typical
+ * headers and parameters over a local WAS connection and compares
+ * the throughput and the number of heap allocations of a
+ * #SimpleRequestHandler with a #CompactRequestHandler.
+ */
+
+#include "was/async/SimpleServer.hxx"
+#include "was/async/SimpleClient.hxx"
+#include "was/async/Socket.hxx"
+#include "event/Loop.hxx"
+#include "util/Cancellable.hxx"
+#include "util/PrintException.hxx"
+#include "DefaultFifoBuffer.hxx"
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+static std::atomic_size_t n_allocations;
+
+void *
+operator new(std::size_t size)
+{
+	++n_allocations;
+
+	if (void *p = std::malloc(size))
+		return p;
+
+	throw std::bad_alloc{};
+}
+
+void
+operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+using std::string_view_literals::operator""sv;
+
+struct ServerHandler final : Was::SimpleServerHandler {
+	void OnWasError(Was::SimpleServer &,
+			std::exception_ptr error) noexcept override {
+		PrintException(error);
+		std::exit(EXIT_FAILURE);
+	}
+
+	void OnWasClosed(Was::SimpleServer &) noexcept override {}
+};
+
+struct ClientHandler final : Was::SimpleClientHandler {
+	void OnWasError(std::exception_ptr error) noexcept override {
+		PrintException(error);
+		std::exit(EXIT_FAILURE);
+	}
+
+	void OnWasClosed() noexcept override {}
+};
+
+class ResponseHandler final : public Was::SimpleResponseHandler {
+	EventLoop &event_loop;
+
+public:
+	explicit ResponseHandler(EventLoop &_event_loop) noexcept
+		:event_loop(_event_loop) {}
+
+	void OnWasResponse(Was::SimpleResponse &&) noexcept override {
+		event_loop.Break();
+	}
+
+	void OnWasError(std::exception_ptr error) noexcept override {
+		PrintException(error);
+		std::exit(EXIT_FAILURE);
+	}
+};
+
+/**
+ * Looks up a few headers, like a real application would.
+ */
+struct SimpleHandler final : Was::SimpleRequestHandler {
+	std::size_t n = 0;
+
+	bool OnRequest(Was::SimpleServer &server, Was::SimpleRequest &&request,
+		       CancellablePointer &) noexcept override {
+		if (request.headers.find("user-agent"sv) != request.headers.end() &&
+		    request.parameters.find("foo"sv) != request.parameters.end())
+			++n;
+
+		return server.SendResponse({});
+	}
+};
+
+struct CompactHandler final : Was::CompactRequestHandler {
+	std::size_t n = 0;
+
+	bool OnCompactRequest(Was::SimpleServer &server,
+			      Was::CompactRequest &&request,
+			      CancellablePointer &) noexcept override {
+		if (request.GetHeader("user-agent"sv).data() != nullptr &&
+		    request.GetParameter("foo"sv).data() != nullptr)
+			++n;
+
+		return server.SendResponse({});
+	}
+};
+
+static Was::SimpleRequest
+MakeRequest() noexcept
+{
+	return {
+		.parameters = {
+			{"foo", "bar"},
+			{"document_root", "/var/www/example.com/htdocs"},
+		},
+		.method = HttpMethod::GET,
+		.uri = "/api/v2/users/12345/preferences?format=json",
+		.script_name = "/api",
+		.path_info = "/v2/users/12345/preferences",
+		.query_string = "format=json",
+		.headers = {
+			{"host", "www.example.com"},
+			{"user-agent", "Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0"},
+			{"accept", "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"},
+			{"accept-language", "en-US,en;q=0.5"},
+			{"accept-encoding", "gzip, deflate, br"},
+			{"cookie", "session=0123456789abcdef0123456789abcdef; theme=dark"},
+			{"referer", "https://www.example.com/index.html"},
+			{"x-forwarded-for", "192.0.2.1"},
+		},
+	};
+}
+
+struct Result {
+	double requests_per_second;
+	double allocations_per_request;
+};
+
+static Result
+Measure(Was::CompactRequestHandler &request_handler, std::size_t n)
+{
+	auto [for_client, for_server] = WasSocket::CreatePair();
+
+	EventLoop event_loop;
+
+	ServerHandler server_handler;
+	Was::SimpleServer server{event_loop, std::move(for_server),
+				 server_handler, request_handler};
+
+	ClientHandler client_handler;
+	Was::SimpleClient client{event_loop, std::move(for_client),
+				 client_handler};
+
+	ResponseHandler response_handler{event_loop};
+	CancellablePointer cancel_ptr;
+
+	const std::size_t allocations_before = n_allocations;
+	const auto start = std::chrono::steady_clock::now();
+
+	for (std::size_t i = 0; i < n; ++i) {
+		client.SendRequest(MakeRequest(), response_handler, cancel_ptr);
+		event_loop.Run();
+	}
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+	const std::size_t allocations = n_allocations - allocations_before;
+
+	client.Close();
+	server.Close();
+
+	return {
+		n / duration.count(),
+		double(allocations) / n,
+	};
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	std::size_t n = 100000;
+	if (argc > 1)
+		n = strtoul(argv[1], nullptr, 10);
+
+	if (argc > 2 || n == 0) {
+		fmt::print(stderr, "usage: {} [COUNT]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	[[maybe_unused]]
+	const ScopeInitDefaultFifoBuffer init_default_fifo_buffer;
+
+	SimpleHandler simple_handler;
+	const auto simple = Measure(simple_handler, n);
+
+	CompactHandler compact_handler;
+	const auto compact = Measure(compact_handler, n);
+
+	if (simple_handler.n != n || compact_handler.n != n) {
+		fmt::print(stderr, "lookup failed\n");
+		return EXIT_FAILURE;
+	}
+
+	/* note: the allocation count includes the client, which
+	   builds a SimpleRequest for each request */
+	fmt::print("SimpleRequest: {:.0f} requests/s, {:.1f} allocations/request\n",
+		   simple.requests_per_second, simple.allocations_per_request);
+	fmt::print("CompactRequest: {:.0f} requests/s, {:.1f} allocations/request ({:.2f}x)\n",
+		   compact.requests_per_second, compact.allocations_per_request,
+		   compact.requests_per_second / simple.requests_per_second);
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
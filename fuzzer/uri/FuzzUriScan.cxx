@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Differential fuzzer comparing the SIMD implementation of
+ * SkipUriChars() with the scalar one, and checking that
+ * UriUnescape() reverses UriEscape().
+ */
+
+#include "uri/Scan.hxx"
+#include "uri/Escape.hxx"
+#include "uri/Unescape.hxx"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+
+extern "C" {
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	const std::string_view input{(const char *)data, size};
+
+	for (const auto c : {UriCharClass::UNRESERVED, UriCharClass::PCHAR,
+			     UriCharClass::PATH, UriCharClass::QUERY})
+		if (SkipUriChars(c, input) != SkipUriCharsScalar(c, input))
+			abort();
+
+	if (input.find('\0') == input.npos) {
+		const auto escaped = std::make_unique<char[]>(size * 3);
+		const std::size_t escaped_length = UriEscape(escaped.get(), input);
+		if (SkipUriChars(UriCharClass::PCHAR, {escaped.get(), escaped_length}) != escaped_length)
+			abort();
+
+		const auto unescaped = std::make_unique<char[]>(escaped_length);
+		const char *end = UriUnescape(unescaped.get(),
+					      {escaped.get(), escaped_length});
+		if (end == nullptr ||
+		    std::string_view(unescaped.get(), end) != input)
+			abort();
+	}
+
+	return 0;
+}
@@ -5,12 +5,14 @@
 #pragma once
 
 #include "InvokeTask.hxx"
+#include "util/DeleteDisposer.hxx"
 #include "util/StaticCache.hxx"
 #include "util/IntrusiveList.hxx"
 
 #include <concepts>
 #include <memory>
 #include <optional>
+#include <variant>
 
 namespace Co {
 
@@ -20,8 +22,26 @@ namespace Co {
  * getter method.
  *
  * @param Factory a factory class whose operator() returns a Coroutine
- * promise; it may optionally have a method `bool IsCacheable(const
- * Data&) const`
+ * promise; it may optionally have these methods:
+ *
+ * - `bool IsCacheable(const Data &) const`
+ *
+ * - `TimePoint Now() const` returns the current time (e.g. from
+ *   EventLoop::SteadyNow()); this is required by the following
+ *   methods
+ *
+ * - `Duration GetTimeToLive(const Data &) const` enables expiry; the
+ *   item expires after the returned duration (zero means "don't
+ *   store")
+ *
+ * - `Duration GetErrorTimeToLive(std::exception_ptr) const` enables
+ *   negative caching: the error is stored for the returned duration
+ *   (zero means "don't store"), and further lookups rethrow it
+ *
+ * - `Duration GetMaxStale() const` enables stale-while-revalidate:
+ *   for this duration after expiry, lookups return the expired value
+ *   immediately while one background request refreshes it; if the
+ *   refresh fails, the stale value remains
  */
 template<typename Factory, typename Key, typename Data,
 	 std::size_t max_size,
@@ -43,12 +63,121 @@ class Cache {
 		}
 	};
 
+	static constexpr bool has_clock = requires(const Factory &f) {
+		f.Now();
+	};
+
+	static constexpr bool has_ttl = requires(const Factory &f, const Data &data) {
+		f.GetTimeToLive(data);
+	};
+
+	static constexpr bool has_negative = requires(const Factory &f, std::exception_ptr error) {
+		f.GetErrorTimeToLive(error);
+	};
+
+	static constexpr bool has_stale = requires(const Factory &f) {
+		f.GetMaxStale();
+	};
+
+	static_assert(has_clock || !(has_ttl || has_negative || has_stale),
+		      "Factory::Now() is required for expiry");
+	static_assert(has_ttl || !has_stale,
+		      "Factory::GetMaxStale() requires Factory::GetTimeToLive()");
+
+	struct NoTimePoint {};
+
+	template<typename F>
+	struct GetTimePoint {
+		using type = NoTimePoint;
+	};
+
+	template<typename F>
+	requires requires(const F &f) { f.Now(); }
+	struct GetTimePoint<F> {
+		using type = std::remove_cvref_t<decltype(std::declval<const F &>().Now())>;
+	};
+
+	using TimePoint = typename GetTimePoint<Factory>::type;
+
+	struct Item {
+		/**
+		 * The cached value or (with negative caching) the
+		 * cached error.
+		 */
+		std::conditional_t<has_negative,
+				   std::variant<Data, std::exception_ptr>,
+				   Data> value;
+
+		/**
+		 * The time when this item expires.  Only used if
+		 * #Factory has a Now() method.
+		 */
+		[[no_unique_address]]
+		TimePoint expires;
+	};
+
 	[[no_unique_address]]
 	Factory factory;
 
-	using Cache_ = StaticCache<Key, Data, max_size, table_size, Hash, Equal>;
+	using Cache_ = StaticCache<Key, Item, max_size, table_size, Hash, Equal>;
 	Cache_ cache;
 
+public:
+	struct Stats {
+		/**
+		 * Lookups which were answered from a fresh cache item
+		 * (including cached errors).
+		 */
+		std::size_t hits;
+
+		/**
+		 * Lookups which had to wait for the factory (either a
+		 * new request or a pending one).
+		 */
+		std::size_t misses;
+
+		/**
+		 * Lookups which were answered with an expired item
+		 * while it was being refreshed.
+		 */
+		std::size_t stale;
+	};
+
+private:
+	Stats stats{};
+
+	template<typename I>
+	static auto *GetData(I &item) noexcept {
+		if constexpr (has_negative)
+			return std::get_if<Data>(&item.value);
+		else
+			return &item.value;
+	}
+
+	/**
+	 * Is this item not yet expired?
+	 */
+	[[gnu::pure]]
+	bool IsFresh(const Item &item) const noexcept {
+		if constexpr (has_clock)
+			return factory.Now() < item.expires;
+		else
+			return true;
+	}
+
+	/**
+	 * Shall this expired item be returned while it is being
+	 * refreshed?
+	 */
+	[[gnu::pure]]
+	bool CanServeStale(const Item &item) const noexcept {
+		if constexpr (has_stale)
+			return GetData(item) != nullptr &&
+				factory.Now() - item.expires < factory.GetMaxStale();
+		else
+			return false;
+	}
+
 	struct Request;
 
 	struct Handler : IntrusiveListHook<IntrusiveHookMode::NORMAL> {
@@ -124,6 +253,13 @@ class Cache {
 		{
 		}
 
+		explicit Task(const Item &item) noexcept {
+			if (const auto *data = GetData(item))
+				handler.reset(new Handler(*data));
+			else if constexpr (has_negative)
+				handler.reset(new Handler(std::get<std::exception_ptr>(item.value)));
+		}
+
 		bool IsReady() const noexcept {
 			return handler->IsReady();
 		}
@@ -168,6 +304,12 @@ class Cache {
 
 		bool store = true;
 
+		/**
+		 * Is this a stale-while-revalidate refresh?  It keeps
+		 * running even if nobody waits for it.
+		 */
+		bool background = false;
+
 		template<typename K>
 		Request(Cache &_cache, K &&_key) noexcept
 			:cache(_cache), key(std::forward<K>(_key)) {}
@@ -177,7 +319,7 @@ class Cache {
 		}
 
 		bool IsAbandoned() const noexcept {
-			return handlers.empty();
+			return handlers.empty() && !background;
 		}
 
 		void Resume() noexcept {
@@ -202,14 +344,18 @@ class Cache {
 			if (store && !IsCacheable<Factory>{}(factory, value))
 				store = false;
 
-			if (store)
-				cache.cache.Put(std::move(key),
-						std::move(value));
+			if (store) {
+				/* clear the flag so OnCompletion() does
+				   not attempt to store an exception
+				   thrown by Store() */
+				store = false;
+				cache.Store(std::move(key), std::move(value));
+			}
 		}
 
 		void Start(Factory &factory) noexcept {
 			assert(!task);
-			assert(!handlers.empty());
+			assert(background || !handlers.empty());
 
 			task = Run(factory);
 			task.Start(BIND_THIS_METHOD(OnCompletion));
@@ -218,10 +364,16 @@ class Cache {
 		void OnCompletion(std::exception_ptr error) noexcept {
 			assert(!task);
 
-			if (error)
+			if (error) {
 				for (auto &i : handlers)
 					i.error = error;
 
+				/* if a background refresh fails, the
+				   stale value remains in the cache */
+				if (store && !background)
+					cache.StoreError(std::move(key), error);
+			}
+
 			Resume();
 			delete this;
 		}
@@ -229,6 +381,60 @@ class Cache {
 
 	IntrusiveList<Request> requests;
 
+	template<typename K>
+	[[gnu::pure]]
+	Request *FindRequest(const K &key) noexcept {
+		for (auto &i : requests)
+			if (i.store && !i.IsDone() && key_eq()(i.key, key))
+				return &i;
+
+		return nullptr;
+	}
+
+	template<typename K>
+	Request &StartRequest(K &&key, bool background=false) {
+		auto *request = new Request(*this, std::forward<K>(key));
+		request->background = background;
+		requests.push_back(*request);
+		return *request;
+	}
+
+	void Store(Key &&key, Data &&data) {
+		if constexpr (has_ttl) {
+			const auto ttl = factory.GetTimeToLive(data);
+			if (ttl <= decltype(ttl)::zero())
+				return;
+
+			cache.PutOrReplace(std::move(key),
+					   Item{std::move(data), factory.Now() + ttl});
+		} else if constexpr (has_clock) {
+			/* never expires */
+			cache.PutOrReplace(std::move(key),
+					   Item{std::move(data), TimePoint::max()});
+		} else {
+			cache.PutOrReplace(std::move(key),
+					   Item{std::move(data)});
+		}
+	}
+
+	void StoreError(Key &&key, std::exception_ptr error) noexcept {
+		if constexpr (has_negative) {
+			const auto ttl = factory.GetErrorTimeToLive(error);
+			if (ttl <= decltype(ttl)::zero())
+				return;
+
+			try {
+				cache.PutOrReplace(std::move(key),
+						   Item{std::move(error), factory.Now() + ttl});
+			} catch (...) {
+				/* ignore, this is just a cache */
+			}
+		} else {
+			(void)key;
+			(void)error;
+		}
+	}
+
 public:
 	using hasher = typename Cache_::hasher;
 	using key_equal = typename Cache_::key_equal;
@@ -237,6 +443,24 @@ public:
 	explicit Cache(P&&... _params) noexcept
 		:factory(std::forward<P>(_params)...) {}
 
+	~Cache() noexcept {
+		/* cancel background refreshes nobody waits for */
+		requests.remove_and_dispose_if([](const Request &request){
+			return request.handlers.empty();
+		}, DeleteDisposer{});
+	}
+
+	Cache(const Cache &) = delete;
+	Cache &operator=(const Cache &) = delete;
+
+	Factory &GetFactory() noexcept {
+		return factory;
+	}
+
+	const Stats &GetStats() const noexcept {
+		return stats;
+	}
+
 	decltype(auto) hash_function() const noexcept {
 		return cache.hash_function();
 	}
@@ -245,25 +469,54 @@ public:
 		return cache.key_eq();
 	}
 
+	/**
+	 * Look up a fresh value in the cache (without invoking the
+	 * factory).  Returns nullptr if there is no such value (or
+	 * if an error is cached).
+	 */
 	template<typename K>
 	[[gnu::pure]]
-	decltype(auto) GetIfCached(K &&key) noexcept {
-		return cache.Get(std::forward<K>(key));
+	Data *GetIfCached(K &&key) noexcept {
+		auto *item = cache.Get(std::forward<K>(key));
+		if (item == nullptr || !IsFresh(*item))
+			return nullptr;
+
+		return GetData(*item);
 	}
 
 	template<typename K>
 	Task Get(K &&key) {
-		if (auto *cached = GetIfCached(key))
-			return Task(*cached);
+		if (auto *item = cache.Get(key)) {
+			if (IsFresh(*item)) {
+				++stats.hits;
+				return Task(*item);
+			}
 
-		for (auto &i : requests)
-			if (i.store && !i.IsDone() && key_eq()(i.key, key))
-				return Task(i);
+			if (CanServeStale(*item)) {
+				++stats.stale;
 
-		auto *request = new Request(*this, std::forward<K>(key));
-		requests.push_back(*request);
-		Task task(*request);
-		request->Start(factory);
+				/* copy the stale value before starting
+				   the refresh, which may replace the
+				   item synchronously */
+				Task task(*item);
+
+				if (FindRequest(key) == nullptr)
+					StartRequest(std::forward<K>(key), true).Start(factory);
+
+				return task;
+			}
+
+			cache.RemoveItem(*item);
+		}
+
+		++stats.misses;
+
+		if (auto *request = FindRequest(key))
+			return Task(*request);
+
+		auto &request = StartRequest(std::forward<K>(key));
+		Task task(request);
+		request.Start(factory);
 		return task;
 	}
 
@@ -292,7 +545,10 @@ public:
 		   requests, so unfortunately, pending requests may
 		   result in stale cache items */
 
-		cache.RemoveIf(p);
+		cache.RemoveIf([&p](const Key &key, const Item &item){
+			const Data *data = GetData(item);
+			return data != nullptr && p(key, *data);
+		});
 	}
 };
 
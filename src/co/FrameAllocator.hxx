@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "util/Poison.hxx"
+#include "util/Sanitizer.hxx"
+
+#include <array>
+#include <cstddef>
+#include <new>
+
+namespace Co {
+
+/**
+ * A per-thread cache for coroutine frames.  Frame sizes are rounded
+ * up to size classes, and freed frames are kept in one free list per
+ * size class, to be reused by the next coroutine of the same size
+ * class without calling malloc()/free().
+ *
+ * A frame may be freed by a different thread than the one which
+ * allocated it; it then migrates to that thread's cache.
+ *
+ * With AddressSanitizer, frames are never cached, so use-after-free
+ * bugs are still detected.
+ */
+class FrameAllocator {
+public:
+	/**
+	 * The size classes are multiples of this.
+	 */
+	static constexpr std::size_t GRANULARITY = 64;
+
+	static constexpr std::size_t N_SIZE_CLASSES = 16;
+
+	/**
+	 * Larger frames are not cached.
+	 */
+	static constexpr std::size_t MAX_SIZE = GRANULARITY * N_SIZE_CLASSES;
+
+	/**
+	 * The maximum number of free frames per size class; more are
+	 * returned to the heap.
+	 */
+	static constexpr std::size_t MAX_FREE = 256;
+
+private:
+	struct FreeFrame {
+		FreeFrame *next;
+	};
+
+	struct SizeClass {
+		FreeFrame *head = nullptr;
+		std::size_t n_free = 0;
+	};
+
+	std::array<SizeClass, N_SIZE_CLASSES> size_classes{};
+
+	/**
+	 * Set by the destructor when this thread exits.  Frames freed
+	 * after that (e.g. by destructors of other thread-local or
+	 * static objects) bypass the cache.  This variable is
+	 * trivially destructible, therefore it remains accessible
+	 * after the #FrameAllocator instance has been destroyed.
+	 */
+	static inline thread_local constinit bool destroyed = false;
+
+	constexpr FrameAllocator() noexcept = default;
+
+	~FrameAllocator() noexcept {
+		Clear();
+		destroyed = true;
+	}
+
+	FrameAllocator(const FrameAllocator &) = delete;
+	FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+	static FrameAllocator &GetInstance() noexcept {
+		static thread_local FrameAllocator instance;
+		return instance;
+	}
+
+	static constexpr bool IsCacheable(std::size_t size) noexcept {
+		return !HaveAddressSanitizer() && size > 0 && size <= MAX_SIZE;
+	}
+
+	static constexpr std::size_t GetSizeClass(std::size_t size) noexcept {
+		return (size - 1) / GRANULARITY;
+	}
+
+	static constexpr std::size_t GetClassSize(std::size_t size_class) noexcept {
+		return (size_class + 1) * GRANULARITY;
+	}
+
+	void Clear() noexcept {
+		for (std::size_t i = 0; i < N_SIZE_CLASSES; ++i) {
+			auto &c = size_classes[i];
+			while (c.head != nullptr) {
+				FreeFrame *f = c.head;
+				c.head = f->next;
+				::operator delete(f, GetClassSize(i));
+			}
+
+			c.n_free = 0;
+		}
+	}
+
+public:
+	[[nodiscard]] [[gnu::malloc]] [[gnu::returns_nonnull]]
+	static void *Allocate(std::size_t size) {
+		if (!IsCacheable(size))
+			return ::operator new(size);
+
+		const std::size_t size_class = GetSizeClass(size);
+
+		if (!destroyed) {
+			auto &c = GetInstance().size_classes[size_class];
+			if (FreeFrame *f = c.head; f != nullptr) {
+				c.head = f->next;
+				--c.n_free;
+
+				PoisonUndefined(f, GetClassSize(size_class));
+				return f;
+			}
+		}
+
+		/* always allocate the whole size class, so the
+		   frame can be reused for any other frame of this
+		   class */
+		return ::operator new(GetClassSize(size_class));
+	}
+
+	static void Deallocate(void *p, std::size_t size) noexcept {
+		if (!IsCacheable(size)) {
+			::operator delete(p, size);
+			return;
+		}
+
+		const std::size_t size_class = GetSizeClass(size);
+
+		if (!destroyed) {
+			auto &c = GetInstance().size_classes[size_class];
+			if (c.n_free < MAX_FREE) {
+				PoisonInaccessible(p, GetClassSize(size_class));
+				PoisonUndefined(p, sizeof(FreeFrame));
+
+				c.head = new(p) FreeFrame{c.head};
+				++c.n_free;
+				return;
+			}
+		}
+
+		::operator delete(p, GetClassSize(size_class));
+	}
+
+	/**
+	 * Free all cached frames of the current thread.
+	 */
+	static void Flush() noexcept {
+		if (!destroyed)
+			GetInstance().Clear();
+	}
+
+	/**
+	 * Returns the number of cached frames of the current thread
+	 * (for debugging and unit tests).
+	 */
+	[[gnu::pure]]
+	static std::size_t GetFreeCount() noexcept {
+		if (destroyed)
+			return 0;
+
+		std::size_t n = 0;
+		for (const auto &c : GetInstance().size_classes)
+			n += c.n_free;
+		return n;
+	}
+};
+
+} // namespace Co
@@ -6,6 +6,9 @@
 
 #include "UniqueHandle.hxx"
 #include "Compat.hxx"
+#ifndef CO_NO_FRAME_ALLOCATOR
+#include "FrameAllocator.hxx"
+#endif
 #include "util/ReturnValue.hxx"
 
 #include <cassert>
@@ -46,6 +49,20 @@ class promise final : public detail::promise_result_manager<T> {
 	std::exception_ptr error;
 
 public:
+#ifndef CO_NO_FRAME_ALLOCATOR
+	/* coroutine frames are recycled by a per-thread cache
+	   because frames of the same coroutine always have the same
+	   size */
+	[[nodiscard]]
+	static void *operator new(std::size_t size) {
+		return FrameAllocator::Allocate(size);
+	}
+
+	static void operator delete(void *p, std::size_t size) noexcept {
+		FrameAllocator::Deallocate(p, size);
+	}
+#endif
+
 	[[nodiscard]]
 	auto initial_suspend() noexcept {
 		if constexpr (lazy)
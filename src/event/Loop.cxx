@@ -12,6 +12,7 @@
 #endif
 
 #ifdef HAVE_URING
+#include "uring/Config.hxx"
 #include "uring/Manager.hxx"
 #include "io/uring/Operation.hxx"
 #include "io/uring/Queue.hxx"
@@ -149,6 +150,16 @@ EventLoop::EnableUring(unsigned entries, unsigned flags)
 	assert(!uring);
 
 	uring = std::make_unique<Uring::Manager>(entries, flags);
+
+	/* with IORING_SETUP_SINGLE_ISSUER, the ring has been created
+	   disabled, and this thread (which will run the EventLoop)
+	   must enable it before anything gets submitted */
+	try {
+		uring->EnableIfDisabled();
+	} catch (...) {
+		uring.reset();
+		throw;
+	}
 }
 
 void
@@ -157,6 +168,24 @@ EventLoop::EnableUring(unsigned entries, struct io_uring_params &params)
 	assert(!uring);
 
 	uring = std::make_unique<Uring::Manager>(entries, params);
+
+	/* with IORING_SETUP_SINGLE_ISSUER, the ring has been created
+	   disabled, and this thread (which will run the EventLoop)
+	   must enable it before anything gets submitted */
+	try {
+		uring->EnableIfDisabled();
+	} catch (...) {
+		uring.reset();
+		throw;
+	}
+}
+
+void
+EventLoop::EnableUring(const Uring::ManagerConfig &config)
+{
+	struct io_uring_params params{};
+	config.Apply(params);
+	EnableUring(config.entries, params);
 }
 
 void
@@ -441,7 +470,26 @@ EventLoop::UringWait(Event::Duration timeout) noexcept
 		   still ready */
 		timeout = Event::Duration{0};
 
-	{
+	bool dispatched = false;
+	if (uring->IsSqPoll()) {
+		/* the SQPOLL kernel thread picks up submissions
+		   (usually without a system call) and posts
+		   completions while we're in userspace; enter the
+		   kernel only if there is nothing to do yet */
+		try {
+			uring->FlushSubmit();
+			dispatched = uring->DispatchCompletions();
+		} catch (...) {
+			/* the submission will be retried by
+			   SubmitAndWaitDispatchCompletions() below */
+		}
+	}
+
+	/* with IORING_SETUP_DEFER_TASKRUN, completions are only
+	   posted while we're inside io_uring_enter(), so there is
+	   no such shortcut (not even for a zero timeout) */
+
+	if (!dispatched) {
 		struct __kernel_timespec timeout_buffer;
 		auto *kernel_timeout = ExportTimeoutKernelTimespec(timeout, timeout_buffer);
 		Uring::Queue &uring_queue = *uring;
@@ -29,7 +29,7 @@
 #ifdef HAVE_URING
 #include <memory>
 struct io_uring_params;
-namespace Uring { class Queue; class Manager; }
+namespace Uring { class Queue; class Manager; struct ManagerConfig; }
 #endif
 
 #include <cassert>
@@ -248,11 +248,25 @@ public:
 	 * GetUring() can be used to obtain a pointer to the queue
 	 * instance.
 	 *
+	 * A ring created with #IORING_SETUP_R_DISABLED is enabled
+	 * right away; with #IORING_SETUP_SINGLE_ISSUER, this must
+	 * therefore be called in the thread which runs this
+	 * #EventLoop.
+	 *
 	 * Throws on error.
 	 */
 	void EnableUring(unsigned entries, unsigned flags);
 	void EnableUring(unsigned entries, struct io_uring_params &params);
 
+	/**
+	 * Enable io_uring with the given configuration, e.g. with
+	 * SQPOLL or deferred task running.
+	 *
+	 * Throws on error (e.g. if the kernel does not support the
+	 * requested mode).
+	 */
+	void EnableUring(const Uring::ManagerConfig &config);
+
 	void DisableUring() noexcept;
 
 	/**
@@ -34,11 +34,24 @@ IgnoreAcceptErrno(int e) noexcept
 class ServerSocket::UringAccept final : Uring::Operation {
 	ServerSocket &parent;
 	Uring::Queue &queue;
-	StaticSocketAddress remote_address;
-	socklen_t remote_address_size;
+
+	/**
+	 * Use IORING_ACCEPT_MULTISHOT?  This is cleared if the kernel
+	 * doesn't support it (Linux < 5.19), and we fall back to
+	 * submitting one accept() operation per connection.
+	 */
+	bool multishot = true;
 
 	bool released = false;
 
+	/**
+	 * Only used in single-shot mode; in multishot mode, the
+	 * kernel would overwrite it with each new connection before
+	 * we get to see it, so we call getpeername() instead.
+	 */
+	StaticSocketAddress remote_address;
+	socklen_t remote_address_size;
+
 public:
 	UringAccept(ServerSocket &_parent, Uring::Queue &_queue) noexcept
 		:parent(_parent), queue(_queue) {}
@@ -51,13 +64,7 @@ public:
 		assert(!released);
 
 		if (IsUringPending()) {
-			if (auto *s = queue.GetSubmitEntry()) {
-				io_uring_prep_cancel(s, GetUringData(), 0);
-				io_uring_sqe_set_data(s, nullptr);
-				io_uring_sqe_set_flags(s, IOSQE_CQE_SKIP_SUCCESS);
-				queue.Submit();
-			}
-
+			CancelPending();
 			released = true;
 		} else
 			delete this;
@@ -66,6 +73,15 @@ public:
 	void Start();
 
 private:
+	/**
+	 * Cancel the pending (multishot) accept operation.  If no
+	 * submit queue entry can be obtained even after flushing the
+	 * queue, shut down the listener socket instead; this makes
+	 * the kernel complete the armed accept with an error, which
+	 * ends it just like a cancellation would.
+	 */
+	void CancelPending() noexcept;
+
 	void OnUringCompletion(int res) noexcept override;
 };
 
@@ -77,31 +93,76 @@ ServerSocket::UringAccept::Start()
 
 	auto &s = queue.RequireSubmitEntry();
 
-	remote_address_size = remote_address.GetCapacity();
-	io_uring_prep_accept(&s, parent.GetSocket().Get(),
-			     remote_address, &remote_address_size,
-			     SOCK_NONBLOCK|SOCK_CLOEXEC);
+	if (multishot) {
+		io_uring_prep_multishot_accept(&s, parent.GetSocket().Get(),
+					       nullptr, nullptr,
+					       SOCK_NONBLOCK|SOCK_CLOEXEC);
+	} else {
+		remote_address_size = remote_address.GetCapacity();
+		io_uring_prep_accept(&s, parent.GetSocket().Get(),
+				     remote_address, &remote_address_size,
+				     SOCK_NONBLOCK|SOCK_CLOEXEC);
+	}
+
 	queue.Push(s, *this);
 }
 
+inline void
+ServerSocket::UringAccept::CancelPending() noexcept
+{
+	assert(IsUringPending());
+
+	try {
+		auto &s = queue.RequireSubmitEntry();
+		io_uring_prep_cancel(&s, GetUringData(), 0);
+		io_uring_sqe_set_data(&s, nullptr);
+		io_uring_sqe_set_flags(&s, IOSQE_CQE_SKIP_SUCCESS);
+		queue.Submit();
+	} catch (...) {
+		parent.GetSocket().Shutdown();
+	}
+}
+
 void
 ServerSocket::UringAccept::OnUringCompletion(int res) noexcept
 {
 	if (released) [[unlikely]] {
 		if (res >= 0)
 			close(res);
-		delete this;
+
+		/* in multishot mode, more completions may arrive
+		   until the kernel has seen our cancellation */
+		if (!IsUringPending())
+			delete this;
 		return;
 	}
 
 	if (res >= 0) [[likely]] {
-		remote_address.SetSize(remote_address_size);
-		parent.OnAccept(UniqueSocketDescriptor{AdoptTag{}, res}, remote_address);
+		UniqueSocketDescriptor fd{AdoptTag{}, res};
+
+		if (multishot) {
+			const auto address = fd.GetPeerAddress();
+			parent.OnAccept(std::move(fd), address);
+		} else {
+			remote_address.SetSize(remote_address_size);
+			parent.OnAccept(std::move(fd), remote_address);
+		}
+
+		/* a multishot accept stays armed until the kernel
+		   stops it (no IORING_CQE_F_MORE) */
+		if (!IsUringPending())
+			Start();
+	} else if (res == -EINVAL && multishot) {
+		/* this kernel doesn't support
+		   IORING_ACCEPT_MULTISHOT; fall back to single-shot
+		   accept() */
+		multishot = false;
 		Start();
 	} else if (IgnoreAcceptErrno(-res)) {
 		/* ignore this spurious error condition and start the
 		   next accept() operation */
-		Start();
+		if (!IsUringPending())
+			Start();
 	} else {
 		parent.OnAcceptError(std::make_exception_ptr(MakeSocketError(-res, "Failed to accept connection")));
 	}
@@ -206,15 +267,19 @@ ServerSocket::ListenPath(const char *path)
 void
 ServerSocket::EventCallback(unsigned) noexcept
 {
-	StaticSocketAddress remote_address;
-	UniqueSocketDescriptor remote_fd{AdoptTag{}, GetSocket().AcceptNonBlock(remote_address)};
-	if (!remote_fd.IsDefined()) {
-		const auto e = GetSocketError();
-		if (!IgnoreAcceptErrno(e))
-			OnAcceptError(std::make_exception_ptr(MakeSocketError(e, "Failed to accept connection")));
-
-		return;
+	/* drain the listen backlog, but don't starve the other
+	   events in this EventLoop */
+	for (unsigned i = 0; i < MAX_ACCEPT_BATCH; ++i) {
+		StaticSocketAddress remote_address;
+		UniqueSocketDescriptor remote_fd{AdoptTag{}, GetSocket().AcceptNonBlock(remote_address)};
+		if (!remote_fd.IsDefined()) {
+			const auto e = GetSocketError();
+			if (!IgnoreAcceptErrno(e))
+				OnAcceptError(std::make_exception_ptr(MakeSocketError(e, "Failed to accept connection")));
+
+			return;
+		}
+
+		OnAccept(std::move(remote_fd), remote_address);
 	}
-
-	OnAccept(std::move(remote_fd), remote_address);
 }
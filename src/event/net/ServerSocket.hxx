@@ -16,6 +16,12 @@ class SocketAddress;
  * A socket that accepts incoming connections.
  */
 class ServerSocket {
+	/**
+	 * The maximum number of connections accepted by one
+	 * EventCallback() invocation.
+	 */
+	static constexpr unsigned MAX_ACCEPT_BATCH = 64;
+
 	SocketEvent event;
 
 #ifdef HAVE_URING
@@ -63,6 +69,9 @@ protected:
 	/**
 	 * A new incoming connection has been established.
 	 *
+	 * Several connections may be accepted in a row, therefore
+	 * this method must not destroy the #ServerSocket.
+	 *
 	 * @param fd the socket owned by the callee
 	 */
 	virtual void OnAccept(UniqueSocketDescriptor fd,
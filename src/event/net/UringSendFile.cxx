@@ -0,0 +1,495 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "UringSendFile.hxx"
+#include "BufferedSocket.hxx"
+#include "http/Range.hxx"
+#include "io/Pipe.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "io/uring/BufferPool.hxx"
+#include "io/uring/Operation.hxx"
+#include "io/uring/Queue.hxx"
+#include "system/Error.hxx"
+#include "util/BindMethod.hxx"
+
+#include <algorithm> // for std::min()
+#include <cassert>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <tuple> // for std::tie()
+#include <utility> // for std::exchange()
+
+#include <fcntl.h> // for SPLICE_F_*
+#include <sys/socket.h> // for MSG_*
+
+/**
+ * The size of the pipe (and of the buffer in fallback mode), i.e. the
+ * maximum amount of data transferred by one pair of operations.
+ */
+static constexpr std::size_t CHUNK_SIZE = 256 * 1024;
+
+class UringSendFile::Transfer final {
+	/**
+	 * One io_uring operation; its completion is forwarded to a
+	 * #Transfer method.
+	 */
+	class Step final : public Uring::Operation {
+		using Callback = BoundMethod<void(int res) noexcept>;
+		const Callback callback;
+
+	public:
+		explicit Step(Callback _callback) noexcept
+			:callback(_callback) {}
+
+	private:
+		/* virtual methods from class Uring::Operation */
+		void OnUringCompletion(int res) noexcept override {
+			callback(res);
+		}
+	};
+
+	/**
+	 * The owner; nullptr after Release().
+	 */
+	UringSendFile *parent;
+
+	Uring::Queue &queue;
+
+	const UniqueFileDescriptor file;
+
+	/**
+	 * The pipe between the two splice operations.  Both are
+	 * closed in fallback mode.
+	 */
+	UniqueFileDescriptor pipe_r, pipe_w;
+
+	Uring::BufferPool *const buffer_pool;
+
+	/**
+	 * The buffer used in fallback mode; it is either allocated
+	 * from #buffer_pool or from the heap.
+	 */
+	Uring::BufferPool::Buffer fixed_buffer;
+	std::unique_ptr<std::byte[]> heap_buffer;
+	std::span<std::byte> buffer;
+
+	/**
+	 * The position of the first unsent byte in #buffer.
+	 */
+	std::size_t buffer_position = 0;
+
+	/**
+	 * The file position of the next read.
+	 */
+	uint64_t read_position;
+
+	/**
+	 * The file position of the first byte which has not yet been
+	 * sent.  Everything between here and #read_position is in the
+	 * pipe (or in the #buffer).
+	 */
+	uint64_t send_position;
+
+	/**
+	 * The file position after the last byte to be sent.
+	 */
+	const uint64_t end_position;
+
+	/**
+	 * Moves data from the file to the pipe (or the #buffer).
+	 */
+	Step fill{BIND_THIS_METHOD(OnFillCompletion)};
+
+	/**
+	 * Moves data from the pipe (or the #buffer) to the socket.
+	 */
+	Step drain{BIND_THIS_METHOD(OnDrainCompletion)};
+
+	std::exception_ptr error;
+
+	/**
+	 * Are we waiting for OnSocketWritable()?
+	 */
+	bool waiting = false;
+
+	/**
+	 * Has a splice operation failed because the file or the
+	 * socket does not support it?  SwitchToFallback() will be
+	 * called after all operations have completed.
+	 */
+	bool splice_unsupported = false;
+
+public:
+	Transfer(UringSendFile &_parent, Uring::Queue &_queue,
+		 UniqueFileDescriptor &&_file,
+		 uint64_t offset, uint64_t length,
+		 Uring::BufferPool *_buffer_pool)
+		:parent(&_parent), queue(_queue), file(std::move(_file)),
+		 buffer_pool(_buffer_pool),
+		 read_position(offset), send_position(offset),
+		 end_position(offset + length)
+	{
+		std::tie(pipe_r, pipe_w) = CreatePipeNonBlock();
+		pipe_w.SetPipeCapacity(CHUNK_SIZE);
+	}
+
+	/**
+	 * Detach from the parent and delete this object as soon as
+	 * the kernel has finished all operations.
+	 */
+	void Release() noexcept;
+
+	bool IsWaiting() const noexcept {
+		return waiting;
+	}
+
+	/**
+	 * Submit the next operations.
+	 *
+	 * Throws on error.
+	 */
+	void Next();
+
+	void Resume() {
+		assert(waiting);
+
+		waiting = false;
+		Next();
+	}
+
+private:
+	bool IsPending() const noexcept {
+		return fill.IsUringPending() || drain.IsUringPending();
+	}
+
+	bool IsFallback() const noexcept {
+		return !pipe_r.IsDefined();
+	}
+
+	void Fail(std::exception_ptr _error) noexcept {
+		if (!error)
+			error = std::move(_error);
+	}
+
+	/**
+	 * Switch to fallback mode: close the pipe (discarding the data
+	 * in it) and read the file into a buffer instead.
+	 */
+	void SwitchToFallback();
+
+	void SubmitFill(std::size_t size, unsigned sqe_flags);
+	void SubmitDrain(std::size_t size);
+
+	void CancelStep(Step &step) noexcept;
+
+	/**
+	 * Called after each completion; continues the transfer after
+	 * both steps have completed.
+	 */
+	void OnStepCompletion() noexcept;
+
+	void OnFillCompletion(int res) noexcept;
+	void OnDrainCompletion(int res) noexcept;
+};
+
+/**
+ * Does this error code mean that splicing is not supported by the
+ * file or the socket?
+ */
+[[gnu::const]]
+static bool
+IsSpliceUnsupported(int error) noexcept
+{
+	return error == EINVAL || error == EOPNOTSUPP || error == ENOSYS;
+}
+
+void
+UringSendFile::Transfer::SwitchToFallback()
+{
+	assert(!IsFallback());
+	assert(!IsPending());
+
+	pipe_r.Close();
+	pipe_w.Close();
+
+	/* the data in the pipe is lost; read it again */
+	read_position = send_position;
+
+	if (buffer_pool != nullptr)
+		fixed_buffer = buffer_pool->Allocate();
+
+	if (fixed_buffer) {
+		buffer = fixed_buffer.get();
+	} else {
+		heap_buffer = std::make_unique_for_overwrite<std::byte[]>(CHUNK_SIZE);
+		buffer = {heap_buffer.get(), CHUNK_SIZE};
+	}
+}
+
+inline void
+UringSendFile::Transfer::SubmitFill(std::size_t size, unsigned sqe_flags)
+{
+	auto &s = queue.RequireSubmitEntry();
+
+	if (!IsFallback()) {
+		io_uring_prep_splice(&s, file.Get(), read_position,
+				     pipe_w.Get(), -1, size,
+				     SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	} else {
+		assert(size <= buffer.size());
+
+		buffer_position = 0;
+
+		if (fixed_buffer)
+			io_uring_prep_read_fixed(&s, file.Get(),
+						 buffer.data(), size,
+						 read_position,
+						 fixed_buffer.GetIndex());
+		else
+			io_uring_prep_read(&s, file.Get(),
+					   buffer.data(), size,
+					   read_position);
+	}
+
+	io_uring_sqe_set_flags(&s, sqe_flags);
+	queue.Push(s, fill);
+}
+
+inline void
+UringSendFile::Transfer::SubmitDrain(std::size_t size)
+{
+	const SocketDescriptor socket = parent->socket.GetSocket();
+
+	/* tell the kernel whether more data will follow, so it can
+	   build full-sized packets */
+	const bool more = send_position + size < end_position;
+
+	auto &s = queue.RequireSubmitEntry();
+
+	if (!IsFallback()) {
+		io_uring_prep_splice(&s, pipe_r.Get(), -1,
+				     socket.Get(), -1, size,
+				     SPLICE_F_MOVE|SPLICE_F_NONBLOCK|
+				     (more ? SPLICE_F_MORE : 0));
+	} else {
+		assert(buffer_position + size <= buffer.size());
+
+		io_uring_prep_send(&s, socket.Get(),
+				   buffer.data() + buffer_position, size,
+				   MSG_DONTWAIT|MSG_NOSIGNAL|
+				   (more ? MSG_MORE : 0));
+	}
+
+	queue.Push(s, drain);
+}
+
+void
+UringSendFile::Transfer::Next()
+{
+	assert(parent != nullptr);
+	assert(!IsPending());
+	assert(!waiting);
+	assert(!error);
+	assert(read_position >= send_position);
+
+	if (const std::size_t buffered = read_position - send_position;
+	    buffered > 0) {
+		/* the previous drain was short; send the rest
+		   first */
+		SubmitDrain(buffered);
+		return;
+	}
+
+	if (send_position >= end_position) {
+		parent->OnTransferDone();
+		return;
+	}
+
+	const std::size_t size = std::min<uint64_t>(end_position - read_position,
+						     IsFallback() ? buffer.size() : CHUNK_SIZE);
+
+	/* the drain is canceled if the fill fails or is short
+	   (IOSQE_IO_LINK) */
+	SubmitFill(size, IOSQE_IO_LINK);
+	SubmitDrain(size);
+}
+
+inline void
+UringSendFile::Transfer::CancelStep(Step &step) noexcept
+{
+	if (!step.IsUringPending())
+		return;
+
+	if (auto *s = queue.GetSubmitEntry()) {
+		io_uring_prep_cancel(s, step.GetUringData(), 0);
+		io_uring_sqe_set_data(s, nullptr);
+		io_uring_sqe_set_flags(s, IOSQE_CQE_SKIP_SUCCESS);
+		queue.Submit();
+	}
+}
+
+void
+UringSendFile::Transfer::Release() noexcept
+{
+	assert(parent != nullptr);
+
+	parent = nullptr;
+
+	if (!IsPending()) {
+		delete this;
+		return;
+	}
+
+	CancelStep(fill);
+	CancelStep(drain);
+}
+
+void
+UringSendFile::Transfer::OnStepCompletion() noexcept
+{
+	if (IsPending())
+		/* wait for the other one */
+		return;
+
+	if (parent == nullptr) {
+		/* released by Cancel() */
+		delete this;
+		return;
+	}
+
+	if (error) {
+		parent->OnTransferError(std::move(error));
+		return;
+	}
+
+	try {
+		if (splice_unsupported) {
+			splice_unsupported = false;
+			SwitchToFallback();
+		}
+
+		if (waiting) {
+			parent->socket.ScheduleWrite();
+			return;
+		}
+
+		Next();
+	} catch (...) {
+		parent->OnTransferError(std::current_exception());
+	}
+}
+
+void
+UringSendFile::Transfer::OnFillCompletion(int res) noexcept
+{
+	if (res > 0) [[likely]]
+		read_position += static_cast<std::size_t>(res);
+	else if (res == 0)
+		Fail(std::make_exception_ptr(std::runtime_error{"Premature end of file"}));
+	else if (!IsFallback() && IsSpliceUnsupported(-res))
+		/* the drain will be canceled */
+		splice_unsupported = true;
+	else
+		Fail(std::make_exception_ptr(MakeErrno(-res, "Failed to read file")));
+
+	OnStepCompletion();
+}
+
+void
+UringSendFile::Transfer::OnDrainCompletion(int res) noexcept
+{
+	if (res > 0) [[likely]] {
+		send_position += static_cast<std::size_t>(res);
+		buffer_position += static_cast<std::size_t>(res);
+	} else if (res == -EAGAIN) {
+		/* the socket buffer is full */
+		waiting = true;
+	} else if (res == -ECANCELED) {
+		/* the fill was short or has failed; Next() will
+		   take care of it */
+	} else if (res == 0) {
+		Fail(std::make_exception_ptr(std::runtime_error{"Socket is not writable"}));
+	} else if (!IsFallback() && IsSpliceUnsupported(-res)) {
+		splice_unsupported = true;
+	} else {
+		Fail(std::make_exception_ptr(MakeErrno(-res, "Failed to send file")));
+	}
+
+	OnStepCompletion();
+}
+
+bool
+UringSendFile::Start(UniqueFileDescriptor &&file,
+		     uint64_t offset, uint64_t length,
+		     Uring::BufferPool *buffer_pool)
+{
+	assert(transfer == nullptr);
+	assert(file.IsDefined());
+
+	if (length == 0)
+		/* Transfer::Next() would finish synchronously and
+		   invoke the handler */
+		return false;
+
+	auto *queue = socket.GetUringQueue();
+	assert(queue != nullptr);
+
+	transfer = new Transfer(*this, *queue, std::move(file),
+				offset, length, buffer_pool);
+
+	try {
+		/* with a non-zero length, this only submits
+		   operations and never finishes synchronously */
+		transfer->Next();
+	} catch (...) {
+		Cancel();
+		throw;
+	}
+
+	return true;
+}
+
+bool
+UringSendFile::Start(UniqueFileDescriptor &&file,
+		     const HttpRangeRequest &range,
+		     Uring::BufferPool *buffer_pool)
+{
+	assert(range.type != HttpRangeRequest::Type::INVALID);
+
+	return Start(std::move(file), range.skip, range.size - range.skip,
+		     buffer_pool);
+}
+
+void
+UringSendFile::Cancel() noexcept
+{
+	if (transfer != nullptr)
+		std::exchange(transfer, nullptr)->Release();
+}
+
+bool
+UringSendFile::OnSocketWritable()
+{
+	if (transfer == nullptr || !transfer->IsWaiting())
+		return false;
+
+	socket.UnscheduleWrite();
+	transfer->Resume();
+	return true;
+}
+
+inline void
+UringSendFile::OnTransferDone() noexcept
+{
+	Cancel();
+	handler.OnUringSendFileDone();
+}
+
+inline void
+UringSendFile::OnTransferError(std::exception_ptr error) noexcept
+{
+	Cancel();
+	handler.OnUringSendFileError(std::move(error));
+}
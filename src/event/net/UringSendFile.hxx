@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <cstdint>
+#include <exception>
+
+class BufferedSocket;
+class UniqueFileDescriptor;
+struct HttpRangeRequest;
+namespace Uring { class BufferPool; }
+
+class UringSendFileHandler {
+public:
+	/**
+	 * All data has been sent to the socket.
+	 */
+	virtual void OnUringSendFileDone() noexcept = 0;
+
+	/**
+	 * Reading the file or writing to the socket has failed.  The
+	 * transfer has been stopped.
+	 */
+	virtual void OnUringSendFileError(std::exception_ptr error) noexcept = 0;
+};
+
+/**
+ * Send (a range of) a regular file to a #BufferedSocket with
+ * io_uring, without blocking and without a thread.
+ *
+ * The data is moved by a pair of linked `IORING_OP_SPLICE` operations
+ * (file to pipe, pipe to socket) and never gets copied to userspace.
+ * If splicing is not supported (e.g. by the filesystem), this falls
+ * back to `IORING_OP_READ_FIXED` (or `IORING_OP_READ` without a
+ * #Uring::BufferPool) linked with `IORING_OP_SEND`.
+ *
+ * When the socket buffer is full, this calls
+ * BufferedSocket::ScheduleWrite(); the #BufferedSocketHandler must
+ * then forward BufferedSocketHandler::OnBufferedWrite() to
+ * OnSocketWritable().
+ *
+ * The #BufferedSocket must have io_uring enabled (see
+ * BufferedSocket::EnableUring()), and its #Uring::Queue must submit
+ * in batches (like the one returned by EventLoop::GetUring()),
+ * because linked operations need to be submitted together.
+ */
+class UringSendFile final {
+	BufferedSocket &socket;
+	UringSendFileHandler &handler;
+
+	class Transfer;
+	Transfer *transfer = nullptr;
+
+public:
+	UringSendFile(BufferedSocket &_socket,
+		      UringSendFileHandler &_handler) noexcept
+		:socket(_socket), handler(_handler) {}
+
+	~UringSendFile() noexcept {
+		Cancel();
+	}
+
+	UringSendFile(const UringSendFile &) = delete;
+	UringSendFile &operator=(const UringSendFile &) = delete;
+
+	bool IsActive() const noexcept {
+		return transfer != nullptr;
+	}
+
+	/**
+	 * Start sending.  This method does not invoke the handler.
+	 *
+	 * Throws on error.
+	 *
+	 * @param file a regular file; this object takes ownership and
+	 * closes it after the kernel is done with it
+	 * @param offset the file position of the first byte to be sent
+	 * @param length the number of bytes to be sent
+	 * @param buffer_pool an optional pool of registered buffers
+	 * for the fallback if splicing is not supported; without it,
+	 * a buffer is allocated from the heap
+	 * @return false if there is nothing to send (#length is
+	 * zero); in that case, no transfer has been started, the
+	 * handler will not be invoked and #file is left untouched
+	 */
+	[[nodiscard]]
+	bool Start(UniqueFileDescriptor &&file,
+		   uint64_t offset, uint64_t length,
+		   Uring::BufferPool *buffer_pool=nullptr);
+
+	/**
+	 * Send the portion of the file selected by the given "Range"
+	 * request header (or the whole file if there was none).  The
+	 * range must not be #HttpRangeRequest::Type::INVALID (the
+	 * caller is supposed to respond with "416 Range Not
+	 * Satisfiable" instead).
+	 *
+	 * @return false if the file or the range is empty (see
+	 * above)
+	 */
+	[[nodiscard]]
+	bool Start(UniqueFileDescriptor &&file, const HttpRangeRequest &range,
+		   Uring::BufferPool *buffer_pool=nullptr);
+
+	/**
+	 * Stop the transfer.  Pending operations are canceled in the
+	 * background.  This does not unschedule writing on the
+	 * #BufferedSocket.
+	 */
+	void Cancel() noexcept;
+
+	/**
+	 * Call this from BufferedSocketHandler::OnBufferedWrite().
+	 * This method does not invoke the handler.
+	 *
+	 * Throws on error.
+	 *
+	 * @return true if the transfer was waiting for the socket to
+	 * become writable and has been resumed
+	 */
+	bool OnSocketWritable();
+
+private:
+	void OnTransferDone() noexcept;
+	void OnTransferError(std::exception_ptr error) noexcept;
+};
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "Resolver.hxx"
+#include "co/AwaitableHelper.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "util/Cancellable.hxx"
+
+#include <vector>
+
+#include <sys/socket.h> // for AF_UNSPEC
+
+namespace Dns {
+
+/**
+ * Coroutine wrapper for Resolver::ResolveHostname().
+ */
+class CoResolveHostname final : ResolveHostnameHandler {
+	std::coroutine_handle<> continuation;
+
+	std::vector<AllocatedSocketAddress> value;
+
+	std::exception_ptr error;
+
+	CancellablePointer cancel_ptr{nullptr};
+
+	/**
+	 * Has the handler been invoked?  This may happen
+	 * synchronously (e.g. on a cache hit).
+	 */
+	bool ready = false;
+
+	using Awaitable = Co::AwaitableHelper<CoResolveHostname>;
+	friend Awaitable;
+
+public:
+	CoResolveHostname(Resolver &resolver,
+			  std::string_view hostname, unsigned port=0,
+			  int family=AF_UNSPEC) noexcept {
+		resolver.ResolveHostname(hostname, port, family,
+					 *this, cancel_ptr);
+	}
+
+	~CoResolveHostname() noexcept {
+		if (!ready && cancel_ptr)
+			cancel_ptr.Cancel();
+	}
+
+	Awaitable operator co_await() noexcept {
+		return *this;
+	}
+
+private:
+	bool IsReady() const noexcept {
+		return ready;
+	}
+
+	std::vector<AllocatedSocketAddress> TakeValue() noexcept {
+		return std::move(value);
+	}
+
+	/* virtual methods from ResolveHostnameHandler */
+	void OnResolveHostname(std::span<const SocketAddress> addresses) noexcept override {
+		ready = true;
+
+		value.reserve(addresses.size());
+		for (const SocketAddress i : addresses)
+			value.emplace_back(i);
+
+		if (continuation)
+			continuation.resume();
+	}
+
+	void OnResolveHostnameError(std::exception_ptr _error) noexcept override {
+		ready = true;
+		error = std::move(_error);
+
+		if (continuation)
+			continuation.resume();
+	}
+};
+
+} // namespace Dns
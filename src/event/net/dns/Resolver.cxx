@@ -0,0 +1,891 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "Resolver.hxx"
+#include "net/dns/Query.hxx"
+#include "net/dns/Response.hxx"
+#include "event/Loop.hxx"
+#include "event/SocketEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/IPv6Address.hxx"
+#include "net/SocketError.hxx"
+#include "net/SocketProtocolError.hxx"
+#include "net/TimeoutError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "system/Urandom.hxx"
+#include "util/Cancellable.hxx"
+#include "util/CharUtil.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/IntrusiveList.hxx"
+#include "util/PackedBigEndian.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <memory>
+
+#include <arpa/inet.h> // for inet_pton()
+
+namespace Dns {
+
+/**
+ * Source ports are chosen randomly from this port up to 65535.
+ */
+static constexpr uint_least16_t MIN_SOURCE_PORT = 1024;
+
+/**
+ * How often to try binding to a random source port before letting
+ * the kernel choose one.
+ */
+static constexpr unsigned BIND_ATTEMPTS = 8;
+
+/**
+ * Generate the key for #Resolver::cache and #Resolver::lookups.
+ */
+std::string
+Resolver::MakeKey(std::string_view name, int family) const noexcept
+{
+	/* with search domains, "foo" and "foo." may resolve to
+	   different hosts */
+	if (config.search.empty() && !name.empty() && name.back() == '.')
+		name.remove_suffix(1);
+
+	std::string key;
+	key.reserve(name.size() + 2);
+	for (const char ch : name)
+		key.push_back(ToLowerASCII(ch));
+
+	/* '/' cannot occur in a valid host name */
+	key.push_back('/');
+	key.push_back(family == AF_INET ? '4' : (family == AF_INET6 ? '6' : '*'));
+	return key;
+}
+
+/**
+ * Invoke the handler with copies of the given addresses with the
+ * port number applied.
+ */
+static void
+InvokeHandler(ResolveHostnameHandler &handler,
+	      std::span<const AllocatedSocketAddress> addresses,
+	      unsigned port) noexcept
+{
+	assert(!addresses.empty());
+
+	std::vector<AllocatedSocketAddress> with_port;
+	if (port != 0) {
+		with_port.reserve(addresses.size());
+		for (const auto &i : addresses)
+			with_port.emplace_back(i.WithPort(port));
+		addresses = with_port;
+	}
+
+	std::vector<SocketAddress> result;
+	result.reserve(addresses.size());
+	for (const auto &i : addresses)
+		result.emplace_back(i);
+
+	handler.OnResolveHostname(result);
+}
+
+static void
+InvokeNotFound(ResolveHostnameHandler &handler) noexcept
+{
+	handler.OnResolveHostnameError(std::make_exception_ptr(HostNotFoundError{"Host not found"}));
+}
+
+/**
+ * One query (for one record type) sent to the name servers.
+ */
+class Resolver::Query final {
+	Resolver &resolver;
+
+	Lookup &lookup;
+
+	const ResolvConf &config;
+
+	const std::string_view name;
+
+	const RecordType type;
+
+	uint_least16_t id;
+
+	SocketEvent socket;
+
+	CoarseTimerEvent timeout_event;
+
+	/**
+	 * The number of datagrams sent so far.  This is used to
+	 * select the name server and to limit the number of attempts.
+	 */
+	unsigned n_sent = 0;
+
+	/**
+	 * Has this query fallen back to TCP?
+	 */
+	bool tcp = false;
+
+	/**
+	 * TCP only: has the request been sent?
+	 */
+	bool tcp_sent;
+
+	std::size_t request_size;
+
+	std::array<std::byte, MAX_QUERY_SIZE> request;
+
+	/**
+	 * TCP only: the response being received (including the
+	 * two-byte length prefix).
+	 */
+	std::unique_ptr<std::byte[]> tcp_buffer;
+	std::size_t tcp_fill, tcp_size;
+
+public:
+	Query(Resolver &_resolver, Lookup &_lookup,
+	      std::string_view _name, RecordType _type) noexcept
+		:resolver(_resolver), lookup(_lookup), config(resolver.config),
+		 name(_name), type(_type),
+		 socket(resolver.event_loop, BIND_THIS_METHOD(OnSocketReady)),
+		 timeout_event(resolver.event_loop, BIND_THIS_METHOD(OnTimeout)) {}
+
+	~Query() noexcept {
+		socket.Close();
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	void Start();
+
+private:
+	SocketAddress GetNameserver() const noexcept {
+		assert(n_sent > 0);
+		return config.nameservers[(n_sent - 1) % config.nameservers.size()];
+	}
+
+	bool CanRetry() const noexcept {
+		return n_sent < config.attempts * config.nameservers.size();
+	}
+
+	void SendUdp();
+	void StartTcp();
+
+	/**
+	 * Retry with the next name server or fail.
+	 */
+	void Retry(std::exception_ptr error) noexcept;
+
+	void OnResponse(Response &&response);
+	void OnUdpReady();
+	void OnTcpReady(unsigned events);
+
+	void OnSocketReady(unsigned events) noexcept;
+	void OnTimeout() noexcept;
+};
+
+class Resolver::Waiter final : public IntrusiveListHook<>, public Cancellable {
+	Lookup &lookup;
+
+public:
+	ResolveHostnameHandler &handler;
+	const unsigned port;
+
+	Waiter(Lookup &_lookup, ResolveHostnameHandler &_handler,
+	       unsigned _port) noexcept
+		:lookup(_lookup), handler(_handler), port(_port) {}
+
+private:
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override;
+};
+
+/**
+ * A lookup of one name (one or two queries for each candidate name
+ * built from the "search" domains); all requests for this name wait
+ * for it.
+ */
+class Resolver::Lookup final {
+	Resolver &resolver;
+
+	const std::string key;
+
+	const std::string name;
+
+	IntrusiveList<Waiter> waiters;
+
+	/**
+	 * The fully qualified names to be queried (in this order)
+	 * until one of them exists.
+	 */
+	std::vector<std::string> candidates;
+
+	/**
+	 * The index of the next item in #candidates.
+	 */
+	std::size_t next_candidate = 0;
+
+	int family;
+
+	/**
+	 * AAAA and/or A queries for the current candidate.
+	 */
+	std::array<std::unique_ptr<Query>, 2> queries;
+
+	std::size_t n_pending = 0;
+
+	/**
+	 * Addresses received so far.
+	 */
+	std::array<std::vector<AllocatedSocketAddress>, 2> addresses;
+
+	/**
+	 * The minimum TTL of all responses (for all candidates).
+	 */
+	std::chrono::seconds ttl = MAX_TTL;
+
+	/**
+	 * The first error which was not a negative response.  This
+	 * stops the search for more candidates.
+	 */
+	std::exception_ptr error;
+
+public:
+	Lookup(Resolver &_resolver, std::string &&_key,
+	       std::string_view _name) noexcept
+		:resolver(_resolver), key(std::move(_key)), name(_name) {}
+
+	~Lookup() noexcept {
+		/* the waiters must have been notified or canceled */
+		waiters.clear_and_dispose(DeleteDisposer{});
+	}
+
+	const std::string &GetKey() const noexcept {
+		return key;
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	void Start(int _family);
+
+	void AddWaiter(ResolveHostnameHandler &handler, unsigned port,
+		       CancellablePointer &cancel_ptr) noexcept {
+		auto *w = new Waiter(*this, handler, port);
+		waiters.push_back(*w);
+		cancel_ptr = *w;
+	}
+
+	void RemoveWaiter(Waiter &w) noexcept {
+		waiters.erase(waiters.iterator_to(w));
+	}
+
+	void OnQueryResponse(Query &query, Response &&response) noexcept;
+	void OnQueryError(Query &query, std::exception_ptr error) noexcept;
+
+private:
+	void MakeCandidates();
+
+	/**
+	 * Start the queries for the next candidate.
+	 *
+	 * Throws on error.
+	 */
+	void StartNext();
+
+	void OnQueryDone() noexcept;
+	void Finish() noexcept;
+};
+
+void
+Resolver::Waiter::Cancel() noexcept
+{
+	/* the lookup continues in order to fill the cache */
+	lookup.RemoveWaiter(*this);
+	delete this;
+}
+
+Resolver::Resolver(EventLoop &_event_loop, ResolvConf &&_config)
+	:event_loop(_event_loop), config(std::move(_config)),
+	 expire_timer(event_loop, BIND_THIS_METHOD(ExpireCache))
+{
+	assert(!config.nameservers.empty());
+	assert(config.attempts > 0);
+}
+
+Resolver::~Resolver() noexcept
+{
+	for (auto &[key, lookup] : lookups)
+		delete lookup;
+}
+
+uint_least16_t
+Resolver::MakeRandom()
+{
+	if (random_pool_size == 0) {
+		UrandomFill(std::as_writable_bytes(std::span{random_pool}));
+		random_pool_size = random_pool.size();
+	}
+
+	return random_pool[--random_pool_size];
+}
+
+UniqueSocketDescriptor
+Resolver::CreateUdpSocket(SocketAddress address)
+{
+	UniqueSocketDescriptor fd;
+	if (!fd.CreateNonBlock(address.GetFamily(), SOCK_DGRAM, 0))
+		throw MakeSocketError("Failed to create socket");
+
+	/* choose the source port ourselves; the kernel's ephemeral
+	   port allocator is easier to predict for an off-path
+	   attacker */
+	if (const int family = address.GetFamily();
+	    family == AF_INET || family == AF_INET6) {
+		for (unsigned i = 0; i < BIND_ATTEMPTS; ++i) {
+			const uint_least16_t port = MakeRandom();
+			if (port < MIN_SOURCE_PORT)
+				continue;
+
+			const bool success = family == AF_INET6
+				? fd.Bind(IPv6Address{port})
+				: fd.Bind(IPv4Address{port});
+			if (success)
+				break;
+
+			/* the port is probably in use; try another
+			   one, and if all attempts fail, Connect()
+			   lets the kernel choose */
+		}
+	}
+
+	if (!fd.Connect(address))
+		throw MakeSocketError("Failed to connect to DNS server");
+
+	return fd;
+}
+
+void
+Resolver::Query::Start()
+{
+	id = resolver.MakeRandom();
+	request_size = MakeQuery(request, id, name, type);
+	SendUdp();
+}
+
+void
+Resolver::Query::SendUdp()
+{
+	tcp = false;
+	++n_sent;
+
+	socket.Close();
+
+	/* a new socket for each query gives us a new random source
+	   port */
+	auto fd = resolver.CreateUdpSocket(GetNameserver());
+	if (fd.Send(std::span{request}.first(request_size)) < 0)
+		throw MakeSocketError("Failed to send DNS query");
+
+	socket.Open(fd.Release());
+	socket.ScheduleRead();
+	timeout_event.Schedule(config.timeout);
+}
+
+void
+Resolver::Query::StartTcp()
+{
+	tcp = true;
+	tcp_sent = false;
+	tcp_fill = 0;
+	tcp_size = 0;
+
+	socket.Close();
+
+	const auto address = GetNameserver();
+
+	UniqueSocketDescriptor fd;
+	if (!fd.CreateNonBlock(address.GetFamily(), SOCK_STREAM, 0))
+		throw MakeSocketError("Failed to create socket");
+
+	if (!fd.Connect(address)) {
+		const auto e = GetSocketError();
+		if (!IsSocketErrorConnectWouldBlock(e))
+			throw MakeSocketError(e, "Failed to connect to DNS server");
+	}
+
+	if (!tcp_buffer)
+		tcp_buffer = std::make_unique<std::byte[]>(sizeof(PackedBE16) + 0xffff);
+
+	socket.Open(fd.Release());
+	socket.ScheduleWrite();
+	timeout_event.Schedule(config.timeout);
+}
+
+void
+Resolver::Query::Retry(std::exception_ptr error) noexcept
+{
+	while (CanRetry()) {
+		try {
+			SendUdp();
+			return;
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	socket.Close();
+	timeout_event.Cancel();
+	lookup.OnQueryError(*this, std::move(error));
+}
+
+void
+Resolver::Query::OnResponse(Response &&response)
+{
+	if (response.truncated) {
+		if (tcp)
+			throw SocketProtocolError{"Truncated DNS response"};
+
+		StartTcp();
+		return;
+	}
+
+	switch (response.rcode) {
+	case ResponseCode::NOERROR:
+	case ResponseCode::NXDOMAIN:
+		break;
+
+	case ResponseCode::SERVFAIL:
+		throw SocketProtocolError{"DNS server failure"};
+
+	case ResponseCode::REFUSED:
+		throw SocketProtocolError{"DNS query refused"};
+
+	default:
+		throw SocketProtocolError{"DNS error"};
+	}
+
+	socket.Close();
+	timeout_event.Cancel();
+	lookup.OnQueryResponse(*this, std::move(response));
+}
+
+inline void
+Resolver::Query::OnUdpReady()
+{
+	std::array<std::byte, MAX_UDP_SIZE> buffer;
+	const auto nbytes = socket.GetSocket().Receive(buffer);
+	if (nbytes < 0) {
+		const auto e = GetSocketError();
+		if (IsSocketErrorReceiveWouldBlock(e))
+			return;
+
+		/* e.g. ECONNREFUSED after an ICMP "port
+		   unreachable" */
+		throw MakeSocketError(e, "Failed to receive DNS response");
+	}
+
+	Response response;
+
+	try {
+		response = ParseResponse(std::span{buffer}.first(nbytes),
+					 name, type);
+	} catch (const SocketProtocolError &) {
+		/* ignore malformed or mismatching datagrams (which
+		   may have been spoofed) and keep waiting for the
+		   real response */
+		return;
+	}
+
+	if (response.id != id)
+		return;
+
+	OnResponse(std::move(response));
+}
+
+inline void
+Resolver::Query::OnTcpReady(unsigned events)
+{
+	if (!tcp_sent) {
+		if (const int e = socket.GetSocket().GetError(); e != 0)
+			throw MakeSocketError(e, "Failed to connect to DNS server");
+
+		if (events & SocketEvent::HANGUP)
+			throw SocketClosedPrematurelyError{};
+
+		/* TCP messages are prefixed with a two-byte length
+		   (RFC 1035 4.2.2) */
+		std::array<std::byte, sizeof(PackedBE16) + MAX_QUERY_SIZE> buffer;
+		const PackedBE16 length(request_size);
+		std::memcpy(buffer.data(), &length, sizeof(length));
+		std::copy_n(request.begin(), request_size,
+			    buffer.begin() + sizeof(length));
+
+		const std::size_t size = sizeof(length) + request_size;
+		const auto nbytes = socket.GetSocket().Send(std::span{buffer}.first(size));
+		if (nbytes < 0)
+			throw MakeSocketError("Failed to send DNS query");
+
+		if (static_cast<std::size_t>(nbytes) != size)
+			throw SocketProtocolError{"Short send to DNS server"};
+
+		tcp_sent = true;
+		socket.Schedule(SocketEvent::READ);
+		return;
+	}
+
+	const std::size_t capacity = tcp_size > 0
+		? tcp_size
+		: sizeof(PackedBE16) + 0xffff;
+
+	const auto nbytes = socket.GetSocket().Receive({tcp_buffer.get() + tcp_fill, capacity - tcp_fill});
+	if (nbytes < 0) {
+		const auto e = GetSocketError();
+		if (IsSocketErrorReceiveWouldBlock(e))
+			return;
+
+		throw MakeSocketError(e, "Failed to receive DNS response");
+	}
+
+	if (nbytes == 0)
+		throw SocketClosedPrematurelyError{};
+
+	tcp_fill += nbytes;
+
+	if (tcp_size == 0 && tcp_fill >= sizeof(PackedBE16)) {
+		PackedBE16 length;
+		std::memcpy(&length, tcp_buffer.get(), sizeof(length));
+		tcp_size = sizeof(length) + length;
+	}
+
+	if (tcp_size == 0 || tcp_fill < tcp_size)
+		return;
+
+	if (tcp_fill > tcp_size)
+		throw SocketGarbageReceivedError{"Garbage after DNS response"};
+
+	auto response = ParseResponse({tcp_buffer.get() + sizeof(PackedBE16), tcp_size - sizeof(PackedBE16)},
+				      name, type);
+	if (response.id != id)
+		throw SocketProtocolError{"Wrong DNS response id"};
+
+	OnResponse(std::move(response));
+}
+
+void
+Resolver::Query::OnSocketReady(unsigned events) noexcept
+try {
+	if (tcp)
+		OnTcpReady(events);
+	else
+		OnUdpReady();
+} catch (...) {
+	Retry(std::current_exception());
+}
+
+void
+Resolver::Query::OnTimeout() noexcept
+{
+	Retry(std::make_exception_ptr(TimeoutError{"DNS query timed out"}));
+}
+
+inline void
+Resolver::Lookup::MakeCandidates()
+{
+	const auto &config = resolver.config;
+
+	if (name.back() == '.' || config.search.empty()) {
+		/* absolute name */
+		candidates.emplace_back(name);
+		return;
+	}
+
+	/* like glibc's res_search(): names with enough dots are
+	   tried as-is first, all others last */
+	const bool as_is_first =
+		std::size_t(std::count(name.begin(), name.end(), '.')) >= config.ndots;
+	if (as_is_first)
+		candidates.emplace_back(name);
+
+	for (const auto &domain : config.search) {
+		std::string candidate;
+		candidate.reserve(name.size() + 1 + domain.size());
+		candidate.append(name);
+		candidate.push_back('.');
+		candidate.append(domain);
+
+		/* skip names which are too long */
+		if (IsValidName(candidate))
+			candidates.emplace_back(std::move(candidate));
+	}
+
+	if (!as_is_first)
+		candidates.emplace_back(name);
+}
+
+void
+Resolver::Lookup::Start(int _family)
+{
+	family = _family;
+	MakeCandidates();
+	StartNext();
+}
+
+void
+Resolver::Lookup::StartNext()
+{
+	assert(n_pending == 0);
+	assert(next_candidate < candidates.size());
+
+	const std::string_view current = candidates[next_candidate++];
+
+	queries = {};
+	addresses = {};
+
+	std::size_t n = 0;
+
+	/* IPv6 first, like getaddrinfo() with the default RFC 6724
+	   policy */
+	if (family != AF_INET)
+		queries[n++] = std::make_unique<Query>(resolver, *this,
+						       current, RecordType::AAAA);
+
+	if (family != AF_INET6)
+		queries[n++] = std::make_unique<Query>(resolver, *this,
+						       current, RecordType::A);
+
+	for (std::size_t i = 0; i < n; ++i) {
+		queries[i]->Start();
+		++n_pending;
+	}
+}
+
+void
+Resolver::Lookup::OnQueryResponse(Query &query,
+				  Response &&response) noexcept
+{
+	const std::size_t i = &query == queries[0].get() ? 0 : 1;
+	addresses[i] = std::move(response.addresses);
+	ttl = std::min(ttl, response.ttl.value_or(DEFAULT_NEGATIVE_TTL));
+
+	OnQueryDone();
+}
+
+void
+Resolver::Lookup::OnQueryError(Query &, std::exception_ptr _error) noexcept
+{
+	if (!error)
+		error = std::move(_error);
+
+	OnQueryDone();
+}
+
+inline void
+Resolver::Lookup::OnQueryDone() noexcept
+{
+	assert(n_pending > 0);
+
+	if (--n_pending > 0)
+		return;
+
+	if (addresses[0].empty() && addresses[1].empty() && !error &&
+	    next_candidate < candidates.size()) {
+		/* this name does not exist; try the next search
+		   domain (this destroys the query which has invoked
+		   us) */
+		try {
+			StartNext();
+			return;
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	Finish();
+}
+
+inline void
+Resolver::Lookup::Finish() noexcept
+{
+	/* no new waiters from here on; new requests for this name
+	   will find the cache item or start a new lookup */
+	resolver.OnLookupFinished(*this);
+
+	std::vector<AllocatedSocketAddress> result = std::move(addresses[0]);
+	result.insert(result.end(),
+		      std::make_move_iterator(addresses[1].begin()),
+		      std::make_move_iterator(addresses[1].end()));
+
+	if (!result.empty() || !error)
+		/* positive or negative response; if one of the
+		   queries has failed, the partial result is cached
+		   only briefly */
+		resolver.AddCache(key, std::vector<AllocatedSocketAddress>{result},
+				  error ? std::min(ttl, PARTIAL_TTL) : ttl);
+
+	while (!waiters.empty()) {
+		auto &w = waiters.pop_front();
+		auto &handler = w.handler;
+		const unsigned port = w.port;
+		delete &w;
+
+		if (!result.empty())
+			InvokeHandler(handler, result, port);
+		else if (error)
+			handler.OnResolveHostnameError(error);
+		else
+			InvokeNotFound(handler);
+	}
+
+	delete this;
+}
+
+void
+Resolver::OnLookupFinished(Lookup &lookup) noexcept
+{
+	lookups.erase(lookup.GetKey());
+}
+
+void
+Resolver::AddCache(std::string_view key,
+		   std::vector<AllocatedSocketAddress> &&addresses,
+		   std::chrono::seconds ttl) noexcept
+{
+	if (ttl <= std::chrono::seconds::zero())
+		return;
+
+	if (cache.size() >= MAX_CACHE_SIZE) {
+		ExpireCache();
+		if (cache.size() >= MAX_CACHE_SIZE)
+			return;
+	}
+
+	cache.insert_or_assign(std::string{key}, CacheItem{
+			std::move(addresses),
+			event_loop.SteadyNow() + std::min(ttl, MAX_TTL),
+		});
+
+	if (!expire_timer.IsPending())
+		expire_timer.Schedule(std::chrono::minutes{1});
+}
+
+void
+Resolver::ExpireCache() noexcept
+{
+	const auto now = event_loop.SteadyNow();
+
+	std::erase_if(cache, [now](const auto &i){
+		return i.second.expires <= now;
+	});
+
+	if (!cache.empty())
+		expire_timer.Schedule(std::chrono::minutes{1});
+}
+
+void
+Resolver::FlushCache() noexcept
+{
+	cache.clear();
+	expire_timer.Cancel();
+}
+
+/**
+ * Try to parse the host name as a numeric IPv4 or IPv6 address.
+ *
+ * @return true if the handler has been invoked
+ */
+static bool
+ResolveNumeric(std::string_view hostname, unsigned port, int family,
+	       ResolveHostnameHandler &handler) noexcept
+{
+	/* inet_pton() needs a null-terminated string */
+	std::array<char, 64> buffer;
+	if (hostname.size() >= buffer.size())
+		return false;
+
+	*std::copy(hostname.begin(), hostname.end(), buffer.begin()) = '\0';
+
+	struct in_addr in4;
+	struct in6_addr in6;
+
+	if (inet_pton(AF_INET, buffer.data(), &in4) == 1) {
+		if (family == AF_INET6) {
+			InvokeNotFound(handler);
+			return true;
+		}
+
+		const IPv4Address address{in4, static_cast<uint16_t>(port)};
+		const SocketAddress result = address;
+		handler.OnResolveHostname({&result, 1});
+		return true;
+	} else if (inet_pton(AF_INET6, buffer.data(), &in6) == 1) {
+		if (family == AF_INET) {
+			InvokeNotFound(handler);
+			return true;
+		}
+
+		const IPv6Address address{in6, static_cast<uint16_t>(port)};
+		const SocketAddress result = address;
+		handler.OnResolveHostname({&result, 1});
+		return true;
+	} else
+		return false;
+}
+
+void
+Resolver::ResolveHostname(std::string_view hostname, unsigned port, int family,
+			  ResolveHostnameHandler &handler,
+			  CancellablePointer &cancel_ptr) noexcept
+{
+	if (family != AF_UNSPEC && family != AF_INET && family != AF_INET6) {
+		handler.OnResolveHostnameError(std::make_exception_ptr(std::invalid_argument{"Unsupported address family"}));
+		return;
+	}
+
+	if (ResolveNumeric(hostname, port, family, handler))
+		return;
+
+	if (!IsValidName(hostname)) {
+		handler.OnResolveHostnameError(std::make_exception_ptr(std::invalid_argument{"Invalid host name"}));
+		return;
+	}
+
+	auto key = MakeKey(hostname, family);
+
+	if (auto i = cache.find(key); i != cache.end()) {
+		if (i->second.expires > event_loop.SteadyNow()) {
+			if (i->second.addresses.empty())
+				InvokeNotFound(handler);
+			else
+				InvokeHandler(handler, i->second.addresses, port);
+			return;
+		}
+
+		cache.erase(i);
+	}
+
+	if (auto i = lookups.find(key); i != lookups.end()) {
+		/* coalesce with the lookup which is already in
+		   progress */
+		i->second->AddWaiter(handler, port, cancel_ptr);
+		return;
+	}
+
+	auto lookup = std::make_unique<Lookup>(*this, std::move(key), hostname);
+
+	try {
+		lookup->Start(family);
+	} catch (...) {
+		handler.OnResolveHostnameError(std::current_exception());
+		return;
+	}
+
+	lookup->AddWaiter(handler, port, cancel_ptr);
+	lookups.emplace(lookup->GetKey(), lookup.get());
+	lookup.release();
+}
+
+} // namespace Dns
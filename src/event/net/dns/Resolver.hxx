@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "net/dns/ResolvConf.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/Chrono.hxx"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class SocketAddress;
+class AllocatedSocketAddress;
+class UniqueSocketDescriptor;
+class CancellablePointer;
+
+namespace Dns {
+
+/**
+ * The host name does not exist or has no addresses of the requested
+ * family.
+ */
+class HostNotFoundError : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+class ResolveHostnameHandler {
+public:
+	virtual void OnResolveHostname(std::span<const SocketAddress> addresses) noexcept = 0;
+	virtual void OnResolveHostnameError(std::exception_ptr error) noexcept = 0;
+};
+
+/**
+ * An asynchronous DNS stub resolver which sends queries to the
+ * name servers from resolv.conf (over UDP, falling back to TCP for
+ * truncated responses).  On systems with systemd-resolved, this is
+ * usually its stub listener on 127.0.0.53.
+ *
+ * Query ids and UDP source ports are taken from the kernel's CSPRNG.
+ * Relative names are qualified with the "search" domains according
+ * to "ndots" like glibc does (but without falling back to the domain
+ * of the local host name).
+ *
+ * Responses are cached according to their TTL, negative responses
+ * (RFC 2308) included.  If only one of the AAAA and A queries
+ * fails, the addresses of the other one are delivered, but cached
+ * no longer than #PARTIAL_TTL.  Concurrent requests for the same
+ * name share one query.
+ */
+class Resolver final {
+	class Query;
+	class Lookup;
+	class Waiter;
+
+	struct CacheItem {
+		/**
+		 * The addresses (with port 0); empty if this is a
+		 * negative cache item.
+		 */
+		std::vector<AllocatedSocketAddress> addresses;
+
+		Event::TimePoint expires;
+	};
+
+	EventLoop &event_loop;
+
+	const ResolvConf config;
+
+	/**
+	 * Cached responses, indexed by MakeKey().
+	 */
+	std::map<std::string, CacheItem, std::less<>> cache;
+
+	/**
+	 * Periodically removes expired items from #cache.
+	 */
+	CoarseTimerEvent expire_timer;
+
+	/**
+	 * Lookups in progress, indexed by MakeKey().
+	 */
+	std::map<std::string, Lookup *, std::less<>> lookups;
+
+	/**
+	 * Random numbers for query ids and source ports, filled from
+	 * the kernel's CSPRNG in batches by MakeRandom().
+	 */
+	std::array<uint_least16_t, 64> random_pool;
+	std::size_t random_pool_size = 0;
+
+public:
+	/**
+	 * Responses are never cached longer than this.
+	 */
+	static constexpr std::chrono::seconds MAX_TTL{3600};
+
+	/**
+	 * The TTL of negative responses without a SOA record.
+	 */
+	static constexpr std::chrono::seconds DEFAULT_NEGATIVE_TTL{30};
+
+	/**
+	 * If one of the two queries (AAAA and A) has failed, the
+	 * addresses of the other one are cached no longer than this,
+	 * so the failed query will be retried soon.
+	 */
+	static constexpr std::chrono::seconds PARTIAL_TTL{10};
+
+	/**
+	 * The maximum number of cache items.
+	 */
+	static constexpr std::size_t MAX_CACHE_SIZE = 4096;
+
+	Resolver(EventLoop &_event_loop, ResolvConf &&_config);
+	~Resolver() noexcept;
+
+	Resolver(const Resolver &) = delete;
+	Resolver &operator=(const Resolver &) = delete;
+
+	auto &GetEventLoop() const noexcept {
+		return event_loop;
+	}
+
+	std::size_t GetCacheSize() const noexcept {
+		return cache.size();
+	}
+
+	/**
+	 * Remove all items from the cache.
+	 */
+	void FlushCache() noexcept;
+
+	/**
+	 * Resolve a host name (or parse a numeric address).  The
+	 * handler may be invoked synchronously (e.g. on a cache hit).
+	 *
+	 * @param port the port number to be stored in the resulting
+	 * addresses
+	 * @param family AF_INET, AF_INET6 or AF_UNSPEC
+	 */
+	void ResolveHostname(std::string_view hostname, unsigned port, int family,
+			     ResolveHostnameHandler &handler,
+			     CancellablePointer &cancel_ptr) noexcept;
+
+private:
+	/**
+	 * Obtain a random number from the kernel's CSPRNG.
+	 *
+	 * Throws on error.
+	 */
+	uint_least16_t MakeRandom();
+
+	/**
+	 * Create a UDP socket bound to a random port and connect it
+	 * to the given name server.
+	 *
+	 * Throws on error.
+	 */
+	UniqueSocketDescriptor CreateUdpSocket(SocketAddress address);
+
+	std::string MakeKey(std::string_view name, int family) const noexcept;
+
+	void AddCache(std::string_view key,
+		      std::vector<AllocatedSocketAddress> &&addresses,
+		      std::chrono::seconds ttl) noexcept;
+
+	void OnLookupFinished(Lookup &lookup) noexcept;
+
+	void ExpireCache() noexcept;
+};
+
+} // namespace Dns
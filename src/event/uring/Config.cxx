@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "Config.hxx"
+
+#include <liburing.h>
+
+#include <cassert>
+
+namespace Uring {
+
+void
+ManagerConfig::Apply(struct io_uring_params &params) const noexcept
+{
+	/* the kernel rejects the task_run flags with SQPOLL; the
+	   SQPOLL thread doesn't need interrupts anyway */
+	assert(!sqpoll || task_run == TaskRun::DEFAULT);
+
+	if (sqpoll) {
+		params.flags |= IORING_SETUP_SQPOLL;
+
+		if (sqpoll_cpu >= 0) {
+			params.flags |= IORING_SETUP_SQ_AFF;
+			params.sq_thread_cpu = static_cast<unsigned>(sqpoll_cpu);
+		}
+
+		params.sq_thread_idle = static_cast<unsigned>(sqpoll_idle.count());
+	}
+
+	switch (task_run) {
+	case TaskRun::DEFAULT:
+		break;
+
+	case TaskRun::COOP:
+		/* TASKRUN_FLAG lets liburing know when it needs to
+		   enter the kernel to flush pending completions */
+		params.flags |= IORING_SETUP_COOP_TASKRUN|IORING_SETUP_TASKRUN_FLAG;
+		break;
+
+	case TaskRun::DEFER:
+		/* the ring is created disabled and gets enabled by
+		   EventLoop::EnableUring(), because the calling
+		   thread becomes the "single issuer" */
+		params.flags |= IORING_SETUP_SINGLE_ISSUER|IORING_SETUP_DEFER_TASKRUN|
+			IORING_SETUP_R_DISABLED;
+		break;
+	}
+}
+
+} // namespace Uring
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+struct io_uring_params;
+
+namespace Uring {
+
+/**
+ * How the #EventLoop's io_uring shall be set up.  Pass it to
+ * EventLoop::EnableUring().
+ */
+struct ManagerConfig {
+	unsigned entries = 1024;
+
+	/**
+	 * Let a kernel thread poll the submission queue
+	 * (IORING_SETUP_SQPOLL), so submitting does not require a
+	 * system call.  The thread occupies a CPU while it is busy.
+	 * This cannot be combined with #TaskRun::COOP or
+	 * #TaskRun::DEFER.
+	 */
+	bool sqpoll = false;
+
+	/**
+	 * Pin the SQPOLL kernel thread to this CPU
+	 * (IORING_SETUP_SQ_AFF).  A negative value disables pinning.
+	 */
+	int sqpoll_cpu = -1;
+
+	/**
+	 * The SQPOLL kernel thread goes to sleep after it has been
+	 * idle for this duration; zero selects the kernel's default
+	 * (one second).
+	 */
+	std::chrono::milliseconds sqpoll_idle{};
+
+	enum class TaskRun : uint_least8_t {
+		/**
+		 * The kernel interrupts the task to post completions.
+		 */
+		DEFAULT,
+
+		/**
+		 * IORING_SETUP_COOP_TASKRUN: completions are posted
+		 * at the next transition to the kernel, without an
+		 * interrupt (requires Linux 5.19).
+		 */
+		COOP,
+
+		/**
+		 * IORING_SETUP_SINGLE_ISSUER and
+		 * IORING_SETUP_DEFER_TASKRUN: completions are posted
+		 * only while the #EventLoop waits for them; this
+		 * batches work and avoids interrupts, but only the
+		 * thread which runs the #EventLoop may submit
+		 * (requires Linux 6.1).
+		 */
+		DEFER,
+	};
+
+	TaskRun task_run = TaskRun::DEFAULT;
+
+	/**
+	 * Fill the given (zero-initialized) #io_uring_params.
+	 */
+	void Apply(struct io_uring_params &params) const noexcept;
+};
+
+} // namespace Uring
@@ -9,8 +9,58 @@
 namespace Uring {
 
 class Manager final : public Queue {
+	/**
+	 * The IORING_SETUP_* flags this ring was created with.
+	 */
+	unsigned setup_flags;
+
 public:
-	using Queue::Queue;
+	Manager(unsigned entries, unsigned flags)
+		:Queue(entries, flags), setup_flags(flags) {}
+
+	Manager(unsigned entries, struct io_uring_params &params)
+		:Queue(entries, params), setup_flags(params.flags) {}
+
+	/**
+	 * Does a kernel thread poll the submission queue?  If yes,
+	 * submitting does not require a system call, and completions
+	 * get posted while we're not inside the kernel.
+	 */
+	bool IsSqPoll() const noexcept {
+		return setup_flags & IORING_SETUP_SQPOLL;
+	}
+
+	/**
+	 * Are completions posted only while we wait for them
+	 * (IORING_SETUP_DEFER_TASKRUN)?
+	 */
+	bool IsDeferTaskRun() const noexcept {
+		return setup_flags & IORING_SETUP_DEFER_TASKRUN;
+	}
+
+	/**
+	 * If the ring was created with IORING_SETUP_R_DISABLED,
+	 * enable it now.  This must be called in the thread which
+	 * runs the #EventLoop.
+	 *
+	 * Throws on error.
+	 */
+	void EnableIfDisabled() {
+		if (setup_flags & IORING_SETUP_R_DISABLED) {
+			GetRing().EnableRings();
+			setup_flags &= ~IORING_SETUP_R_DISABLED;
+		}
+	}
+
+	/**
+	 * Submit all pending entries now.  With IORING_SETUP_SQPOLL,
+	 * this usually does not need a system call.
+	 *
+	 * Throws on error.
+	 */
+	void FlushSubmit() {
+		Queue::Submit();
+	}
 
 	// virtual methods from class Uring::Queue
 	void Submit() override {
@@ -3,6 +3,7 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "Date.hxx"
+#include "DateCache.hxx"
 #include "time/gmtime.hxx"
 #include "util/CharUtil.hxx"
 #include "util/DecimalFormat.hxx"
@@ -100,13 +101,11 @@ http_date_format_r(char *buffer,
 	return buffer;
 }
 
-static char buffer[30];
-
 const char *
 http_date_format(std::chrono::system_clock::time_point t) noexcept
 {
-	*http_date_format_r(buffer, t) = '\0';
-	return buffer;
+	static thread_local HttpDateCache cache;
+	return cache.Format(t).data();
 }
 
 static constexpr int
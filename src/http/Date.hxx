@@ -9,8 +9,17 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
 
 /**
+ * The length of a formatted HTTP date (without the null
+ * terminator), e.g. "Thu, 01 Jan 1970 00:00:00 GMT".
+ */
+static constexpr std::size_t HTTP_DATE_LENGTH = 29;
+
+/**
+ * @param buffer a buffer with room for at least #HTTP_DATE_LENGTH
+ * characters
  * @return the end pointer (not null-terminated)
  */
 [[nodiscard]]
@@ -18,7 +27,11 @@ char *
 http_date_format_r(char *buffer,
 		   std::chrono::system_clock::time_point t) noexcept;
 
-[[gnu::const]]
+/**
+ * Format the time stamp into a thread-local buffer which is
+ * overwritten by the next call in the same thread.  Consecutive
+ * calls within the same second are cheap (see #HttpDateCache).
+ */
 const char *
 http_date_format(std::chrono::system_clock::time_point t) noexcept;
 
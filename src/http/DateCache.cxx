@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "DateCache.hxx"
+#include "util/DecimalFormat.hxx"
+
+/**
+ * The position of the seconds digits in a formatted HTTP date.
+ */
+static constexpr std::size_t SECONDS_POSITION = 23;
+
+/**
+ * Round down to whole seconds since the epoch.  Unlike
+ * std::chrono::system_clock::to_time_t(), this rounds towards
+ * negative infinity, so all time points within one second map to the
+ * same value.
+ */
+static constexpr std::chrono::system_clock::rep
+ToSeconds(std::chrono::system_clock::time_point t) noexcept
+{
+	return std::chrono::floor<std::chrono::seconds>(t.time_since_epoch()).count();
+}
+
+std::string_view
+HttpDateCache::Format(std::chrono::system_clock::time_point t) noexcept
+{
+	const auto s = ToSeconds(t);
+
+	if (s != last) {
+		if (s >= 0 && last >= 0 && s / 60 == last / 60)
+			/* same minute: only the seconds have changed */
+			format_2digit(buffer.data() + SECONDS_POSITION, s % 60);
+		else
+			*http_date_format_r(buffer.data(),
+					    std::chrono::system_clock::time_point{std::chrono::seconds{s}}) = '\0';
+
+		last = s;
+	}
+
+	return {buffer.data(), HTTP_DATE_LENGTH};
+}
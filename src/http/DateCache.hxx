@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "Date.hxx"
+#include "time/ClockCache.hxx"
+
+#include <array>
+#include <chrono>
+#include <limits>
+#include <string_view>
+
+/**
+ * Caches the formatted HTTP date of the current second, so
+ * generating a "Date" response header for each response does not
+ * need to call gmtime() and format all fields.  If only the second
+ * has changed, only the two seconds digits are updated.
+ *
+ * This class is not thread-safe; each thread (or each #EventLoop)
+ * should have its own instance.
+ */
+class HttpDateCache {
+	/**
+	 * The Unix time (in seconds) #buffer was formatted for; the
+	 * initial value is a time stamp nobody will ever format.
+	 */
+	std::chrono::system_clock::rep last =
+		std::numeric_limits<std::chrono::system_clock::rep>::min();
+
+	/**
+	 * Null-terminated.
+	 */
+	std::array<char, HTTP_DATE_LENGTH + 1> buffer;
+
+public:
+	HttpDateCache() noexcept = default;
+
+	HttpDateCache(const HttpDateCache &) = delete;
+	HttpDateCache &operator=(const HttpDateCache &) = delete;
+
+	/**
+	 * Format the given time stamp.
+	 *
+	 * @return a null-terminated string which is valid until the
+	 * next call
+	 */
+	std::string_view Format(std::chrono::system_clock::time_point t) noexcept;
+
+	/**
+	 * Format the time stamp cached by the given #ClockCache (e.g.
+	 * EventLoop::GetSystemClockCache()).
+	 */
+	std::string_view Format(const ClockCache<std::chrono::system_clock> &clock) noexcept {
+		return Format(clock.now());
+	}
+};
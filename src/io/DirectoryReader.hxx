@@ -30,6 +30,14 @@ public:
 			: nullptr;
 	}
 
+	/**
+	 * Like Read(), but return the whole entry (including
+	 * d_type).
+	 */
+	const struct dirent *ReadEntry() noexcept {
+		return readdir(dir);
+	}
+
 	[[gnu::pure]]
 	FileDescriptor GetFileDescriptor() const noexcept;
 };
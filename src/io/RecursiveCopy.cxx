@@ -3,6 +3,7 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "RecursiveCopy.hxx"
+#include "RecursiveCopyContext.hxx"
 #include "CopyRegularFile.hxx"
 #include "FileAt.hxx"
 #include "FileName.hxx"
@@ -21,46 +22,9 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 
-static constexpr int
-RecursiveCopyOptionsToStatxMask(unsigned options) noexcept
-{
-	int mask = STATX_TYPE|STATX_SIZE;
-	if (options & RECURSIVE_COPY_ONE_FILESYSTEM)
-		mask |= STATX_MNT_ID;
-	if (options & RECURSIVE_COPY_PRESERVE_MODE)
-		mask |= STATX_MODE;
-	if (options & RECURSIVE_COPY_PRESERVE_TIME)
-		mask |= STATX_MTIME;
-	return mask;
-}
-
-struct RecursiveCopyContext {
-	uint_least64_t mnt_id{};
-
-	const int statx_mask;
-
-	/**
-	 * @see RECURSIVE_COPY_NO_OVERWRITE
-	 */
-	const bool overwrite;
-
-	const bool one_filesystem;
-
-	const bool preserve_mode, preserve_time;
-
-	constexpr RecursiveCopyContext(unsigned options) noexcept
-		:statx_mask(RecursiveCopyOptionsToStatxMask(options)),
-		 overwrite(!(options & RECURSIVE_COPY_NO_OVERWRITE)),
-		 one_filesystem(options & RECURSIVE_COPY_ONE_FILESYSTEM),
-		 preserve_mode(options & RECURSIVE_COPY_PRESERVE_MODE),
-		 preserve_time(options & RECURSIVE_COPY_PRESERVE_TIME)
-	{
-	}
-};
-
-static void
-Preserve(const RecursiveCopyContext &ctx, const struct statx &stx,
-	 FileDescriptor dst, const char *dst_filename)
+void
+RecursiveCopyPreserve(const RecursiveCopyContext &ctx, const struct statx &stx,
+		      FileDescriptor dst, const char *dst_filename)
 {
 	if (ctx.preserve_mode &&
 	    (S_ISDIR(stx.stx_mode)
@@ -159,11 +123,11 @@ RecursiveCopyDirectory(RecursiveCopyContext &ctx,
 {
 	if (*dst_filename == 0) {
 		RecursiveCopyDirectory(ctx, std::move(src), dst_parent);
-		Preserve(ctx, stx, dst_parent, "?");
+		RecursiveCopyPreserve(ctx, stx, dst_parent, "?");
 	} else {
 		auto dst = MakeDirectory({dst_parent, dst_filename});
 		RecursiveCopyDirectory(ctx, std::move(src), dst);
-		Preserve(ctx, stx, dst, dst_filename);
+		RecursiveCopyPreserve(ctx, stx, dst, dst_filename);
 	}
 }
 
@@ -182,7 +146,7 @@ RecursiveCopy(RecursiveCopyContext &ctx,
 					   stx.stx_size,
 					   ctx.overwrite);
 		if (dst.IsDefined())
-			Preserve(ctx, stx, dst, dst_filename);
+			RecursiveCopyPreserve(ctx, stx, dst, dst_filename);
 	} else {
 		// TODO
 	}
@@ -210,10 +174,10 @@ CreateSymlink(FileDescriptor parent, const char *filename, const char *target,
 		throw FmtErrno("Failed to create {:?}", filename);
 }
 
-static void
-CopySymlink(FileDescriptor src_parent, const char *src_filename,
-	    FileDescriptor dst_parent, const char *dst_filename,
-	    bool overwrite)
+void
+RecursiveCopySymlink(FileDescriptor src_parent, const char *src_filename,
+		     FileDescriptor dst_parent, const char *dst_filename,
+		     bool overwrite)
 {
 	char buffer[4096];
 
@@ -244,9 +208,9 @@ RecursiveCopy(RecursiveCopyContext &ctx,
 		case ELOOP:
 			/* due to O_NOFOLLOW, symlinks fail with
 			   ELOOP, so copy the symlink */
-			CopySymlink(src_file.directory, src_file.name,
-				    dst_file.directory, dst_file.name,
-				    ctx.overwrite);
+			RecursiveCopySymlink(src_file.directory, src_file.name,
+					     dst_file.directory, dst_file.name,
+					     ctx.overwrite);
 			return;
 
 		default:
@@ -261,16 +225,8 @@ RecursiveCopy(RecursiveCopyContext &ctx,
 		  ctx.statx_mask, &stx) < 0)
 		throw FmtErrno("Failed to stat {:?}", src_file.name);
 
-	if (ctx.one_filesystem) {
-		if (ctx.mnt_id == 0)
-			/* this is the top-level call - initialize the
-			   "device" field */
-			ctx.mnt_id = stx.stx_mnt_id;
-		else if (stx.stx_mnt_id != ctx.mnt_id)
-			/* this is on a different device (filesystem);
-			   ignore it */
-			return;
-	}
+	if (!ctx.CheckFilesystem(stx))
+		return;
 
 	RecursiveCopy(ctx, std::move(src), stx, dst_file.directory, dst_file.name);
 }
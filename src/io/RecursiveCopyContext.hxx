@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Internal declarations shared by the RecursiveCopy()
+ * implementations.
+ */
+
+#pragma once
+
+#include "RecursiveCopy.hxx"
+
+#include <cstdint>
+
+#include <sys/stat.h>
+
+static constexpr int
+RecursiveCopyOptionsToStatxMask(unsigned options) noexcept
+{
+	int mask = STATX_TYPE|STATX_SIZE;
+	if (options & RECURSIVE_COPY_ONE_FILESYSTEM)
+		mask |= STATX_MNT_ID;
+	if (options & RECURSIVE_COPY_PRESERVE_MODE)
+		mask |= STATX_MODE;
+	if (options & RECURSIVE_COPY_PRESERVE_TIME)
+		mask |= STATX_MTIME;
+	return mask;
+}
+
+struct RecursiveCopyContext {
+	uint_least64_t mnt_id{};
+
+	const int statx_mask;
+
+	/**
+	 * @see RECURSIVE_COPY_NO_OVERWRITE
+	 */
+	const bool overwrite;
+
+	const bool one_filesystem;
+
+	const bool preserve_mode, preserve_time;
+
+	constexpr RecursiveCopyContext(unsigned options) noexcept
+		:statx_mask(RecursiveCopyOptionsToStatxMask(options)),
+		 overwrite(!(options & RECURSIVE_COPY_NO_OVERWRITE)),
+		 one_filesystem(options & RECURSIVE_COPY_ONE_FILESYSTEM),
+		 preserve_mode(options & RECURSIVE_COPY_PRESERVE_MODE),
+		 preserve_time(options & RECURSIVE_COPY_PRESERVE_TIME)
+	{
+	}
+
+	/**
+	 * Check whether the given file is on the initial filesystem
+	 * (if #one_filesystem is enabled).  The first call
+	 * determines the initial filesystem.
+	 */
+	bool CheckFilesystem(const struct statx &stx) noexcept {
+		if (!one_filesystem)
+			return true;
+
+		if (mnt_id == 0) {
+			/* this is the top-level call - initialize the
+			   "device" field */
+			mnt_id = stx.stx_mnt_id;
+			return true;
+		}
+
+		/* if this is on a different device (filesystem),
+		   ignore it */
+		return stx.stx_mnt_id == mnt_id;
+	}
+};
+
+/**
+ * Apply the mode and the modification time of the source file (if
+ * enabled) to the destination file.
+ *
+ * @param dst the destination file (or an O_PATH descriptor of the
+ * destination directory)
+ */
+void
+RecursiveCopyPreserve(const RecursiveCopyContext &ctx, const struct statx &stx,
+		      FileDescriptor dst, const char *dst_filename);
+
+/**
+ * Copy a symlink as-is.
+ */
+void
+RecursiveCopySymlink(FileDescriptor src_parent, const char *src_filename,
+		     FileDescriptor dst_parent, const char *dst_filename,
+		     bool overwrite);
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "CgroupStat.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringSplit.hxx"
+
+using std::string_view_literals::operator""sv;
+
+CgroupCpuStat
+ParseCgroupCpuStat(std::string_view text) noexcept
+{
+	CgroupCpuStat result{};
+
+	for (const std::string_view line : IterableSplitString{text, '\n'}) {
+		const auto [name, value] = Split(line, ' ');
+		if (name == "usage_usec"sv)
+			ParseIntegerTo(value, result.usage_usec);
+		else if (name == "user_usec"sv)
+			ParseIntegerTo(value, result.user_usec);
+		else if (name == "system_usec"sv)
+			ParseIntegerTo(value, result.system_usec);
+		else if (name == "nr_periods"sv)
+			ParseIntegerTo(value, result.nr_periods);
+		else if (name == "nr_throttled"sv)
+			ParseIntegerTo(value, result.nr_throttled);
+		else if (name == "throttled_usec"sv)
+			ParseIntegerTo(value, result.throttled_usec);
+	}
+
+	return result;
+}
+
+CgroupMemoryStat
+ParseCgroupMemoryStat(std::string_view text) noexcept
+{
+	CgroupMemoryStat result{};
+
+	for (const std::string_view line : IterableSplitString{text, '\n'}) {
+		const auto [name, value] = Split(line, ' ');
+		if (name == "anon"sv)
+			ParseIntegerTo(value, result.anon);
+		else if (name == "file"sv)
+			ParseIntegerTo(value, result.file);
+		else if (name == "kernel"sv)
+			ParseIntegerTo(value, result.kernel);
+		else if (name == "sock"sv)
+			ParseIntegerTo(value, result.sock);
+		else if (name == "shmem"sv)
+			ParseIntegerTo(value, result.shmem);
+		else if (name == "pgfault"sv)
+			ParseIntegerTo(value, result.pgfault);
+		else if (name == "pgmajfault"sv)
+			ParseIntegerTo(value, result.pgmajfault);
+	}
+
+	return result;
+}
+
+CgroupIoStat
+ParseCgroupIoStat(std::string_view text) noexcept
+{
+	CgroupIoStat result{};
+
+	for (const std::string_view line : IterableSplitString{text, '\n'}) {
+		/* skip the device number ("MAJ:MIN") */
+		const auto values = Split(line, ' ').second;
+
+		for (const std::string_view i : IterableSplitString{values, ' '}) {
+			const auto [name, s] = Split(i, '=');
+
+			uint_least64_t value;
+			if (!ParseIntegerTo(s, value))
+				continue;
+
+			if (name == "rbytes"sv)
+				result.rbytes += value;
+			else if (name == "wbytes"sv)
+				result.wbytes += value;
+			else if (name == "rios"sv)
+				result.rios += value;
+			else if (name == "wios"sv)
+				result.wios += value;
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Parsers for cgroup2 statistics files.  They operate on a buffer
+ * which has already been read by the caller (e.g. with pread() on a
+ * file descriptor that is kept open) and do not allocate memory.
+ * Unknown keys and malformed lines are ignored.
+ */
+
+/**
+ * Parsed contents of a cgroup "cpu.stat" file.
+ */
+struct CgroupCpuStat {
+	uint_least64_t usage_usec, user_usec, system_usec;
+	uint_least64_t nr_periods, nr_throttled, throttled_usec;
+};
+
+/**
+ * Parse the contents of a "cpu.stat" file (flat keyed).
+ */
+[[gnu::pure]]
+CgroupCpuStat
+ParseCgroupCpuStat(std::string_view text) noexcept;
+
+/**
+ * Parsed contents of a cgroup "memory.stat" file (only the most
+ * important fields).  The sizes are in bytes.
+ */
+struct CgroupMemoryStat {
+	uint_least64_t anon, file, kernel, sock, shmem;
+
+	/**
+	 * Event counters (monotonic, unlike the other fields).
+	 */
+	uint_least64_t pgfault, pgmajfault;
+};
+
+/**
+ * Parse the contents of a "memory.stat" file (flat keyed).
+ */
+[[gnu::pure]]
+CgroupMemoryStat
+ParseCgroupMemoryStat(std::string_view text) noexcept;
+
+/**
+ * Parsed contents of a cgroup "io.stat" file, summed over all
+ * devices.
+ */
+struct CgroupIoStat {
+	uint_least64_t rbytes, wbytes, rios, wios;
+};
+
+/**
+ * Parse the contents of an "io.stat" file (nested keyed, one line
+ * per device).
+ */
+[[gnu::pure]]
+CgroupIoStat
+ParseCgroupIoStat(std::string_view text) noexcept;
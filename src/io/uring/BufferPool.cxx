@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "BufferPool.hxx"
+#include "Queue.hxx"
+
+#include <cassert>
+#include <new> // for std::bad_alloc
+
+#include <sys/mman.h>
+
+namespace Uring {
+
+static std::byte *
+AllocateBuffers(std::size_t size)
+{
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE,
+		       MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		throw std::bad_alloc{};
+
+	return static_cast<std::byte *>(p);
+}
+
+BufferPool::BufferPool(Queue &_queue, unsigned n_buffers,
+		       std::size_t _buffer_size)
+	:queue(_queue),
+	 data(AllocateBuffers(n_buffers * _buffer_size)),
+	 buffer_size(_buffer_size), total_size(n_buffers * buffer_size)
+{
+	try {
+		std::vector<struct iovec> iov;
+		iov.reserve(n_buffers);
+		for (unsigned i = 0; i < n_buffers; ++i) {
+			const auto b = Get(i);
+			iov.push_back({b.data(), b.size()});
+		}
+
+		queue.GetRing().RegisterBuffers(iov);
+
+		/* allocate low indexes first */
+		free_buffers.reserve(n_buffers);
+		for (unsigned i = n_buffers; i > 0; --i)
+			free_buffers.push_back(i - 1);
+	} catch (...) {
+		munmap(data, total_size);
+		throw;
+	}
+}
+
+BufferPool::~BufferPool() noexcept
+{
+	assert(free_buffers.size() * buffer_size == total_size);
+
+	queue.GetRing().UnregisterBuffers();
+	munmap(data, total_size);
+}
+
+} // namespace Uring
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace Uring {
+
+class Queue;
+
+/**
+ * A pool of equally-sized buffers which are registered with a
+ * #Queue ("fixed buffers").  The kernel pins their pages once, so
+ * operations like CoReadFixed don't need to do that for each
+ * operation.
+ *
+ * There can be only one instance per #Queue.
+ */
+class BufferPool {
+	Queue &queue;
+
+	std::byte *const data;
+
+	const std::size_t buffer_size, total_size;
+
+	/**
+	 * The indexes of all free buffers.
+	 */
+	std::vector<unsigned> free_buffers;
+
+public:
+	/**
+	 * A buffer allocated from a #BufferPool; it is returned to
+	 * the pool by the destructor.
+	 */
+	class Buffer {
+		BufferPool *pool = nullptr;
+		unsigned index;
+
+	public:
+		Buffer() noexcept = default;
+
+		Buffer(BufferPool &_pool, unsigned _index) noexcept
+			:pool(&_pool), index(_index) {}
+
+		Buffer(Buffer &&src) noexcept
+			:pool(std::exchange(src.pool, nullptr)), index(src.index) {}
+
+		~Buffer() noexcept {
+			if (pool != nullptr)
+				pool->Free(index);
+		}
+
+		Buffer &operator=(Buffer &&src) noexcept {
+			using std::swap;
+			swap(pool, src.pool);
+			swap(index, src.index);
+			return *this;
+		}
+
+		operator bool() const noexcept {
+			return pool != nullptr;
+		}
+
+		/**
+		 * The index to be passed to io_uring_prep_read_fixed()
+		 * and io_uring_prep_write_fixed().
+		 */
+		unsigned GetIndex() const noexcept {
+			return index;
+		}
+
+		std::span<std::byte> get() const noexcept {
+			return pool->Get(index);
+		}
+	};
+
+	/**
+	 * Throws on error.
+	 */
+	BufferPool(Queue &_queue, unsigned n_buffers, std::size_t _buffer_size);
+
+	~BufferPool() noexcept;
+
+	BufferPool(const BufferPool &) = delete;
+	BufferPool &operator=(const BufferPool &) = delete;
+
+	std::size_t GetBufferSize() const noexcept {
+		return buffer_size;
+	}
+
+	/**
+	 * Allocate a buffer.
+	 *
+	 * @return the buffer or a "nulled" instance if all buffers
+	 * are in use
+	 */
+	[[nodiscard]]
+	Buffer Allocate() noexcept {
+		if (free_buffers.empty())
+			return {};
+
+		const unsigned index = free_buffers.back();
+		free_buffers.pop_back();
+		return {*this, index};
+	}
+
+private:
+	std::span<std::byte> Get(unsigned index) const noexcept {
+		return {data + index * buffer_size, buffer_size};
+	}
+
+	void Free(unsigned index) noexcept {
+		free_buffers.push_back(index);
+	}
+};
+
+} // namespace Uring
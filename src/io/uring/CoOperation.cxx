@@ -82,6 +82,29 @@ CoOpenOperation::CoOpenOperation(struct io_uring_sqe &s,
 			     flags|O_NOCTTY|O_CLOEXEC|O_NONBLOCK, mode);
 }
 
+CoOpenDirectOperation::CoOpenDirectOperation(struct io_uring_sqe &s,
+					     FileDescriptor directory_fd,
+					     const char *path,
+					     int flags, mode_t mode,
+					     unsigned file_index,
+					     int sqe_flags) noexcept
+{
+	/* no O_CLOEXEC here because direct descriptors are not file
+	   descriptors */
+	io_uring_prep_openat_direct(&s, directory_fd.Get(), path,
+				    flags|O_NOCTTY|O_NONBLOCK, mode,
+				    file_index);
+	s.flags = sqe_flags;
+}
+
+CoCloseDirectOperation::CoCloseDirectOperation(struct io_uring_sqe &s,
+					       FixedFile file,
+					       int sqe_flags) noexcept
+{
+	io_uring_prep_close_direct(&s, file.index);
+	s.flags = sqe_flags;
+}
+
 CoOpen
 CoOpenReadOnly(Queue &queue, FileDescriptor directory_fd, const char *path) noexcept
 {
@@ -103,6 +126,15 @@ CoReadOperation::CoReadOperation(struct io_uring_sqe &s,
 	s.flags = flags;
 }
 
+CoReadOperation::CoReadOperation(struct io_uring_sqe &s,
+				 FixedFile file,
+				 std::span<std::byte> dest,
+				 off_t offset, int flags) noexcept
+{
+	io_uring_prep_read(&s, file.index, dest.data(), dest.size(), offset);
+	s.flags = flags|IOSQE_FIXED_FILE;
+}
+
 std::size_t
 CoReadOperation::GetValue(int value) const
 {
@@ -112,6 +144,37 @@ CoReadOperation::GetValue(int value) const
 	return value;
 }
 
+CoReadFixedOperation::CoReadFixedOperation(struct io_uring_sqe &s,
+					   FileDescriptor fd,
+					   std::span<std::byte> dest,
+					   unsigned buffer_index,
+					   off_t offset, int flags) noexcept
+{
+	io_uring_prep_read_fixed(&s, fd.Get(), dest.data(), dest.size(),
+				 offset, buffer_index);
+	s.flags = flags;
+}
+
+CoReadFixedOperation::CoReadFixedOperation(struct io_uring_sqe &s,
+					   FixedFile file,
+					   std::span<std::byte> dest,
+					   unsigned buffer_index,
+					   off_t offset, int flags) noexcept
+{
+	io_uring_prep_read_fixed(&s, file.index, dest.data(), dest.size(),
+				 offset, buffer_index);
+	s.flags = flags|IOSQE_FIXED_FILE;
+}
+
+std::size_t
+CoReadFixedOperation::GetValue(int value) const
+{
+	if (value < 0)
+		throw MakeErrno(-value, "Failed to read");
+
+	return value;
+}
+
 CoBaseWriteOperation::CoBaseWriteOperation(struct io_uring_sqe &s,
 					   FileDescriptor fd,
 					   std::span<const std::byte> src,
@@ -144,4 +207,11 @@ CoUnlinkOperation::CoUnlinkOperation(struct io_uring_sqe &sqe,
 	io_uring_prep_unlinkat(&sqe, directory_fd.Get(), path, flags);
 }
 
+CoMkdirOperation::CoMkdirOperation(struct io_uring_sqe &sqe,
+				   FileDescriptor directory_fd, const char *path,
+				   mode_t mode) noexcept
+{
+	io_uring_prep_mkdirat(&sqe, directory_fd.Get(), path, mode);
+}
+
 } // namespace Uring
@@ -21,6 +21,14 @@ namespace Uring {
 
 class Queue;
 
+/**
+ * A file in the registered file table (see #FileTable), to be used
+ * with operations which support #IOSQE_FIXED_FILE.
+ */
+struct FixedFile {
+	unsigned index;
+};
+
 /**
  * Coroutine integration for an io_uring #Operation.
  */
@@ -102,6 +110,36 @@ public:
 
 using CoOpen = CoOperation<CoOpenOperation>;
 
+/**
+ * Like #CoOpenOperation, but install the new file in the registered
+ * file table (a "direct descriptor") instead of allocating a file
+ * descriptor.  Requires Linux 5.15.
+ *
+ * @return the slot index (if #IORING_FILE_INDEX_ALLOC was passed),
+ * 0 on success or a negative errno value on error (no exceptions
+ * thrown on error)
+ */
+class CoOpenDirectOperation final {
+public:
+	/**
+	 * @param file_index the slot to install the file in; pass
+	 * #IORING_FILE_INDEX_ALLOC to let the kernel choose one
+	 * (requires Linux 5.19)
+	 * @param sqe_flags flags for the submit queue entry, e.g.
+	 * #IOSQE_IO_LINK
+	 */
+	CoOpenDirectOperation(struct io_uring_sqe &sqe,
+			      FileDescriptor directory_fd, const char *path,
+			      int flags, mode_t mode,
+			      unsigned file_index, int sqe_flags=0) noexcept;
+
+	int GetValue(int value) const noexcept {
+		return value;
+	}
+};
+
+using CoOpenDirect = CoOperation<CoOpenDirectOperation>;
+
 CoOpen
 CoOpenReadOnly(Queue &queue,
 	       FileDescriptor directory_fd, const char *path) noexcept;
@@ -118,17 +156,64 @@ public:
 
 using CoClose = CoOperation<CoCloseOperation>;
 
+/**
+ * Close a direct descriptor, i.e. clear a slot in the registered
+ * file table.
+ *
+ * @return 0 on success or a negative errno value on error (no
+ * exceptions thrown on error)
+ */
+class CoCloseDirectOperation final {
+public:
+	CoCloseDirectOperation(struct io_uring_sqe &sqe, FixedFile file,
+			       int sqe_flags=0) noexcept;
+
+	int GetValue(int value) const noexcept {
+		return value;
+	}
+};
+
+using CoCloseDirect = CoOperation<CoCloseDirectOperation>;
+
 class CoReadOperation final {
 public:
 	CoReadOperation(struct io_uring_sqe &sqe, FileDescriptor fd,
 			std::span<std::byte> dest,
 			off_t offset, int flags=0) noexcept;
 
+	CoReadOperation(struct io_uring_sqe &sqe, FixedFile file,
+			std::span<std::byte> dest,
+			off_t offset, int flags=0) noexcept;
+
 	std::size_t GetValue(int value) const;
 };
 
 using CoRead = CoOperation<CoReadOperation>;
 
+/**
+ * Like #CoReadOperation, but read into a registered buffer (see
+ * #BufferPool).
+ */
+class CoReadFixedOperation final {
+public:
+	/**
+	 * @param dest the destination; must be inside the registered
+	 * buffer
+	 * @param buffer_index the index of the registered buffer
+	 */
+	CoReadFixedOperation(struct io_uring_sqe &sqe, FileDescriptor fd,
+			     std::span<std::byte> dest, unsigned buffer_index,
+			     off_t offset, int flags=0) noexcept;
+
+	CoReadFixedOperation(struct io_uring_sqe &sqe, FixedFile file,
+			     std::span<std::byte> dest, unsigned buffer_index,
+			     off_t offset, int flags=0) noexcept;
+
+	std::size_t GetValue(int value) const;
+};
+
+using CoReadFixed = CoOperation<CoReadFixedOperation>;
+
 /**
  * Perform a write().  Returns a negative errno value on error.
  */
@@ -188,4 +273,23 @@ public:
 
 using CoUnlink = CoOperation<CoUnlinkOperation>;
 
+/**
+ * Performs the mkdirat() system call.
+ *
+ * @return 0 on success or a negative errno value on error (no
+ * exceptions thrown on error)
+ */
+class CoMkdirOperation final {
+public:
+	CoMkdirOperation(struct io_uring_sqe &sqe,
+			 FileDescriptor directory_fd, const char *path,
+			 mode_t mode) noexcept;
+
+	int GetValue(int value) const noexcept {
+		return value;
+	}
+};
+
+using CoMkdir = CoOperation<CoMkdirOperation>;
+
 } // namespace Uring
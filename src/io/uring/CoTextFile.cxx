@@ -4,10 +4,15 @@
 
 #include "CoTextFile.hxx"
 #include "CoOperation.hxx"
+#include "FileTable.hxx"
+#include "Operation.hxx"
+#include "Queue.hxx"
 #include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
 
 #include <liburing.h>
 
+#include <optional>
 #include <stdexcept>
 
 #include <fcntl.h>
@@ -62,4 +67,82 @@ CoReadTextFile(Queue &queue, FileDescriptor directory_fd, const char *path,
 	co_return value;
 }
 
+/**
+ * Closes a direct descriptor and returns its slot to the #FileTable
+ * from the completion handler, i.e. after the kernel has finished
+ * all operations linked before it.  This object deletes itself,
+ * therefore the slot is not reused too early even if the coroutine
+ * which submitted the chain gets destroyed meanwhile.
+ */
+class CloseDirectAndFreeSlot final : Operation {
+	FileTable &files;
+	const unsigned slot;
+
+public:
+	CloseDirectAndFreeSlot(FileTable &_files, unsigned _slot) noexcept
+		:files(_files), slot(_slot) {}
+
+	/**
+	 * Throws on error.
+	 */
+	void Start() {
+		auto &queue = files.GetQueue();
+		auto &s = queue.RequireSubmitEntry();
+		io_uring_prep_close_direct(&s, slot);
+		queue.Push(s, *this);
+	}
+
+private:
+	/* virtual methods from class Uring::Operation */
+	void OnUringCompletion(int) noexcept override {
+		files.FreeSlot(slot);
+		delete this;
+	}
+};
+
+Co::Task<std::size_t>
+CoReadFileDirect(FileTable &files, FileDescriptor directory_fd,
+		 const char *path, std::span<std::byte> dest)
+{
+	const auto slot = files.AllocateSlot();
+	if (!slot)
+		throw std::runtime_error{"Registered file table is full"};
+
+	auto &queue = files.GetQueue();
+	const FixedFile file{*slot};
+
+	/* the read() is canceled if the openat() fails; the close()
+	   runs even if the read() fails (IOSQE_IO_HARDLINK) */
+	std::optional<CoOpenDirect> open;
+
+	try {
+		open.emplace(queue, directory_fd, path, O_RDONLY, 0,
+			     file.index, IOSQE_IO_LINK);
+	} catch (...) {
+		/* nothing was submitted */
+		files.FreeSlot(*slot);
+		throw;
+	}
+
+	/* from here on, the kernel may be using the slot; if one of
+	   the following throws, the slot is leaked, because it
+	   cannot be known when it is safe to reuse it */
+	auto read = CoRead(queue, file, dest, 0, IOSQE_IO_HARDLINK);
+
+	/* the slot is freed by the close() completion handler */
+	auto *close = new CloseDirectAndFreeSlot(files, *slot);
+	try {
+		close->Start();
+	} catch (...) {
+		delete close;
+		throw;
+	}
+
+	const int open_result = co_await *open;
+	if (open_result < 0)
+		throw MakeErrno(-open_result, "Failed to open file");
+
+	co_return co_await read;
+}
+
 } // namespace Uring
@@ -6,6 +6,8 @@
 
 #include "co/Task.hxx"
 
+#include <cstddef>
+#include <span>
 #include <string>
 
 #include <sys/stat.h>
@@ -15,9 +17,34 @@ class FileDescriptor;
 namespace Uring {
 
 class Queue;
+class FileTable;
 
 Co::Task<std::string>
 CoReadTextFile(Queue &queue, FileDescriptor directory_fd, const char *path,
 	       size_t max_size=65536);
 
+/**
+ * Read (the beginning of) a file into the given buffer.  This
+ * submits three linked operations at once: an openat() which
+ * installs a direct descriptor into a slot of the given
+ * #FileTable, a read() and a close().  No file descriptor is
+ * allocated, and there is no round trip between the operations.
+ *
+ * The linked operations are only submitted together if the #Queue
+ * defers submission (like #Uring::Manager).
+ *
+ * The slot is returned to the #FileTable only after the kernel has
+ * completed the close(), even if the task is destroyed before that.
+ * Similarly, the kernel may write to the buffer until the read()
+ * completes, therefore the caller must not free it before the task
+ * has finished.
+ *
+ * Throws on error (including when all slots are in use).
+ *
+ * @return the number of bytes read
+ */
+Co::Task<std::size_t>
+CoReadFileDirect(FileTable &files, FileDescriptor directory_fd,
+		 const char *path, std::span<std::byte> dest);
+
 } // namespace Uring
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "FileTable.hxx"
+#include "Queue.hxx"
+
+#include <stdexcept>
+
+namespace Uring {
+
+FileTable::FileTable(Queue &_queue, unsigned n_slots, unsigned n_alloc)
+	:queue(_queue)
+{
+	auto &ring = queue.GetRing();
+	ring.RegisterFilesSparse(n_slots + n_alloc);
+
+	try {
+		if (n_slots > 0 && n_alloc > 0)
+			ring.SetFileAllocRange(n_slots, n_alloc);
+	} catch (...) {
+		ring.UnregisterFiles();
+		throw;
+	}
+
+	/* allocate low slot numbers first */
+	free_slots.reserve(n_slots);
+	for (unsigned i = n_slots; i > 0; --i)
+		free_slots.push_back(i - 1);
+}
+
+FileTable::~FileTable() noexcept
+{
+	queue.GetRing().UnregisterFiles();
+}
+
+unsigned
+FileTable::Add(FileDescriptor fd)
+{
+	const auto slot = AllocateSlot();
+	if (!slot)
+		throw std::runtime_error{"Registered file table is full"};
+
+	try {
+		const int fds[] = {fd.Get()};
+		queue.GetRing().UpdateFiles(*slot, fds);
+	} catch (...) {
+		FreeSlot(*slot);
+		throw;
+	}
+
+	return *slot;
+}
+
+void
+FileTable::Remove(unsigned slot) noexcept
+{
+	static constexpr int fds[] = {-1};
+
+	try {
+		queue.GetRing().UpdateFiles(slot, fds);
+	} catch (...) {
+		/* this can only fail if the slot number is invalid,
+		   which is a bug */
+	}
+
+	FreeSlot(slot);
+}
+
+} // namespace Uring
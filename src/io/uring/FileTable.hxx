@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <optional>
+#include <vector>
+
+class FileDescriptor;
+
+namespace Uring {
+
+class Queue;
+
+/**
+ * Manages the registered file table of a #Queue.  Operations on a
+ * registered file ("fixed file", #IOSQE_FIXED_FILE) skip the
+ * per-operation file descriptor lookup in the kernel, which helps
+ * with long-lived sockets and hot files.
+ *
+ * The table is sparse and consists of two ranges: the first
+ * #n_slots slots are allocated by this class (AllocateSlot(),
+ * Add()), and the following #n_alloc slots are allocated by the
+ * kernel for operations with #IORING_FILE_INDEX_ALLOC (e.g.
+ * CoOpenDirect).
+ *
+ * There can be only one instance per #Queue.
+ */
+class FileTable {
+	Queue &queue;
+
+	/**
+	 * Free slots in the range managed by this class.  The last
+	 * element is the next one to be allocated.
+	 */
+	std::vector<unsigned> free_slots;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_slots the number of slots managed by this class
+	 * @param n_alloc the number of slots managed by the kernel
+	 * for #IORING_FILE_INDEX_ALLOC (requires Linux 6.0 if both
+	 * ranges are used)
+	 */
+	FileTable(Queue &_queue, unsigned n_slots, unsigned n_alloc=0);
+
+	~FileTable() noexcept;
+
+	FileTable(const FileTable &) = delete;
+	FileTable &operator=(const FileTable &) = delete;
+
+	auto &GetQueue() const noexcept {
+		return queue;
+	}
+
+	/**
+	 * Allocate an empty slot, e.g. for an operation which
+	 * installs a direct descriptor at a specific index
+	 * (CoOpenDirect).  Use FreeSlot() after the direct
+	 * descriptor has been closed.
+	 *
+	 * @return the slot index or std::nullopt if the table is full
+	 */
+	[[nodiscard]]
+	std::optional<unsigned> AllocateSlot() noexcept {
+		if (free_slots.empty())
+			return std::nullopt;
+
+		const unsigned slot = free_slots.back();
+		free_slots.pop_back();
+		return slot;
+	}
+
+	/**
+	 * Return a slot obtained by AllocateSlot() after its direct
+	 * descriptor has been closed.
+	 */
+	void FreeSlot(unsigned slot) noexcept {
+		free_slots.push_back(slot);
+	}
+
+	/**
+	 * Register an existing file descriptor.  The kernel keeps
+	 * its own reference, i.e. the caller may close the given
+	 * file descriptor afterwards.
+	 *
+	 * Throws on error (e.g. if the table is full).
+	 *
+	 * @return the slot index
+	 */
+	unsigned Add(FileDescriptor fd);
+
+	/**
+	 * Close the file in the given slot and free the slot.
+	 */
+	void Remove(unsigned slot) noexcept;
+};
+
+} // namespace Uring
@@ -38,6 +38,15 @@ public:
 		ring.SetMaxWorkers(bounded, unbounded);
 	}
 
+	/**
+	 * Direct access to the #Ring, e.g. to register files or
+	 * buffers.  Usually, you should use #FileTable and
+	 * #BufferPool instead.
+	 */
+	Ring &GetRing() noexcept {
+		return ring;
+	}
+
 	[[gnu::pure]]
 	bool HasOverflow() const noexcept {
 		return ring.HasOverflow();
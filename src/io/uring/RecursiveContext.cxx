@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "RecursiveContext.hxx"
+
+#include <algorithm>
+#include <bit>
+
+#include <fcntl.h>
+
+namespace Uring {
+
+/**
+ * The maximum number of directories walked concurrently (each one
+ * has a file descriptor open).
+ */
+static constexpr unsigned MAX_DIRECTORIES = 64;
+
+RecursiveContext::RecursiveContext(unsigned max_concurrency)
+	:queue(std::bit_ceil(std::max(max_concurrency, 1U)), 0),
+	 n_slots(std::max(max_concurrency, 1U)),
+	 n_directories(MAX_DIRECTORIES)
+{
+}
+
+RecursiveContext::~RecursiveContext() noexcept
+{
+	assert(slot_waiters.empty());
+	assert(ready.empty());
+}
+
+static Co::InvokeTask
+Invoke(Co::Task<void> task)
+{
+	co_await task;
+}
+
+void
+RecursiveContext::Run(Co::Task<void> &&_task)
+{
+	auto task = Invoke(std::move(_task));
+	task.Start(BIND_THIS_METHOD(OnCompletion));
+
+	while (!done) {
+		if (!ready.empty()) {
+			auto &waiter = ready.pop_front();
+			waiter.continuation.resume();
+			continue;
+		}
+
+		/* submit all operations queued since the last
+		   iteration with one system call and wait for
+		   completions */
+		assert(queue.HasPending());
+		queue.SubmitAndWaitDispatchCompletions(nullptr);
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+CoTryOpenOperation::CoTryOpenOperation(struct io_uring_sqe &sqe,
+				       FileDescriptor directory_fd,
+				       const char *path,
+				       const struct open_how &_how) noexcept
+	:how(_how)
+{
+	how.flags |= O_NOCTTY|O_CLOEXEC;
+	io_uring_prep_openat2(&sqe, directory_fd.Get(), path, &how);
+}
+
+CoTryStatxOperation::CoTryStatxOperation(struct io_uring_sqe &sqe,
+					 FileDescriptor directory_fd,
+					 const char *path,
+					 int flags, unsigned mask,
+					 struct statx &stx) noexcept
+{
+	io_uring_prep_statx(&sqe, directory_fd.Get(), path,
+			    flags, mask, &stx);
+}
+
+} // namespace Uring
@@ -0,0 +1,372 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Internal helpers for Uring::RecursiveCopy() and
+ * Uring::RecursiveDelete().
+ */
+
+#pragma once
+
+#include "Queue.hxx"
+#include "CoOperation.hxx"
+#include "co/InvokeTask.hxx"
+#include "co/Task.hxx"
+#include "io/FileDescriptor.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <cassert>
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <linux/openat2.h> // for struct open_how
+
+namespace Uring {
+
+/**
+ * The state of one recursive operation: a private #Queue which
+ * submits operations in batches, limits for the number of concurrent
+ * operations and open directories, and the first error.
+ */
+class RecursiveContext {
+	class BatchQueue final : public Queue {
+	public:
+		using Queue::Queue;
+
+		// virtual methods from class Uring::Queue
+		void Submit() override {
+			/* this will be done by Run() */
+		}
+	};
+
+	BatchQueue queue;
+
+	struct SlotWaiter : AutoUnlinkIntrusiveListHook {
+		std::coroutine_handle<> continuation;
+	};
+
+	/**
+	 * Coroutines waiting for a slot.
+	 */
+	IntrusiveList<SlotWaiter> slot_waiters;
+
+	/**
+	 * Coroutines which have been assigned a slot and will be
+	 * resumed by Run().  They are not resumed by ReleaseSlot()
+	 * directly, to avoid deep recursion.
+	 */
+	IntrusiveList<SlotWaiter> ready;
+
+	/**
+	 * The number of free slots.
+	 */
+	unsigned n_slots;
+
+	/**
+	 * The number of directories which may still be walked
+	 * concurrently.
+	 */
+	unsigned n_directories;
+
+	std::exception_ptr error;
+
+	bool done = false;
+
+public:
+	/**
+	 * Throws if io_uring is not available.
+	 */
+	explicit RecursiveContext(unsigned max_concurrency);
+
+	~RecursiveContext() noexcept;
+
+	RecursiveContext(const RecursiveContext &) = delete;
+	RecursiveContext &operator=(const RecursiveContext &) = delete;
+
+	Queue &GetQueue() noexcept {
+		return queue;
+	}
+
+	/**
+	 * Has an error occurred?  If yes, no new operations should
+	 * be started.
+	 */
+	bool IsFailed() const noexcept {
+		return !!error;
+	}
+
+	/**
+	 * Remember the given error (unless an error has already
+	 * occurred).  It will be rethrown by Run().
+	 */
+	void Fail(std::exception_ptr _error) noexcept {
+		if (!error)
+			error = std::move(_error);
+	}
+
+	/**
+	 * The permission to perform I/O operations; the number of
+	 * slots limits the number of operations in flight.  A
+	 * coroutine must not wait for anything else than its own I/O
+	 * operations while holding a slot.
+	 */
+	class Slot {
+		RecursiveContext *ctx;
+
+	public:
+		explicit Slot(RecursiveContext &_ctx) noexcept
+			:ctx(&_ctx) {}
+
+		Slot(Slot &&src) noexcept
+			:ctx(std::exchange(src.ctx, nullptr)) {}
+
+		~Slot() noexcept {
+			Release();
+		}
+
+		Slot &operator=(Slot &&src) noexcept {
+			Release();
+			ctx = std::exchange(src.ctx, nullptr);
+			return *this;
+		}
+
+		void Release() noexcept {
+			if (ctx != nullptr)
+				std::exchange(ctx, nullptr)->ReleaseSlot();
+		}
+	};
+
+	/**
+	 * The permission to walk a directory concurrently.  This
+	 * limits the number of open directories.
+	 */
+	class DirectoryToken {
+		RecursiveContext *ctx;
+
+	public:
+		explicit DirectoryToken(RecursiveContext *_ctx) noexcept
+			:ctx(_ctx) {}
+
+		DirectoryToken(DirectoryToken &&src) noexcept
+			:ctx(std::exchange(src.ctx, nullptr)) {}
+
+		~DirectoryToken() noexcept {
+			if (ctx != nullptr)
+				++ctx->n_directories;
+		}
+
+		DirectoryToken &operator=(DirectoryToken &&) = delete;
+
+		operator bool() const noexcept {
+			return ctx != nullptr;
+		}
+	};
+
+	/**
+	 * Wait for a free #Slot.
+	 */
+	[[nodiscard]]
+	auto AcquireSlot() noexcept {
+		struct Awaitable final {
+			RecursiveContext &ctx;
+			SlotWaiter waiter;
+
+			bool await_ready() const noexcept {
+				if (ctx.n_slots == 0)
+					return false;
+
+				--ctx.n_slots;
+				return true;
+			}
+
+			void await_suspend(std::coroutine_handle<> _continuation) noexcept {
+				waiter.continuation = _continuation;
+				ctx.slot_waiters.push_back(waiter);
+			}
+
+			Slot await_resume() noexcept {
+				return Slot{ctx};
+			}
+		};
+
+		return Awaitable{*this, {}};
+	}
+
+	/**
+	 * Obtain a #DirectoryToken if one is available; if not, the
+	 * caller should walk the directory inline (without
+	 * concurrency).
+	 */
+	DirectoryToken TryAcquireDirectory() noexcept {
+		if (n_directories == 0)
+			return DirectoryToken{nullptr};
+
+		--n_directories;
+		return DirectoryToken{this};
+	}
+
+	/**
+	 * Run the given task (and all tasks it starts) until it
+	 * finishes.  Throws the first error.
+	 */
+	void Run(Co::Task<void> &&task);
+
+private:
+	void ReleaseSlot() noexcept {
+		if (slot_waiters.empty()) {
+			++n_slots;
+		} else {
+			/* pass the slot to the next waiter */
+			auto &waiter = slot_waiters.front();
+			waiter.unlink();
+			ready.push_back(waiter);
+		}
+	}
+
+	void OnCompletion(std::exception_ptr _error) noexcept {
+		if (_error)
+			Fail(std::move(_error));
+
+		done = true;
+	}
+};
+
+/**
+ * Directories which were discovered by a concurrent task only after
+ * it had started (because the filesystem does not provide d_type)
+ * while no #RecursiveContext::DirectoryToken was available.  Instead
+ * of walking them without a token, the task adds them to its parent's
+ * list, and the parent walks them inline after all its other
+ * children have finished.
+ */
+using DeferredDirectories = std::vector<std::string>;
+
+/**
+ * Runs any number of tasks concurrently; co_await it to wait until
+ * all of them have finished.  Errors are passed to
+ * RecursiveContext::Fail().
+ */
+class TaskGroup {
+	RecursiveContext &ctx;
+
+	struct Child final : IntrusiveListHook<IntrusiveHookMode::NORMAL> {
+		TaskGroup &group;
+
+		Co::InvokeTask task;
+
+		Child(TaskGroup &_group, Co::Task<void> &&_task) noexcept
+			:group(_group), task(Invoke(std::move(_task))) {}
+
+		void OnCompletion(std::exception_ptr error) noexcept {
+			group.OnChildCompletion(*this, std::move(error));
+		}
+
+		static Co::InvokeTask Invoke(Co::Task<void> task) {
+			co_await task;
+		}
+	};
+
+	IntrusiveList<Child> children;
+
+	std::coroutine_handle<> continuation;
+
+public:
+	explicit TaskGroup(RecursiveContext &_ctx) noexcept
+		:ctx(_ctx) {}
+
+	~TaskGroup() noexcept {
+		children.clear_and_dispose(DeleteDisposer{});
+	}
+
+	TaskGroup(const TaskGroup &) = delete;
+	TaskGroup &operator=(const TaskGroup &) = delete;
+
+	/**
+	 * Start a task.  It runs until its first suspension point
+	 * before this method returns.
+	 */
+	void Add(Co::Task<void> &&task) {
+		auto *child = new Child(*this, std::move(task));
+		children.push_back(*child);
+		child->task.Start(BIND_METHOD(*child, &Child::OnCompletion));
+	}
+
+	auto operator co_await() noexcept {
+		struct Awaitable final {
+			TaskGroup &group;
+
+			bool await_ready() const noexcept {
+				return group.children.empty();
+			}
+
+			void await_suspend(std::coroutine_handle<> _continuation) noexcept {
+				group.continuation = _continuation;
+			}
+
+			void await_resume() noexcept {
+				assert(group.children.empty());
+			}
+		};
+
+		return Awaitable{*this};
+	}
+
+private:
+	void OnChildCompletion(Child &child, std::exception_ptr error) noexcept {
+		if (error)
+			ctx.Fail(std::move(error));
+
+		children.erase(children.iterator_to(child));
+		delete &child;
+
+		if (children.empty() && continuation)
+			std::exchange(continuation, {}).resume();
+	}
+};
+
+/**
+ * Like #CoOpenOperation, but uses openat2() and does not throw;
+ * returns the new file descriptor or a negative errno value.
+ */
+class CoTryOpenOperation final {
+	/**
+	 * The kernel reads this when the operation is submitted,
+	 * so it must be kept here.
+	 */
+	struct open_how how;
+
+public:
+	CoTryOpenOperation(struct io_uring_sqe &sqe,
+			   FileDescriptor directory_fd, const char *path,
+			   const struct open_how &_how) noexcept;
+
+	int GetValue(int value) const noexcept {
+		return value;
+	}
+};
+
+using CoTryOpen = CoOperation<CoTryOpenOperation>;
+
+/**
+ * Like #CoStatxOperation, but does not throw; returns 0 or a
+ * negative errno value.
+ */
+class CoTryStatxOperation final {
+public:
+	CoTryStatxOperation(struct io_uring_sqe &sqe,
+			    FileDescriptor directory_fd, const char *path,
+			    int flags, unsigned mask,
+			    struct statx &stx) noexcept;
+
+	int GetValue(int value) const noexcept {
+		return value;
+	}
+};
+
+using CoTryStatx = CoOperation<CoTryStatxOperation>;
+
+} // namespace Uring
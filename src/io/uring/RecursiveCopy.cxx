@@ -0,0 +1,308 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "RecursiveCopy.hxx"
+#include "RecursiveContext.hxx"
+#include "io/CopyRegularFile.hxx"
+#include "io/DirectoryReader.hxx"
+#include "io/FileAt.hxx"
+#include "io/FileName.hxx"
+#include "io/RecursiveCopyContext.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "lib/fmt/SystemError.hxx"
+
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+
+namespace Uring {
+
+static Co::Task<void>
+CopyEntry(RecursiveContext &ctx, RecursiveCopyContext &copy,
+	  FileDescriptor src_parent, std::string src_name,
+	  FileDescriptor dst_parent, std::string dst_name);
+
+/**
+ * @param deferred if this is not nullptr, the caller does not hold a
+ * #RecursiveContext::DirectoryToken for this entry; if it turns out to
+ * be a directory and no token is available, its name is added to this
+ * list instead of walking it
+ */
+static Co::Task<void>
+CopyEntry(RecursiveContext &ctx, RecursiveCopyContext &copy,
+	  RecursiveContext::Slot slot,
+	  FileDescriptor src_parent, std::string src_name,
+	  FileDescriptor dst_parent, std::string dst_name,
+	  DeferredDirectories *deferred);
+
+static Co::Task<void>
+CopyEntry(RecursiveContext &ctx, RecursiveCopyContext &copy,
+	  RecursiveContext::DirectoryToken token,
+	  FileDescriptor src_parent, std::string src_name,
+	  FileDescriptor dst_parent, std::string dst_name)
+{
+	/* the token is released when this coroutine finishes */
+	(void)token;
+
+	co_await CopyEntry(ctx, copy, src_parent, std::move(src_name),
+			   dst_parent, std::move(dst_name));
+}
+
+/**
+ * Create a regular file.  If one already exists, it is deleted
+ * (unless overwriting is disabled).
+ *
+ * The caller must hold a #RecursiveContext::Slot.
+ *
+ * @return the new file or an undefined file descriptor if the file
+ * already exists and shall not be overwritten
+ */
+static Co::Task<UniqueFileDescriptor>
+CreateRegularFile(RecursiveContext &ctx, FileDescriptor parent,
+		  const char *filename, bool overwrite)
+{
+	static constexpr struct open_how how{
+		.flags = O_CREAT|O_EXCL|O_WRONLY|O_NOFOLLOW,
+		.mode = 0666,
+	};
+
+	/* optimistic create with O_EXCL */
+	int result = co_await CoTryOpen(ctx.GetQueue(), parent, filename, how);
+	if (result == -EEXIST) {
+		if (!overwrite)
+			co_return UniqueFileDescriptor{};
+
+		/* already exists: delete it (so we create a new
+		   inode for the new file) */
+		result = co_await CoUnlink(ctx.GetQueue(), parent, filename);
+		if (result < 0 && result != -ENOENT)
+			throw FmtErrno(-result, "Failed to delete {:?}", filename);
+
+		/* ... and try again */
+		result = co_await CoTryOpen(ctx.GetQueue(), parent, filename, how);
+	}
+
+	if (result < 0)
+		throw FmtErrno(-result, "Failed to create {:?}", filename);
+
+	co_return UniqueFileDescriptor{AdoptTag{}, result};
+}
+
+/**
+ * Copy the contents of the given source directory to the given
+ * destination directory.
+ */
+static Co::Task<void>
+CopyDirectoryContents(RecursiveContext &ctx, RecursiveCopyContext &copy,
+		      UniqueFileDescriptor &&src_fd, FileDescriptor dst)
+{
+	DirectoryReader r{std::move(src_fd)};
+	const FileDescriptor src = r.GetFileDescriptor();
+
+	DeferredDirectories deferred;
+	TaskGroup group{ctx};
+
+	try {
+		while (const auto *entry = r.ReadEntry()) {
+			if (ctx.IsFailed())
+				break;
+
+			const char *name = entry->d_name;
+			if (IsSpecialFilename(name))
+				continue;
+
+			if (entry->d_type == DT_DIR) {
+				if (auto token = ctx.TryAcquireDirectory())
+					group.Add(CopyEntry(ctx, copy, std::move(token),
+							    src, name, dst, name));
+				else
+					/* too many open directories:
+					   walk this one inline */
+					co_await CopyEntry(ctx, copy,
+							   src, name, dst, name);
+			} else {
+				/* acquire the slot here, so the
+				   number of pending tasks (and open
+				   file descriptors) is bounded */
+				auto slot = co_await ctx.AcquireSlot();
+				group.Add(CopyEntry(ctx, copy, std::move(slot),
+						    src, name, dst, name,
+						    &deferred));
+			}
+		}
+	} catch (...) {
+		ctx.Fail(std::current_exception());
+	}
+
+	/* the directories must remain open until all children have
+	   finished */
+	co_await group;
+
+	/* walk the directories which could not be walked
+	   concurrently */
+	try {
+		for (auto &name : deferred) {
+			if (ctx.IsFailed())
+				break;
+
+			co_await CopyEntry(ctx, copy, src, name, dst, name);
+		}
+	} catch (...) {
+		ctx.Fail(std::current_exception());
+	}
+}
+
+/**
+ * Copy the given source directory to a newly created directory.
+ */
+static Co::Task<void>
+CopyDirectory(RecursiveContext &ctx, RecursiveCopyContext &copy,
+	      UniqueFileDescriptor &&src, const struct statx stx,
+	      FileDescriptor dst_parent, std::string dst_name)
+{
+	if (dst_name.empty()) {
+		co_await CopyDirectoryContents(ctx, copy, std::move(src),
+					       dst_parent);
+		if (!ctx.IsFailed())
+			RecursiveCopyPreserve(copy, stx, dst_parent, "?");
+		co_return;
+	}
+
+	int result;
+
+	{
+		auto slot = co_await ctx.AcquireSlot();
+
+		result = co_await CoMkdir(ctx.GetQueue(), dst_parent,
+					  dst_name.c_str(), 0777);
+		if (result < 0 && result != -EEXIST)
+			throw FmtErrno(-result, "Failed to create directory {:?}",
+				       dst_name);
+
+		result = co_await CoTryOpen(ctx.GetQueue(), dst_parent,
+					    dst_name.c_str(),
+					    open_how{
+						    .flags = O_DIRECTORY|O_PATH|O_RDONLY|O_NOFOLLOW,
+						    .resolve = RESOLVE_NO_SYMLINKS,
+					    });
+		if (result < 0)
+			throw FmtErrno(-result, "Failed to open {:?}", dst_name);
+	}
+
+	UniqueFileDescriptor dst{AdoptTag{}, result};
+
+	co_await CopyDirectoryContents(ctx, copy, std::move(src), dst);
+	if (!ctx.IsFailed())
+		RecursiveCopyPreserve(copy, stx, dst, dst_name.c_str());
+}
+
+static Co::Task<void>
+CopyEntry(RecursiveContext &ctx, RecursiveCopyContext &copy,
+	  RecursiveContext::Slot slot,
+	  FileDescriptor src_parent, std::string src_name,
+	  FileDescriptor dst_parent, std::string dst_name,
+	  DeferredDirectories *deferred)
+{
+	if (ctx.IsFailed())
+		co_return;
+
+	/* optimistic open() - this works for regular files and
+	   directories */
+	int result = co_await CoTryOpen(ctx.GetQueue(), src_parent,
+					src_name.c_str(),
+					open_how{
+						.flags = O_RDONLY|O_NOFOLLOW,
+					});
+	if (result == -ELOOP) {
+		/* due to O_NOFOLLOW, symlinks fail with ELOOP, so
+		   copy the symlink */
+		RecursiveCopySymlink(src_parent, src_name.c_str(),
+				     dst_parent, dst_name.c_str(),
+				     copy.overwrite);
+		co_return;
+	}
+
+	if (result < 0)
+		throw FmtErrno(-result, "Failed to open {:?}", src_name);
+
+	UniqueFileDescriptor src{AdoptTag{}, result};
+
+	struct statx stx;
+	result = co_await CoTryStatx(ctx.GetQueue(), src, "",
+				     AT_EMPTY_PATH|AT_SYMLINK_NOFOLLOW|AT_STATX_SYNC_AS_STAT,
+				     copy.statx_mask, stx);
+	if (result < 0)
+		throw FmtErrno(-result, "Failed to stat {:?}", src_name);
+
+	if (!copy.CheckFilesystem(stx))
+		co_return;
+
+	if (S_ISDIR(stx.stx_mode)) {
+		/* don't hold the slot while walking the directory
+		   (only if the filesystem does not provide d_type) */
+		slot.Release();
+
+		if (deferred == nullptr) {
+			co_await CopyDirectory(ctx, copy, std::move(src), stx,
+					       dst_parent, std::move(dst_name));
+		} else if (auto token = ctx.TryAcquireDirectory()) {
+			co_await CopyDirectory(ctx, copy, std::move(src), stx,
+					       dst_parent, std::move(dst_name));
+		} else {
+			/* too many open directories: let the
+			   parent walk this one inline (closing
+			   ours) */
+			assert(src_name == dst_name);
+			deferred->emplace_back(std::move(src_name));
+		}
+	} else if (S_ISREG(stx.stx_mode)) {
+		auto dst = co_await CreateRegularFile(ctx, dst_parent,
+						      dst_name.c_str(),
+						      copy.overwrite);
+		if (!dst.IsDefined())
+			co_return;
+
+		CopyRegularFile(src, dst, stx.stx_size);
+		RecursiveCopyPreserve(copy, stx, dst, dst_name.c_str());
+	} else {
+		// TODO
+	}
+}
+
+static Co::Task<void>
+CopyEntry(RecursiveContext &ctx, RecursiveCopyContext &copy,
+	  FileDescriptor src_parent, std::string src_name,
+	  FileDescriptor dst_parent, std::string dst_name)
+{
+	auto slot = co_await ctx.AcquireSlot();
+	co_await CopyEntry(ctx, copy, std::move(slot),
+			   src_parent, std::move(src_name),
+			   dst_parent, std::move(dst_name),
+			   nullptr);
+}
+
+void
+RecursiveCopy(FileAt src_file, FileAt dst_file,
+	      unsigned options, unsigned max_concurrency)
+{
+	std::optional<RecursiveContext> ctx;
+
+	try {
+		ctx.emplace(max_concurrency);
+	} catch (const std::system_error &) {
+		/* io_uring is not available (e.g. disabled by
+		   seccomp or sysctl) */
+		::RecursiveCopy(src_file, dst_file, options);
+		return;
+	}
+
+	RecursiveCopyContext copy{options};
+	ctx->Run(CopyEntry(*ctx, copy,
+			   src_file.directory, src_file.name,
+			   dst_file.directory, dst_file.name));
+}
+
+} // namespace Uring
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+struct FileAt;
+
+namespace Uring {
+
+/**
+ * Like ::RecursiveCopy(), but submits the openat(), statx(),
+ * mkdirat() and unlinkat() system calls through a private io_uring,
+ * with up to #max_concurrency operations in flight.  File contents
+ * are still copied with copy_file_range().
+ *
+ * If io_uring is not available, this falls back to
+ * ::RecursiveCopy().
+ *
+ * Throws on error.  After the first error, no new operations are
+ * started, but this function waits for all pending operations
+ * before throwing.
+ *
+ * @param options one or more of #RecursiveCopyOptions
+ */
+void
+RecursiveCopy(FileAt src_file, FileAt dst_file,
+	      unsigned options=0, unsigned max_concurrency=64);
+
+} // namespace Uring
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "RecursiveDelete.hxx"
+#include "RecursiveContext.hxx"
+#include "io/DirectoryReader.hxx"
+#include "io/FileAt.hxx"
+#include "io/FileName.hxx"
+#include "io/RecursiveDelete.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "lib/fmt/SystemError.hxx"
+
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+
+namespace Uring {
+
+static Co::Task<void>
+DeleteDirectory(RecursiveContext &ctx,
+		FileDescriptor parent, std::string name);
+
+static Co::Task<void>
+DeleteDirectory(RecursiveContext &ctx, RecursiveContext::DirectoryToken token,
+		FileDescriptor parent, std::string name)
+{
+	/* the token is released when this coroutine finishes */
+	(void)token;
+
+	co_await DeleteDirectory(ctx, parent, std::move(name));
+}
+
+/**
+ * Delete a file which is not known to be a directory.
+ *
+ * @param deferred if this is not nullptr, the caller does not hold a
+ * #RecursiveContext::DirectoryToken for this entry; if it turns out to
+ * be a directory and no token is available, its name is added to this
+ * list instead of walking it
+ */
+static Co::Task<void>
+DeleteFile(RecursiveContext &ctx, RecursiveContext::Slot slot,
+	   FileDescriptor parent, std::string name,
+	   DeferredDirectories *deferred)
+{
+	const int result = co_await CoUnlink(ctx.GetQueue(), parent, name.c_str());
+	slot.Release();
+
+	switch (result) {
+	case 0:
+	case -ENOENT:
+		/* does not exist, nothing to do */
+		co_return;
+
+	case -EISDIR:
+		/* switch to directory mode (only if the
+		   filesystem does not provide d_type) */
+		if (deferred == nullptr) {
+			co_await DeleteDirectory(ctx, parent, std::move(name));
+		} else if (auto token = ctx.TryAcquireDirectory()) {
+			co_await DeleteDirectory(ctx, parent, std::move(name));
+		} else {
+			/* too many open directories: let the
+			   parent walk this one inline */
+			deferred->emplace_back(std::move(name));
+		}
+
+		co_return;
+
+	default:
+		throw FmtErrno(-result, "Failed to delete {:?}", name);
+	}
+}
+
+/**
+ * Delete all entries of the given directory.
+ */
+static Co::Task<void>
+ClearDirectory(RecursiveContext &ctx, UniqueFileDescriptor &&fd)
+{
+	DirectoryReader r{std::move(fd)};
+	const FileDescriptor directory = r.GetFileDescriptor();
+
+	DeferredDirectories deferred;
+	TaskGroup group{ctx};
+
+	try {
+		while (const auto *entry = r.ReadEntry()) {
+			if (ctx.IsFailed())
+				break;
+
+			const char *name = entry->d_name;
+			if (IsSpecialFilename(name))
+				continue;
+
+			if (entry->d_type == DT_DIR) {
+				if (auto token = ctx.TryAcquireDirectory())
+					group.Add(DeleteDirectory(ctx, std::move(token),
+								  directory, name));
+				else
+					/* too many open directories:
+					   walk this one inline */
+					co_await DeleteDirectory(ctx, directory, name);
+			} else {
+				auto slot = co_await ctx.AcquireSlot();
+				group.Add(DeleteFile(ctx, std::move(slot),
+						     directory, name,
+						     &deferred));
+			}
+		}
+	} catch (...) {
+		ctx.Fail(std::current_exception());
+	}
+
+	/* the directory must remain open until all children have
+	   finished */
+	co_await group;
+
+	/* walk the directories which could not be walked
+	   concurrently */
+	try {
+		for (auto &name : deferred) {
+			if (ctx.IsFailed())
+				break;
+
+			co_await DeleteDirectory(ctx, directory, std::move(name));
+		}
+	} catch (...) {
+		ctx.Fail(std::current_exception());
+	}
+}
+
+static Co::Task<void>
+DeleteDirectory(RecursiveContext &ctx,
+		FileDescriptor parent, std::string name)
+{
+	if (ctx.IsFailed())
+		co_return;
+
+	int result;
+
+	{
+		auto slot = co_await ctx.AcquireSlot();
+		result = co_await CoTryOpen(ctx.GetQueue(), parent, name.c_str(),
+					    open_how{
+						    .flags = O_DIRECTORY|O_NOFOLLOW|O_RDONLY,
+					    });
+	}
+
+	if (result == -ENOENT)
+		/* does not exist, nothing to do */
+		co_return;
+
+	if (result < 0)
+		throw FmtErrno(-result, "Failed to open {:?}", name);
+
+	co_await ClearDirectory(ctx, UniqueFileDescriptor{AdoptTag{}, result});
+
+	if (ctx.IsFailed())
+		co_return;
+
+	{
+		auto slot = co_await ctx.AcquireSlot();
+		result = co_await CoUnlink(ctx.GetQueue(), parent, name.c_str(),
+					   AT_REMOVEDIR);
+	}
+
+	if (result < 0 && result != -ENOENT)
+		throw FmtErrno(-result, "Failed to delete {:?}", name);
+}
+
+static Co::Task<void>
+DeleteFile(RecursiveContext &ctx, FileDescriptor parent, std::string name)
+{
+	auto slot = co_await ctx.AcquireSlot();
+	co_await DeleteFile(ctx, std::move(slot), parent, std::move(name),
+			    nullptr);
+}
+
+void
+RecursiveDelete(FileAt file, unsigned max_concurrency)
+{
+	std::optional<RecursiveContext> ctx;
+
+	try {
+		ctx.emplace(max_concurrency);
+	} catch (const std::system_error &) {
+		/* io_uring is not available (e.g. disabled by
+		   seccomp or sysctl) */
+		::RecursiveDelete(file);
+		return;
+	}
+
+	ctx->Run(DeleteFile(*ctx, file.directory, file.name));
+}
+
+} // namespace Uring
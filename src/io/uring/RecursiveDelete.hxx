@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+struct FileAt;
+
+namespace Uring {
+
+/**
+ * Like ::RecursiveDelete(), but submits the unlinkat() and openat()
+ * system calls through a private io_uring, with up to
+ * #max_concurrency operations in flight.  This is much faster on
+ * filesystems with high latency (e.g. network filesystems).
+ *
+ * If io_uring is not available, this falls back to
+ * ::RecursiveDelete().
+ *
+ * Throws on error.  After the first error, no new operations are
+ * started, but this function waits for all pending operations
+ * before throwing.
+ */
+void
+RecursiveDelete(FileAt file, unsigned max_concurrency=64);
+
+} // namespace Uring
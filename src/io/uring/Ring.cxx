@@ -29,6 +29,48 @@ Ring::SetMaxWorkers(unsigned values[2])
 		throw MakeErrno(-error, "io_uring_register_iowq_max_workers() failed");
 }
 
+void
+Ring::EnableRings()
+{
+	if (int error = io_uring_enable_rings(&ring);
+	    error < 0)
+		throw MakeErrno(-error, "io_uring_enable_rings() failed");
+}
+
+void
+Ring::RegisterFilesSparse(unsigned n)
+{
+	if (int error = io_uring_register_files_sparse(&ring, n);
+	    error < 0)
+		throw MakeErrno(-error, "io_uring_register_files_sparse() failed");
+}
+
+void
+Ring::UpdateFiles(unsigned offset, std::span<const int> fds)
+{
+	if (int error = io_uring_register_files_update(&ring, offset,
+						       fds.data(), fds.size());
+	    error < 0)
+		throw MakeErrno(-error, "io_uring_register_files_update() failed");
+}
+
+void
+Ring::SetFileAllocRange(unsigned offset, unsigned n)
+{
+	if (int error = io_uring_register_file_alloc_range(&ring, offset, n);
+	    error < 0)
+		throw MakeErrno(-error, "io_uring_register_file_alloc_range() failed");
+}
+
+void
+Ring::RegisterBuffers(std::span<const struct iovec> buffers)
+{
+	if (int error = io_uring_register_buffers(&ring, buffers.data(),
+						  buffers.size());
+	    error < 0)
+		throw MakeErrno(-error, "io_uring_register_buffers() failed");
+}
+
 void
 Ring::Submit()
 {
@@ -8,6 +8,8 @@
 
 #include <liburing.h>
 
+#include <span>
+
 namespace Uring {
 
 /**
@@ -67,6 +69,67 @@ public:
 		SetMaxWorkers(values);
 	}
 
+	/**
+	 * Enable a ring which was created with
+	 * #IORING_SETUP_R_DISABLED.  With
+	 * #IORING_SETUP_SINGLE_ISSUER, the calling thread becomes the
+	 * only one which is allowed to submit.  Wrapper for
+	 * io_uring_enable_rings() (requires Linux 5.10).
+	 *
+	 * Throws on error.
+	 */
+	void EnableRings();
+
+	/**
+	 * Register a sparse file table with the given number of
+	 * (empty) slots.  Wrapper for
+	 * io_uring_register_files_sparse().
+	 *
+	 * Throws on error.
+	 */
+	void RegisterFilesSparse(unsigned n);
+
+	/**
+	 * Wrapper for io_uring_unregister_files().
+	 */
+	void UnregisterFiles() noexcept {
+		io_uring_unregister_files(&ring);
+	}
+
+	/**
+	 * Replace slots in the registered file table.  A file
+	 * descriptor of -1 clears the slot.  Wrapper for
+	 * io_uring_register_files_update().
+	 *
+	 * Throws on error.
+	 */
+	void UpdateFiles(unsigned offset, std::span<const int> fds);
+
+	/**
+	 * Set the range of the registered file table which is used
+	 * by the kernel to allocate slots for
+	 * #IORING_FILE_INDEX_ALLOC.  Wrapper for
+	 * io_uring_register_file_alloc_range() (requires Linux 6.0).
+	 *
+	 * Throws on error.
+	 */
+	void SetFileAllocRange(unsigned offset, unsigned n);
+
+	/**
+	 * Register fixed buffers.  Wrapper for
+	 * io_uring_register_buffers().
+	 *
+	 * Throws on error.
+	 */
+	void RegisterBuffers(std::span<const struct iovec> buffers);
+
+	/**
+	 * Wrapper for io_uring_unregister_buffers().
+	 */
+	void UnregisterBuffers() noexcept {
+		io_uring_unregister_buffers(&ring);
+	}
+
 	/**
 	 * @return true if there are overflow entries waiting to be
 	 * flushed onto the CQ ring
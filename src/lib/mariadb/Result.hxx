@@ -6,6 +6,7 @@
 
 #include <mysql.h>
 
+#include <cstddef>
 #include <utility>
 
 class MysqlResult {
@@ -39,6 +40,14 @@ public:
 		return result;
 	}
 
+	/**
+	 * Returns the number of rows in a result obtained with
+	 * mysql_store_result().
+	 */
+	std::size_t GetRowCount() const noexcept {
+		return mysql_num_rows(result);
+	}
+
 	MYSQL_ROW FetchRow() const noexcept {
 		return mysql_fetch_row(result);
 	}
@@ -0,0 +1,559 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "Serialize.hxx"
+#include "lua/StringView.hxx"
+#include "util/ScopeExit.hxx"
+
+extern "C" {
+#include <lua.h>
+}
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <forward_list>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <stdio.h>
+
+namespace Lua {
+
+/**
+ * Tables nested deeper than this are rejected; this protects the C
+ * stack from unbounded recursion.
+ */
+static constexpr std::size_t MAX_DEPTH = 256;
+
+/**
+ * Does this byte need special treatment inside a JSON string, i.e.
+ * does it need to be escaped or is it part of a multi-byte UTF-8
+ * sequence which needs to be validated?
+ */
+static constexpr bool
+IsSpecialChar(char ch) noexcept
+{
+	const auto uch = static_cast<unsigned char>(ch);
+	return uch < 0x20 || uch >= 0x80 || ch == '"' || ch == '\\';
+}
+
+/**
+ * Determine the length of the (well-formed, see Unicode Table 3-7)
+ * UTF-8 sequence at the beginning of the given string, which starts
+ * with a non-ASCII byte.
+ *
+ * @return the length or 0 if the sequence is malformed
+ */
+[[gnu::pure]]
+static std::size_t
+GetSequenceLength(std::string_view s) noexcept
+{
+	const auto *p = reinterpret_cast<const unsigned char *>(s.data());
+	const unsigned char ch = p[0];
+
+	/* the allowed range of the second byte */
+	unsigned char lo = 0x80, hi = 0xbf;
+	std::size_t n;
+
+	if (ch >= 0xc2 && ch <= 0xdf)
+		n = 2;
+	else if (ch == 0xe0) {
+		n = 3;
+		lo = 0xa0;
+	} else if (ch == 0xed) {
+		/* no surrogates */
+		n = 3;
+		hi = 0x9f;
+	} else if (ch >= 0xe1 && ch <= 0xef)
+		n = 3;
+	else if (ch == 0xf0) {
+		n = 4;
+		lo = 0x90;
+	} else if (ch == 0xf4) {
+		/* nothing above U+10FFFF */
+		n = 4;
+		hi = 0x8f;
+	} else if (ch >= 0xf1 && ch <= 0xf3)
+		n = 4;
+	else
+		return 0;
+
+	if (s.size() < n || p[1] < lo || p[1] > hi)
+		return 0;
+
+	for (std::size_t i = 2; i < n; ++i)
+		if ((p[i] & 0xc0) != 0x80)
+			return 0;
+
+	return n;
+}
+
+/**
+ * Append a quoted and escaped JSON string (the same way
+ * nlohmann::json::dump() does).  Throws std::invalid_argument if the
+ * string is not valid UTF-8.
+ */
+static void
+AppendString(std::string &dest, std::string_view value)
+{
+	static constexpr char hex_digits[] = "0123456789abcdef";
+
+	dest.push_back('"');
+
+	while (true) {
+		const auto i = std::find_if(value.begin(), value.end(),
+					    IsSpecialChar);
+		dest.append(value.begin(), i);
+		if (i == value.end())
+			break;
+
+		value = {i, value.end()};
+
+		switch (const char ch = value.front()) {
+		case '"':
+			dest.append("\\\"");
+			break;
+
+		case '\\':
+			dest.append("\\\\");
+			break;
+
+		case '\b':
+			dest.append("\\b");
+			break;
+
+		case '\f':
+			dest.append("\\f");
+			break;
+
+		case '\n':
+			dest.append("\\n");
+			break;
+
+		case '\r':
+			dest.append("\\r");
+			break;
+
+		case '\t':
+			dest.append("\\t");
+			break;
+
+		default:
+			if (static_cast<unsigned char>(ch) >= 0x80) {
+				const std::size_t n = GetSequenceLength(value);
+				if (n == 0)
+					throw std::invalid_argument{"Invalid UTF-8 in string"};
+
+				dest.append(value.substr(0, n));
+				value.remove_prefix(n);
+				continue;
+			}
+
+			dest.append("\\u00");
+			dest.push_back(hex_digits[(ch >> 4) & 0xf]);
+			dest.push_back(hex_digits[ch & 0xf]);
+			break;
+		}
+
+		value.remove_prefix(1);
+	}
+
+	dest.push_back('"');
+}
+
+/**
+ * If the table at the given (absolute) stack index is a sequence
+ * (i.e. its keys are exactly 1..n), return n, else 0.
+ */
+static std::size_t
+GetArrayLength(lua_State *L, int idx) noexcept
+{
+	const std::size_t n = lua_objlen(L, idx);
+	if (n == 0)
+		return 0;
+
+	std::size_t count = 0;
+
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		/* pop the value */
+		lua_pop(L, 1);
+
+		const lua_Number key = lua_type(L, -1) == LUA_TNUMBER
+			? lua_tonumber(L, -1)
+			: 0;
+		if (key < 1 || key > static_cast<lua_Number>(n) ||
+		    key != std::floor(key)) {
+			/* pop the key */
+			lua_pop(L, 1);
+			return 0;
+		}
+
+		/* since keys are unique, n keys in the range 1..n
+		   are a sequence */
+		++count;
+	}
+
+	return count == n ? n : 0;
+}
+
+namespace {
+
+class JsonSerializer {
+	lua_State *const L;
+
+	std::string &dest;
+
+	const JsonDialect dialect;
+
+	/**
+	 * The tables currently being serialized (identified by
+	 * lua_topointer()), for cycle detection.
+	 */
+	std::vector<const void *> tables;
+
+	/**
+	 * The stack index of a scratch array used by
+	 * LegacyObject() (0 if not yet created), and the number of
+	 * its elements which are currently in use.  Nested objects
+	 * use it like a stack.
+	 */
+	int scratch_idx = 0, scratch_size = 0;
+
+	/**
+	 * A member of a #JsonDialect::LEGACY object.
+	 */
+	struct Member {
+		/**
+		 * The key as a string; it points into the Lua string
+		 * (which is kept alive by the table) or into
+		 * LegacyObject()'s list of converted numeric keys.
+		 */
+		std::string_view key;
+
+		/**
+		 * The index of the value in the scratch array.
+		 */
+		int value_index;
+	};
+
+public:
+	JsonSerializer(lua_State *_L, std::string &_dest,
+		       JsonDialect _dialect) noexcept
+		:L(_L), dest(_dest), dialect(_dialect) {}
+
+	void Value(int idx);
+
+private:
+	void Number(lua_Number value);
+	void Pointer(const char *prefix, const void *ptr);
+
+	std::string_view LegacyKey(int idx,
+				   std::forward_list<std::string> &number_keys);
+	void LegacyObject(int idx);
+
+	void Key(int idx);
+	void Array(int idx, std::size_t n);
+	void Object(int idx);
+
+	void Table(int idx);
+};
+
+void
+JsonSerializer::Number(lua_Number value)
+{
+	if (!std::isfinite(value)) {
+		/* JSON has no representation for these */
+		dest.append("null");
+		return;
+	}
+
+	char buffer[32];
+	std::to_chars_result result;
+
+	/* all integers up to 2^53 can be represented exactly by a
+	   double */
+	if (value == std::trunc(value) && std::fabs(value) <= 0x1p53)
+		result = std::to_chars(buffer, std::end(buffer),
+				       static_cast<int_least64_t>(value));
+	else
+		/* the shortest representation which parses back to
+		   the same value */
+		result = std::to_chars(buffer, std::end(buffer), value);
+
+	dest.append(buffer, result.ptr);
+}
+
+void
+JsonSerializer::Pointer(const char *prefix, const void *ptr)
+{
+	/* same format as ToJson() */
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%s:%p", prefix, ptr);
+	AppendString(dest, buffer);
+}
+
+inline std::string_view
+JsonSerializer::LegacyKey(int idx, std::forward_list<std::string> &number_keys)
+{
+	switch (lua_type(L, idx)) {
+	case LUA_TSTRING:
+		return ToStringView(L, idx);
+
+	case LUA_TNUMBER:
+		{
+			/* convert a copy (with Lua's number format,
+			   like ToJson() does); converting the key in
+			   place would confuse lua_next() */
+			lua_pushvalue(L, idx);
+			AtScopeExit(this) { lua_pop(L, 1); };
+			return number_keys.emplace_front(ToStringView(L, -1));
+		}
+
+	default:
+		throw std::invalid_argument{"Unsupported table key type"};
+	}
+}
+
+inline void
+JsonSerializer::LegacyObject(int idx)
+{
+	/* collect the keys and sort them first, and then serialize
+	   the values in this order, so each value is written only
+	   once, at its final position; the values are collected in
+	   the scratch array, which is cheaper to look up than the
+	   original table */
+
+	if (scratch_idx == 0) {
+		/* the stack above the top-level value is not used
+		   yet, so the scratch array can stay here until
+		   SerializeJson() returns */
+		lua_newtable(L);
+		scratch_idx = lua_gettop(L);
+	}
+
+	const int scratch_base = scratch_size;
+	AtScopeExit(this, scratch_base) { scratch_size = scratch_base; };
+
+	std::vector<Member> members;
+	std::forward_list<std::string> number_keys;
+
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		const int value_index = ++scratch_size;
+		members.push_back({LegacyKey(lua_gettop(L) - 1, number_keys),
+				   value_index});
+
+		/* move the value to the scratch array */
+		lua_rawseti(L, scratch_idx, value_index);
+	}
+
+	/* like nlohmann::json objects: sorted by key, and the first
+	   of duplicate keys (e.g. 1 and "1") wins */
+	std::stable_sort(members.begin(), members.end(),
+			 [](const Member &a, const Member &b){
+				 return a.key < b.key;
+			 });
+
+	dest.push_back('{');
+
+	const Member *previous = nullptr;
+	for (const auto &i : members) {
+		if (previous != nullptr) {
+			if (i.key == previous->key)
+				continue;
+
+			dest.push_back(',');
+		}
+
+		previous = &i;
+
+		AppendString(dest, i.key);
+		dest.push_back(':');
+
+		lua_rawgeti(L, scratch_idx, i.value_index);
+		Value(lua_gettop(L));
+		lua_pop(L, 1);
+	}
+
+	dest.push_back('}');
+}
+
+inline void
+JsonSerializer::Key(int idx)
+{
+	switch (lua_type(L, idx)) {
+	case LUA_TSTRING:
+		AppendString(dest, ToStringView(L, idx));
+		break;
+
+	case LUA_TNUMBER:
+		/* not using lua_tolstring() because converting the
+		   key in place would confuse lua_next() */
+		dest.push_back('"');
+		Number(lua_tonumber(L, idx));
+		dest.push_back('"');
+		break;
+
+	default:
+		throw std::invalid_argument{"Unsupported table key type"};
+	}
+}
+
+inline void
+JsonSerializer::Array(int idx, std::size_t n)
+{
+	dest.push_back('[');
+
+	for (std::size_t i = 1; i <= n; ++i) {
+		if (i > 1)
+			dest.push_back(',');
+
+		lua_rawgeti(L, idx, i);
+		Value(lua_gettop(L));
+		lua_pop(L, 1);
+	}
+
+	dest.push_back(']');
+}
+
+inline void
+JsonSerializer::Object(int idx)
+{
+	dest.push_back('{');
+
+	bool first = true;
+
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		if (!first)
+			dest.push_back(',');
+		first = false;
+
+		const int value_idx = lua_gettop(L);
+		Key(value_idx - 1);
+		dest.push_back(':');
+		Value(value_idx);
+
+		/* pop the value */
+		lua_pop(L, 1);
+	}
+
+	dest.push_back('}');
+}
+
+inline void
+JsonSerializer::Table(int idx)
+{
+	const void *const ptr = lua_topointer(L, idx);
+	if (std::find(tables.begin(), tables.end(), ptr) != tables.end())
+		throw std::invalid_argument{"Reference cycle in table"};
+
+	if (tables.size() >= MAX_DEPTH)
+		throw std::invalid_argument{"Tables nested too deeply"};
+
+	/* each level needs up to three stack slots (key, value and
+	   a copy of a numeric key), plus one for the scratch
+	   array */
+	if (!lua_checkstack(L, 4))
+		throw std::runtime_error{"Lua stack overflow"};
+
+	tables.push_back(ptr);
+
+	if (dialect == JsonDialect::LEGACY)
+		LegacyObject(idx);
+	else if (const std::size_t n = GetArrayLength(L, idx); n > 0)
+		Array(idx, n);
+	else
+		Object(idx);
+
+	tables.pop_back();
+}
+
+void
+JsonSerializer::Value(int idx)
+{
+	switch (lua_type(L, idx)) {
+	case LUA_TBOOLEAN:
+		if (dialect == JsonDialect::LEGACY)
+			/* ToJson() converts lua_toboolean()'s int
+			   return value to a JSON number */
+			dest.push_back(lua_toboolean(L, idx) ? '1' : '0');
+		else
+			dest.append(lua_toboolean(L, idx) ? "true" : "false");
+		break;
+
+	case LUA_TLIGHTUSERDATA:
+	case LUA_TUSERDATA:
+		Pointer("userdata", lua_touserdata(L, idx));
+		break;
+
+	case LUA_TNUMBER:
+		if (dialect == JsonDialect::LEGACY) {
+			/* truncated to an integer like ToJson()
+			   does */
+			char buffer[32];
+			const auto result = std::to_chars(buffer, std::end(buffer),
+							  static_cast<int_least64_t>(lua_tointeger(L, idx)));
+			dest.append(buffer, result.ptr);
+		} else
+			Number(lua_tonumber(L, idx));
+		break;
+
+	case LUA_TSTRING:
+		AppendString(dest, ToStringView(L, idx));
+		break;
+
+	case LUA_TTABLE:
+		Table(idx);
+		break;
+
+	case LUA_TFUNCTION:
+		Pointer("cfunction", (const void *)lua_tocfunction(L, idx));
+		break;
+
+	case LUA_TTHREAD:
+		Pointer("thread", lua_tothread(L, idx));
+		break;
+
+	default:
+		dest.append("null");
+		break;
+	}
+}
+
+} // anonymous namespace
+
+void
+SerializeJson(lua_State *L, int idx, std::string &dest, JsonDialect dialect)
+{
+	/* convert to an absolute index because the serializer
+	   pushes values */
+	if (idx < 0 && idx > LUA_REGISTRYINDEX)
+		idx = lua_gettop(L) + idx + 1;
+
+	const int top = lua_gettop(L);
+
+	try {
+		JsonSerializer{L, dest, dialect}.Value(idx);
+
+		/* pop the scratch array */
+		lua_settop(L, top);
+	} catch (const std::exception &) {
+		/* only our own errors are handled here; Lua errors
+		   (e.g. out of memory inside the Lua API) are not
+		   derived from std::exception and pass through
+		   untouched, because the Lua error handler expects
+		   the error value at the top of the stack */
+		lua_settop(L, top);
+		throw;
+	}
+}
+
+} // namespace Lua
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct lua_State;
+
+namespace Lua {
+
+enum class JsonDialect : uint_least8_t {
+	/**
+	 * The same output as ToJson(L, idx).dump(): all tables are
+	 * objects with sorted keys, numbers are truncated to
+	 * integers and booleans become 1 or 0.
+	 */
+	LEGACY,
+
+	/**
+	 * Tables whose keys are exactly the integers 1..n become
+	 * arrays, all other tables (including empty ones) become
+	 * objects (in iteration order).  Integral numbers are
+	 * formatted without fraction, all others in the shortest
+	 * form which parses back to the same value; NaN and
+	 * infinity become null.  Booleans become true or false.
+	 */
+	STANDARD,
+};
+
+/**
+ * Serialize the Lua value at the given stack index to JSON and
+ * append it to the given string.  Unlike ToJson(), this writes
+ * directly into the buffer without building a #nlohmann::json tree
+ * first.
+ *
+ * In both dialects, userdata, functions and threads become
+ * "type:address" strings.
+ *
+ * Throws on error, e.g. std::invalid_argument on strings which are
+ * not valid UTF-8, on reference cycles, on tables nested too deeply
+ * and on table keys which are neither strings nor numbers.  On
+ * error, the Lua stack is restored, but some garbage may have been
+ * appended to the string.
+ */
+void
+SerializeJson(lua_State *L, int idx, std::string &dest,
+	      JsonDialect dialect=JsonDialect::LEGACY);
+
+} // namespace Lua
@@ -3,6 +3,8 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "ToJson.hxx"
+#include "Serialize.hxx"
+#include "lua/Error.hxx"
 #include "lua/ForEach.hxx"
 #include "lua/StringView.hxx"
 #include "util/ScopeExit.hxx"
@@ -68,6 +70,11 @@ TableToJson(lua_State *L, int idx) noexcept
 nlohmann::json
 ToJson(lua_State *L, int idx) noexcept
 {
+	/* convert to an absolute index because TableToJson() pushes
+	   values */
+	if (idx < 0 && idx > LUA_REGISTRYINDEX)
+		idx = lua_gettop(L) + idx + 1;
+
 	switch (lua_type(L, idx)) {
 	case LUA_TNIL:
 		return nullptr;
@@ -106,10 +113,29 @@ ToJson(lua_State *L)
 	if (lua_gettop(L) < 1)
 		return luaL_error(L, "Not enough parameters");
 
-	if (lua_gettop(L) > 1)
+	if (lua_gettop(L) > 2)
 		return luaL_error(L, "Too many parameters");
 
-	const auto json = ToJson(L, 1).dump();
+	/* the optional second parameter is an options table;
+	   "standard=true" selects JsonDialect::STANDARD */
+	auto dialect = JsonDialect::LEGACY;
+	if (!lua_isnoneornil(L, 2)) {
+		luaL_checktype(L, 2, LUA_TTABLE);
+
+		lua_getfield(L, 2, "standard");
+		if (lua_toboolean(L, -1))
+			dialect = JsonDialect::STANDARD;
+		lua_pop(L, 1);
+	}
+
+	std::string json;
+
+	try {
+		SerializeJson(L, 1, json, dialect);
+	} catch (...) {
+		RaiseCurrent(L);
+	}
+
 	lua_pushlstring(L, json.data(), json.size());
 	return 1;
 }
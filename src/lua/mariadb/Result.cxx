@@ -7,10 +7,13 @@
 #include "lua/Assert.hxx"
 #include "lua/Class.hxx"
 #include "lua/Error.hxx"
+#include "util/NumberParser.hxx"
 #include "util/StringAPI.hxx"
 
 #include <memory>
 
+#include <stdlib.h> // for strtod()
+
 namespace Lua::MariaDB {
 
 static constexpr char lua_result[] = "MariaDB_Result";
@@ -73,9 +76,136 @@ try {
 	RaiseCurrent(L);
 }
 
+/**
+ * Push the value converted to a native Lua type (number) if the
+ * field type allows it, else as string.
+ *
+ * The conversion depends only on the field type, never on the
+ * value, so all values of a column have the same Lua type.  BIGINT
+ * values are always strings because a lua_Number (a double in
+ * LuaJIT) cannot represent all of them exactly.
+ */
+static void
+PushTypedValue(lua_State *L, const MYSQL_FIELD &field,
+	       const char *value, std::size_t length) noexcept
+{
+	if (value == nullptr) {
+		Push(L, nullptr);
+		return;
+	}
+
+	const std::string_view s{value, length};
+
+	switch (field.type) {
+	case MYSQL_TYPE_TINY:
+	case MYSQL_TYPE_SHORT:
+	case MYSQL_TYPE_LONG:
+	case MYSQL_TYPE_INT24:
+	case MYSQL_TYPE_YEAR:
+		/* even INT UNSIGNED fits into 64 bits (and into a
+		   double) */
+		if (const auto i = ParseInteger<int_least64_t>(s)) {
+			Push(L, static_cast<lua_Integer>(*i));
+			return;
+		}
+
+		break;
+
+	case MYSQL_TYPE_FLOAT:
+	case MYSQL_TYPE_DOUBLE:
+		/* values returned by mysql_fetch_row() are
+		   null-terminated */
+		Push(L, strtod(value, nullptr));
+		return;
+
+	default:
+		break;
+	}
+
+	Push(L, s);
+}
+
+static int
+FetchAll(lua_State *L)
+try {
+	if (lua_gettop(L) > 3)
+		return luaL_error(L, "Too many parameters");
+
+	auto &result = LuaResult::Cast(L, 1);
+	if (!result)
+		throw std::runtime_error{"Result was already closed"};
+
+	bool numerical = true;
+	const char *mode = luaL_optstring(L, 2, "a");
+	if (StringIsEqual(mode, "a"))
+		numerical = false;
+	else if (!StringIsEqual(mode, "n"))
+		luaL_argerror(L, 2, "Bad mode");
+
+	const lua_Integer max_rows = luaL_optinteger(L, 3, 0);
+	luaL_argcheck(L, max_rows >= 0, 3, "Negative row count");
+
+	const std::size_t n_fields = result->field_count;
+	const MYSQL_FIELD *const fields = result->fields;
+
+	/* the list, the field names, one row table, key and
+	   value */
+	luaL_checkstack(L, n_fields + 4, "Too many fields");
+
+	/* this is only a hint for preallocating the list; it
+	   includes rows which were already fetched */
+	std::size_t size_hint = result.GetRowCount();
+	if (max_rows > 0 && size_hint > static_cast<std::size_t>(max_rows))
+		size_hint = max_rows;
+
+	lua_createtable(L, size_hint, 0);
+	const int list_idx = lua_gettop(L);
+
+	/* push the field names only once; Lua strings are
+	   interned, so pushing copies of these for each row is
+	   cheap */
+	if (!numerical)
+		for (std::size_t i = 0; i < n_fields; ++i)
+			Push(L, fields[i].name);
+
+	lua_Integer n_rows = 0;
+	while (max_rows == 0 || n_rows < max_rows) {
+		auto *row = result.FetchRow();
+		if (row == nullptr)
+			break;
+
+		const auto *lengths = result.FetchLengths();
+
+		if (numerical) {
+			lua_createtable(L, n_fields, 0);
+
+			for (std::size_t i = 0; i < n_fields; ++i) {
+				PushTypedValue(L, fields[i], row[i], lengths[i]);
+				lua_rawseti(L, -2, i + 1);
+			}
+		} else {
+			lua_createtable(L, 0, n_fields);
+
+			for (std::size_t i = 0; i < n_fields; ++i) {
+				lua_pushvalue(L, list_idx + 1 + i);
+				PushTypedValue(L, fields[i], row[i], lengths[i]);
+				lua_rawset(L, -3);
+			}
+		}
+
+		lua_rawseti(L, list_idx, ++n_rows);
+	}
+
+	lua_settop(L, list_idx);
+	return 1;
+} catch (...) {
+	RaiseCurrent(L);
+}
+
 static constexpr struct luaL_Reg result_methods[] = {
 	{"close", Close},
 	{"fetch", Fetch},
+	{"fetchall", FetchAll},
 	{nullptr, nullptr}
 };
 
@@ -6,12 +6,15 @@
 #include "lua/Class.hxx"
 #include "lua/Util.hxx"
 #include "pg/Result.hxx"
+#include "util/NumberParser.hxx"
 #include "util/StringAPI.hxx"
 
 extern "C" {
 #include <lauxlib.h>
 }
 
+#include <stdlib.h> // for strtod()
+
 namespace Lua {
 
 class PgResult final {
@@ -24,6 +27,21 @@ public:
 		:result(std::move(_result)) {}
 
 	int Fetch(lua_State *L);
+	int FetchAll(lua_State *L);
+
+private:
+	/**
+	 * Push the value converted to a native Lua type (boolean or
+	 * number) if the column type allows it, else as string.
+	 *
+	 * The conversion depends only on the column type, never on
+	 * the value, so all values of a column have the same Lua
+	 * type.  "int8" values are always strings because a
+	 * lua_Number (a double in LuaJIT) cannot represent all of
+	 * them exactly.
+	 */
+	void PushTypedValue(lua_State *L,
+			    unsigned row, unsigned column) const noexcept;
 };
 
 static constexpr char lua_pg_result_class[] = "pg.Result";
@@ -31,6 +49,7 @@ using PgResultClass = Lua::Class<PgResult, lua_pg_result_class>;
 
 static constexpr struct luaL_Reg lua_pg_result_methods [] = {
 	{"fetch", PgResultClass::WrapMethod<&PgResult::Fetch>()},
+	{"fetchall", PgResultClass::WrapMethod<&PgResult::FetchAll>()},
 	{nullptr, nullptr}
 };
 
@@ -72,6 +91,104 @@ PgResult::Fetch(lua_State *L)
 	return 1;
 }
 
+inline void
+PgResult::PushTypedValue(lua_State *L,
+			 unsigned row, unsigned column) const noexcept
+{
+	if (result.IsValueNull(row, column)) {
+		Push(L, nullptr);
+		return;
+	}
+
+	if (!result.IsColumnBinary(column)) {
+		switch (result.GetColumnType(column)) {
+		case 16: /* bool */
+			Push(L, result.GetBoolValue(row, column));
+			return;
+
+		case 21: /* int2 */
+		case 23: /* int4 */
+			if (const auto value = ParseInteger<int_least32_t>(result.GetValueView(row, column))) {
+				Push(L, static_cast<lua_Integer>(*value));
+				return;
+			}
+
+			break;
+
+		case 700: /* float4 */
+		case 701: /* float8 */
+			/* strtod() also parses PostgreSQL's "NaN",
+			   "Infinity" and "-Infinity" */
+			Push(L, strtod(result.GetValue(row, column), nullptr));
+			return;
+		}
+	}
+
+	Push(L, result.GetValueView(row, column));
+}
+
+inline int
+PgResult::FetchAll(lua_State *L)
+{
+	if (lua_gettop(L) > 3)
+		return luaL_error(L, "Too many parameters");
+
+	bool numerical = true;
+	const char *mode = luaL_optstring(L, 2, "a");
+	if (StringIsEqual(mode, "a"))
+		numerical = false;
+	else if (!StringIsEqual(mode, "n"))
+		luaL_argerror(L, 2, "Bad mode");
+
+	const lua_Integer max_rows = luaL_optinteger(L, 3, 0);
+	luaL_argcheck(L, max_rows >= 0, 3, "Negative row count");
+
+	const unsigned n_columns = result.GetColumnCount();
+
+	unsigned n_rows = result.GetRowCount() - next_row;
+	if (max_rows > 0 && static_cast<lua_Integer>(n_rows) > max_rows)
+		n_rows = max_rows;
+
+	/* the list, the column names, one row table, key and
+	   value */
+	luaL_checkstack(L, n_columns + 4, "Too many columns");
+
+	lua_createtable(L, n_rows, 0);
+	const int list_idx = lua_gettop(L);
+
+	/* push the column names only once; Lua strings are interned,
+	   so pushing copies of these for each row is cheap */
+	if (!numerical)
+		for (unsigned i = 0; i < n_columns; ++i)
+			Push(L, result.GetColumnName(i));
+
+	for (unsigned i = 0; i < n_rows; ++i) {
+		const unsigned row = next_row++;
+
+		if (numerical) {
+			lua_createtable(L, n_columns, 0);
+
+			for (unsigned column = 0; column < n_columns; ++column) {
+				PushTypedValue(L, row, column);
+				lua_rawseti(L, -2, column + 1);
+			}
+		} else {
+			lua_createtable(L, 0, n_columns);
+
+			for (unsigned column = 0; column < n_columns; ++column) {
+				lua_pushvalue(L, list_idx + 1 + column);
+				PushTypedValue(L, row, column);
+				lua_rawset(L, -3);
+			}
+		}
+
+		lua_rawseti(L, list_idx, i + 1);
+	}
+
+	lua_settop(L, list_idx);
+	return 1;
+}
+
 void
 InitPgResult(lua_State *L) noexcept
 {
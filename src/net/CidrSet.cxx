@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "CidrSet.hxx"
+#include "MaskedSocketAddress.hxx"
+#include "IPv4Address.hxx"
+#include "IPv6Address.hxx"
+#include "SocketAddress.hxx"
+#include "util/ByteOrder.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include <string.h>
+
+static constexpr uint_least64_t
+MaskHigh(unsigned n) noexcept
+{
+	return n == 0 ? 0 : ~uint_least64_t{} << (64 - n);
+}
+
+static constexpr unsigned IPV4_MAPPED_PREFIX = 96;
+
+static constexpr uint_least64_t
+MapV4(uint32_t address) noexcept
+{
+	return uint_least64_t{0xffff} << 32 | address;
+}
+
+[[gnu::pure]]
+static uint_least64_t
+LoadBE64(const uint8_t *src) noexcept
+{
+	uint64_t value;
+	memcpy(&value, src, sizeof(value));
+	return FromBE64(value);
+}
+
+void
+CidrSet::Add(Key key, unsigned prefix_length) noexcept
+{
+	assert(prefix_length <= 128);
+
+	Key mask;
+	if (prefix_length <= 64)
+		mask = {MaskHigh(prefix_length), 0};
+	else
+		mask = {~uint_least64_t{}, MaskHigh(prefix_length - 64)};
+
+	const Key first{key.hi & mask.hi, key.lo & mask.lo};
+	const Key last{first.hi | ~mask.hi, first.lo | ~mask.lo};
+
+	ranges.push_back({first, last});
+	dirty = true;
+}
+
+void
+CidrSet::Add(SocketAddress address, uint_least8_t prefix_length)
+{
+	switch (address.GetFamily()) {
+	case AF_INET:
+		if (prefix_length > 32)
+			throw std::runtime_error("Prefix length is too big");
+
+		Add(Key{0, MapV4(IPv4Address::Cast(address).GetNumericAddress())},
+		    IPV4_MAPPED_PREFIX + prefix_length);
+		break;
+
+	case AF_INET6:
+		if (prefix_length > 128)
+			throw std::runtime_error("Prefix length is too big");
+
+		{
+			const auto *p = IPv6Address::Cast(address).GetAddress().s6_addr;
+			Add(Key{LoadBE64(p), LoadBE64(p + 8)}, prefix_length);
+		}
+
+		break;
+
+	default:
+		throw std::runtime_error("Address family not supported");
+	}
+}
+
+void
+CidrSet::Add(const MaskedSocketAddress &address)
+{
+	Add(address.GetAddress(), address.GetPrefixLength());
+}
+
+void
+CidrSet::Add(const char *s)
+{
+	Add(MaskedSocketAddress{s});
+}
+
+void
+CidrSet::Finish() noexcept
+{
+	if (!dirty)
+		return;
+
+	dirty = false;
+
+	if (ranges.empty())
+		return;
+
+	std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b){
+		return a.first < b.first;
+	});
+
+	/* merge overlapping and adjacent ranges */
+	auto out = ranges.begin();
+	for (auto i = std::next(out); i != ranges.end(); ++i) {
+		const Key &last = out->last;
+		const bool adjacent = last.lo == ~uint_least64_t{}
+			? (last.hi != ~uint_least64_t{} &&
+			   i->first == Key{last.hi + 1, 0})
+			: i->first == Key{last.hi, last.lo + 1};
+
+		if (i->first <= last || adjacent)
+			out->last = std::max(out->last, i->last);
+		else
+			*++out = *i;
+	}
+
+	ranges.erase(std::next(out), ranges.end());
+	ranges.shrink_to_fit();
+}
+
+bool
+CidrSet::Contains(SocketAddress address) const noexcept
+{
+	assert(!dirty);
+
+	if (address.IsNull())
+		return false;
+
+	Key key;
+
+	switch (address.GetFamily()) {
+	case AF_INET:
+		key = {0, MapV4(IPv4Address::Cast(address).GetNumericAddress())};
+		break;
+
+	case AF_INET6:
+		{
+			const auto *p = IPv6Address::Cast(address).GetAddress().s6_addr;
+			key = {LoadBE64(p), LoadBE64(p + 8)};
+		}
+
+		break;
+
+	default:
+		return false;
+	}
+
+	/* find the last range which begins at or before the key */
+	auto i = std::upper_bound(ranges.begin(), ranges.end(), key,
+				  [](const Key &k, const Range &r){
+					  return k < r.first;
+				  });
+	if (i == ranges.begin())
+		return false;
+
+	return key <= std::prev(i)->last;
+}
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <vector>
+
+class SocketAddress;
+class MaskedSocketAddress;
+
+/**
+ * A set of IPv4 and IPv6 networks (CIDR prefixes) which can check
+ * quickly whether an address is contained in one of them.  This is
+ * meant for access control lists with many entries, where calling
+ * MaskedSocketAddress::Matches() for each entry would be too slow.
+ *
+ * IPv4 addresses are stored as IPv4-mapped IPv6 addresses
+ * (::ffff:0:0/96), therefore an IPv4 network also matches the
+ * IPv4-mapped form of its addresses (and vice versa).
+ *
+ * Internally, all prefixes are converted to address ranges which are
+ * sorted and merged by Finish(), and lookups are a binary search,
+ * i.e. O(log n) comparisons of 128 bit integers.
+ */
+class CidrSet {
+	/**
+	 * A 128 bit IPv6 address in host byte order.
+	 */
+	struct Key {
+		uint_least64_t hi, lo;
+
+		friend constexpr auto operator<=>(const Key &,
+						  const Key &) noexcept = default;
+	};
+
+	struct Range {
+		/**
+		 * The first and the last address (inclusive).
+		 */
+		Key first, last;
+	};
+
+	std::vector<Range> ranges;
+
+	/**
+	 * Have new ranges been added since the last Finish() call?
+	 */
+	bool dirty = false;
+
+public:
+	bool empty() const noexcept {
+		return ranges.empty();
+	}
+
+	/**
+	 * @return the number of (merged) address ranges
+	 */
+	std::size_t size() const noexcept {
+		return ranges.size();
+	}
+
+	void clear() noexcept {
+		ranges.clear();
+		dirty = false;
+	}
+
+	/**
+	 * Add a network.  Bits of the address beyond the prefix
+	 * length are ignored.
+	 *
+	 * Throws std::runtime_error if the address family is not
+	 * supported or if the prefix length is too big.
+	 */
+	void Add(SocketAddress address, uint_least8_t prefix_length);
+
+	/**
+	 * Throws std::runtime_error if the address family is not
+	 * supported.
+	 */
+	void Add(const MaskedSocketAddress &address);
+
+	/**
+	 * Parse a string with a numeric address and an optional
+	 * prefix separated with a slash (see
+	 * MaskedSocketAddress::MaskedSocketAddress(const char *)) and
+	 * add it.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void Add(const char *s);
+
+	/**
+	 * Sort and merge the ranges.  This must be called after
+	 * adding networks and before calling Contains().
+	 */
+	void Finish() noexcept;
+
+	/**
+	 * Is the given address contained in one of the networks?
+	 * Addresses of other families always return false.
+	 */
+	[[gnu::pure]]
+	bool Contains(SocketAddress address) const noexcept;
+
+private:
+	void Add(Key key, unsigned prefix_length) noexcept;
+};
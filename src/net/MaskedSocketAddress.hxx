@@ -26,6 +26,14 @@ public:
 	 */
 	explicit MaskedSocketAddress(const char *s);
 
+	SocketAddress GetAddress() const noexcept {
+		return address;
+	}
+
+	uint_least8_t GetPrefixLength() const noexcept {
+		return prefix_length;
+	}
+
 	[[gnu::pure]]
 	static uint_least8_t MaximumPrefixLength(const SocketAddress address) noexcept;
 
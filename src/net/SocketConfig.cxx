@@ -9,6 +9,7 @@
 #include "lib/fmt/SystemError.hxx"
 #include "lib/fmt/SocketError.hxx"
 #include "lib/fmt/SocketAddressFormatter.hxx"
+#include "system/Error.hxx"
 
 #include <cassert>
 
@@ -116,3 +117,42 @@ SocketConfig::Create(int type) const
 
 	return fd;
 }
+
+std::vector<UniqueSocketDescriptor>
+SocketConfig::CreateReusePortGroup(int type, unsigned n,
+				   std::span<const unsigned> cpus) const
+{
+	assert(n > 0);
+	assert(cpus.empty() || cpus.size() == n);
+
+	std::vector<UniqueSocketDescriptor> result;
+	result.reserve(n);
+
+	if (!bind_address.IsInet()) {
+		/* SO_REUSEPORT is only implemented for TCP and UDP;
+		   all threads share the same socket */
+		result.emplace_back(Create(type));
+
+		for (unsigned i = 1; i < n; ++i) {
+			auto fd = result.front().Duplicate();
+			if (!fd.IsDefined())
+				throw MakeErrno("Failed to duplicate socket");
+
+			result.emplace_back(std::move(fd));
+		}
+
+		return result;
+	}
+
+	SocketConfig copy = *this;
+	copy.reuse_port = true;
+
+	for (unsigned i = 0; i < n; ++i)
+		result.emplace_back(copy.Create(type));
+
+	if (!cpus.empty() &&
+	    !result.front().AttachReusePortCpuFilter(cpus))
+		throw MakeSocketError("Failed to attach SO_REUSEPORT filter");
+
+	return result;
+}
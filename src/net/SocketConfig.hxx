@@ -7,8 +7,10 @@
 #include "AllocatedSocketAddress.hxx"
 
 #include <cstdint>
+#include <span>
 #include <string>
 #include <utility>
+#include <vector>
 
 class UniqueSocketDescriptor;
 
@@ -87,4 +89,25 @@ struct SocketConfig {
 	 * Throws exception on error.
 	 */
 	UniqueSocketDescriptor Create(int type) const;
+
+	/**
+	 * Create a group of listening sockets bound to the same
+	 * address, one for each thread of an #EventLoopGroup.  For
+	 * TCP/UDP sockets, this sets SO_REUSEPORT on all of them so
+	 * the kernel distributes incoming connections; other sockets
+	 * (e.g. local sockets) cannot be sharded, so only one socket
+	 * is created and duplicated.
+	 *
+	 * Throws exception on error.
+	 *
+	 * @param n the number of sockets
+	 * @param cpus if not empty, then socket i is handled by a
+	 * thread pinned to cpus[i] (see EventLoopGroup::GetCpus()),
+	 * and a BPF program is attached which selects the socket by
+	 * the CPU which received the connection (see
+	 * SocketDescriptor::AttachReusePortCpuFilter())
+	 */
+	std::vector<UniqueSocketDescriptor> CreateReusePortGroup(int type,
+								 unsigned n,
+								 std::span<const unsigned> cpus={}) const;
 };
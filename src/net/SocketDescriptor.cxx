@@ -12,6 +12,8 @@
 
 #ifdef __linux__
 #include "io/UniqueFileDescriptor.hxx"
+
+#include <linux/filter.h> // for struct sock_fprog
 #endif
 
 #ifdef HAVE_GETPEEREID
@@ -30,6 +32,7 @@
 
 #include <cassert>
 #include <cerrno>
+#include <vector>
 
 #include <string.h>
 
@@ -317,6 +320,44 @@ SocketDescriptor::SetReusePort(bool value) const noexcept
 	return SetBoolOption(SOL_SOCKET, SO_REUSEPORT, value);
 }
 
+bool
+SocketDescriptor::AttachReusePortCpuFilter(std::span<const unsigned> cpus) const noexcept
+{
+	assert(!cpus.empty());
+
+	/* A = raw_smp_processor_id(); then one "if (A == cpu)
+	   return index" per socket; the fallback is "return A %
+	   group_size" */
+	const std::size_t n_insns = cpus.size() * 2 + 3;
+	if (n_insns > BPF_MAXINSNS) {
+		errno = EINVAL;
+		return false;
+	}
+
+	std::vector<struct sock_filter> code;
+	code.reserve(n_insns);
+
+	code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU)));
+
+	for (std::size_t i = 0; i < cpus.size(); ++i) {
+		/* if equal, fall through to the "return" statement;
+		   else skip it */
+		code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, cpus[i], 0, 1));
+		code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<__u32>(i)));
+	}
+
+	code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<__u32>(cpus.size())));
+	code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+
+	const struct sock_fprog program{
+		.len = static_cast<unsigned short>(code.size()),
+		.filter = code.data(),
+	};
+
+	return SetOption(SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+			 &program, sizeof(program));
+}
+
 bool
 SocketDescriptor::SetFreeBind(bool value) const noexcept
 {
@@ -254,6 +254,21 @@ public:
 
 #ifdef __linux__
 	bool SetReusePort(bool value=true) const noexcept;
+
+	/**
+	 * Attach a classic BPF program to the SO_REUSEPORT group of
+	 * this socket which selects the socket by the CPU which
+	 * received the packet.  Combined with one thread per CPU
+	 * (each with its own socket), this keeps connections on the
+	 * CPU which handled the interrupt.
+	 *
+	 * @param cpus the CPU which handles each socket of the
+	 * SO_REUSEPORT group (in the order the sockets were added to
+	 * the group); packets received by a CPU not in this list are
+	 * distributed by CPU number modulo the group size
+	 */
+	bool AttachReusePortCpuFilter(std::span<const unsigned> cpus) const noexcept;
+
 	bool SetFreeBind(bool value=true) const noexcept;
 	bool SetNoDelay(bool value=true) const noexcept;
 	bool SetCork(bool value=true) const noexcept;
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Definitions for the DNS wire protocol (RFC 1035).
+ */
+
+#pragma once
+
+#include "util/PackedBigEndian.hxx"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Dns {
+
+static constexpr uint_least16_t DEFAULT_PORT = 53;
+
+/**
+ * The maximum size of a DNS message over UDP we accept; this is
+ * announced with EDNS(0) (RFC 6891).  The value is the one
+ * recommended by "DNS Flag Day 2020" to avoid IP fragmentation.
+ */
+static constexpr std::size_t MAX_UDP_SIZE = 1232;
+
+/**
+ * The maximum length of a domain name in presentation format
+ * (without the trailing dot).
+ */
+static constexpr std::size_t MAX_NAME_LENGTH = 253;
+
+static constexpr std::size_t MAX_LABEL_LENGTH = 63;
+
+struct Header {
+	PackedBE16 id;
+	PackedBE16 flags;
+	PackedBE16 qdcount, ancount, nscount, arcount;
+};
+
+static_assert(sizeof(Header) == 12);
+static_assert(alignof(Header) == 1);
+
+namespace Flags {
+
+static constexpr uint_least16_t QR = 0x8000;
+static constexpr uint_least16_t OPCODE_MASK = 0x7800;
+static constexpr uint_least16_t TC = 0x0200;
+static constexpr uint_least16_t RD = 0x0100;
+static constexpr uint_least16_t RCODE_MASK = 0x000f;
+
+} // namespace Flags
+
+enum class RecordType : uint_least16_t {
+	A = 1,
+	NS = 2,
+	CNAME = 5,
+	SOA = 6,
+	AAAA = 28,
+	OPT = 41,
+};
+
+static constexpr uint_least16_t CLASS_IN = 1;
+
+enum class ResponseCode : uint_least8_t {
+	NOERROR = 0,
+	FORMERR = 1,
+	SERVFAIL = 2,
+	NXDOMAIN = 3,
+	NOTIMP = 4,
+	REFUSED = 5,
+};
+
+/**
+ * The fixed part of a question after the name.
+ */
+struct QuestionTail {
+	PackedBE16 type, class_;
+};
+
+static_assert(sizeof(QuestionTail) == 4);
+
+/**
+ * The fixed part of a resource record after the name.
+ */
+struct RecordTail {
+	PackedBE16 type, class_;
+	PackedBE32 ttl;
+	PackedBE16 rdlength;
+};
+
+static_assert(sizeof(RecordTail) == 10);
+
+} // namespace Dns
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "Query.hxx"
+#include "util/CharUtil.hxx"
+#include "util/IterableSplitString.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace Dns {
+
+static constexpr std::string_view
+StripTrailingDot(std::string_view name) noexcept
+{
+	if (!name.empty() && name.back() == '.')
+		name.remove_suffix(1);
+	return name;
+}
+
+static constexpr bool
+IsValidNameChar(char ch) noexcept
+{
+	/* letters, digits and hyphens (RFC 952/1123) plus the
+	   underscore which is common in SRV/DKIM names */
+	return IsAlphaNumericASCII(ch) || ch == '-' || ch == '_';
+}
+
+bool
+IsValidName(std::string_view name) noexcept
+{
+	name = StripTrailingDot(name);
+	if (name.empty() || name.size() > MAX_NAME_LENGTH)
+		return false;
+
+	for (const std::string_view label : IterableSplitString(name, '.'))
+		if (label.empty() || label.size() > MAX_LABEL_LENGTH ||
+		    !std::all_of(label.begin(), label.end(), IsValidNameChar))
+			return false;
+
+	return true;
+}
+
+template<typename T>
+static std::byte *
+Append(std::byte *dest, const T &src) noexcept
+{
+	std::memcpy(dest, &src, sizeof(src));
+	return dest + sizeof(src);
+}
+
+std::size_t
+MakeQuery(std::span<std::byte> buffer, uint_least16_t id,
+	  std::string_view name, RecordType type)
+{
+	assert(buffer.size() >= MAX_QUERY_SIZE);
+
+	if (!IsValidName(name))
+		throw std::invalid_argument{"Invalid domain name"};
+
+	std::byte *p = buffer.data();
+
+	p = Append(p, Header{
+		.id = id,
+		.flags = Flags::RD,
+		.qdcount = 1,
+		.ancount = 0,
+		.nscount = 0,
+		.arcount = 1,
+	});
+
+	/* the question */
+
+	for (const std::string_view label : IterableSplitString(StripTrailingDot(name), '.')) {
+		*p++ = static_cast<std::byte>(label.size());
+		p = std::copy_n(reinterpret_cast<const std::byte *>(label.data()),
+				label.size(), p);
+	}
+
+	*p++ = std::byte{0};
+
+	p = Append(p, QuestionTail{
+		.type = static_cast<uint_least16_t>(type),
+		.class_ = CLASS_IN,
+	});
+
+	/* the EDNS(0) OPT pseudo-record: root name, the UDP payload
+	   size in the "class" field, no extended flags */
+
+	*p++ = std::byte{0};
+	p = Append(p, RecordTail{
+		.type = static_cast<uint_least16_t>(RecordType::OPT),
+		.class_ = MAX_UDP_SIZE,
+		.ttl = 0,
+		.rdlength = 0,
+	});
+
+	assert(p <= buffer.data() + buffer.size());
+	return p - buffer.data();
+}
+
+} // namespace Dns
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "Protocol.hxx"
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace Dns {
+
+/**
+ * The maximum size of a query generated by MakeQuery().
+ */
+static constexpr std::size_t MAX_QUERY_SIZE =
+	sizeof(Header) + MAX_NAME_LENGTH + 2 + sizeof(QuestionTail) + 11;
+
+/**
+ * Check whether the given string is a valid host name which can be
+ * sent to a DNS server (letters, digits, hyphens and underscores;
+ * one trailing dot is allowed).
+ */
+[[gnu::pure]]
+bool
+IsValidName(std::string_view name) noexcept;
+
+/**
+ * Generate a recursive query for the given name and record type
+ * with an EDNS(0) OPT record.
+ *
+ * Throws std::invalid_argument if the name is not valid.
+ *
+ * @param buffer a buffer of at least #MAX_QUERY_SIZE bytes
+ * @return the size of the query
+ */
+std::size_t
+MakeQuery(std::span<std::byte> buffer, uint_least16_t id,
+	  std::string_view name, RecordType type);
+
+} // namespace Dns
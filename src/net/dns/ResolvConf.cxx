@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "ResolvConf.hxx"
+#include "Protocol.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/Parser.hxx"
+#include "io/StringFile.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringSplit.hxx"
+#include "util/StringStrip.hxx"
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+
+using std::string_view_literals::operator""sv;
+
+namespace Dns {
+
+/**
+ * glibc ignores name servers beyond this number.
+ */
+static constexpr std::size_t MAXNS = 3;
+
+/**
+ * glibc ignores search domains beyond this number.
+ */
+static constexpr std::size_t MAXDNSRCH = 6;
+
+static AllocatedSocketAddress
+ParseNameserver(std::string_view value)
+{
+	/* IPv6 addresses need brackets, or else the last colon
+	   would be parsed as the port separator */
+	std::string s;
+	if (value.find(':') != value.npos) {
+		s.reserve(value.size() + 2);
+		s.push_back('[');
+		s.append(value);
+		s.push_back(']');
+	} else
+		s = value;
+
+	return ParseSocketAddress(s.c_str(), DEFAULT_PORT, false);
+}
+
+static void
+ParseOption(ResolvConf &rc, std::string_view option) noexcept
+{
+	const auto [name, value] = Split(option, ':');
+
+	if (name == "timeout"sv) {
+		if (const auto v = ParseInteger<unsigned>(value))
+			rc.timeout = std::chrono::seconds{std::clamp(*v, 1U, 30U)};
+	} else if (name == "attempts"sv) {
+		if (const auto v = ParseInteger<unsigned>(value))
+			rc.attempts = std::clamp(*v, 1U, 5U);
+	} else if (name == "ndots"sv) {
+		if (const auto v = ParseInteger<unsigned>(value))
+			rc.ndots = std::min(*v, 15U);
+	}
+}
+
+static void
+ParseSearch(ResolvConf &rc, std::string_view value)
+{
+	/* the last "search" or "domain" line wins */
+	rc.search.clear();
+
+	for (std::string_view domain : IterableSplitString(value, ' ')) {
+		domain = Strip(domain);
+		if (!domain.empty() && domain.back() == '.')
+			domain.remove_suffix(1);
+
+		if (domain.empty())
+			continue;
+
+		if (rc.search.size() >= MAXDNSRCH)
+			break;
+
+		rc.search.emplace_back(domain);
+	}
+}
+
+ResolvConf
+ParseResolvConf(std::string_view contents)
+{
+	ResolvConf rc;
+
+	for (std::string_view line : IterableSplitString(contents, '\n')) {
+		line = Strip(line);
+		if (line.empty() || line.front() == '#' || line.front() == ';')
+			continue;
+
+		auto [keyword, rest] = Split(line, ' ');
+		if (keyword.find('\t') != keyword.npos)
+			std::tie(keyword, rest) = Split(line, '\t');
+
+		rest = Strip(rest);
+
+		if (keyword == "nameserver"sv) {
+			if (rc.nameservers.size() >= MAXNS)
+				continue;
+
+			try {
+				rc.nameservers.emplace_back(ParseNameserver(rest));
+			} catch (...) {
+				/* ignore malformed addresses */
+			}
+		} else if (keyword == "search"sv || keyword == "domain"sv) {
+			ParseSearch(rc, rest);
+		} else if (keyword == "options"sv) {
+			for (const std::string_view option : IterableSplitString(rest, ' '))
+				if (!option.empty())
+					ParseOption(rc, Strip(option));
+		}
+	}
+
+	if (rc.nameservers.empty())
+		rc.nameservers.emplace_back(IPv4Address{127, 0, 0, 1, DEFAULT_PORT});
+
+	return rc;
+}
+
+ResolvConf
+LoadResolvConf(const char *path)
+{
+	return ParseResolvConf(LoadStringFile(path));
+}
+
+} // namespace Dns
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "net/AllocatedSocketAddress.hxx"
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Dns {
+
+/**
+ * The subset of resolv.conf(5) settings used by the DNS client.
+ */
+struct ResolvConf {
+	/**
+	 * The name servers (with port 53) in the order in which they
+	 * shall be queried.
+	 */
+	std::vector<AllocatedSocketAddress> nameservers;
+
+	/**
+	 * How long to wait for a response from one name server.
+	 */
+	std::chrono::seconds timeout{5};
+
+	/**
+	 * How often to query the list of name servers before giving
+	 * up.
+	 */
+	unsigned attempts = 2;
+
+	/**
+	 * The domains (without trailing dot) which are appended to
+	 * relative host names ("search" or "domain").  Unlike glibc,
+	 * this does not default to the domain of the local host
+	 * name.
+	 */
+	std::vector<std::string> search;
+
+	/**
+	 * Names with at least this many dots are tried as absolute
+	 * names before applying #search.
+	 */
+	unsigned ndots = 1;
+};
+
+/**
+ * Parse the contents of a resolv.conf file.  Unknown or malformed
+ * lines are ignored (like glibc does).  If no name server is
+ * configured, the local host is used.
+ *
+ * Throws on error.
+ */
+ResolvConf
+ParseResolvConf(std::string_view contents);
+
+/**
+ * Load and parse a resolv.conf file.
+ *
+ * Throws on error.
+ */
+ResolvConf
+LoadResolvConf(const char *path="/etc/resolv.conf");
+
+} // namespace Dns
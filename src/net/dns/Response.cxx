@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "Response.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/IPv6Address.hxx"
+#include "net/SocketProtocolError.hxx"
+#include "util/CharUtil.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace Dns {
+
+namespace {
+
+/**
+ * A resource record from the answer or authority section.
+ */
+struct Record {
+	std::string name;
+	RecordType type;
+	std::chrono::seconds ttl;
+	std::span<const std::byte> data;
+
+	/**
+	 * The target name of a CNAME record.
+	 */
+	std::string target;
+};
+
+class Reader {
+	const std::span<const std::byte> packet;
+	std::size_t position = 0;
+
+public:
+	explicit Reader(std::span<const std::byte> _packet,
+			std::size_t _position=0) noexcept
+		:packet(_packet), position(_position) {}
+
+	template<typename T>
+	T ReadT() {
+		if (packet.size() - position < sizeof(T))
+			throw SocketProtocolError{"Truncated DNS response"};
+
+		T value;
+		std::memcpy(&value, packet.data() + position, sizeof(value));
+		position += sizeof(value);
+		return value;
+	}
+
+	std::span<const std::byte> ReadBytes(std::size_t size) {
+		if (packet.size() - position < size)
+			throw SocketProtocolError{"Truncated DNS response"};
+
+		const auto result = packet.subspan(position, size);
+		position += size;
+		return result;
+	}
+
+	/**
+	 * Read a (possibly compressed) domain name and convert it to
+	 * lower case presentation format without the trailing dot.
+	 */
+	std::string ReadName();
+
+	Record ReadRecord() {
+		Record record;
+		record.name = ReadName();
+
+		const auto tail = ReadT<RecordTail>();
+		record.type = static_cast<RecordType>(uint_least16_t{tail.type});
+		record.ttl = std::chrono::seconds{
+			/* RFC 2181 5.2: values with the most
+			   significant bit set are treated as zero */
+			uint_least32_t{tail.ttl} & 0x80000000
+			? 0 : uint_least32_t{tail.ttl}
+		};
+		const std::size_t data_position = position;
+		record.data = ReadBytes(tail.rdlength);
+
+		if (record.type == RecordType::CNAME)
+			/* the target may be compressed, so it needs
+			   to be parsed with access to the whole
+			   packet */
+			record.target = Reader{packet, data_position}.ReadName();
+
+		return record;
+	}
+};
+
+std::string
+Reader::ReadName()
+{
+	std::string name;
+
+	/* the position after the name, i.e. after the first
+	   compression pointer */
+	std::size_t end = 0;
+
+	std::size_t p = position;
+
+	/* limit the number of compression pointers to avoid
+	   endless loops */
+	for (unsigned n_jumps = 0;;) {
+		if (p >= packet.size())
+			throw SocketProtocolError{"Truncated DNS response"};
+
+		const auto length = static_cast<uint_least8_t>(packet[p]);
+		if (length == 0) {
+			++p;
+			break;
+		}
+
+		if ((length & 0xc0) == 0xc0) {
+			/* compression pointer */
+			if (p + 1 >= packet.size())
+				throw SocketProtocolError{"Truncated DNS response"};
+
+			if (++n_jumps > 16)
+				throw SocketProtocolError{"Too many DNS compression pointers"};
+
+			if (end == 0)
+				end = p + 2;
+
+			p = ((length & 0x3f) << 8) | static_cast<uint_least8_t>(packet[p + 1]);
+			continue;
+		}
+
+		if (length > MAX_LABEL_LENGTH)
+			throw SocketProtocolError{"Malformed DNS label"};
+
+		++p;
+		if (packet.size() - p < length)
+			throw SocketProtocolError{"Truncated DNS response"};
+
+		if (!name.empty())
+			name.push_back('.');
+
+		for (const std::byte b : packet.subspan(p, length))
+			name.push_back(ToLowerASCII(static_cast<char>(b)));
+
+		if (name.size() > MAX_NAME_LENGTH)
+			throw SocketProtocolError{"DNS name too long"};
+
+		p += length;
+	}
+
+	position = end != 0 ? end : p;
+	return name;
+}
+
+} // anonymous namespace
+
+[[gnu::pure]]
+static bool
+EqualsIgnoreCase(std::string_view lower, std::string_view name) noexcept
+{
+	if (!name.empty() && name.back() == '.')
+		name.remove_suffix(1);
+
+	return std::equal(lower.begin(), lower.end(), name.begin(), name.end(),
+			  [](char a, char b){
+				  return a == ToLowerASCII(b);
+			  });
+}
+
+static void
+AddAddress(std::vector<AllocatedSocketAddress> &addresses,
+	   RecordType type, std::span<const std::byte> data)
+{
+	switch (type) {
+	case RecordType::A:
+		if (data.size() != 4)
+			throw SocketProtocolError{"Malformed A record"};
+
+		addresses.emplace_back(IPv4Address{
+				static_cast<uint8_t>(data[0]),
+				static_cast<uint8_t>(data[1]),
+				static_cast<uint8_t>(data[2]),
+				static_cast<uint8_t>(data[3]),
+				0,
+			});
+		break;
+
+	case RecordType::AAAA:
+		if (data.size() != 16)
+			throw SocketProtocolError{"Malformed AAAA record"};
+
+		{
+			struct in6_addr a;
+			std::memcpy(&a, data.data(), sizeof(a));
+			addresses.emplace_back(IPv6Address{a, 0});
+		}
+
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ * Determine the negative caching TTL from the SOA record in the
+ * authority section (RFC 2308 section 5).
+ */
+static std::optional<std::chrono::seconds>
+GetNegativeTtl(Reader &reader, unsigned nscount)
+{
+	for (unsigned i = 0; i < nscount; ++i) {
+		const auto record = reader.ReadRecord();
+		if (record.type != RecordType::SOA)
+			continue;
+
+		/* the last 4 bytes of the RDATA (after MNAME, RNAME
+		   and four other 32 bit fields) are the MINIMUM
+		   field */
+		if (record.data.size() < 22)
+			throw SocketProtocolError{"Malformed SOA record"};
+
+		PackedBE32 minimum;
+		std::memcpy(&minimum, record.data.last(sizeof(minimum)).data(),
+			    sizeof(minimum));
+
+		return std::min(record.ttl,
+				std::chrono::seconds{uint_least32_t{minimum}});
+	}
+
+	return std::nullopt;
+}
+
+Response
+ParseResponse(std::span<const std::byte> packet,
+	      std::string_view name, RecordType type)
+{
+	Reader reader{packet};
+
+	const auto header = reader.ReadT<Header>();
+	const uint_least16_t flags = header.flags;
+
+	if ((flags & Flags::QR) == 0)
+		throw SocketProtocolError{"Not a DNS response"};
+
+	Response response{
+		.id = header.id,
+		.rcode = static_cast<ResponseCode>(flags & Flags::RCODE_MASK),
+		.truncated = (flags & Flags::TC) != 0,
+		.addresses = {},
+		.ttl = std::nullopt,
+	};
+
+	if (header.qdcount != 1)
+		throw SocketProtocolError{"Wrong number of questions in DNS response"};
+
+	/* verify the question to ensure this is the response to our
+	   query */
+	const auto qname = reader.ReadName();
+	const auto qtail = reader.ReadT<QuestionTail>();
+	if (!EqualsIgnoreCase(qname, name) ||
+	    qtail.type != static_cast<uint_least16_t>(type) ||
+	    qtail.class_ != CLASS_IN)
+		throw SocketProtocolError{"Mismatched question in DNS response"};
+
+	if (response.truncated)
+		/* the remaining sections may be incomplete; the
+		   caller is going to retry over TCP */
+		return response;
+
+	std::vector<Record> answers;
+	answers.reserve(header.ancount);
+	for (unsigned i = 0; i < header.ancount; ++i)
+		answers.push_back(reader.ReadRecord());
+
+	/* follow the CNAME chain */
+	std::string_view current = qname;
+	std::optional<std::chrono::seconds> ttl;
+
+	for (unsigned n_cnames = 0; n_cnames < 16; ++n_cnames) {
+		const auto cname = std::find_if(answers.begin(), answers.end(),
+						[current](const Record &r){
+							return r.type == RecordType::CNAME &&
+								r.name == current;
+						});
+		if (cname == answers.end())
+			break;
+
+		ttl = ttl ? std::min(*ttl, cname->ttl) : cname->ttl;
+		current = cname->target;
+	}
+
+	std::optional<std::chrono::seconds> address_ttl;
+	for (const auto &record : answers) {
+		if (record.type != type || record.name != current)
+			continue;
+
+		AddAddress(response.addresses, type, record.data);
+		address_ttl = address_ttl
+			? std::min(*address_ttl, record.ttl)
+			: record.ttl;
+	}
+
+	if (!response.addresses.empty()) {
+		response.ttl = ttl ? std::min(*ttl, *address_ttl) : *address_ttl;
+	} else if (response.rcode == ResponseCode::NOERROR ||
+		   response.rcode == ResponseCode::NXDOMAIN) {
+		/* negative response */
+		response.ttl = GetNegativeTtl(reader, header.nscount);
+	}
+
+	return response;
+}
+
+} // namespace Dns
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "Protocol.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Dns {
+
+struct Response {
+	uint_least16_t id;
+
+	ResponseCode rcode;
+
+	/**
+	 * Was the TC (truncated) flag set?  If yes, the query should
+	 * be repeated over TCP.
+	 */
+	bool truncated;
+
+	/**
+	 * The addresses (with port 0) of the requested record type;
+	 * CNAME chains have been followed.
+	 */
+	std::vector<AllocatedSocketAddress> addresses;
+
+	/**
+	 * How long may this response be cached?  For positive
+	 * responses, this is the minimum TTL of all records which were
+	 * used; for negative responses (NXDOMAIN or no addresses),
+	 * this is derived from the SOA record in the authority
+	 * section (RFC 2308).  std::nullopt if there was no such
+	 * record.
+	 */
+	std::optional<std::chrono::seconds> ttl;
+};
+
+/**
+ * Parse the response to a query generated by MakeQuery().  The
+ * question section must match the given name and type.
+ *
+ * Throws SocketProtocolError if the response is malformed or does
+ * not match the question.
+ */
+Response
+ParseResponse(std::span<const std::byte> packet,
+	      std::string_view name, RecordType type);
+
+} // namespace Dns
@@ -0,0 +1,717 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "CgroupStatsCollector.hxx"
+#include "CgroupStatsHandler.hxx"
+#include "event/Loop.hxx"
+#include "event/config.h" // for HAVE_URING
+#include "io/FileAt.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "lib/fmt/SystemError.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/SpanCast.hxx"
+
+#ifdef HAVE_URING
+#include "io/uring/Operation.hxx"
+#include "io/uring/Queue.hxx"
+#include <liburing.h>
+#else
+namespace Uring { class Queue; }
+#endif
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <utility>
+
+#include <errno.h>
+
+/**
+ * The read buffer sizes of the three files.  Files which are
+ * larger get truncated (at a line boundary).
+ */
+static constexpr std::size_t CPU_BUFFER_SIZE = 1024;
+static constexpr std::size_t MEMORY_BUFFER_SIZE = 8192;
+static constexpr std::size_t IO_BUFFER_SIZE = 4096;
+
+static constexpr std::size_t MAX_BUFFER_SIZE =
+	std::max({CPU_BUFFER_SIZE, MEMORY_BUFFER_SIZE, IO_BUFFER_SIZE});
+
+/**
+ * Calculate the difference between two counter values.  If the
+ * counter was reset (because the cgroup was recreated), the new
+ * value is returned.
+ */
+static constexpr uint_least64_t
+CounterDelta(uint_least64_t current, uint_least64_t previous) noexcept
+{
+	return current >= previous
+		? current - previous
+		: current;
+}
+
+/**
+ * If the buffer was filled completely, the file was probably
+ * truncated; chop off the last (incomplete) line.
+ */
+static constexpr std::string_view
+CompleteLines(std::string_view s, std::size_t buffer_size) noexcept
+{
+	if (s.size() >= buffer_size)
+		s = s.substr(0, s.rfind('\n') + 1);
+
+	return s;
+}
+
+/**
+ * Reads one of a cgroup's statistics files.  Instances are
+ * allocated on the heap and are freed with Release(): while an
+ * io_uring read is pending, the kernel may still write to the
+ * buffer (and still needs the file descriptor), so the object
+ * outlives its #Group until the completion arrives.
+ */
+class CgroupStatsCollector::ReadOperation final
+#ifdef HAVE_URING
+	: Uring::Operation
+#endif
+{
+public:
+	enum class Kind : uint_least8_t {
+		CPU,
+		MEMORY,
+		IO,
+	};
+
+private:
+	/**
+	 * The group this object belongs to; nullptr after
+	 * Release() was called while a read was pending.
+	 */
+	Group *group;
+
+	const UniqueFileDescriptor fd;
+
+	const Kind kind;
+
+#ifdef HAVE_URING
+	Uring::Queue *queue;
+
+	/**
+	 * The buffer of the pending io_uring read.  It is allocated
+	 * by Start() and freed by OnUringCompletion().
+	 */
+	std::unique_ptr<std::byte[]> buffer;
+#endif
+
+public:
+	ReadOperation(Group &_group, UniqueFileDescriptor &&_fd,
+		      Kind _kind) noexcept
+		:group(&_group), fd(std::move(_fd)), kind(_kind) {}
+
+	/**
+	 * Delete this object, or (if an io_uring read is pending)
+	 * cancel the read and delete this object as soon as the
+	 * kernel has finished it.
+	 */
+	void Release() noexcept;
+
+	bool IsPending() const noexcept {
+#ifdef HAVE_URING
+		return IsUringPending();
+#else
+		return false;
+#endif
+	}
+
+	/**
+	 * Read the file synchronously.
+	 *
+	 * @return true on success
+	 */
+	bool Read() noexcept;
+
+#ifdef HAVE_URING
+	/**
+	 * Submit an io_uring read.
+	 *
+	 * Throws on error.
+	 */
+	void Start(Uring::Queue &_queue);
+
+private:
+	// virtual methods from class Uring::Operation
+	void OnUringCompletion(int res) noexcept override;
+#endif
+
+private:
+	static constexpr std::size_t GetBufferSize(Kind kind) noexcept {
+		switch (kind) {
+		case Kind::CPU:
+			return CPU_BUFFER_SIZE;
+
+		case Kind::MEMORY:
+			return MEMORY_BUFFER_SIZE;
+
+		case Kind::IO:
+			return IO_BUFFER_SIZE;
+		}
+
+		return 0;
+	}
+};
+
+struct CgroupStatsCollector::Group final
+	: IntrusiveHashSetHook<>, IntrusiveListHook<IntrusiveHookMode::NORMAL>
+{
+	CgroupStatsCollector &collector;
+
+	const std::string name;
+	const std::size_t name_hash;
+
+	/**
+	 * Readers for "cpu.stat", "memory.stat" and "io.stat";
+	 * nullptr if the file does not exist (because the controller
+	 * is not enabled).
+	 */
+	ReadOperation *cpu = nullptr, *memory = nullptr, *io = nullptr;
+
+	/**
+	 * The number of pending io_uring read operations.
+	 */
+	unsigned n_pending = 0;
+
+	/**
+	 * The number of samples collected so far (saturating at 2).
+	 */
+	unsigned n_samples = 0;
+
+	/**
+	 * Has one of the reads of the current refresh failed?  If
+	 * yes, the incomplete #next sample is discarded.
+	 */
+	bool failed;
+
+	/**
+	 * The sample which is being collected right now.
+	 */
+	CgroupStatsSample next;
+
+	CgroupStatsSample current, previous;
+
+	Group(CgroupStatsCollector &_collector, StringWithHash _name) noexcept
+		:collector(_collector),
+		 name(_name.value), name_hash(_name.hash) {}
+
+	~Group() noexcept {
+		Close();
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	void Open(FileDescriptor cgroup_fd);
+
+	/**
+	 * Release all #ReadOperation instances, canceling pending
+	 * reads.
+	 */
+	void Close() noexcept;
+
+	void Refresh(Uring::Queue *queue) noexcept;
+
+	void OnRead(ReadOperation::Kind kind, std::string_view text) noexcept;
+
+	/**
+	 * An io_uring read operation has finished.
+	 *
+	 * @param success false if the read has failed
+	 */
+	void OnReadDone(bool success) noexcept;
+
+	CgroupStatsDelta GetDelta() const noexcept;
+
+private:
+	void Refresh(ReadOperation *operation, Uring::Queue *queue) noexcept;
+
+	void Commit() noexcept;
+};
+
+void
+CgroupStatsCollector::ReadOperation::Release() noexcept
+{
+	group = nullptr;
+
+#ifdef HAVE_URING
+	if (IsUringPending()) {
+		/* the kernel may still write to our buffer; cancel
+		   the read, and OnUringCompletion() will delete
+		   this object */
+		if (auto *s = queue->GetSubmitEntry()) {
+			io_uring_prep_cancel(s, GetUringData(), 0);
+			io_uring_sqe_set_data(s, nullptr);
+			io_uring_sqe_set_flags(s, IOSQE_CQE_SKIP_SUCCESS);
+			queue->Submit();
+		}
+
+		return;
+	}
+#endif
+
+	delete this;
+}
+
+inline bool
+CgroupStatsCollector::ReadOperation::Read() noexcept
+{
+	assert(group != nullptr);
+
+	std::array<std::byte, MAX_BUFFER_SIZE> _buffer;
+	const auto b = std::span{_buffer}.first(GetBufferSize(kind));
+
+	/* pread() at offset 0 makes the kernel generate fresh
+	   contents */
+	const auto nbytes = fd.ReadAt(0, b);
+	if (nbytes <= 0)
+		return false;
+
+	group->OnRead(kind, CompleteLines(ToStringView(b.first(nbytes)),
+					  b.size()));
+	return true;
+}
+
+#ifdef HAVE_URING
+
+inline void
+CgroupStatsCollector::ReadOperation::Start(Uring::Queue &_queue)
+{
+	assert(group != nullptr);
+	assert(!IsUringPending());
+
+	const std::size_t size = GetBufferSize(kind);
+
+	/* allocate the buffer before obtaining the submit entry,
+	   because a submit entry must not be abandoned */
+	auto new_buffer = std::make_unique_for_overwrite<std::byte[]>(size);
+
+	auto &s = _queue.RequireSubmitEntry();
+	queue = &_queue;
+	buffer = std::move(new_buffer);
+	io_uring_prep_read(&s, fd.Get(), buffer.get(), size, 0);
+	_queue.Push(s, *this);
+}
+
+void
+CgroupStatsCollector::ReadOperation::OnUringCompletion(int res) noexcept
+{
+	/* free the buffer at the end of this method */
+	const auto b = std::move(buffer);
+
+	if (group == nullptr) [[unlikely]] {
+		/* Release() was called */
+		delete this;
+		return;
+	}
+
+	if (res > 0) {
+		const std::size_t size = GetBufferSize(kind);
+		group->OnRead(kind, CompleteLines(ToStringView(std::span{b.get(), size}.first(res)),
+						  size));
+	}
+
+	/* this call may delete this object */
+	group->OnReadDone(res > 0);
+}
+
+#endif // HAVE_URING
+
+/**
+ * Open one of the statistics files of a cgroup.
+ *
+ * Throws on error.
+ *
+ * @return the file descriptor or an undefined one if the file does
+ * not exist (because the controller is not enabled)
+ */
+static UniqueFileDescriptor
+OpenStatFile(FileDescriptor cgroup_fd, const char *filename)
+{
+	UniqueFileDescriptor fd;
+	if (!fd.OpenReadOnly({cgroup_fd, filename}))
+		if (const int e = errno; e != ENOENT)
+			throw FmtErrno(e, "Failed to open {:?}", filename);
+
+	return fd;
+}
+
+inline void
+CgroupStatsCollector::Group::Open(FileDescriptor cgroup_fd)
+{
+	/* open all files first so this object remains unmodified
+	   if one of them fails */
+	auto cpu_fd = OpenStatFile(cgroup_fd, "cpu.stat");
+	auto memory_fd = OpenStatFile(cgroup_fd, "memory.stat");
+	auto io_fd = OpenStatFile(cgroup_fd, "io.stat");
+
+	Close();
+	n_samples = 0;
+
+	if (cpu_fd.IsDefined())
+		cpu = new ReadOperation(*this, std::move(cpu_fd),
+					ReadOperation::Kind::CPU);
+
+	if (memory_fd.IsDefined())
+		memory = new ReadOperation(*this, std::move(memory_fd),
+					   ReadOperation::Kind::MEMORY);
+
+	if (io_fd.IsDefined())
+		io = new ReadOperation(*this, std::move(io_fd),
+				       ReadOperation::Kind::IO);
+}
+
+inline void
+CgroupStatsCollector::Group::Close() noexcept
+{
+	for (auto **i : {&cpu, &memory, &io}) {
+		if (*i == nullptr)
+			continue;
+
+		if ((*i)->IsPending()) {
+			assert(n_pending > 0);
+			assert(collector.n_pending > 0);
+
+			--n_pending;
+			--collector.n_pending;
+		}
+
+		std::exchange(*i, nullptr)->Release();
+	}
+
+	assert(n_pending == 0);
+}
+
+inline void
+CgroupStatsCollector::Group::Refresh(ReadOperation *operation,
+				     Uring::Queue *queue) noexcept
+{
+	if (operation == nullptr)
+		return;
+
+#ifdef HAVE_URING
+	if (queue != nullptr) {
+		try {
+			operation->Start(*queue);
+			++n_pending;
+			++collector.n_pending;
+			return;
+		} catch (...) {
+			/* fall back to a synchronous read */
+		}
+	}
+#else
+	(void)queue;
+#endif
+
+	if (!operation->Read())
+		failed = true;
+}
+
+inline void
+CgroupStatsCollector::Group::Refresh(Uring::Queue *queue) noexcept
+{
+	assert(n_pending == 0);
+
+	next = {};
+	failed = false;
+
+	Refresh(cpu, queue);
+	Refresh(memory, queue);
+	Refresh(io, queue);
+
+	if (n_pending == 0 && !failed)
+		Commit();
+}
+
+inline void
+CgroupStatsCollector::Group::OnRead(ReadOperation::Kind kind,
+				    std::string_view text) noexcept
+{
+	switch (kind) {
+	case ReadOperation::Kind::CPU:
+		next.cpu = ParseCgroupCpuStat(text);
+		break;
+
+	case ReadOperation::Kind::MEMORY:
+		next.memory = ParseCgroupMemoryStat(text);
+		break;
+
+	case ReadOperation::Kind::IO:
+		next.io = ParseCgroupIoStat(text);
+		break;
+	}
+}
+
+inline void
+CgroupStatsCollector::Group::OnReadDone(bool success) noexcept
+{
+	assert(n_pending > 0);
+	assert(collector.n_pending > 0);
+
+	if (!success)
+		failed = true;
+
+	/* copy the reference, because the handler (invoked by
+	   Commit()) may delete this object */
+	auto &_collector = collector;
+
+	--_collector.n_pending;
+	if (--n_pending == 0 && !failed)
+		/* if a read has failed, the incomplete sample is
+		   discarded and the previous one is kept */
+		Commit();
+
+	if (_collector.n_pending == 0)
+		_collector.ScheduleTimer();
+}
+
+inline void
+CgroupStatsCollector::Group::Commit() noexcept
+{
+	next.time = collector.GetEventLoop().SteadyNow();
+	previous = current;
+	current = next;
+
+	if (n_samples < 2)
+		++n_samples;
+
+	if (n_samples >= 2 && collector.handler != nullptr)
+		collector.handler->OnCgroupStats(name, current, GetDelta());
+}
+
+CgroupStatsDelta
+CgroupStatsCollector::Group::GetDelta() const noexcept
+{
+	const auto &c = current, &p = previous;
+
+	return {
+		.duration = c.time - p.time,
+		.cpu = {
+			CounterDelta(c.cpu.usage_usec, p.cpu.usage_usec),
+			CounterDelta(c.cpu.user_usec, p.cpu.user_usec),
+			CounterDelta(c.cpu.system_usec, p.cpu.system_usec),
+			CounterDelta(c.cpu.nr_periods, p.cpu.nr_periods),
+			CounterDelta(c.cpu.nr_throttled, p.cpu.nr_throttled),
+			CounterDelta(c.cpu.throttled_usec, p.cpu.throttled_usec),
+		},
+		.io = {
+			CounterDelta(c.io.rbytes, p.io.rbytes),
+			CounterDelta(c.io.wbytes, p.io.wbytes),
+			CounterDelta(c.io.rios, p.io.rios),
+			CounterDelta(c.io.wios, p.io.wios),
+		},
+		.pgfault = CounterDelta(c.memory.pgfault, p.memory.pgfault),
+		.pgmajfault = CounterDelta(c.memory.pgmajfault, p.memory.pgmajfault),
+	};
+}
+
+constexpr StringWithHash
+CgroupStatsCollector::GetName::operator()(const Group &group) const noexcept
+{
+	return StringWithHash{group.name, group.name_hash};
+}
+
+CgroupStatsCollector::CgroupStatsCollector(EventLoop &event_loop,
+					   CgroupStatsHandler *_handler,
+					   Event::Duration _interval,
+					   unsigned _max_per_interval)
+	:handler(_handler),
+	 timer(event_loop, BIND_THIS_METHOD(OnTimer)),
+	 interval(_interval),
+	 max_per_interval(std::max(_max_per_interval, 1U))
+{
+}
+
+CgroupStatsCollector::~CgroupStatsCollector() noexcept
+{
+	refresh_list.clear();
+	groups.clear_and_dispose(DeleteDisposer{});
+}
+
+void
+CgroupStatsCollector::Add(StringWithHash name, FileDescriptor cgroup_fd)
+{
+	auto [it, inserted] = groups.insert_check(name);
+	if (inserted) {
+		auto *group = new Group(*this, name);
+
+		try {
+			group->Open(cgroup_fd);
+		} catch (...) {
+			delete group;
+			throw;
+		}
+
+		groups.insert_commit(it, *group);
+		refresh_list.push_front(*group);
+	} else {
+		it->Open(cgroup_fd);
+	}
+
+	ScheduleTimer();
+}
+
+void
+CgroupStatsCollector::Remove(StringWithHash name) noexcept
+{
+	auto i = groups.find(name);
+	if (i == groups.end())
+		return;
+
+	refresh_list.erase(refresh_list.iterator_to(*i));
+	groups.erase_and_dispose(i, DeleteDisposer{});
+
+	ScheduleTimer();
+}
+
+inline void
+CgroupStatsCollector::ScheduleTimer() noexcept
+{
+	/* don't start a new round before the previous one has
+	   finished */
+	if (n_pending == 0 && !refresh_list.empty() && !timer.IsPending())
+		timer.Schedule(interval);
+}
+
+inline void
+CgroupStatsCollector::OnTimer() noexcept
+{
+	assert(n_pending == 0);
+
+#ifdef HAVE_URING
+	Uring::Queue *queue = GetEventLoop().GetUring();
+#else
+	Uring::Queue *queue = nullptr;
+#endif
+
+	const std::size_t n = std::min<std::size_t>(refresh_list.size(),
+						    max_per_interval);
+
+	for (std::size_t i = 0; i < n; ++i) {
+		/* move the group to the end of the list; the ones
+		   which were not refreshed this time will be next */
+		auto &group = refresh_list.front();
+		refresh_list.pop_front();
+		refresh_list.push_back(group);
+
+		group.Refresh(queue);
+	}
+
+	ScheduleTimer();
+}
+
+/**
+ * Append a Prometheus label value, escaping special characters.
+ */
+static void
+AppendLabelValue(std::string &out, std::string_view value) noexcept
+{
+	for (const char ch : value) {
+		switch (ch) {
+		case '\\':
+		case '"':
+			out.push_back('\\');
+			out.push_back(ch);
+			break;
+
+		case '\n':
+			out.append("\\n");
+			break;
+
+		default:
+			out.push_back(ch);
+		}
+	}
+}
+
+void
+CgroupStatsCollector::ExportPrometheus(std::string &out) const
+{
+	const auto metric = [this, &out](const char *name, const char *type,
+					 const char *help, auto get){
+		fmt::format_to(std::back_inserter(out),
+			       "# HELP {0} {1}\n"
+			       "# TYPE {0} {2}\n",
+			       name, help, type);
+
+		for (const auto &group : refresh_list) {
+			if (group.n_samples == 0)
+				continue;
+
+			fmt::format_to(std::back_inserter(out),
+				       "{}{{cgroup=\"", name);
+			AppendLabelValue(out, group.name);
+			fmt::format_to(std::back_inserter(out),
+				       "\"}} {}\n", get(group.current));
+		}
+	};
+
+	const auto usec = [](uint_least64_t value){
+		return value / 1e6;
+	};
+
+	metric("cgroup_cpu_usage_seconds_total", "counter",
+	       "Total CPU time",
+	       [&](const auto &s){ return usec(s.cpu.usage_usec); });
+	metric("cgroup_cpu_user_seconds_total", "counter",
+	       "User CPU time",
+	       [&](const auto &s){ return usec(s.cpu.user_usec); });
+	metric("cgroup_cpu_system_seconds_total", "counter",
+	       "System CPU time",
+	       [&](const auto &s){ return usec(s.cpu.system_usec); });
+	metric("cgroup_cpu_throttled_periods_total", "counter",
+	       "Number of throttled periods",
+	       [](const auto &s){ return s.cpu.nr_throttled; });
+	metric("cgroup_cpu_throttled_seconds_total", "counter",
+	       "Time throttled by the CPU bandwidth limit",
+	       [&](const auto &s){ return usec(s.cpu.throttled_usec); });
+
+	metric("cgroup_memory_anon_bytes", "gauge",
+	       "Anonymous memory",
+	       [](const auto &s){ return s.memory.anon; });
+	metric("cgroup_memory_file_bytes", "gauge",
+	       "Page cache memory",
+	       [](const auto &s){ return s.memory.file; });
+	metric("cgroup_memory_kernel_bytes", "gauge",
+	       "Kernel memory",
+	       [](const auto &s){ return s.memory.kernel; });
+	metric("cgroup_memory_sock_bytes", "gauge",
+	       "Network transmission buffers",
+	       [](const auto &s){ return s.memory.sock; });
+	metric("cgroup_memory_shmem_bytes", "gauge",
+	       "Shared memory",
+	       [](const auto &s){ return s.memory.shmem; });
+	metric("cgroup_memory_page_faults_total", "counter",
+	       "Page faults",
+	       [](const auto &s){ return s.memory.pgfault; });
+	metric("cgroup_memory_major_page_faults_total", "counter",
+	       "Major page faults",
+	       [](const auto &s){ return s.memory.pgmajfault; });
+
+	metric("cgroup_io_read_bytes_total", "counter",
+	       "Bytes read from block devices",
+	       [](const auto &s){ return s.io.rbytes; });
+	metric("cgroup_io_write_bytes_total", "counter",
+	       "Bytes written to block devices",
+	       [](const auto &s){ return s.io.wbytes; });
+	metric("cgroup_io_reads_total", "counter",
+	       "Read operations on block devices",
+	       [](const auto &s){ return s.io.rios; });
+	metric("cgroup_io_writes_total", "counter",
+	       "Write operations on block devices",
+	       [](const auto &s){ return s.io.wios; });
+}
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "event/CoarseTimerEvent.hxx"
+#include "io/linux/CgroupStat.hxx"
+#include "util/IntrusiveHashSet.hxx"
+#include "util/IntrusiveList.hxx"
+#include "util/StringWithHash.hxx"
+
+#include <cstddef>
+#include <string>
+
+class FileDescriptor;
+class CgroupStatsHandler;
+
+/**
+ * One sample of a cgroup's statistics.
+ */
+struct CgroupStatsSample {
+	Event::TimePoint time;
+
+	CgroupCpuStat cpu;
+	CgroupMemoryStat memory;
+	CgroupIoStat io;
+};
+
+/**
+ * The difference between the two most recent samples of a cgroup.
+ */
+struct CgroupStatsDelta {
+	Event::Duration duration;
+
+	CgroupCpuStat cpu;
+	CgroupIoStat io;
+
+	uint_least64_t pgfault, pgmajfault;
+};
+
+/**
+ * Periodically collects the "cpu.stat", "memory.stat" and "io.stat"
+ * files of many cgroups.  The files are kept open and re-read with
+ * pread(); if the #EventLoop has io_uring enabled, all reads of one
+ * interval are submitted in one batch.
+ *
+ * To bound the CPU usage, at most #max_per_interval cgroups are
+ * refreshed per interval (round-robin); with more cgroups, each one
+ * is refreshed less often.
+ */
+class CgroupStatsCollector final {
+	CgroupStatsHandler *const handler;
+
+	CoarseTimerEvent timer;
+
+	const Event::Duration interval;
+
+	const unsigned max_per_interval;
+
+	struct Group;
+	class ReadOperation;
+
+	struct GetName {
+		constexpr StringWithHash operator()(const Group &group) const noexcept;
+	};
+
+	IntrusiveHashSet<Group, 4096,
+			 IntrusiveHashSetOperators<Group, GetName,
+						   std::hash<StringWithHash>,
+						   std::equal_to<StringWithHash>>> groups;
+
+	/**
+	 * All groups in refresh order: the ones at the front are
+	 * refreshed next.
+	 */
+	IntrusiveList<Group, IntrusiveListBaseHookTraits<Group>,
+		      IntrusiveListOptions{.constant_time_size = true}> refresh_list;
+
+	/**
+	 * The number of pending io_uring read operations.  The timer
+	 * is rescheduled when this drops to zero.
+	 */
+	unsigned n_pending = 0;
+
+public:
+	/**
+	 * @param _handler an optional handler which gets notified
+	 * about each new sample
+	 */
+	CgroupStatsCollector(EventLoop &event_loop,
+			     CgroupStatsHandler *_handler,
+			     Event::Duration _interval,
+			     unsigned _max_per_interval=256);
+	~CgroupStatsCollector() noexcept;
+
+	CgroupStatsCollector(const CgroupStatsCollector &) = delete;
+	CgroupStatsCollector &operator=(const CgroupStatsCollector &) = delete;
+
+	auto &GetEventLoop() const noexcept {
+		return timer.GetEventLoop();
+	}
+
+	/**
+	 * Start collecting statistics of the given cgroup.  Files
+	 * which do not exist (because the controller is not enabled)
+	 * are ignored.  If a cgroup with this name already exists,
+	 * its files are reopened.
+	 *
+	 * Throws on error.
+	 *
+	 * @param cgroup_fd a file descriptor of the cgroup directory
+	 * (may be O_PATH)
+	 */
+	void Add(StringWithHash name, FileDescriptor cgroup_fd);
+
+	/**
+	 * Stop collecting statistics of the given cgroup (e.g. after
+	 * it has been deleted).
+	 */
+	void Remove(StringWithHash name) noexcept;
+
+	/**
+	 * Append the most recent samples in the Prometheus text
+	 * format to the given string.  Counters are exported as
+	 * totals; Prometheus calculates rates from them.
+	 */
+	void ExportPrometheus(std::string &out) const;
+
+private:
+	void ScheduleTimer() noexcept;
+	void OnTimer() noexcept;
+};
@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <string_view>
+
+struct CgroupStatsSample;
+struct CgroupStatsDelta;
+
+class CgroupStatsHandler {
+public:
+	/**
+	 * A new sample of a cgroup has been collected (and there was
+	 * a previous sample to calculate the delta from).
+	 */
+	virtual void OnCgroupStats(std::string_view name,
+				   const CgroupStatsSample &sample,
+				   const CgroupStatsDelta &delta) noexcept = 0;
+};
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "HashSeed.hxx"
+#include "Urandom.hxx"
+#include "util/SpanCast.hxx"
+
+#include <chrono>
+
+namespace HashSeedDetail {
+
+constinit std::atomic<uint_least64_t> seed{0};
+
+static uint_least64_t
+Generate() noexcept
+{
+	uint_least64_t value;
+
+	try {
+		UrandomFill(ReferenceAsWritableBytes(value));
+	} catch (...) {
+		/* fall back to address space layout randomization
+		   and the clock; not really random, but better
+		   than a constant */
+		value = reinterpret_cast<uintptr_t>(&value) ^
+			std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+
+	/* zero is reserved for "not yet initialized" */
+	return value | 1;
+}
+
+uint_least64_t
+Initialize() noexcept
+{
+	uint_least64_t expected = 0;
+	const uint_least64_t value = Generate();
+
+	/* if another thread was faster, use its value */
+	if (!seed.compare_exchange_strong(expected, value,
+					  std::memory_order_relaxed))
+		return expected;
+
+	return value;
+}
+
+} // namespace HashSeedDetail
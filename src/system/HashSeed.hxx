@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace HashSeedDetail {
+
+/**
+ * Zero means "not yet initialized".
+ */
+extern std::atomic<uint_least64_t> seed;
+
+uint_least64_t
+Initialize() noexcept;
+
+} // namespace HashSeedDetail
+
+/**
+ * Returns a random seed for hash functions such as WyHash().  It is
+ * generated (from /dev/urandom or getrandom()) on the first call and
+ * remains the same for the lifetime of the process, so hash values
+ * must not be shared with other processes.
+ *
+ * This function is thread-safe.
+ */
+[[gnu::always_inline]]
+inline uint_least64_t
+GetHashSeed() noexcept
+{
+	if (const auto seed = HashSeedDetail::seed.load(std::memory_order_relaxed);
+	    seed != 0) [[likely]]
+		return seed;
+
+	return HashSeedDetail::Initialize();
+}
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "HashSeed.hxx"
+#include "util/StringWithHash.hxx"
+#include "util/WyHash.hxx"
+
+#include <string_view>
+
+/**
+ * A hash function object for strings which uses WyHash() with the
+ * per-process random seed from GetHashSeed().  Use it instead of
+ * std::hash or djb_hash() for hash tables (e.g. #IntrusiveHashSet)
+ * whose keys come from untrusted sources, to make hash flooding
+ * attacks harder.
+ */
+struct SeededStringHash {
+	using is_transparent = void;
+
+	[[gnu::pure]]
+	std::size_t operator()(std::string_view s) const noexcept {
+		return WyHash(s, GetHashSeed());
+	}
+};
+
+/**
+ * Construct a #StringWithHash with #SeededStringHash (instead of
+ * djb_hash()).  All keys of one container must be constructed the
+ * same way.
+ */
+[[gnu::pure]]
+inline StringWithHash
+MakeSeededStringWithHash(std::string_view s) noexcept
+{
+	return StringWithHash{s, SeededStringHash{}(s)};
+}
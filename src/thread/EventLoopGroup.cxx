@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "EventLoopGroup.hxx"
+#include "Notify.hxx"
+#include "event/Loop.hxx"
+#include "system/Error.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <cassert>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sched.h>
+
+class EventLoopGroup::Thread {
+	EventLoop event_loop;
+
+	/**
+	 * Wakes up the #EventLoop from another thread and makes it
+	 * return from EventLoop::Run().
+	 */
+	Notify stop_notify{event_loop, BIND_THIS_METHOD(OnStop)};
+
+	const int cpu;
+
+	pthread_t thread;
+
+	bool running = false;
+
+public:
+	/**
+	 * @param _cpu the CPU to pin this thread to or -1
+	 */
+	explicit Thread(int _cpu) noexcept
+		:cpu(_cpu) {}
+
+	~Thread() noexcept {
+		assert(!running);
+	}
+
+	EventLoop &GetEventLoop() noexcept {
+		return event_loop;
+	}
+
+	/**
+	 * Throws on error.
+	 */
+	void Start();
+
+	void Stop() noexcept {
+		stop_notify.Signal();
+	}
+
+	void Join() noexcept {
+		if (running) {
+			pthread_join(thread, nullptr);
+			running = false;
+		}
+	}
+
+private:
+	void OnStop() noexcept {
+		event_loop.Break();
+	}
+
+	static void *Run(void *ctx) noexcept;
+};
+
+void *
+EventLoopGroup::Thread::Run(void *ctx) noexcept
+{
+	/* reduce glibc's thread cancellation overhead */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+
+	auto &t = *(Thread *)ctx;
+	t.event_loop.Run();
+
+	return nullptr;
+}
+
+void
+EventLoopGroup::Thread::Start()
+{
+	assert(!running);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	AtScopeExit(&attr) { pthread_attr_destroy(&attr); };
+
+	int error;
+
+	if (cpu >= 0) {
+		cpu_set_t cpu_set;
+		CPU_ZERO(&cpu_set);
+		CPU_SET(cpu, &cpu_set);
+		error = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set), &cpu_set);
+		if (error != 0)
+			throw MakeErrno(error, "Failed to set CPU affinity");
+	}
+
+	error = pthread_create(&thread, &attr, Run, this);
+	if (error != 0)
+		throw MakeErrno(error, "Failed to create event loop thread");
+
+	running = true;
+}
+
+/**
+ * Returns the list of CPUs this process may run on.
+ *
+ * Throws on error.
+ */
+static std::vector<unsigned>
+GetAllowedCpus()
+{
+	cpu_set_t cpu_set;
+	if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) < 0)
+		throw MakeErrno("sched_getaffinity() failed");
+
+	std::vector<unsigned> result;
+	for (unsigned i = 0; i < CPU_SETSIZE; ++i)
+		if (CPU_ISSET(i, &cpu_set))
+			result.push_back(i);
+
+	if (result.empty())
+		throw std::runtime_error{"No CPU available"};
+
+	return result;
+}
+
+EventLoopGroup::EventLoopGroup(unsigned n, bool pin_cpu)
+{
+	const auto allowed = GetAllowedCpus();
+
+	if (n == 0)
+		n = allowed.size();
+
+	if (pin_cpu) {
+		cpus.reserve(n);
+		for (unsigned i = 0; i < n; ++i)
+			cpus.push_back(allowed[i % allowed.size()]);
+	}
+
+	threads.reserve(n);
+	for (unsigned i = 0; i < n; ++i)
+		threads.emplace_back(std::make_unique<Thread>(pin_cpu
+							      ? static_cast<int>(cpus[i])
+							      : -1));
+}
+
+EventLoopGroup::~EventLoopGroup() noexcept = default;
+
+EventLoop &
+EventLoopGroup::GetEventLoop(std::size_t i) noexcept
+{
+	assert(i < threads.size());
+
+	return threads[i]->GetEventLoop();
+}
+
+void
+EventLoopGroup::Start()
+try {
+	for (auto &i : threads)
+		i->Start();
+} catch (...) {
+	Stop();
+	Join();
+	throw;
+}
+
+void
+EventLoopGroup::Stop() noexcept
+{
+	for (auto &i : threads)
+		i->Stop();
+}
+
+void
+EventLoopGroup::Join() noexcept
+{
+	for (auto &i : threads)
+		i->Join();
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * Runs a number of #EventLoop instances, each in its own thread,
+ * optionally pinned to one CPU.  The loops do not share any state;
+ * the caller creates per-loop objects (e.g. one listener socket
+ * each, see SocketConfig::CreateReusePortGroup()) before calling
+ * Start() and destroys them after Join().
+ *
+ * Between Start() and Join(), the #EventLoop instances must not be
+ * accessed from outside their threads.
+ */
+class EventLoopGroup {
+	class Thread;
+	std::vector<std::unique_ptr<Thread>> threads;
+
+	/**
+	 * The CPU each thread is pinned to; empty if the threads are
+	 * not pinned.
+	 */
+	std::vector<unsigned> cpus;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n the number of threads; 0 means one per CPU this
+	 * process may run on (see sched_getaffinity())
+	 * @param pin_cpu pin thread i to the i-th CPU this process
+	 * may run on (wrapping around if there are more threads than
+	 * CPUs)?
+	 */
+	explicit EventLoopGroup(unsigned n=0, bool pin_cpu=true);
+
+	~EventLoopGroup() noexcept;
+
+	EventLoopGroup(const EventLoopGroup &) = delete;
+	EventLoopGroup &operator=(const EventLoopGroup &) = delete;
+
+	std::size_t size() const noexcept {
+		return threads.size();
+	}
+
+	EventLoop &GetEventLoop(std::size_t i) noexcept;
+
+	/**
+	 * Returns the CPU each thread is pinned to (or an empty span
+	 * if the threads are not pinned).  This can be passed to
+	 * SocketConfig::CreateReusePortGroup().
+	 */
+	std::span<const unsigned> GetCpus() const noexcept {
+		return cpus;
+	}
+
+	/**
+	 * Launch all threads.
+	 *
+	 * Throws on error (after stopping the threads which have
+	 * already been launched).
+	 */
+	void Start();
+
+	/**
+	 * Ask all threads to return from EventLoop::Run().
+	 *
+	 * This method is thread-safe.
+	 */
+	void Stop() noexcept;
+
+	/**
+	 * Wait for all threads to exit.  You must call Stop() prior
+	 * to this method.
+	 */
+	void Join() noexcept;
+};
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "util/StaticCache.hxx"
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+/**
+ * A thread-safe cache which can be shared by all threads (e.g. all
+ * #EventLoop instances of an #EventLoopGroup).  It is split into
+ * #n_shards independent #StaticCache instances, each protected by
+ * its own mutex, so threads looking up different keys rarely
+ * contend for the same lock.
+ *
+ * Since references to items would be invalidated by other threads
+ * at any time, lookups return a copy of the value (or pass it to a
+ * function while the shard is locked).
+ *
+ * @param n_shards the number of shards; must be a power of two
+ * @param shard_size the maximum number of items in each shard
+ * @param table_size the size of the hash table of each shard
+ * @param Policy the eviction policy of each shard
+ */
+template<typename Key, typename Data,
+	 std::size_t n_shards,
+	 std::size_t shard_size,
+	 std::size_t table_size,
+	 typename Hash=std::hash<Key>,
+	 typename Equal=std::equal_to<Key>,
+	 typename Policy=LruCachePolicy>
+class ShardedCache {
+	static_assert(std::has_single_bit(n_shards),
+		      "The number of shards must be a power of two");
+
+	using Cache = StaticCache<Key, Data, shard_size, table_size,
+				  Hash, Equal, Policy>;
+
+	/**
+	 * Each shard is aligned to a cache line to avoid false
+	 * sharing between the mutexes.
+	 */
+	struct alignas(64) Shard {
+		mutable std::mutex mutex;
+
+		Cache cache;
+	};
+
+	[[no_unique_address]]
+	Hash hash;
+
+	[[no_unique_address]]
+	Equal equal;
+
+	std::array<Shard, n_shards> shards;
+
+	/**
+	 * Choose a shard for the given key.  This uses the upper bits
+	 * of the (Fibonacci-hashed) hash value, because the lower
+	 * bits are used by the hash table inside the shard.
+	 */
+	template<typename K>
+	[[gnu::pure]]
+	Shard &GetShard(const K &key) noexcept {
+		if constexpr (n_shards == 1) {
+			(void)key;
+			return shards.front();
+		} else {
+			const uint_least64_t h = hash(key);
+			constexpr unsigned shift = 64 - std::countr_zero(n_shards);
+			return shards[(h * 0x9e3779b97f4a7c15ULL) >> shift];
+		}
+	}
+
+public:
+	using hasher = Hash;
+	using key_equal = Equal;
+
+	ShardedCache() = default;
+
+	ShardedCache(const ShardedCache &) = delete;
+	ShardedCache &operator=(const ShardedCache &) = delete;
+
+	const Hash &hash_function() const noexcept {
+		return hash;
+	}
+
+	const Equal &key_eq() const noexcept {
+		return equal;
+	}
+
+	/**
+	 * Look up an item by its key and return a copy of its value.
+	 */
+	template<typename K>
+	std::optional<Data> Get(const K &key) {
+		auto &shard = GetShard(key);
+		const std::scoped_lock lock{shard.mutex};
+
+		if (const Data *data = shard.cache.Get(key))
+			return *data;
+
+		return std::nullopt;
+	}
+
+	/**
+	 * Look up an item by its key and pass its value to the given
+	 * function (while the shard is locked, so the function must
+	 * be quick and must not access this cache).
+	 *
+	 * @return true if the item was found
+	 */
+	template<typename K>
+	bool Visit(const K &key, std::invocable<const Data &> auto f) {
+		auto &shard = GetShard(key);
+		const std::scoped_lock lock{shard.mutex};
+
+		const Data *data = shard.cache.Get(key);
+		if (data == nullptr)
+			return false;
+
+		f(*data);
+		return true;
+	}
+
+	/**
+	 * Insert a new item into the cache.  If the key exists
+	 * already (e.g. because another thread has inserted it
+	 * meanwhile), then the item is replaced.
+	 */
+	template<typename K, typename U>
+	void Put(K &&key, U &&data) {
+		auto &shard = GetShard(key);
+		const std::scoped_lock lock{shard.mutex};
+
+		shard.cache.PutOrReplace(std::forward<K>(key),
+					 std::forward<U>(data));
+	}
+
+	template<typename K>
+	void Remove(const K &key) noexcept {
+		auto &shard = GetShard(key);
+		const std::scoped_lock lock{shard.mutex};
+
+		shard.cache.Remove(key);
+	}
+
+	/**
+	 * Remove all items which match the given predicate.  The
+	 * shards are locked one after another, so this is not atomic
+	 * with respect to other threads.
+	 */
+	void RemoveIf(std::predicate<const Key &, const Data &> auto p) noexcept {
+		for (auto &shard : shards) {
+			const std::scoped_lock lock{shard.mutex};
+			shard.cache.RemoveIf(p);
+		}
+	}
+
+	void Clear() noexcept {
+		for (auto &shard : shards) {
+			const std::scoped_lock lock{shard.mutex};
+			shard.cache.Clear();
+		}
+	}
+
+	/**
+	 * Iterates over all items, passing each key/value pair to a
+	 * given function (while its shard is locked).  The cache must
+	 * not be accessed from within that function.
+	 */
+	void ForEach(std::invocable<const Key &, const Data &> auto f) const {
+		for (const auto &shard : shards) {
+			const std::scoped_lock lock{shard.mutex};
+			shard.cache.ForEach(f);
+		}
+	}
+};
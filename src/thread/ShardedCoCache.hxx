@@ -0,0 +1,456 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "Notify.hxx"
+#include "ShardedCache.hxx"
+#include "co/InvokeTask.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+/**
+ * A #ShardedCache which is shared by several threads, each running
+ * its own #EventLoop, and which loads missing items with a coroutine
+ * factory (like #Co::Cache).  Concurrent requests for the same key
+ * are merged, even if they come from different threads: the factory
+ * runs only once (in the thread of the first requester), and the
+ * result is delivered to all other requesters via their thread's
+ * #Notify.
+ *
+ * Each thread needs a #Client instance which must be destroyed
+ * (in that thread) before its #EventLoop.  Destroying a #Client
+ * cancels all requests running in its thread; other threads waiting
+ * for them get an exception.
+ *
+ * Unlike #Co::Cache, a pending request is not canceled when all of
+ * its waiters disappear; it continues to run, and its result is
+ * stored in the cache.
+ *
+ * @param Factory a factory class whose operator() returns a
+ * #Co::Task; it is called from all threads, so it must be
+ * thread-safe
+ */
+template<typename Factory, typename Key, typename Data,
+	 std::size_t n_shards,
+	 std::size_t shard_size,
+	 std::size_t table_size,
+	 typename Hash=std::hash<Key>,
+	 typename Equal=std::equal_to<Key>,
+	 typename Policy=LruCachePolicy>
+class ShardedCoCache {
+	[[no_unique_address]]
+	Factory factory;
+
+	using Cache_ = ShardedCache<Key, Data, n_shards, shard_size, table_size,
+				    Hash, Equal, Policy>;
+	Cache_ cache;
+
+	/**
+	 * Protects #requests, Request::handlers, Request::store and
+	 * Client::completed.  It may be held while locking a shard of
+	 * #cache, but not vice versa.
+	 */
+	std::mutex mutex;
+
+	struct Request;
+
+public:
+	class Client;
+
+private:
+	struct Handler : SafeLinkIntrusiveListHook {
+		ShardedCoCache &parent;
+
+		/**
+		 * The client which waits for this handler.  Only
+		 * valid while it is linked in Request::handlers or
+		 * Client::completed.
+		 */
+		Client *client = nullptr;
+
+		std::coroutine_handle<> continuation;
+
+		std::optional<Data> data;
+
+		std::exception_ptr error;
+
+		/**
+		 * Is #data or #error available?  Only accessed by the
+		 * client's thread.
+		 */
+		bool ready = false;
+
+		Handler(ShardedCoCache &_parent, Data &&_data) noexcept
+			:parent(_parent), data(std::move(_data)), ready(true) {}
+
+		Handler(ShardedCoCache &_parent, Client &_client,
+			Request &request) noexcept
+			:parent(_parent), client(&_client)
+		{
+			request.handlers.push_back(*this);
+		}
+
+		~Handler() noexcept {
+			if (!ready) {
+				const std::scoped_lock lock{parent.mutex};
+				if (is_linked())
+					unlink();
+			}
+		}
+
+		/**
+		 * Move this handler to its client's "completed" list
+		 * and wake up the client's thread.  The caller must
+		 * hold the mutex and must have unlinked this handler.
+		 */
+		void Complete() noexcept {
+			assert(client != nullptr);
+
+			client->completed.push_back(*this);
+			client->notify.Signal();
+		}
+	};
+
+public:
+	class Task {
+		std::unique_ptr<Handler> handler;
+
+	public:
+		explicit Task(std::unique_ptr<Handler> &&_handler) noexcept
+			:handler(std::move(_handler)) {}
+
+		auto operator co_await() noexcept {
+			struct Awaitable final {
+				Handler &handler;
+
+				bool await_ready() const noexcept {
+					return handler.ready;
+				}
+
+				void await_suspend(std::coroutine_handle<> _continuation) noexcept {
+					handler.continuation = _continuation;
+				}
+
+				Data &&await_resume() {
+					assert(handler.ready);
+
+					if (handler.error)
+						std::rethrow_exception(handler.error);
+
+					return std::move(*handler.data);
+				}
+			};
+
+			return Awaitable{*handler};
+		}
+	};
+
+	/**
+	 * The per-thread part of #ShardedCoCache.  All methods must be
+	 * called from the thread which runs the #EventLoop passed to
+	 * the constructor.
+	 */
+	class Client {
+		friend class ShardedCoCache;
+
+		ShardedCoCache &parent;
+
+		Notify notify;
+
+		/**
+		 * Handlers whose request has finished; they will be
+		 * resumed by OnNotify().  Protected by
+		 * ShardedCoCache::mutex.
+		 */
+		IntrusiveList<Handler> completed;
+
+	public:
+		Client(ShardedCoCache &_parent, EventLoop &event_loop) noexcept
+			:parent(_parent),
+			 notify(event_loop, BIND_THIS_METHOD(OnNotify)) {}
+
+		~Client() noexcept {
+			parent.RemoveClient(*this);
+		}
+
+		Client(const Client &) = delete;
+		Client &operator=(const Client &) = delete;
+
+		auto &GetEventLoop() const noexcept {
+			return notify.GetEventLoop();
+		}
+
+		template<typename K>
+		Task Get(K &&key) {
+			return parent.Get(*this, std::forward<K>(key));
+		}
+
+	private:
+		void OnNotify() noexcept {
+			while (true) {
+				Handler *handler;
+
+				{
+					const std::scoped_lock lock{parent.mutex};
+					if (completed.empty())
+						break;
+
+					handler = &completed.pop_front();
+				}
+
+				/* resuming may destroy other handlers
+				   (or this one), therefore they are
+				   popped one by one */
+				handler->ready = true;
+				if (handler->continuation)
+					handler->continuation.resume();
+			}
+		}
+	};
+
+private:
+	struct Request : IntrusiveListHook<IntrusiveHookMode::NORMAL> {
+		ShardedCoCache &parent;
+
+		/**
+		 * The client in whose thread the factory runs.
+		 */
+		Client &client;
+
+		const Key key;
+
+		/**
+		 * Protected by ShardedCoCache::mutex.
+		 */
+		IntrusiveList<Handler> handlers;
+
+		std::optional<Data> value;
+
+		Co::InvokeTask task;
+
+		/**
+		 * Shall the value be stored in the cache?  Protected
+		 * by ShardedCoCache::mutex.
+		 */
+		bool store = true;
+
+		template<typename K>
+		Request(ShardedCoCache &_parent, Client &_client, K &&_key) noexcept
+			:parent(_parent), client(_client),
+			 key(std::forward<K>(_key)) {}
+
+		Co::InvokeTask Run() {
+			value.emplace(co_await parent.factory(key));
+		}
+
+		void Start() noexcept {
+			assert(!task);
+
+			task = Run();
+			task.Start(BIND_THIS_METHOD(OnCompletion));
+		}
+
+		void OnCompletion(std::exception_ptr error) noexcept {
+			assert(!task);
+
+			parent.Finish(*this, std::move(error));
+			delete this;
+		}
+	};
+
+	/**
+	 * All pending requests.  Protected by #mutex.
+	 */
+	IntrusiveList<Request> requests;
+
+	template<typename K>
+	[[gnu::pure]]
+	Request *FindRequest(const K &key) noexcept {
+		for (auto &i : requests)
+			if (i.store && key_eq()(i.key, key))
+				return &i;
+
+		return nullptr;
+	}
+
+	template<typename K>
+	Task Get(Client &client, K &&key) {
+		assert(&client.parent == this);
+
+		if (auto value = cache.Get(key))
+			return Task{std::make_unique<Handler>(*this, std::move(*value))};
+
+		Request *request;
+		std::unique_ptr<Handler> handler;
+
+		{
+			const std::scoped_lock lock{mutex};
+
+			request = FindRequest(key);
+			if (request != nullptr)
+				return Task{std::make_unique<Handler>(*this, client, *request)};
+
+			/* another request may have finished after
+			   the first lookup */
+			if (auto value = cache.Get(key))
+				return Task{std::make_unique<Handler>(*this, std::move(*value))};
+
+			request = new Request(*this, client, std::forward<K>(key));
+			requests.push_back(*request);
+			handler = std::make_unique<Handler>(*this, client, *request);
+		}
+
+		/* the factory is invoked without holding the mutex,
+		   because it may finish synchronously */
+		request->Start();
+		return Task{std::move(handler)};
+	}
+
+	void Finish(Request &request, std::exception_ptr error) noexcept {
+		const std::scoped_lock lock{mutex};
+
+		if (!error && request.store) {
+			try {
+				cache.Put(request.key, *request.value);
+			} catch (...) {
+				/* ignore, this is just a cache */
+			}
+		}
+
+		requests.erase(requests.iterator_to(request));
+
+		request.handlers.clear_and_dispose([&request, &error](Handler *handler){
+			if (error) {
+				handler->error = error;
+			} else {
+				try {
+					handler->data.emplace(*request.value);
+				} catch (...) {
+					handler->error = std::current_exception();
+				}
+			}
+
+			handler->Complete();
+		});
+	}
+
+	void RemoveClient(Client &client) noexcept {
+		IntrusiveList<Request> canceled;
+
+		{
+			const std::scoped_lock lock{mutex};
+
+			/* this client's coroutines will never be
+			   resumed */
+			client.completed.clear();
+			for (auto &request : requests)
+				request.handlers.remove_and_dispose_if([&client](const Handler &handler){
+					return handler.client == &client;
+				}, [](Handler *){});
+
+			/* cancel the requests running in this
+			   client's thread; the other clients waiting
+			   for them get an error */
+			requests.remove_and_dispose_if([&client](const Request &request){
+				return &request.client == &client;
+			}, [&canceled](Request *request){
+				canceled.push_back(*request);
+			});
+
+			if (!canceled.empty()) {
+				const auto error = std::make_exception_ptr(std::runtime_error{"Cache loader canceled"});
+				for (auto &request : canceled)
+					request.handlers.clear_and_dispose([&error](Handler *handler){
+						handler->error = error;
+						handler->Complete();
+					});
+			}
+		}
+
+		/* destroy the coroutines without holding the
+		   mutex */
+		canceled.clear_and_dispose(DeleteDisposer{});
+	}
+
+public:
+	using hasher = typename Cache_::hasher;
+	using key_equal = typename Cache_::key_equal;
+
+	template<typename... P>
+	explicit ShardedCoCache(P&&... _params) noexcept
+		:factory(std::forward<P>(_params)...) {}
+
+	~ShardedCoCache() noexcept {
+		assert(requests.empty());
+	}
+
+	ShardedCoCache(const ShardedCoCache &) = delete;
+	ShardedCoCache &operator=(const ShardedCoCache &) = delete;
+
+	Factory &GetFactory() noexcept {
+		return factory;
+	}
+
+	decltype(auto) hash_function() const noexcept {
+		return cache.hash_function();
+	}
+
+	decltype(auto) key_eq() const noexcept {
+		return cache.key_eq();
+	}
+
+	/**
+	 * Look up a value in the cache (without invoking the
+	 * factory).  This method is thread-safe.
+	 */
+	template<typename K>
+	std::optional<Data> GetIfCached(const K &key) {
+		return cache.Get(key);
+	}
+
+	/**
+	 * Delete all cache items and mark all pending requests as
+	 * "don't store".  This method is thread-safe.
+	 */
+	void Clear() noexcept {
+		const std::scoped_lock lock{mutex};
+
+		cache.Clear();
+
+		for (auto &i : requests)
+			i.store = false;
+	}
+
+	/**
+	 * This method is thread-safe.
+	 */
+	template<typename K>
+	void Remove(const K &key) noexcept {
+		const std::scoped_lock lock{mutex};
+
+		for (auto &i : requests)
+			if (key_eq()(i.key, key))
+				i.store = false;
+
+		cache.Remove(key);
+	}
+
+	/**
+	 * This method is thread-safe.
+	 */
+	void RemoveIf(std::predicate<const Key &, const Data &> auto p) noexcept {
+		/* note: this method is unable to check pending
+		   requests, so unfortunately, pending requests may
+		   result in stale cache items */
+
+		cache.RemoveIf(p);
+	}
+};
@@ -5,9 +5,15 @@
 #include "Connection.hxx"
 #include "Handler.hxx"
 #include "Response.hxx"
+#include "ResponseCache.hxx"
+#include "event/Loop.hxx"
+#include "net/PeerCredentials.hxx"
 #include "translation/Protocol.hxx"
 #include "io/Logger.hxx"
 
+#include <algorithm>
+
+#include <limits.h> // for IOV_MAX
 #include <sys/socket.h>
 #include <unistd.h>
 #include <errno.h>
@@ -17,8 +23,12 @@ namespace Translation::Server {
 
 Connection::Connection(EventLoop &event_loop,
 		       Handler &_handler,
+		       ResponseCache *_cache,
 		       UniqueSocketDescriptor &&_fd) noexcept
-	:handler(_handler),
+	:handler(_handler), cache(_cache),
+	 peer(cache != nullptr
+	      ? ResponseCache::Peer::From(_fd.GetPeerCredentials())
+	      : ResponseCache::Peer{}),
 	 event(event_loop, BIND_THIS_METHOD(OnSocketReady), _fd.Release()),
 	 state(State::INIT),
 	 input(8192)
@@ -28,9 +38,6 @@ Connection::Connection(EventLoop &event_loop,
 
 Connection::~Connection() noexcept
 {
-	if (state == State::RESPONSE)
-		delete[] response;
-
 	if (cancel_ptr)
 		cancel_ptr.Cancel();
 
@@ -80,6 +87,16 @@ Connection::OnReceived() noexcept
 		if (r.size() < total_size)
 			break;
 
+		if (cache != nullptr) {
+			if (header->command == TranslationCommand::BEGIN)
+				request_packets.clear();
+
+			if (header->command != TranslationCommand::END)
+				request_packets.insert(request_packets.end(),
+						       r.begin(),
+						       std::next(r.begin(), total_size));
+		}
+
 		const auto payload = r.subspan(sizeof(*header),
 					       payload_length);
 		if (!OnPacket(header->command, payload))
@@ -122,6 +139,14 @@ Connection::OnPacket(TranslationCommand cmd,
 
 	if (cmd == TranslationCommand::END) [[unlikely]] {
 		state = State::PROCESSING;
+
+		if (cache != nullptr) {
+			const auto cached = cache->Get(request_packets, peer,
+						       event.GetEventLoop().SteadyNow());
+			if (!cached.empty())
+				return SendCachedResponse(cached);
+		}
+
 		return handler.OnTranslationRequest(*this, request, cancel_ptr);
 	}
 
@@ -141,7 +166,11 @@ Connection::TryWrite() noexcept
 {
 	assert(state == State::RESPONSE);
 
-	ssize_t nbytes = event.GetSocket().Send(output, MSG_DONTWAIT);
+	auto v = output.GetVector();
+	if (v.size() > IOV_MAX)
+		v = v.first(IOV_MAX);
+
+	ssize_t nbytes = event.GetSocket().Send(v, MSG_DONTWAIT);
 	if (nbytes < 0) {
 		if (errno == EAGAIN) [[likely]] {
 			event.ScheduleWrite();
@@ -153,10 +182,10 @@ Connection::TryWrite() noexcept
 		return false;
 	}
 
-	output = output.subspan(nbytes);
+	output.Consume(nbytes);
 
 	if (output.empty()) {
-		delete[] response;
+		output = {};
 		state = State::INIT;
 		event.CancelWrite();
 	}
@@ -170,10 +199,26 @@ Connection::SendResponse(Response &&_response) noexcept
 	assert(state == State::PROCESSING);
 
 	state = State::RESPONSE;
-	output = _response.Finish();
-	response = output.data();
+	output = _response.FinishVector();
 	cancel_ptr = nullptr;
 
+	if (cache != nullptr)
+		cache->Put(request_packets, peer, output.GetVector(),
+			   event.GetEventLoop().SteadyNow());
+
+	return TryWrite();
+}
+
+inline bool
+Connection::SendCachedResponse(std::span<const std::byte> src) noexcept
+{
+	assert(state == State::PROCESSING);
+
+	/* copy the response because the cache item may be evicted
+	   while we're still sending it */
+	output = FinishedResponse{AllocatedArray<std::byte>{src}};
+	state = State::RESPONSE;
+
 	return TryWrite();
 }
 
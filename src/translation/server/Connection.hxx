@@ -10,8 +10,11 @@
 #include "util/Cancellable.hxx"
 #include "util/IntrusiveList.hxx"
 #include "AllocatedRequest.hxx"
+#include "FinishedResponse.hxx"
+#include "ResponseCache.hxx"
 
 #include <span>
+#include <vector>
 
 enum class TranslationCommand : uint16_t;
 
@@ -26,6 +29,14 @@ class Connection : AutoUnlinkIntrusiveListHook
 
 	Handler &handler;
 
+	ResponseCache *const cache;
+
+	/**
+	 * The identity of the client, part of the #cache key.  Only
+	 * used if #cache is set.
+	 */
+	const ResponseCache::Peer peer;
+
 	SocketEvent event;
 
 	enum class State {
@@ -39,19 +50,28 @@ class Connection : AutoUnlinkIntrusiveListHook
 
 	AllocatedRequest request;
 
+	/**
+	 * A copy of all packets of the current request (without
+	 * END), used as key for the #cache.  Only used if #cache is
+	 * set.
+	 */
+	std::vector<std::byte> request_packets;
+
 	/**
          * If this is set, then our #handler is currently handling the
          * #request.
 	 */
 	CancellablePointer cancel_ptr{nullptr};
 
-	std::byte *response;
-
-	std::span<std::byte> output;
+	/**
+	 * The response currently being sent (#State::RESPONSE).
+	 */
+	FinishedResponse output;
 
 public:
 	Connection(EventLoop &event_loop,
 		   Handler &_handler,
+		   ResponseCache *_cache,
 		   UniqueSocketDescriptor &&_fd) noexcept;
 	~Connection() noexcept;
 
@@ -70,6 +90,13 @@ private:
 	bool OnPacket(TranslationCommand cmd,
 		      std::span<const std::byte> payload) noexcept;
 
+	/**
+	 * Send a copy of the given (cached) response.
+	 *
+	 * @return false if this object has been destroyed
+	 */
+	bool SendCachedResponse(std::span<const std::byte> src) noexcept;
+
 	/**
 	 * @return false if this object has been destroyed
 	 */
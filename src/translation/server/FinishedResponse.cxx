@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "FinishedResponse.hxx"
+#include "io/Iovec.hxx"
+
+#include <cassert>
+
+namespace Translation::Server {
+
+FinishedResponse::FinishedResponse(AllocatedArray<std::byte> &&src) noexcept
+{
+	vector.emplace_back(MakeIovec(std::span<const std::byte>{src}));
+	owned.emplace_back(std::move(src));
+}
+
+void
+FinishedResponse::Consume(std::size_t nbytes) noexcept
+{
+	while (nbytes > 0) {
+		assert(position < vector.size());
+
+		auto &i = vector[position];
+		if (nbytes < i.iov_len) {
+			i.iov_base = static_cast<std::byte *>(i.iov_base) + nbytes;
+			i.iov_len -= nbytes;
+			return;
+		}
+
+		nbytes -= i.iov_len;
+		++position;
+	}
+}
+
+} // namespace Translation::Server
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "util/AllocatedArray.hxx"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <sys/uio.h>
+
+namespace Translation::Server {
+
+/**
+ * A finished translation response (see Response::FinishVector())
+ * as a list of buffers which can be passed to writev()/sendmsg().
+ * This object owns the #Response buffer and all payloads which were
+ * passed to Response::ExternalPacket() by value; payloads passed by
+ * reference are owned by the #Handler.
+ */
+class FinishedResponse {
+	std::unique_ptr<std::byte[]> buffer;
+
+	std::vector<AllocatedArray<std::byte>> owned;
+
+	std::vector<struct iovec> vector;
+
+	/**
+	 * The index of the first #vector element which has not yet
+	 * been consumed.
+	 */
+	std::size_t position = 0;
+
+public:
+	FinishedResponse() noexcept = default;
+
+	FinishedResponse(std::unique_ptr<std::byte[]> &&_buffer,
+			 std::vector<AllocatedArray<std::byte>> &&_owned,
+			 std::vector<struct iovec> &&_vector) noexcept
+		:buffer(std::move(_buffer)), owned(std::move(_owned)),
+		 vector(std::move(_vector)) {}
+
+	/**
+	 * Construct an instance from a contiguous buffer (e.g. a
+	 * copy of a cached response).
+	 */
+	explicit FinishedResponse(AllocatedArray<std::byte> &&src) noexcept;
+
+	FinishedResponse(FinishedResponse &&) noexcept = default;
+	FinishedResponse &operator=(FinishedResponse &&) noexcept = default;
+
+	bool empty() const noexcept {
+		return position == vector.size();
+	}
+
+	/**
+	 * Returns the buffers which have not yet been consumed.
+	 */
+	std::span<const struct iovec> GetVector() const noexcept {
+		return std::span{vector}.subspan(position);
+	}
+
+	/**
+	 * Mark the given number of bytes as consumed (i.e. sent).
+	 */
+	void Consume(std::size_t nbytes) noexcept;
+};
+
+} // namespace Translation::Server
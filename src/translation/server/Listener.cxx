@@ -26,7 +26,8 @@ Listener::OnAccept(UniqueSocketDescriptor new_fd,
 		   SocketAddress) noexcept
 {
 	auto *connection = new Connection(GetEventLoop(),
-					  handler, std::move(new_fd));
+					  handler, cache.get(),
+					  std::move(new_fd));
 	connections.push_back(*connection);
 }
 
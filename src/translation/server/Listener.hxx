@@ -4,9 +4,13 @@
 
 #pragma once
 
+#include "ResponseCache.hxx"
 #include "event/net/ServerSocket.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <cassert>
+#include <memory>
+
 namespace Translation::Server {
 
 class Handler;
@@ -15,6 +19,8 @@ class Connection;
 class Listener final : private ServerSocket {
 	Handler &handler;
 
+	std::unique_ptr<ResponseCache> cache;
+
 	IntrusiveList<Connection> connections;
 
 public:
@@ -25,6 +31,21 @@ public:
 	using ServerSocket::Listen;
 	using ServerSocket::ListenPath;
 
+	/**
+	 * Enable the #ResponseCache for all new connections.  This
+	 * may be called only once (connections keep a pointer to the
+	 * cache).
+	 */
+	void EnableResponseCache(const ResponseCache::Config &config) noexcept {
+		assert(!cache);
+
+		cache = std::make_unique<ResponseCache>(config);
+	}
+
+	ResponseCache *GetResponseCache() const noexcept {
+		return cache.get();
+	}
+
 private:
 	void OnAccept(UniqueSocketDescriptor fd,
 		      SocketAddress address) noexcept override;
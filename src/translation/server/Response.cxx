@@ -3,6 +3,8 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "Response.hxx"
+#include "FinishedResponse.hxx"
+#include "io/Iovec.hxx"
 
 #include <algorithm>
 #include <numeric>
@@ -24,6 +26,16 @@ Response::Grow(std::size_t new_capacity) noexcept
 	capacity = new_capacity;
 }
 
+void
+Response::Reserve(std::size_t nbytes) noexcept
+{
+	assert(size <= capacity);
+
+	const std::size_t new_size = size + nbytes;
+	if (new_size > capacity)
+		Grow(new_size);
+}
+
 void *
 Response::Write(std::size_t nbytes) noexcept
 {
@@ -31,7 +43,10 @@ Response::Write(std::size_t nbytes) noexcept
 
 	const std::size_t new_size = size + nbytes;
 	if (new_size > capacity)
-		Grow(((new_size - 1) | 0x7fff) + 1);
+		/* grow exponentially to avoid quadratic copying
+		   for large responses */
+		Grow(std::max(((new_size - 1) | 0x7fff) + 1,
+			      capacity * 2));
 
 	void *result = buffer + size;
 	size = new_size;
@@ -48,6 +63,32 @@ Response::WriteHeader(TranslationCommand cmd, std::size_t payload_size) noexcept
 	return mempcpy(p, &header, sizeof(header));
 }
 
+void *
+Response::WriteExternalHeader(TranslationCommand cmd, std::size_t head_size,
+			      std::span<const std::byte> tail) noexcept
+{
+	assert(head_size + tail.size() <= 0xffff);
+
+	const TranslationHeader header{uint16_t(head_size + tail.size()), cmd};
+	void *p = Write(sizeof(header) + head_size);
+	p = mempcpy(p, &header, sizeof(header));
+
+	/* the tail is inserted right after the head */
+	external.push_back({size, tail});
+	return p;
+}
+
+void *
+Response::WriteExternalHeader(TranslationCommand cmd, std::size_t head_size,
+			      AllocatedArray<std::byte> &&tail) noexcept
+{
+	/* the AllocatedArray's buffer does not move when the
+	   AllocatedArray instance is moved */
+	owned.emplace_back(std::move(tail));
+	return WriteExternalHeader(cmd, head_size,
+				   std::span<const std::byte>{owned.back()});
+}
+
 Response &
 Response::Packet(TranslationCommand cmd, std::span<const std::byte> payload) noexcept
 {
@@ -56,8 +97,30 @@ Response::Packet(TranslationCommand cmd, std::span<const std::byte> payload) noe
 	return *this;
 }
 
-std::span<std::byte>
-Response::Finish() noexcept
+Response &
+Response::ExternalPacket(TranslationCommand cmd,
+			 std::span<const std::byte> payload) noexcept
+{
+	if (payload.size() < MIN_EXTERNAL_SIZE)
+		return Packet(cmd, payload);
+
+	WriteExternalHeader(cmd, 0, payload);
+	return *this;
+}
+
+Response &
+Response::ExternalPacket(TranslationCommand cmd,
+			 AllocatedArray<std::byte> &&payload) noexcept
+{
+	if (payload.size() < MIN_EXTERNAL_SIZE)
+		return Packet(cmd, std::span<const std::byte>{payload});
+
+	WriteExternalHeader(cmd, 0, std::move(payload));
+	return *this;
+}
+
+inline void
+Response::WriteTrailer() noexcept
 {
 	/* generate a VARY packet? */
 	std::size_t n_vary = std::accumulate(vary.begin(), vary.end(), 0,
@@ -72,6 +135,40 @@ Response::Finish() noexcept
 	}
 
 	Packet(TranslationCommand::END);
+}
+
+std::span<std::byte>
+Response::Finish() noexcept
+{
+	WriteTrailer();
+
+	if (!external.empty()) {
+		/* copy everything into one buffer */
+		const std::size_t total_size =
+			std::accumulate(external.begin(), external.end(), size,
+					[](std::size_t a, const External &e){
+						return a + e.payload.size();
+					});
+
+		std::byte *const new_buffer = new std::byte[total_size];
+		std::byte *dest = new_buffer;
+		std::size_t position = 0;
+
+		for (const auto &e : external) {
+			dest = std::copy(buffer + position, buffer + e.offset, dest);
+			dest = std::copy(e.payload.begin(), e.payload.end(), dest);
+			position = e.offset;
+		}
+
+		std::copy(buffer + position, buffer + size, dest);
+
+		delete[] buffer;
+		buffer = new_buffer;
+		size = total_size;
+
+		external.clear();
+		owned.clear();
+	}
 
 	std::span<std::byte> result{buffer, size};
 	buffer = nullptr;
@@ -79,4 +176,35 @@ Response::Finish() noexcept
 	return result;
 }
 
+FinishedResponse
+Response::FinishVector() noexcept
+{
+	WriteTrailer();
+
+	std::vector<struct iovec> vector;
+	vector.reserve(external.size() * 2 + 1);
+
+	std::size_t position = 0;
+	for (const auto &e : external) {
+		if (e.offset > position)
+			vector.emplace_back(MakeIovec(std::span{buffer + position, buffer + e.offset}));
+		vector.emplace_back(MakeIovec(e.payload));
+		position = e.offset;
+	}
+
+	/* this is never empty because it contains at least the END
+	   packet */
+	assert(size > position);
+	vector.emplace_back(MakeIovec(std::span{buffer + position, buffer + size}));
+
+	external.clear();
+	capacity = size = 0;
+
+	return {
+		std::unique_ptr<std::byte[]>{std::exchange(buffer, nullptr)},
+		std::move(owned),
+		std::move(vector),
+	};
+}
+
 } // namespace Translation::Server
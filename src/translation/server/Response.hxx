@@ -7,6 +7,7 @@
 #include "../Protocol.hxx"
 #include "http/Status.hxx"
 #include "net/SocketAddress.hxx"
+#include "util/AllocatedArray.hxx"
 
 #include <array>
 #include <chrono>
@@ -16,11 +17,14 @@
 #include <span>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include <string.h>
 
 namespace Translation::Server {
 
+class FinishedResponse;
+
 /* This class is at namespace scope, because clang has a bug that prevents us from moving
    it into the Response or MountNamespaceContext class:
    https://github.com/llvm/llvm-project/issues/36032 */
@@ -33,6 +37,27 @@ class Response {
 	std::byte *buffer = nullptr;
 	std::size_t capacity = 0, size = 0;
 
+	/**
+	 * A payload which was added with ExternalPacket() and is not
+	 * copied to #buffer.
+	 */
+	struct External {
+		/**
+		 * The position in #buffer where this payload is
+		 * inserted (i.e. right after its packet header).
+		 */
+		std::size_t offset;
+
+		std::span<const std::byte> payload;
+	};
+
+	std::vector<External> external;
+
+	/**
+	 * Payloads which were passed to ExternalPacket() by value.
+	 */
+	std::vector<AllocatedArray<std::byte>> owned;
+
 	enum VaryIndex {
 		PARAM,
 		SESSION,
@@ -66,16 +91,43 @@ class Response {
 	std::array<bool, vary_cmds.size()> vary{};
 
 public:
+	/**
+	 * Returns the list of commands which may appear in the VARY
+	 * packet generated by this class.
+	 */
+	static constexpr std::span<const TranslationCommand> GetVaryCommands() noexcept {
+		return vary_cmds;
+	}
+
+	/**
+	 * Payloads smaller than this are copied by ExternalPacket()
+	 * because a separate #iovec would cost more than the copy.
+	 */
+	static constexpr std::size_t MIN_EXTERNAL_SIZE = 1024;
+
 	Response() noexcept
 	{
-		static constexpr uint8_t protocol_version = 3;
-		PacketT(TranslationCommand::BEGIN, protocol_version);
+		WriteBegin();
+	}
+
+	/**
+	 * Construct an instance with a buffer which is large enough
+	 * for the given number of bytes (excluding BEGIN), so no
+	 * reallocation is necessary if the estimate is correct.  Use
+	 * GetPacketSize() to calculate the estimate.
+	 */
+	explicit Response(std::size_t size_hint) noexcept
+	{
+		Reserve(GetPacketSize(sizeof(uint8_t)) + size_hint);
+		WriteBegin();
 	}
 
 	Response(Response &&other) noexcept
 		:buffer(std::exchange(other.buffer, nullptr)),
 		 capacity(other.capacity),
 		 size(other.size),
+		 external(std::move(other.external)),
+		 owned(std::move(other.owned)),
 		 vary(other.vary) {}
 
 	~Response() noexcept {
@@ -87,22 +139,38 @@ public:
 		swap(buffer, src.buffer);
 		swap(capacity, src.capacity);
 		swap(size, src.size);
+		swap(external, src.external);
+		swap(owned, src.owned);
 		swap(vary, src.vary);
 		return *this;
 	}
 
+	/**
+	 * Calculate the number of bytes occupied by a packet with the
+	 * given payload size.
+	 */
+	static constexpr std::size_t GetPacketSize(std::size_t payload_size) noexcept {
+		return sizeof(TranslationHeader) + payload_size;
+	}
+
+	/**
+	 * Make sure the buffer has room for at least the given
+	 * number of additional bytes.
+	 */
+	void Reserve(std::size_t nbytes) noexcept;
+
 	/**
 	 * An opaque type for Mark() and Revert().
 	 */
 	struct Marker {
-		std::size_t size;
+		std::size_t size, n_external, n_owned;
 	};
 
 	/**
 	 * Returns an opaque marker for later use with Revert().
 	 */
 	Marker Mark() const noexcept {
-		return {size};
+		return {size, external.size(), owned.size()};
 	}
 
 	/**
@@ -111,6 +179,8 @@ public:
 	 */
 	void Revert(Marker m) noexcept {
 		size = m.size;
+		external.resize(m.n_external);
+		owned.resize(m.n_owned);
 	}
 
 	auto &VaryParam() noexcept {
@@ -204,6 +274,50 @@ public:
 		return Packet(cmd, static_cast<std::span<const std::byte>>(address));
 	}
 
+	/**
+	 * Append a packet without copying the payload; it will be
+	 * sent directly from the given buffer (unless it is small).
+	 * The payload must remain valid until the #FinishedResponse
+	 * has been destroyed, which is only guaranteed for data that
+	 * lives as long as the translation server (e.g. configuration
+	 * data); everything else should be passed by value.
+	 */
+	Response &ExternalPacket(TranslationCommand cmd,
+				 std::span<const std::byte> payload) noexcept;
+
+	/**
+	 * Append a packet, taking over ownership of the payload
+	 * buffer instead of copying it.
+	 */
+	Response &ExternalPacket(TranslationCommand cmd,
+				 AllocatedArray<std::byte> &&payload) noexcept;
+
+	/**
+	 * Append a packet whose payload is a concatenation of all
+	 * string parameters (which are copied) followed by the given
+	 * tail, whose buffer is taken over instead of being copied
+	 * (unless it is small).
+	 */
+	template<typename... Params>
+	Response &ExternalStringPacket(TranslationCommand cmd,
+				       AllocatedArray<std::byte> &&tail,
+				       Params... head) noexcept {
+		const std::size_t head_length =
+			(std::size_t{0} + ... + GetParamLength(head));
+
+		if (tail.size() < MIN_EXTERNAL_SIZE) {
+			void *p = WriteHeader(cmd, head_length + tail.size());
+			p = WriteStringParams(p, head...);
+			memcpy(p, tail.data(), tail.size());
+		} else {
+			void *p = WriteExternalHeader(cmd, head_length,
+						      std::move(tail));
+			WriteStringParams(p, head...);
+		}
+
+		return *this;
+	}
+
 	/**
 	 * Append a packet by copying the raw bytes of an object.
 	 */
@@ -907,6 +1021,20 @@ public:
 			return *this;
 		}
 
+		/**
+		 * Like the other overload, but take over the
+		 * contents buffer instead of copying it.
+		 */
+		template<typename P>
+		auto WriteFile(P &&path,
+			       AllocatedArray<std::byte> &&contents) noexcept {
+			response.ExternalStringPacket(TranslationCommand::WRITE_FILE,
+						      std::move(contents),
+						      std::forward<P>(path),
+						      std::string_view{"", 1});
+			return *this;
+		}
+
 		template<typename T, typename L>
 		auto Symlink(T &&target, L &&linkpath) noexcept {
 			response.StringPacket(TranslationCommand::SYMLINK,
@@ -1785,15 +1913,54 @@ public:
 		return Packet(TranslationCommand::ACCEPT_HTTP);
 	}
 
+	/**
+	 * Finish the response and return it as one contiguous
+	 * buffer.  The caller is responsible for freeing it with
+	 * delete[].  External payloads are copied.
+	 */
 	std::span<std::byte> Finish() noexcept;
 
+	/**
+	 * Finish the response and return it as a list of buffers
+	 * for writev(), without copying external payloads.
+	 */
+	FinishedResponse FinishVector() noexcept;
+
 private:
+	void WriteBegin() noexcept {
+		static constexpr uint8_t protocol_version = 3;
+		PacketT(TranslationCommand::BEGIN, protocol_version);
+	}
+
+	/**
+	 * Append the VARY (if applicable) and END packets.
+	 */
+	void WriteTrailer() noexcept;
+
 	void Grow(std::size_t new_capacity) noexcept;
 	void *Write(std::size_t nbytes) noexcept;
 
 	void *WriteHeader(TranslationCommand cmd,
 			  std::size_t payload_size) noexcept;
 
+	/**
+	 * Write a packet header and reserve room for the first
+	 * #head_size payload bytes (to be filled by the caller); the
+	 * rest of the payload is #tail, which is not copied.
+	 *
+	 * @return a pointer to the head
+	 */
+	void *WriteExternalHeader(TranslationCommand cmd,
+				  std::size_t head_size,
+				  std::span<const std::byte> tail) noexcept;
+
+	/**
+	 * Like the other overload, but take over the tail buffer.
+	 */
+	void *WriteExternalHeader(TranslationCommand cmd,
+				  std::size_t head_size,
+				  AllocatedArray<std::byte> &&tail) noexcept;
+
 	static constexpr std::size_t GetParamLength(std::span<const std::byte> src) noexcept {
 		return src.size();
 	}
@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "ResponseCache.hxx"
+#include "Response.hxx"
+#include "translation/Protocol.hxx"
+#include "io/Iovec.hxx"
+#include "net/PeerCredentials.hxx"
+#include "util/SpanCast.hxx"
+
+#include <algorithm>
+#include <new> // for std::bad_alloc
+#include <optional>
+#include <string>
+
+#include <string.h>
+
+namespace Translation::Server {
+
+/**
+ * Invoke a function for each packet in the given buffer.  The
+ * function receives the command, the payload and the whole packet
+ * (including the header).  Stops at the first malformed packet.
+ */
+static void
+ForEachPacket(std::span<const std::byte> src, auto &&f) noexcept
+{
+	while (src.size() >= sizeof(TranslationHeader)) {
+		TranslationHeader header;
+		memcpy(&header, src.data(), sizeof(header));
+
+		const std::size_t total_size = sizeof(header) + header.length;
+		if (src.size() < total_size)
+			break;
+
+		f(header.command, src.subspan(sizeof(header), header.length),
+		  src.first(total_size));
+		src = src.subspan(total_size);
+	}
+}
+
+/**
+ * Like the other overload, but the packets are scattered over a list
+ * of buffers (see Response::FinishVector()).  Payloads are passed
+ * without copying unless they cross a buffer boundary (which
+ * FinishVector() never does).
+ */
+static void
+ForEachPacket(std::span<const struct iovec> src, auto &&f)
+{
+	std::span<const std::byte> current{};
+	std::string scratch;
+
+	/* copy the given number of bytes to the destination (if not
+	   nullptr) and consume them */
+	const auto read = [&](std::byte *dest, std::size_t n) noexcept {
+		while (n > 0) {
+			while (current.empty()) {
+				if (src.empty())
+					return false;
+
+				current = ToSpan(src.front());
+				src = src.subspan(1);
+			}
+
+			const std::size_t chunk = std::min(n, current.size());
+			if (dest != nullptr)
+				dest = std::copy_n(current.begin(), chunk, dest);
+			current = current.subspan(chunk);
+			n -= chunk;
+		}
+
+		return true;
+	};
+
+	while (true) {
+		TranslationHeader header;
+		if (!read(reinterpret_cast<std::byte *>(&header), sizeof(header)))
+			break;
+
+		/* the next buffer may start with the payload */
+		if (current.empty() && header.length > 0 && !src.empty()) {
+			current = ToSpan(src.front());
+			src = src.subspan(1);
+		}
+
+		std::span<const std::byte> payload;
+		if (current.size() >= header.length) {
+			payload = current.first(header.length);
+			current = current.subspan(header.length);
+		} else {
+			/* the payload crosses a buffer boundary */
+			scratch.resize(header.length);
+			auto *dest = reinterpret_cast<std::byte *>(scratch.data());
+			if (!read(dest, header.length))
+				break;
+
+			payload = {dest, header.length};
+		}
+
+		f(header.command, payload);
+	}
+}
+
+/**
+ * @return the index in Response::vary_cmds or -1 if this command
+ * cannot be used in a VARY packet
+ */
+[[gnu::const]]
+static int
+VaryIndex(TranslationCommand command) noexcept
+{
+	const auto cmds = Response::GetVaryCommands();
+	const auto i = std::find(cmds.begin(), cmds.end(), command);
+	return i != cmds.end() ? static_cast<int>(std::distance(cmds.begin(), i)) : -1;
+}
+
+struct CacheControl {
+	std::optional<uint32_t> max_age;
+
+	unsigned vary_mask = 0;
+
+	bool cacheable = true;
+};
+
+static void
+ApplyCacheControlPacket(CacheControl &cc, TranslationCommand command,
+			std::span<const std::byte> payload) noexcept
+{
+	switch (command) {
+	case TranslationCommand::MAX_AGE:
+		if (payload.size() == sizeof(uint32_t)) {
+			uint32_t value;
+			memcpy(&value, payload.data(), sizeof(value));
+			cc.max_age = value;
+		}
+
+		break;
+
+	case TranslationCommand::VARY:
+		for (std::size_t i = 0; i + sizeof(TranslationCommand) <= payload.size();
+		     i += sizeof(TranslationCommand)) {
+			TranslationCommand vary;
+			memcpy(&vary, payload.data() + i, sizeof(vary));
+
+			const int index = VaryIndex(vary);
+			if (index < 0)
+				/* we don't know how to interpret
+				   this one */
+				cc.cacheable = false;
+			else
+				cc.vary_mask |= 1U << index;
+		}
+
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ * Parse the response packets which control caching.  Accepts a
+ * contiguous buffer or a list of buffers.
+ */
+static CacheControl
+ParseCacheControl(const auto &response)
+{
+	CacheControl cc;
+
+	ForEachPacket(response, [&cc](TranslationCommand command,
+				      std::span<const std::byte> payload,
+				      auto &&...){
+		ApplyCacheControlPacket(cc, command, payload);
+	});
+
+	return cc;
+}
+
+ResponseCache::Peer
+ResponseCache::Peer::From(const SocketPeerCredentials &cred) noexcept
+{
+	if (!cred.IsDefined())
+		return {UINT_LEAST32_MAX, UINT_LEAST32_MAX};
+
+	return {
+		static_cast<uint_least32_t>(cred.GetUid()),
+		static_cast<uint_least32_t>(cred.GetGid()),
+	};
+}
+
+ResponseCache::ResponseCache(const Config &config) noexcept
+	:default_ttl(config.default_ttl), max_ttl(config.max_ttl),
+	 cache(config.max_size)
+{
+}
+
+ResponseCache::~ResponseCache() noexcept = default;
+
+void
+ResponseCache::BuildKey(std::span<const std::byte> request, Peer peer,
+			unsigned vary_mask)
+{
+	key_buffer.clear();
+
+	const uint_least16_t mask16 = vary_mask;
+	key_buffer.append(ToStringView(ReferenceAsBytes(mask16)));
+	key_buffer.append(ToStringView(ReferenceAsBytes(peer.uid)));
+	key_buffer.append(ToStringView(ReferenceAsBytes(peer.gid)));
+
+	ForEachPacket(request, [this, vary_mask](TranslationCommand command,
+						 std::span<const std::byte>,
+						 std::span<const std::byte> packet){
+		const int index = VaryIndex(command);
+		if (index < 0 || (vary_mask & (1U << index)) != 0)
+			key_buffer.append(ToStringView(packet));
+	});
+}
+
+void
+ResponseCache::AddVaryMask(unsigned vary_mask) noexcept
+{
+	auto i = std::find(vary_masks.begin(), vary_masks.end(), vary_mask);
+	if (i == vary_masks.end()) {
+		if (vary_masks.full()) {
+			/* forget the least recently used mask and
+			   all items using it (which are unreachable
+			   now) */
+			const unsigned old_mask = vary_masks.back();
+			vary_masks.pop_back();
+			cache.RemoveIf([old_mask](const Item &item){
+				return item.vary_mask == old_mask;
+			});
+		}
+
+		vary_masks.push_back(vary_mask);
+		i = std::prev(vary_masks.end());
+	}
+
+	/* move it to the front */
+	std::rotate(vary_masks.begin(), i, std::next(i));
+}
+
+std::span<const std::byte>
+ResponseCache::Get(std::span<const std::byte> request, Peer peer,
+		   Event::TimePoint now) noexcept
+try {
+	for (const unsigned vary_mask : vary_masks) {
+		BuildKey(request, peer, vary_mask);
+
+		Item *item = cache.Get(std::string_view{key_buffer});
+		if (item == nullptr)
+			continue;
+
+		if (now >= item->expires) {
+			/* a response with another VARY mask may
+			   still be fresh */
+			cache.RemoveItem(*item);
+			continue;
+		}
+
+		++stats.hits;
+		return item->response;
+	}
+
+	++stats.misses;
+	return {};
+} catch (const std::bad_alloc &) {
+	++stats.misses;
+	return {};
+}
+
+/**
+ * Determine how long a response may be cached.
+ *
+ * @return the duration or zero if the response must not be cached
+ */
+static Event::Duration
+GetTtl(const CacheControl &cc,
+       Event::Duration default_ttl, Event::Duration max_ttl) noexcept
+{
+	if (!cc.cacheable)
+		return Event::Duration::zero();
+
+	Event::Duration ttl = cc.max_age
+		? std::chrono::seconds{*cc.max_age}
+		: default_ttl;
+	if (ttl > max_ttl)
+		ttl = max_ttl;
+
+	return ttl;
+}
+
+inline void
+ResponseCache::Store(std::span<const std::byte> request, Peer peer,
+		     AllocatedArray<std::byte> &&response,
+		     unsigned vary_mask, Event::TimePoint expires)
+{
+	BuildKey(request, peer, vary_mask);
+
+	auto *item = new Item(key_buffer, request, std::move(response),
+			      expires, vary_mask);
+
+	AddVaryMask(vary_mask);
+	cache.Put(*item);
+	++stats.stores;
+}
+
+void
+ResponseCache::Put(std::span<const std::byte> request, Peer peer,
+		   std::span<const std::byte> response,
+		   Event::TimePoint now) noexcept
+try {
+	const auto cc = ParseCacheControl(response);
+	const auto ttl = GetTtl(cc, default_ttl, max_ttl);
+	if (ttl <= Event::Duration::zero())
+		return;
+
+	Store(request, peer, AllocatedArray<std::byte>{response},
+	      cc.vary_mask, now + ttl);
+} catch (const std::bad_alloc &) {
+	/* out of memory: don't cache this response */
+}
+
+void
+ResponseCache::Put(std::span<const std::byte> request, Peer peer,
+		   std::span<const struct iovec> response,
+		   Event::TimePoint now) noexcept
+try {
+	/* parse the fragments in place; most responses are not
+	   cacheable, and those are not copied at all */
+	const auto cc = ParseCacheControl(response);
+	const auto ttl = GetTtl(cc, default_ttl, max_ttl);
+	if (ttl <= Event::Duration::zero())
+		return;
+
+	/* copy the fragments into one contiguous buffer */
+	std::size_t size = 0;
+	for (const auto &i : response)
+		size += i.iov_len;
+
+	AllocatedArray<std::byte> flat{size};
+	std::byte *dest = flat.data();
+	for (const auto &i : response)
+		dest = std::copy_n(static_cast<const std::byte *>(i.iov_base),
+				   i.iov_len, dest);
+
+	Store(request, peer, std::move(flat), cc.vary_mask, now + ttl);
+} catch (const std::bad_alloc &) {
+	/* out of memory: don't cache this response */
+}
+
+void
+ResponseCache::Flush() noexcept
+{
+	cache.clear();
+	vary_masks.clear();
+}
+
+void
+ResponseCache::Invalidate(TranslationCommand command,
+			  std::span<const std::byte> payload) noexcept
+{
+	cache.RemoveIf([command, payload](const Item &item){
+		bool match = false;
+
+		ForEachPacket(AsBytes(item.request), [&match, command, payload](TranslationCommand c,
+										 std::span<const std::byte> p,
+										 std::span<const std::byte>){
+			if (c == command && std::ranges::equal(p, payload))
+				match = true;
+		});
+
+		return match;
+	});
+}
+
+} // namespace Translation::Server
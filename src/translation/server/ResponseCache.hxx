@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "event/Chrono.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/IntrusiveCache.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StaticVector.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+struct iovec;
+class SocketPeerCredentials;
+enum class TranslationCommand : uint16_t;
+
+namespace Translation::Server {
+
+/**
+ * A cache for finished translation responses (the wire format
+ * generated by Response::Finish()), which allows replaying a
+ * response to an identical request without invoking the #Handler.
+ *
+ * The cache key consists of all request packets which the
+ * #Response cannot declare in a VARY packet, plus those "varyable"
+ * packets which were listed in the VARY packet of the response.
+ * Responses with a VARY on a command which this class does not
+ * know are not cached.
+ *
+ * Responses are only shared between peers with the same identity
+ * (see #Peer), because a #Handler may generate different responses
+ * depending on who is asking.
+ *
+ * This class is not thread-safe.
+ */
+class ResponseCache {
+public:
+	struct Config {
+		/**
+		 * The maximum total size of all cached requests and
+		 * responses [bytes].
+		 */
+		std::size_t max_size = 4 * 1024 * 1024;
+
+		/**
+		 * The time to live for responses without a MAX_AGE
+		 * packet.  Zero means such responses are not cached.
+		 */
+		Event::Duration default_ttl{};
+
+		/**
+		 * An upper limit for MAX_AGE.
+		 */
+		Event::Duration max_ttl = std::chrono::hours{1};
+	};
+
+	struct Stats {
+		std::size_t hits, misses, stores;
+	};
+
+	/**
+	 * The identity of the client, which is part of the cache
+	 * key.  The process id is deliberately not included, so all
+	 * processes of a client (which run with the same uid/gid)
+	 * share the cached responses.
+	 */
+	struct Peer {
+		uint_least32_t uid, gid;
+
+		/**
+		 * Construct from the credentials of a (local) socket
+		 * peer.  All peers with undefined credentials share
+		 * one identity.
+		 */
+		[[gnu::pure]]
+		static Peer From(const SocketPeerCredentials &cred) noexcept;
+	};
+
+private:
+	struct Item final : IntrusiveCacheHook {
+		/**
+		 * The key (see BuildKey()).
+		 */
+		const std::string key;
+
+		/**
+		 * All request packets; needed by Invalidate() to match
+		 * packets which are not part of the key.
+		 */
+		const std::string request;
+
+		const AllocatedArray<std::byte> response;
+
+		const Event::TimePoint expires;
+
+		const unsigned vary_mask;
+
+		/**
+		 * Throws std::bad_alloc on error.
+		 */
+		Item(std::string_view _key, std::span<const std::byte> _request,
+		     AllocatedArray<std::byte> &&_response,
+		     Event::TimePoint _expires, unsigned _vary_mask)
+			:key(_key), request(ToStringView(_request)),
+			 response(std::move(_response)),
+			 expires(_expires), vary_mask(_vary_mask) {}
+	};
+
+	struct ItemGetKey {
+		std::string_view operator()(const Item &item) const noexcept {
+			return item.key;
+		}
+	};
+
+	struct ItemGetSize {
+		std::size_t operator()(const Item &item) const noexcept {
+			return sizeof(item) + item.key.size() +
+				item.request.size() + item.response.size();
+		}
+	};
+
+	const Event::Duration default_ttl, max_ttl;
+
+	IntrusiveCache<Item, 4096,
+		       IntrusiveCacheOperators<Item, ItemGetKey,
+					       std::hash<std::string_view>,
+					       std::equal_to<std::string_view>,
+					       ItemGetSize, DeleteDisposer>> cache;
+
+	/**
+	 * The VARY masks (bit i corresponds to Response::vary_cmds[i])
+	 * of the cached responses, the most recently used first.
+	 * The number of distinct masks is usually very small,
+	 * because a #Handler generates VARY packets with a fixed set
+	 * of commands for a given kind of request.
+	 */
+	StaticVector<uint_least16_t, 8> vary_masks;
+
+	/**
+	 * A buffer for building lookup keys, reused to avoid an
+	 * allocation for each lookup.
+	 */
+	std::string key_buffer;
+
+	Stats stats{};
+
+public:
+	explicit ResponseCache(const Config &config) noexcept;
+	~ResponseCache() noexcept;
+
+	ResponseCache(const ResponseCache &) = delete;
+	ResponseCache &operator=(const ResponseCache &) = delete;
+
+	const Stats &GetStats() const noexcept {
+		return stats;
+	}
+
+	std::size_t GetTotalSize() const noexcept {
+		return cache.GetTotalSize();
+	}
+
+	/**
+	 * Look up a cached response.
+	 *
+	 * @param request all request packets (including BEGIN but
+	 * without END)
+	 * @param peer the client which sent the request
+	 * @return the response (the wire format including BEGIN and
+	 * END) or an empty span if there is no (fresh) cached
+	 * response; the span is valid until the cache is modified
+	 */
+	std::span<const std::byte> Get(std::span<const std::byte> request,
+				       Peer peer,
+				       Event::TimePoint now) noexcept;
+
+	/**
+	 * Add a response to the cache (if it is cacheable).  If
+	 * memory allocation fails, the response is not cached.
+	 *
+	 * @param request all request packets (including BEGIN but
+	 * without END)
+	 * @param peer the client which sent the request
+	 * @param response the return value of Response::Finish()
+	 */
+	void Put(std::span<const std::byte> request, Peer peer,
+		 std::span<const std::byte> response,
+		 Event::TimePoint now) noexcept;
+
+	/**
+	 * Like the other overload, but the response is given as a
+	 * list of buffers (see Response::FinishVector()).
+	 */
+	void Put(std::span<const std::byte> request, Peer peer,
+		 std::span<const struct iovec> response,
+		 Event::TimePoint now) noexcept;
+
+	/**
+	 * Remove all cached responses.
+	 */
+	void Flush() noexcept;
+
+	/**
+	 * Remove all cached responses whose request contained the
+	 * given packet (command and payload).
+	 */
+	void Invalidate(TranslationCommand command,
+			std::span<const std::byte> payload) noexcept;
+
+private:
+	/**
+	 * Build the key in #key_buffer.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	void BuildKey(std::span<const std::byte> request, Peer peer,
+		      unsigned vary_mask);
+
+	void AddVaryMask(unsigned vary_mask) noexcept;
+
+	/**
+	 * Add a (cacheable) response to the cache.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	void Store(std::span<const std::byte> request, Peer peer,
+		   AllocatedArray<std::byte> &&response,
+		   unsigned vary_mask, Event::TimePoint expires);
+};
+
+} // namespace Translation::Server
@@ -4,6 +4,13 @@
 
 #include "Server.hxx"
 #include "Listener.hxx"
+#include "thread/EventLoopGroup.hxx"
+#include "net/LocalSocketAddress.hxx"
+#include "net/SocketConfig.hxx"
+#include "net/SocketError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <cassert>
 
 #ifdef HAVE_LIBSYSTEMD
 #include <systemd/sd-daemon.h>
@@ -36,6 +43,79 @@ Server::Server(EventLoop &_event_loop, Handler &_handler)
 	listeners.front().ListenPath("@translation");
 }
 
+Server::Server(EventLoopGroup &group, std::span<Handler *const> handlers)
+{
+	assert(group.size() > 0);
+	assert(handlers.size() == group.size());
+
+	const auto n = group.size();
+
+	const auto add = [this, &group, handlers](std::size_t i,
+						 UniqueSocketDescriptor fd){
+		listeners.emplace_front(group.GetEventLoop(i), *handlers[i]);
+		listeners.front().Listen(std::move(fd));
+	};
+
+#ifdef HAVE_LIBSYSTEMD
+	int n_fds = sd_listen_fds(true);
+	if (n_fds > 0) {
+		/* systemd has launched us by socket activation; share
+		   each of those sockets with all threads */
+		for (unsigned i = 0; i < unsigned(n_fds); ++i) {
+			const SocketDescriptor fd{static_cast<int>(SD_LISTEN_FDS_START + i)};
+
+			for (std::size_t j = 1; j < n; ++j) {
+				auto dup = fd.Duplicate();
+				if (!dup.IsDefined())
+					throw MakeSocketError("Failed to duplicate socket");
+
+				add(j, std::move(dup));
+			}
+
+			add(0, UniqueSocketDescriptor{AdoptTag{}, fd.Get()});
+		}
+
+		/* ... instead of the default socket; we're done
+		   now */
+		return;
+	}
+#endif
+
+	const SocketConfig config{
+		.bind_address = AllocatedSocketAddress{LocalSocketAddress{"@translation"}},
+		.listen = 256,
+		.pass_cred = true,
+	};
+
+	auto fds = config.CreateReusePortGroup(SOCK_STREAM, n);
+	for (std::size_t i = 0; i < n; ++i)
+		add(i, std::move(fds[i]));
+}
+
 Server::~Server() noexcept = default;
 
+void
+Server::EnableResponseCache(const ResponseCache::Config &config) noexcept
+{
+	for (auto &i : listeners)
+		i.EnableResponseCache(config);
+}
+
+void
+Server::FlushResponseCache() noexcept
+{
+	for (auto &i : listeners)
+		if (auto *cache = i.GetResponseCache())
+			cache->Flush();
+}
+
+void
+Server::InvalidateResponseCache(TranslationCommand command,
+				std::span<const std::byte> payload) noexcept
+{
+	for (auto &i : listeners)
+		if (auto *cache = i.GetResponseCache())
+			cache->Invalidate(command, payload);
+}
+
 } // namespace Translation::Server
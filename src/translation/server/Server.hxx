@@ -4,9 +4,13 @@
 
 #pragma once
 
+#include "ResponseCache.hxx"
+
 #include <forward_list>
+#include <span>
 
 class EventLoop;
+class EventLoopGroup;
 
 namespace Translation::Server {
 
@@ -24,7 +28,43 @@ public:
 	 */
 	Server(EventLoop &_event_loop, Handler &_handler);
 
+	/**
+	 * Create listeners for all threads of the given
+	 * #EventLoopGroup; each thread accepts connections on its
+	 * own #EventLoop and passes them to its own #Handler (with
+	 * the same index), so no state is shared between threads.
+	 * The listener sockets are shared by all threads (see
+	 * SocketConfig::CreateReusePortGroup()).
+	 *
+	 * This must be called before EventLoopGroup::Start(), and
+	 * the #Server must be destructed after
+	 * EventLoopGroup::Join().
+	 */
+	Server(EventLoopGroup &group, std::span<Handler *const> handlers);
+
 	~Server() noexcept;
+
+	/**
+	 * Enable a #ResponseCache for each listener.  This may be
+	 * called only once.
+	 */
+	void EnableResponseCache(const ResponseCache::Config &config) noexcept;
+
+	/**
+	 * Invoke ResponseCache::Flush() on all listeners.
+	 *
+	 * In an #EventLoopGroup, the caches are owned by different
+	 * threads; this method must not be called while they are
+	 * running.
+	 */
+	void FlushResponseCache() noexcept;
+
+	/**
+	 * Invoke ResponseCache::Invalidate() on all listeners (with
+	 * the same restriction as FlushResponseCache()).
+	 */
+	void InvalidateResponseCache(TranslationCommand command,
+				     std::span<const std::byte> payload) noexcept;
 };
 
 } // namespace Translation::Server
@@ -3,28 +3,35 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "Escape.hxx"
-#include "uri/Chars.hxx"
+#include "Scan.hxx"
 #include "util/AllocatedString.hxx"
 #include "util/HexFormat.hxx"
 #include "util/SpanCast.hxx"
 
+#include <algorithm>
+
 std::size_t
 UriEscape(char *dest, std::string_view src,
 	  char escape_char) noexcept
 {
-	std::size_t dest_length = 0;
-
-	for (std::size_t i = 0; i < src.size(); ++i) {
-		if (IsUriUnreservedChar(src[i])) {
-			dest[dest_length++] = src[i];
-		} else {
-			dest[dest_length++] = escape_char;
-			HexFormatUint8Fixed(&dest[dest_length], (uint8_t)src[i]);
-			dest_length += 2;
-		}
+	char *const dest_start = dest;
+
+	while (!src.empty()) {
+		/* copy the run of characters which don't need to be
+		   escaped */
+		const std::size_t n = SkipUriChars(UriCharClass::UNRESERVED, src);
+		dest = std::copy_n(src.data(), n, dest);
+		src.remove_prefix(n);
+
+		if (src.empty())
+			break;
+
+		*dest++ = escape_char;
+		dest = HexFormatUint8Fixed(dest, (uint8_t)src.front());
+		src.remove_prefix(1);
 	}
 
-	return dest_length;
+	return dest - dest_start;
 }
 
 std::size_t
@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "Scan.hxx"
+#include "Chars.hxx"
+
+#include <array>
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define URI_SCAN_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define URI_SCAN_NEON
+#endif
+
+/**
+ * A character class encoded as two 16 byte lookup tables indexed by
+ * the low and the high nibble of a character.  A character belongs
+ * to the class if the bitwise "and" of both lookups is non-zero.
+ * Each bit stands for one high nibble value, so this can describe
+ * any subset of ASCII; non-ASCII characters (high nibble 8..15) are
+ * never members.
+ *
+ * This layout allows classifying 16 characters with two PSHUFB (or
+ * TBL) instructions.
+ */
+struct NibbleTable {
+	alignas(16) uint8_t lo[16];
+	alignas(16) uint8_t hi[16];
+
+	constexpr bool Contains(char ch) const noexcept {
+		const auto b = static_cast<uint8_t>(ch);
+		return (lo[b & 0xf] & hi[b >> 4]) != 0;
+	}
+};
+
+static consteval NibbleTable
+MakeNibbleTable(bool (*predicate)(char)) noexcept
+{
+	NibbleTable t{};
+
+	for (unsigned h = 0; h < 8; ++h)
+		t.hi[h] = 1U << h;
+
+	for (unsigned ch = 0; ch < 0x80; ++ch)
+		if (predicate(static_cast<char>(ch)))
+			t.lo[ch & 0xf] |= 1U << (ch >> 4);
+
+	return t;
+}
+
+static constexpr bool
+IsUriPathChar(char ch) noexcept
+{
+	return IsUriPchar(ch) || ch == '/';
+}
+
+/* indexed by UriCharClass */
+static constexpr std::array tables{
+	MakeNibbleTable(IsUriUnreservedChar),
+	MakeNibbleTable(IsUriPchar),
+	MakeNibbleTable(IsUriPathChar),
+	MakeNibbleTable(IsUriQueryChar),
+};
+
+static constexpr auto predicates = std::array{
+	IsUriUnreservedChar,
+	IsUriPchar,
+	IsUriPathChar,
+	IsUriQueryChar,
+};
+
+static_assert([]{
+	for (std::size_t i = 0; i < tables.size(); ++i)
+		for (unsigned ch = 0; ch < 0x100; ++ch)
+			if (tables[i].Contains(static_cast<char>(ch)) !=
+			    predicates[i](static_cast<char>(ch)))
+				return false;
+	return true;
+}());
+
+static constexpr const NibbleTable &
+GetTable(UriCharClass c) noexcept
+{
+	return tables[static_cast<std::size_t>(c)];
+}
+
+static inline std::size_t
+SkipTable(const NibbleTable &t, const char *p, std::size_t size,
+	  std::size_t i=0) noexcept
+{
+	while (i < size && t.Contains(p[i]))
+		++i;
+	return i;
+}
+
+#ifdef URI_SCAN_X86
+
+[[gnu::target("ssse3")]]
+static std::size_t
+SkipSSSE3(const NibbleTable &t, const char *p, std::size_t size) noexcept
+{
+	const __m128i lo_table = _mm_load_si128((const __m128i *)t.lo);
+	const __m128i hi_table = _mm_load_si128((const __m128i *)t.hi);
+	const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+	const __m128i zero = _mm_setzero_si128();
+
+	std::size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		const __m128i lo = _mm_shuffle_epi8(lo_table,
+						    _mm_and_si128(v, nibble_mask));
+		/* there is no 8 bit shift; the bits shifted in
+		   from the neighbouring byte are masked out */
+		const __m128i hi = _mm_shuffle_epi8(hi_table,
+						    _mm_and_si128(_mm_srli_epi16(v, 4),
+								  nibble_mask));
+
+		/* 0xff for each character which is not a member */
+		const __m128i outside = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero);
+		const unsigned mask = _mm_movemask_epi8(outside);
+		if (mask != 0)
+			return i + std::countr_zero(mask);
+	}
+
+	return SkipTable(t, p, size, i);
+}
+
+[[gnu::target("avx2")]]
+static std::size_t
+SkipAVX2(const NibbleTable &t, const char *p, std::size_t size) noexcept
+{
+	/* VPSHUFB looks up each 128 bit lane separately, therefore
+	   the tables are duplicated into both lanes */
+	const __m256i lo_table = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)t.lo));
+	const __m256i hi_table = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)t.hi));
+	const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+	const __m256i zero = _mm256_setzero_si256();
+
+	std::size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		const __m256i lo = _mm256_shuffle_epi8(lo_table,
+						       _mm256_and_si256(v, nibble_mask));
+		const __m256i hi = _mm256_shuffle_epi8(hi_table,
+						       _mm256_and_si256(_mm256_srli_epi16(v, 4),
+									nibble_mask));
+
+		const __m256i outside = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero);
+		const unsigned mask = _mm256_movemask_epi8(outside);
+		if (mask != 0)
+			return i + std::countr_zero(mask);
+	}
+
+	return i + SkipSSSE3(t, p + i, size - i);
+}
+
+using SkipFunction = std::size_t (*)(const NibbleTable &t,
+				     const char *p, std::size_t size) noexcept;
+
+static std::size_t
+SkipScalar(const NibbleTable &t, const char *p, std::size_t size) noexcept
+{
+	return SkipTable(t, p, size);
+}
+
+static SkipFunction
+ChooseSkipFunction() noexcept
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return SkipAVX2;
+
+	if (__builtin_cpu_supports("ssse3"))
+		return SkipSSSE3;
+
+	return SkipScalar;
+}
+
+static std::size_t
+SkipSIMD(const NibbleTable &t, const char *p, std::size_t size) noexcept
+{
+	static const SkipFunction f = ChooseSkipFunction();
+	return f(t, p, size);
+}
+
+#elif defined(URI_SCAN_NEON)
+
+static std::size_t
+SkipSIMD(const NibbleTable &t, const char *p, std::size_t size) noexcept
+{
+	const uint8x16_t lo_table = vld1q_u8(t.lo);
+	const uint8x16_t hi_table = vld1q_u8(t.hi);
+	const uint8x16_t nibble_mask = vdupq_n_u8(0x0f);
+
+	std::size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const uint8x16_t v = vld1q_u8((const uint8_t *)(p + i));
+		const uint8x16_t lo = vqtbl1q_u8(lo_table, vandq_u8(v, nibble_mask));
+		const uint8x16_t hi = vqtbl1q_u8(hi_table, vshrq_n_u8(v, 4));
+
+		/* 0xff for each character which is a member */
+		const uint8x16_t inside = vtstq_u8(lo, hi);
+		if (vminvq_u8(inside) != 0xff)
+			/* the mismatch is somewhere in this block */
+			return SkipTable(t, p, i + 16, i);
+	}
+
+	return SkipTable(t, p, size, i);
+}
+
+#else
+
+static std::size_t
+SkipSIMD(const NibbleTable &t, const char *p, std::size_t size) noexcept
+{
+	return SkipTable(t, p, size);
+}
+
+#endif
+
+std::size_t
+SkipUriChars(UriCharClass c, std::string_view s) noexcept
+{
+	return SkipSIMD(GetTable(c), s.data(), s.size());
+}
+
+std::size_t
+SkipUriCharsScalar(UriCharClass c, std::string_view s) noexcept
+{
+	const auto predicate = predicates[static_cast<std::size_t>(c)];
+
+	std::size_t i = 0;
+	while (i < s.size() && predicate(s[i]))
+		++i;
+	return i;
+}
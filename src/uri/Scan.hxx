@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Fast scanning for runs of URI characters.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * A character class for SkipUriChars(); each one corresponds to a
+ * predicate from Chars.hxx.
+ */
+enum class UriCharClass : uint_least8_t {
+	/**
+	 * IsUriUnreservedChar()
+	 */
+	UNRESERVED,
+
+	/**
+	 * IsUriPchar()
+	 */
+	PCHAR,
+
+	/**
+	 * IsUriPchar() or a slash (i.e. a sequence of path
+	 * segments).
+	 */
+	PATH,
+
+	/**
+	 * IsUriQueryChar()
+	 */
+	QUERY,
+};
+
+/**
+ * Determine the length of the initial run of characters which
+ * belong to the given class (like strspn()).  Depending on the CPU,
+ * this uses SIMD instructions to check 16 or 32 characters at a
+ * time.
+ */
+[[gnu::pure]]
+std::size_t
+SkipUriChars(UriCharClass c, std::string_view s) noexcept;
+
+/**
+ * The portable (one character at a time) implementation of
+ * SkipUriChars(), for testing and benchmarking.
+ */
+[[gnu::pure]]
+std::size_t
+SkipUriCharsScalar(UriCharClass c, std::string_view s) noexcept;
+
+/**
+ * Does the given string consist only of characters of the given
+ * class?
+ */
+[[gnu::pure]]
+inline bool
+CheckUriChars(UriCharClass c, std::string_view s) noexcept
+{
+	return SkipUriChars(c, s) == s.size();
+}
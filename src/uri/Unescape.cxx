@@ -7,14 +7,23 @@
 
 #include <algorithm>
 
+#include <string.h>
+
 char *
 UriUnescape(char *dest, std::string_view _src, char escape_char) noexcept
 {
-	auto src = _src.begin();
-	const auto end = _src.end();
+	const char *src = _src.data();
+	const char *const end = src + _src.size();
 
 	while (true) {
-		auto p = std::find(src, end, escape_char);
+		/* memchr() is usually vectorized, while std::find()
+		   checks one character at a time */
+		const char *p = src < end
+			? static_cast<const char *>(memchr(src, escape_char, end - src))
+			: nullptr;
+		if (p == nullptr)
+			p = end;
+
 		dest = std::copy(src, p, dest);
 
 		if (p == end)
@@ -3,7 +3,7 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "Verify.hxx"
-#include "Chars.hxx"
+#include "Scan.hxx"
 #include "util/CharUtil.hxx"
 #include "util/StringCompare.hxx"
 #include "util/StringListVerify.hxx"
@@ -158,14 +158,9 @@ VerifyUriHostPort(std::string_view host_port) noexcept
 bool
 uri_segment_verify(std::string_view segment) noexcept
 {
-	for (char ch : segment) {
-		/* XXX check for invalid escaped characters? */
+	/* XXX check for invalid escaped characters? */
 
-		if (!IsUriPchar(ch))
-			return false;
-	}
-
-	return true;
+	return CheckUriChars(UriCharClass::PCHAR, segment);
 }
 
 bool
@@ -177,15 +172,9 @@ uri_path_verify(std::string_view uri) noexcept
 
 	uri.remove_prefix(1); // strip the leading slash
 
-	do {
-		auto s = Split(uri, '/');
-		if (!uri_segment_verify(s.first))
-			return false;
-
-		uri = s.second;
-	} while (!uri.empty());
-
-	return true;
+	/* all segments are verified at once, because a slash is the
+	   only additional character allowed in a path */
+	return CheckUriChars(UriCharClass::PATH, uri);
 }
 
 static constexpr bool
@@ -279,7 +268,7 @@ uri_path_verify_quick(const char *uri) noexcept
 bool
 VerifyUriQuery(std::string_view query) noexcept
 {
-	return CheckChars(query, IsUriQueryChar);
+	return CheckUriChars(UriCharClass::QUERY, query);
 }
 
 bool
@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// author: Max Kellermann <max.kellermann@gmail.com>
+
+#pragma once
+
+#include "FrequencySketch.hxx"
+#include "IntrusiveList.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+
+/*
+ * Eviction policies for #StaticCache and #IntrusiveCache.
+ *
+ * A policy provides a "Lists" class template which manages the
+ * eviction order of all items in the cache, and an "ItemData" type
+ * which is embedded in each item.  The methods of "Lists" receive
+ * function objects which return the hash and the weight of an item;
+ * a policy which does not need them does not call them.
+ */
+
+/**
+ * The list manager for #LruCachePolicy: one list ordered by the time
+ * of the last access.
+ */
+template<typename T, typename HookTraits>
+class LruCacheLists {
+	using List = IntrusiveList<T, HookTraits>;
+
+	List list;
+
+public:
+	explicit constexpr LruCacheLists(std::size_t) noexcept {}
+
+	constexpr bool empty() const noexcept {
+		return list.empty();
+	}
+
+	/**
+	 * Count one lookup of a key (which may or may not be in the
+	 * cache).
+	 */
+	constexpr void Record(std::invocable auto) noexcept {}
+
+	void Insert(T &item, std::size_t, std::invocable<const T &> auto) noexcept {
+		list.push_front(item);
+	}
+
+	/**
+	 * An item in the cache was accessed.
+	 */
+	void Touch(T &item, std::invocable<const T &> auto) noexcept {
+		list.erase(list.iterator_to(item));
+		list.push_front(item);
+	}
+
+	void Erase(T &item, std::size_t) noexcept {
+		list.erase(list.iterator_to(item));
+	}
+
+	/**
+	 * Choose an item to be evicted, making room for a new item
+	 * with the given weight, and remove it from the lists.  The
+	 * lists must not be empty.
+	 */
+	T &Evict(std::size_t,
+		 std::invocable<const T &> auto,
+		 std::invocable<const T &> auto) noexcept {
+		assert(!list.empty());
+
+		T &item = list.back();
+		list.pop_back();
+		return item;
+	}
+
+	void clear_and_dispose(Disposer<T> auto disposer) noexcept {
+		list.clear_and_dispose(disposer);
+	}
+
+	void remove_and_dispose_if(std::predicate<const T &> auto pred,
+				   Disposer<T> auto disposer,
+				   std::invocable<const T &> auto) noexcept {
+		list.remove_and_dispose_if(pred, disposer);
+	}
+
+	void ForEach(std::invocable<const T &> auto f) const {
+		for (const auto &i : list)
+			f(i);
+	}
+};
+
+/**
+ * The default policy: evict the least recently used item.
+ */
+struct LruCachePolicy {
+	/**
+	 * Per-item data which must be made available by
+	 * HookTraits::GetPolicyData().
+	 */
+	struct ItemData {};
+
+	template<typename T, typename HookTraits, std::size_t max_items>
+	using Lists = LruCacheLists<T, HookTraits>;
+};
+
+/**
+ * The per-item data needed by #WTinyLfuCacheLists.
+ */
+struct WTinyLfuItemData {
+	enum class Segment : uint_least8_t {
+		WINDOW,
+		PROBATION,
+		PROTECTED,
+	} segment;
+};
+
+/**
+ * The list manager for #WTinyLfuCachePolicy.
+ *
+ * New items enter a small LRU "window" (1% of the capacity).  Items
+ * falling out of the window compete with the least recently used
+ * item of the main space; the one which was used more frequently
+ * (according to a #FrequencySketch) stays.  The main space is a
+ * segmented LRU: items enter the "probation" segment and are
+ * promoted to the "protected" segment (80% of the main space) on
+ * their next access.
+ *
+ * This keeps frequently used items in the cache even when many
+ * one-off keys are looked up (e.g. by a crawler), which would flush
+ * a plain LRU cache.
+ */
+template<typename T, typename HookTraits, std::size_t sketch_words>
+class WTinyLfuCacheLists {
+	static_assert(sketch_words > 0,
+		      "The sketch size must be specified");
+
+	using Segment = WTinyLfuItemData::Segment;
+	using List = IntrusiveList<T, HookTraits>;
+
+	FrequencySketch<std::bit_ceil(sketch_words)> sketch;
+
+	List window, probation, protected_list;
+
+	std::size_t window_weight = 0, protected_weight = 0;
+
+	const std::size_t max_window_weight, max_protected_weight;
+
+	static Segment &GetSegment(T &item) noexcept {
+		return HookTraits::GetPolicyData(item).segment;
+	}
+
+	List &GetList(Segment segment) noexcept {
+		switch (segment) {
+		case Segment::WINDOW:
+			return window;
+
+		case Segment::PROBATION:
+			return probation;
+
+		case Segment::PROTECTED:
+			break;
+		}
+
+		return protected_list;
+	}
+
+	void MoveToProbation(T &item, std::size_t weight) noexcept {
+		assert(GetSegment(item) == Segment::WINDOW);
+		assert(window_weight >= weight);
+
+		window.erase(window.iterator_to(item));
+		window_weight -= weight;
+
+		GetSegment(item) = Segment::PROBATION;
+		probation.push_front(item);
+	}
+
+	/**
+	 * Returns the least recently used item of the main space or
+	 * nullptr if it is empty.
+	 */
+	T *GetMainVictim() noexcept {
+		if (!probation.empty())
+			return &probation.back();
+
+		if (!protected_list.empty())
+			return &protected_list.back();
+
+		return nullptr;
+	}
+
+public:
+	/**
+	 * @param max_weight the capacity of the cache
+	 */
+	explicit WTinyLfuCacheLists(std::size_t max_weight) noexcept
+		:max_window_weight(std::max<std::size_t>(max_weight / 100, 1)),
+		 max_protected_weight(max_weight > max_window_weight
+				      ? (max_weight - max_window_weight) * 4 / 5
+				      : 0) {}
+
+	bool empty() const noexcept {
+		return window.empty() && probation.empty() &&
+			protected_list.empty();
+	}
+
+	void Record(std::invocable auto get_hash) noexcept {
+		sketch.Increment(get_hash());
+	}
+
+	void Insert(T &item, std::size_t weight,
+		    std::invocable<const T &> auto get_weight) noexcept {
+		/* if the window is full (but no eviction was
+		   necessary, i.e. the cache is not yet full), move
+		   its oldest items to the main space */
+		while (!window.empty() &&
+		       window_weight + weight > max_window_weight) {
+			T &tail = window.back();
+			MoveToProbation(tail, get_weight(tail));
+		}
+
+		GetSegment(item) = Segment::WINDOW;
+		window.push_front(item);
+		window_weight += weight;
+	}
+
+	void Touch(T &item, std::invocable<const T &> auto get_weight) noexcept {
+		switch (GetSegment(item)) {
+		case Segment::WINDOW:
+			window.erase(window.iterator_to(item));
+			window.push_front(item);
+			break;
+
+		case Segment::PROBATION:
+			probation.erase(probation.iterator_to(item));
+			GetSegment(item) = Segment::PROTECTED;
+			protected_list.push_front(item);
+			protected_weight += get_weight(item);
+
+			/* demote the oldest protected items */
+			while (protected_weight > max_protected_weight) {
+				T &tail = protected_list.back();
+				if (&tail == &item)
+					break;
+
+				const std::size_t tail_weight = get_weight(tail);
+				assert(protected_weight >= tail_weight);
+
+				protected_list.pop_back();
+				protected_weight -= tail_weight;
+				GetSegment(tail) = Segment::PROBATION;
+				probation.push_front(tail);
+			}
+
+			break;
+
+		case Segment::PROTECTED:
+			protected_list.erase(protected_list.iterator_to(item));
+			protected_list.push_front(item);
+			break;
+		}
+	}
+
+	void Erase(T &item, std::size_t weight) noexcept {
+		const Segment segment = GetSegment(item);
+		auto &list = GetList(segment);
+		list.erase(list.iterator_to(item));
+
+		if (segment == Segment::WINDOW) {
+			assert(window_weight >= weight);
+			window_weight -= weight;
+		} else if (segment == Segment::PROTECTED) {
+			assert(protected_weight >= weight);
+			protected_weight -= weight;
+		}
+	}
+
+	T &Evict(std::size_t incoming_weight,
+		 std::invocable<const T &> auto get_hash,
+		 std::invocable<const T &> auto get_weight) noexcept {
+		assert(!empty());
+
+		T *victim = GetMainVictim();
+
+		if (!window.empty() &&
+		    window_weight + incoming_weight > max_window_weight) {
+			/* the window overflows: its oldest item
+			   is a candidate for admission to the main
+			   space */
+			T &candidate = window.back();
+
+			if (victim == nullptr ||
+			    sketch.Get(get_hash(candidate)) <= sketch.Get(get_hash(*victim))) {
+				Erase(candidate, get_weight(candidate));
+				return candidate;
+			}
+
+			MoveToProbation(candidate, get_weight(candidate));
+		} else if (victim == nullptr) {
+			victim = &window.back();
+		}
+
+		Erase(*victim, get_weight(*victim));
+		return *victim;
+	}
+
+	void clear_and_dispose(Disposer<T> auto disposer) noexcept {
+		window.clear_and_dispose(disposer);
+		probation.clear_and_dispose(disposer);
+		protected_list.clear_and_dispose(disposer);
+		window_weight = protected_weight = 0;
+		sketch.Clear();
+	}
+
+	void remove_and_dispose_if(std::predicate<const T &> auto pred,
+				   Disposer<T> auto disposer,
+				   std::invocable<const T &> auto get_weight) noexcept {
+		window.remove_and_dispose_if(pred, [&](T *item){
+			window_weight -= get_weight(*item);
+			disposer(item);
+		});
+
+		probation.remove_and_dispose_if(pred, disposer);
+
+		protected_list.remove_and_dispose_if(pred, [&](T *item){
+			protected_weight -= get_weight(*item);
+			disposer(item);
+		});
+	}
+
+	void ForEach(std::invocable<const T &> auto f) const {
+		for (const auto &i : window)
+			f(i);
+		for (const auto &i : protected_list)
+			f(i);
+		for (const auto &i : probation)
+			f(i);
+	}
+};
+
+/**
+ * The "W-TinyLFU" policy (see #WTinyLfuCacheLists), which is
+ * resistant to scans.
+ *
+ * The items must provide room for #WTinyLfuItemData (e.g. by using
+ * #IntrusiveCacheLfuHook with #IntrusiveCache).
+ *
+ * @param sketch_size the size of the frequency sketch, i.e. the
+ * expected maximum number of items; if zero, the maximum number of
+ * items of #StaticCache is used (#IntrusiveCache requires a nonzero
+ * value)
+ */
+template<std::size_t sketch_size=0>
+struct WTinyLfuCachePolicy {
+	using ItemData = WTinyLfuItemData;
+
+	template<typename T, typename HookTraits, std::size_t max_items>
+	using Lists = WTinyLfuCacheLists<T, HookTraits,
+					 (sketch_size > 0 ? sketch_size : max_items)>;
+};
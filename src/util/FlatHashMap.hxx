@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "SwissTable.hxx"
+
+#include <concepts> // for std::predicate
+#include <functional> // for std::equal_to
+#include <memory> // for std::construct_at()
+#include <type_traits>
+#include <utility>
+
+/**
+ * A hash map which stores keys and values in an open-addressing
+ * table (see SwissTable.hxx).  Unlike #IntrusiveHashSet and
+ * #IntrusiveHashArrayTrie, a lookup does not need to chase pointers
+ * (unless the key/value contains pointers), which makes it faster for
+ * read-heavy workloads.
+ *
+ * Keys and values must be small and trivially copyable, because
+ * they get moved around with memcpy() semantics when the table grows.
+ * This also means that any insertion invalidates all pointers to
+ * items.
+ */
+template<typename Key, typename Value,
+	 std::regular_invocable<const Key &> Hash=std::hash<Key>,
+	 std::predicate<const Key &, const Key &> Equal=std::equal_to<Key>>
+requires std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>
+class FlatHashMap {
+public:
+	struct value_type {
+		Key key;
+		Value value;
+	};
+
+	using key_type = Key;
+	using mapped_type = Value;
+	using size_type = std::size_t;
+	using hasher = Hash;
+	using key_equal = Equal;
+
+private:
+	struct Operators {
+		[[no_unique_address]]
+		Hash hash;
+
+		[[no_unique_address]]
+		Equal equal;
+
+		static constexpr const Key &get_key(const value_type &item) noexcept {
+			return item.key;
+		}
+	};
+
+	SwissTable::Table<value_type, Operators> table;
+
+public:
+	[[nodiscard]]
+	FlatHashMap() noexcept = default;
+
+	[[nodiscard]]
+	explicit FlatHashMap(const Hash &hash, const Equal &equal={}) noexcept
+		:table(Operators{hash, equal}) {}
+
+	FlatHashMap(FlatHashMap &&) noexcept = default;
+	FlatHashMap &operator=(FlatHashMap &&) noexcept = default;
+
+	[[nodiscard]]
+	constexpr const hasher &hash_function() const noexcept {
+		return table.GetOperators().hash;
+	}
+
+	[[nodiscard]]
+	constexpr const key_equal &key_eq() const noexcept {
+		return table.GetOperators().equal;
+	}
+
+	[[nodiscard]]
+	constexpr bool empty() const noexcept {
+		return table.empty();
+	}
+
+	[[nodiscard]]
+	constexpr size_type size() const noexcept {
+		return table.size();
+	}
+
+	void clear() noexcept {
+		table.clear();
+	}
+
+	/**
+	 * Make room for at least the given number of items, so they
+	 * can be inserted without growing the table.
+	 */
+	void reserve(size_type n) {
+		table.reserve(n);
+	}
+
+	/**
+	 * @return a pointer to the item or nullptr if the key does
+	 * not exist
+	 */
+	[[nodiscard]] [[gnu::pure]]
+	value_type *find(const auto &key) noexcept {
+		return table.Find(key);
+	}
+
+	[[nodiscard]] [[gnu::pure]]
+	const value_type *find(const auto &key) const noexcept {
+		return table.Find(key);
+	}
+
+	[[nodiscard]] [[gnu::pure]]
+	bool contains(const auto &key) const noexcept {
+		return find(key) != nullptr;
+	}
+
+	/**
+	 * Insert a new item unless the key already exists.
+	 *
+	 * @return a pointer to the new or the existing item and
+	 * whether the item was inserted
+	 */
+	std::pair<value_type *, bool> insert(const Key &key, const Value &value) {
+		auto [item, inserted] = table.FindOrPrepareInsert(key);
+		if (inserted)
+			std::construct_at(item, key, value);
+		return {item, inserted};
+	}
+
+	/**
+	 * Insert a new item or replace the value of an existing
+	 * one.
+	 */
+	value_type &insert_or_assign(const Key &key, const Value &value) {
+		auto [item, inserted] = table.FindOrPrepareInsert(key);
+		if (inserted)
+			std::construct_at(item, key, value);
+		else
+			item->value = value;
+		return *item;
+	}
+
+	/**
+	 * Returns a reference to the value for the given key,
+	 * inserting a value-initialized one if the key does not
+	 * exist.
+	 */
+	Value &operator[](const Key &key) requires std::is_default_constructible_v<Value> {
+		auto [item, inserted] = table.FindOrPrepareInsert(key);
+		if (inserted)
+			std::construct_at(item, key, Value{});
+		return item->value;
+	}
+
+	void erase(value_type &item) noexcept {
+		table.Erase(item);
+	}
+
+	/**
+	 * @return true if an item was removed
+	 */
+	bool erase(const auto &key) noexcept {
+		auto *item = find(key);
+		if (item == nullptr)
+			return false;
+
+		erase(*item);
+		return true;
+	}
+
+	/**
+	 * Remove all items matching the given predicate.
+	 *
+	 * @return the number of removed items
+	 */
+	size_type remove_if(std::predicate<const value_type &> auto pred) noexcept {
+		size_type n = 0;
+		table.ForEach([this, &pred, &n](value_type &item){
+			if (pred(std::as_const(item))) {
+				table.Erase(item);
+				++n;
+			}
+		});
+		return n;
+	}
+
+	void for_each(auto &&f) {
+		table.ForEach(f);
+	}
+
+	void for_each(auto &&f) const {
+		table.ForEach(f);
+	}
+};
@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "IntrusiveHashSet.hxx" // for IntrusiveHashSetOperatorsConcept
+#include "SwissTable.hxx"
+
+#include <cassert>
+#include <concepts> // for std::predicate
+#include <memory> // for std::construct_at()
+#include <utility>
+
+/**
+ * A hash set of pointers to items, stored in an open-addressing
+ * table (see SwissTable.hxx).  The items do not need a hook, and
+ * they are not owned by this container.
+ *
+ * Next to each pointer, the table stores 7 bits of the item's hash,
+ * so a lookup dereferences only items whose hash is likely to match
+ * (usually just the one it is looking for), instead of walking a
+ * bucket list like #IntrusiveHashSet.
+ *
+ * The hash of an item is needed again when the table grows; its
+ * calculation should therefore be cheap (e.g. a precalculated hash
+ * like in #StringWithHash).
+ *
+ * @param Operators a class which contains functions `hash`, `equal`
+ * and `get_key` (e.g. #IntrusiveHashSetOperators)
+ */
+template<typename T, IntrusiveHashSetOperatorsConcept<T> Operators>
+class FlatPointerSet {
+	struct PointerOperators {
+		[[no_unique_address]]
+		Operators ops;
+
+		constexpr std::size_t hash(const auto &key) const {
+			return ops.hash(key);
+		}
+
+		constexpr bool equal(const auto &a, const auto &b) const {
+			return ops.equal(a, b);
+		}
+
+		constexpr decltype(auto) get_key(const T *item) const noexcept {
+			return ops.get_key(*item);
+		}
+	};
+
+	SwissTable::Table<T *, PointerOperators> table;
+
+public:
+	using value_type = T;
+	using reference = T &;
+	using const_reference = const T &;
+	using pointer = T *;
+	using const_pointer = const T *;
+	using size_type = std::size_t;
+
+	using hasher = typename Operators::hasher;
+	using key_equal = typename Operators::key_equal;
+
+	[[nodiscard]]
+	FlatPointerSet() noexcept = default;
+
+	FlatPointerSet(FlatPointerSet &&) noexcept = default;
+	FlatPointerSet &operator=(FlatPointerSet &&) noexcept = default;
+
+	[[nodiscard]]
+	constexpr const hasher &hash_function() const noexcept {
+		return table.GetOperators().ops.hash;
+	}
+
+	[[nodiscard]]
+	constexpr const key_equal &key_eq() const noexcept {
+		return table.GetOperators().ops.equal;
+	}
+
+	[[nodiscard]]
+	constexpr bool empty() const noexcept {
+		return table.empty();
+	}
+
+	[[nodiscard]]
+	constexpr size_type size() const noexcept {
+		return table.size();
+	}
+
+	/**
+	 * Remove all pointers (but do not dispose the items).
+	 */
+	void clear() noexcept {
+		table.clear();
+	}
+
+	void reserve(size_type n) {
+		table.reserve(n);
+	}
+
+	/**
+	 * @return the item or nullptr if the key does not exist
+	 */
+	[[nodiscard]] [[gnu::pure]]
+	pointer find(const auto &key) const noexcept {
+		T *const*slot = table.Find(key);
+		return slot != nullptr ? *slot : nullptr;
+	}
+
+	[[nodiscard]] [[gnu::pure]]
+	bool contains(const auto &key) const noexcept {
+		return table.Find(key) != nullptr;
+	}
+
+	/**
+	 * Insert a new item unless an item with the same key already
+	 * exists.
+	 *
+	 * @return the new or the existing item and whether the item
+	 * was inserted
+	 */
+	std::pair<pointer, bool> insert(reference item) {
+		const auto &ops = table.GetOperators();
+		auto [slot, inserted] = table.FindOrPrepareInsert(ops.get_key(&item));
+		if (inserted)
+			std::construct_at(slot, &item);
+		return {*slot, inserted};
+	}
+
+	/**
+	 * Remove the given item, which must be in this container.
+	 */
+	void erase(reference item) noexcept {
+		const auto &ops = table.GetOperators();
+		T **slot = table.Find(ops.get_key(&item));
+		assert(slot != nullptr);
+		assert(*slot == &item);
+
+		table.Erase(*slot);
+	}
+
+	/**
+	 * Remove the item with the given key.
+	 *
+	 * @return the removed item or nullptr if the key does not
+	 * exist
+	 */
+	pointer erase_key(const auto &key) noexcept {
+		T **slot = table.Find(key);
+		if (slot == nullptr)
+			return nullptr;
+
+		T *item = *slot;
+		table.Erase(*slot);
+		return item;
+	}
+
+	/**
+	 * Remove all items matching the given predicate and pass
+	 * them to the disposer.
+	 *
+	 * @return the number of removed items
+	 */
+	size_type remove_and_dispose_if(std::predicate<const_reference> auto pred,
+					Disposer<value_type> auto disposer) noexcept {
+		size_type n = 0;
+		table.ForEach([this, &pred, &disposer, &n](T *&slot){
+			if (pred(std::as_const(*slot))) {
+				T *item = slot;
+				table.Erase(slot);
+				disposer(item);
+				++n;
+			}
+		});
+		return n;
+	}
+
+	void clear_and_dispose(Disposer<value_type> auto disposer) noexcept {
+		table.ForEach([&disposer](T *item){
+			disposer(item);
+		});
+		table.clear();
+	}
+
+	void for_each(auto &&f) {
+		table.ForEach([&f](T *item){
+			f(*item);
+		});
+	}
+
+	void for_each(auto &&f) const {
+		table.ForEach([&f](const T *item){
+			f(*item);
+		});
+	}
+};
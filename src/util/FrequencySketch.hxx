@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// author: Max Kellermann <max.kellermann@gmail.com>
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A count-min sketch with 4-bit counters which estimates how often a
+ * (hashed) key has been seen recently.  This is the frequency
+ * histogram of the "TinyLFU" cache admission policy.
+ *
+ * After a number of increments proportional to the size of the
+ * sketch, all counters are halved, so the history fades out and the
+ * sketch adapts to a changing workload.
+ *
+ * @param n_words the number of 64-bit words, each containing 16
+ * counters; must be a power of two; rule of thumb: the number of
+ * items in the cache
+ */
+template<std::size_t n_words>
+class FrequencySketch {
+	static_assert(std::has_single_bit(n_words));
+
+	/**
+	 * Each key is counted in this many counters.
+	 */
+	static constexpr unsigned DEPTH = 4;
+
+	/**
+	 * All counters of a key are in one block of this many words
+	 * (i.e. one 64 byte cache line), each in a different word.
+	 */
+	static constexpr std::size_t BLOCK_WORDS = 8;
+
+	static constexpr std::size_t N_BLOCKS =
+		std::max(n_words / BLOCK_WORDS, std::size_t{1});
+
+	static constexpr unsigned MAX_COUNT = 15;
+
+	/**
+	 * After this number of increments, all counters are halved.
+	 */
+	static constexpr std::size_t SAMPLE_SIZE = 10 * n_words;
+
+	alignas(64) std::array<uint_least64_t, N_BLOCKS * BLOCK_WORDS> table{};
+
+	std::size_t n_additions = 0;
+
+	struct Position {
+		std::size_t word;
+		unsigned shift;
+	};
+
+	/**
+	 * Calculate the #DEPTH counter positions for the given hash.
+	 */
+	[[gnu::const]]
+	static constexpr std::array<Position, DEPTH> GetPositions(std::size_t hash) noexcept {
+		/* the finalizer of SplitMix64; this is necessary
+		   because many std::hash specializations return the
+		   key unmodified */
+		uint_least64_t h = hash;
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+
+		/* the lower 32 bits select the block, the upper 32
+		   bits select the counters inside the block */
+		const std::size_t block = (h & 0xffffffff) % N_BLOCKS * BLOCK_WORDS;
+
+		std::array<Position, DEPTH> result;
+		for (unsigned i = 0; i < DEPTH; ++i) {
+			const unsigned x = h >> (32 + i * 8);
+			result[i] = {
+				block + i * 2 + (x & 1),
+				((x >> 1) & 0xf) * 4,
+			};
+		}
+
+		return result;
+	}
+
+	constexpr unsigned GetCount(Position p) const noexcept {
+		return (table[p.word] >> p.shift) & 0xf;
+	}
+
+public:
+	/**
+	 * Estimate the frequency of the given hash.
+	 */
+	[[gnu::pure]]
+	constexpr unsigned Get(std::size_t hash) const noexcept {
+		unsigned result = MAX_COUNT;
+		for (const auto p : GetPositions(hash))
+			result = std::min(result, GetCount(p));
+		return result;
+	}
+
+	/**
+	 * Count one occurrence of the given hash.
+	 */
+	constexpr void Increment(std::size_t hash) noexcept {
+		const auto positions = GetPositions(hash);
+
+		unsigned min = MAX_COUNT;
+		for (const auto p : positions)
+			min = std::min(min, GetCount(p));
+
+		if (min == MAX_COUNT)
+			return;
+
+		/* "conservative update": increment only the
+		   smallest counters, which reduces the error caused
+		   by collisions (branchless; this is possible
+		   because each counter is in a different word) */
+		for (const auto p : positions)
+			table[p.word] += uint_least64_t{GetCount(p) == min} << p.shift;
+
+		if (++n_additions >= SAMPLE_SIZE)
+			Reset();
+	}
+
+	/**
+	 * Reset all counters to zero.
+	 */
+	constexpr void Clear() noexcept {
+		table.fill(0);
+		n_additions = 0;
+	}
+
+private:
+	/**
+	 * Halve all counters.
+	 */
+	constexpr void Reset() noexcept {
+		for (auto &i : table)
+			i = (i >> 1) & 0x7777777777777777ULL;
+
+		n_additions /= 2;
+	}
+};
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "CachePolicy.hxx"
 #include "Concepts.hxx"
 #include "IntrusiveHashSet.hxx"
 #include "IntrusiveList.hxx"
@@ -22,7 +23,16 @@ struct IntrusiveCacheHook {
 };
 
 /**
- * For classes which embed #IntrusiveCacheHook as base class.
+ * Like #IntrusiveCacheHook, but with room for the per-item data
+ * needed by #WTinyLfuCachePolicy.
+ */
+struct IntrusiveCacheLfuHook : IntrusiveCacheHook {
+	WTinyLfuItemData intrusive_cache_policy_data;
+};
+
+/**
+ * For classes which embed #IntrusiveCacheHook (or
+ * #IntrusiveCacheLfuHook) as base class.
  */
 template<typename T>
 struct IntrusiveCacheBaseHookTraits {
@@ -31,19 +41,24 @@ struct IntrusiveCacheBaseHookTraits {
 	}
 
 	static constexpr auto &ToHook(T &t) noexcept {
-		return static_cast<IntrusiveCacheHook &>(t);
+		if constexpr (std::derived_from<T, IntrusiveCacheLfuHook>)
+			return static_cast<IntrusiveCacheLfuHook &>(t);
+		else
+			return static_cast<IntrusiveCacheHook &>(t);
 	}
 };
 
 /**
- * For classes which embed #IntrusiveCacheHook as member.
+ * For classes which embed #IntrusiveCacheHook (or
+ * #IntrusiveCacheLfuHook) as member.
  */
 template<auto member>
 struct IntrusiveCacheMemberHookTraits {
 	using T = MemberPointerContainerType<decltype(member)>;
+	using _Hook = MemberPointerType<decltype(member)>;
 
 	static constexpr T *Cast(IntrusiveCacheHook *node) noexcept {
-		return &ContainerCast(*node, member);
+		return &ContainerCast(static_cast<_Hook &>(*node), member);
 	}
 
 	static constexpr auto &ToHook(T &t) noexcept {
@@ -83,16 +98,19 @@ struct IntrusiveCacheOperators {
 };
 
 /**
- * A simple LRU cache.  Items are allocated by the caller and are
- * "intrusive", i.e. they contain a structure that helps integrating
- * it in the container.
+ * A simple cache (LRU by default).  Items are allocated by the caller
+ * and are "intrusive", i.e. they contain a structure that helps
+ * integrating it in the container.
  *
  * @param table_size the size of the internal hash table
+ * @param Policy the eviction policy, e.g. #LruCachePolicy or
+ * #WTinyLfuCachePolicy (which requires #IntrusiveCacheLfuHook)
  */
 template<typename T,
 	 std::size_t table_size,
 	 IntrusiveCacheOperatorsConcept<T> Operators,
-	 typename HookTraits=IntrusiveCacheBaseHookTraits<T>>
+	 typename HookTraits=IntrusiveCacheBaseHookTraits<T>,
+	 typename Policy=LruCachePolicy>
 class IntrusiveCache {
 	[[no_unique_address]]
 	Operators ops;
@@ -113,11 +131,19 @@ class IntrusiveCache {
 			auto &hook = HookTraits::ToHook(t);
 			return hook.intrusive_cache_chronological_hook;
 		}
+
+		static constexpr auto &GetPolicyData(T &t) noexcept {
+			auto &hook = HookTraits::ToHook(t);
+			return hook.intrusive_cache_policy_data;
+		}
 	};
 
-	using ChronologicalList = IntrusiveList<T, ChronologicalHookTraits>;
+	using Lists = typename Policy::template Lists<T, ChronologicalHookTraits, 0>;
 
-	ChronologicalList chronological_list;
+	/**
+	 * All items in the order determined by the #Policy.
+	 */
+	Lists lists;
 
 	struct KeyHookTraits {
 		template<typename>
@@ -145,7 +171,7 @@ public:
 
 	[[nodiscard]]
 	explicit IntrusiveCache(std::size_t _max_size) noexcept
-		:max_size(_max_size) {}
+		:max_size(_max_size), lists(_max_size) {}
 
 	~IntrusiveCache() noexcept {
 		clear();
@@ -155,13 +181,13 @@ public:
 	IntrusiveCache &operator=(const IntrusiveCache &) = delete;
 
 	bool empty() const noexcept {
-		return chronological_list.empty();
+		return lists.empty();
 	}
 
 	void clear() noexcept {
 		key_map.clear();
 
-		chronological_list.clear_and_dispose([this](T *item){
+		lists.clear_and_dispose([this](T *item){
 #ifndef NDEBUG
 			assert(size >= ops.size_of(*item));
 			size -= ops.size_of(*item);
@@ -187,6 +213,10 @@ public:
 	template<typename K>
 	[[nodiscard]] [[gnu::pure]]
 	T *Get(K &&key) noexcept {
+		lists.Record([this, &key]{
+			return ops.hash(key);
+		});
+
 		auto i = key_map.find(std::forward<K>(key));
 		if (i == key_map.end())
 			return nullptr;
@@ -194,31 +224,37 @@ public:
 		T &item = *i;
 		assert(size >= ops.size_of(item));
 
-		/* move to the front of the chronological list */
-		chronological_list.erase(chronological_list.iterator_to(item));
-		chronological_list.push_front(item);
+		/* update the eviction order */
+		lists.Touch(item, GetWeightFunction());
 
 		return &item;
 	}
 
 	/**
-	 * Insert a new item into the cache.  The key must not exist
-	 * already, i.e. Get() has returned nullptr; it is not
-	 * possible to replace an existing item.  If the cache is
-	 * full, then the least recently used item is deleted, making
-	 * room for this one.
+	 * Insert a new item into the cache.  If an item with the same
+	 * key exists already, it is replaced.  If the cache is full,
+	 * then items chosen by the #Policy (e.g. the least recently
+	 * used ones) are deleted, making room for this one.
 	 */
 	void Put(T &item) {
-		auto [it, inserted] = key_map.insert_check(ops.get_key(item));
-		key_map.insert_commit(it, item);
-		chronological_list.push_front(item);
-		size += ops.size_of(item);
+		if (auto i = key_map.find(ops.get_key(item)); i != key_map.end())
+			RemoveItem(*i);
+
+		const std::size_t item_size = ops.size_of(item);
+
+		while (size + item_size > max_size && !lists.empty())
+			DisposeEvicted(lists.Evict(item_size, GetHashFunction(),
+						   GetWeightFunction()));
 
-		if (!inserted)
-			RemoveItem(*it);
+		key_map.insert(item);
+		lists.Insert(item, item_size, GetWeightFunction());
+		size += item_size;
 
+		/* if the new item alone is too large, it is deleted
+		   right away */
 		while (size > max_size)
-			RemoveItem(GetOldest());
+			DisposeEvicted(lists.Evict(0, GetHashFunction(),
+						   GetWeightFunction()));
 	}
 
 	/**
@@ -229,7 +265,7 @@ public:
 		assert(size >= ops.size_of(item));
 
 		key_map.erase(key_map.iterator_to(item));
-		chronological_list.erase(chronological_list.iterator_to(item));
+		lists.Erase(item, ops.size_of(item));
 		size -= ops.size_of(item);
 		ops.disposer(&item);
 	}
@@ -239,9 +275,9 @@ public:
 	 */
 	template<typename K>
 	void Remove(K &&key) noexcept {
-		T *item = Get(std::forward<K>(key));
-		if (item != nullptr)
-			RemoveItem(*item);
+		auto i = key_map.find(std::forward<K>(key));
+		if (i != key_map.end())
+			RemoveItem(*i);
 	}
 
 	/**
@@ -249,13 +285,13 @@ public:
 	 * the given predicate.
 	 */
 	void RemoveIf(std::predicate<const T &> auto p) noexcept {
-		chronological_list.remove_and_dispose_if(p, [this](T *item){
+		lists.remove_and_dispose_if(p, [this](T *item){
 			assert(size >= ops.size_of(*item));
 
 			key_map.erase(key_map.iterator_to(*item));
 			size -= ops.size_of(*item);
 			ops.disposer(item);
-		});
+		}, GetWeightFunction());
 	}
 
 	/**
@@ -264,15 +300,31 @@ public:
 	 * that function.
 	 */
 	void ForEach(std::invocable<const T &> auto f) const {
-		for (const auto &i : chronological_list)
-			f(i);
+		lists.ForEach(f);
 	}
 
 private:
-	[[gnu::pure]]
-	T &GetOldest() noexcept {
-		assert(!chronological_list.empty());
+	auto GetHashFunction() const noexcept {
+		return [this](const T &item){
+			return ops.hash(ops.get_key(item));
+		};
+	}
+
+	auto GetWeightFunction() const noexcept {
+		return [this](const T &item){
+			return ops.size_of(item);
+		};
+	}
+
+	/**
+	 * Delete an item which has already been removed from #lists
+	 * by Lists::Evict().
+	 */
+	void DisposeEvicted(T &item) noexcept {
+		assert(size >= ops.size_of(item));
 
-		return chronological_list.back();
+		key_map.erase(key_map.iterator_to(item));
+		size -= ops.size_of(item);
+		ops.disposer(&item);
 	}
 };
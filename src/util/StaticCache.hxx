@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "CachePolicy.hxx"
 #include "Cast.hxx"
 #include "Manual.hxx"
 #include "IntrusiveHashSet.hxx"
@@ -13,19 +14,22 @@
 #include <concepts>
 
 /**
- * A simple LRU cache.  Item lookup is done with a hash table.  No
- * dynamic allocation; all items are allocated statically inside this
- * class.
+ * A simple cache (LRU by default).  Item lookup is done with a hash
+ * table.  No dynamic allocation; all items are allocated statically
+ * inside this class.
  *
  * @param max_size the maximum number of items in the cache
  * @param table_size the size of the internal hash table; rule of
  * thumb: should be prime
+ * @param Policy the eviction policy, e.g. #LruCachePolicy or
+ * #WTinyLfuCachePolicy
  */
 template<typename Key, typename Data,
 	 std::size_t max_size,
 	 std::size_t table_size,
 	 typename Hash=std::hash<Key>,
-	 typename Equal=std::equal_to<Key>>
+	 typename Equal=std::equal_to<Key>,
+	 typename Policy=LruCachePolicy>
 class StaticCache {
 
 	struct Pair {
@@ -61,6 +65,9 @@ class StaticCache {
 		Manual<Pair> pair;
 
 	public:
+		[[no_unique_address]]
+		typename Policy::ItemData policy_data;
+
 		static constexpr Item &Cast(Data &data) {
 			return ContainerCast(Manual<Pair>::Cast(Pair::Cast(data)),
 					     &Item::pair);
@@ -123,7 +130,19 @@ class StaticCache {
 	 */
 	ItemList unallocated_list;
 
-	ItemList chronological_list;
+	struct ListHookTraits : IntrusiveListBaseHookTraits<Item> {
+		static constexpr auto &GetPolicyData(Item &item) noexcept {
+			return item.policy_data;
+		}
+	};
+
+	using Lists = typename Policy::template Lists<Item, ListHookTraits, max_size>;
+
+	/**
+	 * All allocated items in the order determined by the
+	 * #Policy.
+	 */
+	Lists lists{max_size};
 
 	using KeyMap =
 		IntrusiveHashSet<Item, table_size,
@@ -134,22 +153,25 @@ class StaticCache {
 
 	std::array<Item, max_size> buffer;
 
-	[[gnu::pure]]
-	Item &GetOldest() noexcept {
-		assert(!chronological_list.empty());
+	static constexpr std::size_t GetWeight(const Item &) noexcept {
+		return 1;
+	}
 
-		return chronological_list.back();
+	[[gnu::pure]]
+	std::size_t GetHash(const Item &item) const noexcept {
+		return map.hash_function()(item.GetKey());
 	}
 
 	/**
-	 * Remove the oldest item from the cache (both from the #map and
-	 * from #chronological_list), but do not destruct it.
+	 * Remove the item chosen by the #Policy from the cache (both
+	 * from the #map and from #lists), but do not destruct it.
 	 */
-	Item &RemoveOldest() noexcept {
-		Item &item = GetOldest();
+	Item &RemoveVictim() noexcept {
+		Item &item = lists.Evict(1, [this](const Item &i){
+			return GetHash(i);
+		}, GetWeight);
 
 		map.erase(map.iterator_to(item));
-		chronological_list.erase(chronological_list.iterator_to(item));
 
 		return item;
 	}
@@ -166,8 +188,8 @@ class StaticCache {
 	template<typename K, typename U>
 	Item &Make(K &&key, U &&data) {
 		if (unallocated_list.empty()) {
-			/* cache is full: delete oldest */
-			Item &item = RemoveOldest();
+			/* cache is full: evict one item */
+			Item &item = RemoveVictim();
 			item.Replace(std::forward<K>(key), std::forward<U>(data));
 			return item;
 		} else {
@@ -203,7 +225,7 @@ public:
 	}
 
 	bool IsEmpty() const noexcept {
-		return chronological_list.empty();
+		return lists.empty();
 	}
 
 	bool IsFull() const noexcept {
@@ -213,7 +235,7 @@ public:
 	void Clear() noexcept {
 		map.clear();
 
-		chronological_list.clear_and_dispose([this](Item *item){
+		lists.clear_and_dispose([this](Item *item){
 				item->Destruct();
 				unallocated_list.push_front(*item);
 			});
@@ -235,15 +257,18 @@ public:
 	template<typename K>
 	[[gnu::pure]]
 	Data *Get(K &&key) noexcept {
+		lists.Record([this, &key]{
+			return map.hash_function()(key);
+		});
+
 		auto i = map.find(std::forward<K>(key));
 		if (i == map.end())
 			return nullptr;
 
 		Item &item = *i;
 
-		/* move to the front of the chronological list */
-		chronological_list.erase(chronological_list.iterator_to(item));
-		chronological_list.push_front(item);
+		/* update the eviction order */
+		lists.Touch(item, GetWeight);
 
 		return &item.GetData();
 	}
@@ -252,8 +277,8 @@ public:
 	 * Insert a new item into the cache.  The key must not exist
 	 * already, i.e. Get() has returned nullptr; it is not
 	 * possible to replace an existing item.  If the cache is
-	 * full, then the least recently used item is deleted, making
-	 * room for this one.
+	 * full, then the item chosen by the #Policy (e.g. the least
+	 * recently used one) is deleted, making room for this one.
 	 */
 	template<typename K, typename U>
 	Data &Put(K &&key, U &&data) {
@@ -261,7 +286,7 @@ public:
 		       "Key must not exist already");
 
 		Item &item = Make(std::forward<K>(key), std::forward<U>(data));
-		chronological_list.push_front(item);
+		lists.Insert(item, 1, GetWeight);
 		map.insert(item);
 		return item.GetData();
 	}
@@ -275,7 +300,7 @@ public:
 		auto [position, inserted] = map.insert_check(key);
 		if (inserted) {
 			Item &item = Make(std::forward<K>(key), std::forward<U>(data));
-			chronological_list.push_front(item);
+			lists.Insert(item, 1, GetWeight);
 			map.insert_commit(position, item);
 			return item.GetData();
 		} else {
@@ -301,7 +326,7 @@ public:
 		auto &item = Item::Cast(data);
 
 		map.erase(map.iterator_to(item));
-		chronological_list.erase(chronological_list.iterator_to(item));
+		lists.Erase(item, 1);
 
 		item.Destruct();
 		unallocated_list.push_front(item);
@@ -319,7 +344,7 @@ public:
 		Item &item = *i;
 
 		map.erase(i);
-		chronological_list.erase(chronological_list.iterator_to(item));
+		lists.Erase(item, 1);
 
 		item.Destruct();
 		unallocated_list.push_front(item);
@@ -330,14 +355,14 @@ public:
 	 * the given predicate.
 	 */
 	void RemoveIf(std::predicate<const Key &, const Data &> auto p) noexcept {
-		chronological_list.remove_and_dispose_if([&p](const Item &item){
+		lists.remove_and_dispose_if([&p](const Item &item){
 				return p(item.GetKey(), item.GetData());
 			},
 			[this](Item *item){
 				map.erase(map.iterator_to(*item));
 				item->Destruct();
 				unallocated_list.push_front(*item);
-			});
+			}, GetWeight);
 	}
 
 	/**
@@ -346,7 +371,8 @@ public:
 	 * that function.
 	 */
 	void ForEach(std::invocable<const Key &, const Data &> auto f) const {
-		for (const auto &i : chronological_list)
+		lists.ForEach([&f](const Item &i){
 			f(i.GetKey(), i.GetData());
+		});
 	}
 };
@@ -13,6 +13,10 @@
  *
  * This class does not own the memory the #value points to, as it only
  * contains a std::string_view.
+ *
+ * The default hash function (djb_hash()) is fast for short strings
+ * and predictable; for keys from untrusted sources, consider
+ * MakeSeededStringWithHash() from system/SeededHash.hxx.
  */
 struct StringWithHash {
 	std::size_t hash;
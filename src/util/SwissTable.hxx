@@ -0,0 +1,481 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * The core of an open-addressing hash table in the style of Google's
+ * "Swiss tables" (Abseil's flat_hash_map).  Next to the array of
+ * slots, there is an array of control bytes, one per slot, which
+ * contain 7 bits of the slot's hash (or a marker for empty/deleted
+ * slots).  A lookup compares a whole group of control bytes at once
+ * (with SSE2 if available) and looks at the slots only if their
+ * control byte matches, so a lookup usually touches only one or two
+ * cache lines.
+ *
+ * This is the common implementation of #FlatHashMap and
+ * #FlatPointerSet; use those instead of this.
+ */
+
+#pragma once
+
+#include "ByteOrder.hxx"
+#include "Unaligned.hxx"
+
+#include <algorithm> // for std::max()
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring> // for std::memset()
+#include <memory> // for std::construct_at()
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace SwissTable {
+
+/*
+ * Control byte values.  The control byte of a "full" slot is
+ * non-negative and contains the lower 7 bits of the hash ("H2").
+ */
+static constexpr int8_t EMPTY = -128;
+static constexpr int8_t DELETED = -2;
+
+/**
+ * A mask with one bit (or one byte) per slot of a #Group.
+ *
+ * @param WIDTH the number of slots
+ * @param SHIFT log2 of the number of mask bits per slot
+ */
+template<typename T, std::size_t WIDTH, unsigned SHIFT>
+class BitMask {
+	T mask;
+
+public:
+	explicit constexpr BitMask(T _mask) noexcept
+		:mask(_mask) {}
+
+	constexpr operator bool() const noexcept {
+		return mask != 0;
+	}
+
+	/**
+	 * Returns the index of the lowest slot in this mask, which
+	 * is also the number of trailing unset slots.  Must not be
+	 * called on an empty mask.
+	 */
+	constexpr unsigned Lowest() const noexcept {
+		return std::countr_zero(mask) >> SHIFT;
+	}
+
+	/**
+	 * Returns the number of leading unset slots.  Must not be
+	 * called on an empty mask.
+	 */
+	constexpr unsigned LeadingZeros() const noexcept {
+		constexpr unsigned unused_bits = sizeof(T) * 8 - (WIDTH << SHIFT);
+		return (std::countl_zero(mask) - unused_bits) >> SHIFT;
+	}
+
+	constexpr void ClearLowest() noexcept {
+		mask &= mask - 1;
+	}
+};
+
+#ifdef __SSE2__
+
+/**
+ * A group of control bytes which are examined together.
+ */
+class Group {
+	__m128i ctrl;
+
+public:
+	static constexpr std::size_t WIDTH = 16;
+
+	using Mask = BitMask<uint32_t, WIDTH, 0>;
+
+	explicit Group(const int8_t *p) noexcept
+		:ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) {}
+
+	/**
+	 * Find all slots whose control byte equals the given value.
+	 */
+	Mask Match(int8_t value) const noexcept {
+		const auto match = _mm_set1_epi8(value);
+		return Mask{static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(match, ctrl)))};
+	}
+
+	Mask MatchEmpty() const noexcept {
+		return Match(EMPTY);
+	}
+
+	Mask MatchEmptyOrDeleted() const noexcept {
+		/* the two have the sign bit set, full slots don't */
+		return Mask{static_cast<uint32_t>(_mm_movemask_epi8(ctrl))};
+	}
+};
+
+#else
+
+/**
+ * A group of control bytes which are examined together.  This
+ * portable implementation operates on a 64 bit integer ("SIMD within
+ * a register").
+ */
+class Group {
+	uint64_t ctrl;
+
+	static constexpr uint64_t LSBS = 0x0101010101010101ULL;
+	static constexpr uint64_t MSBS = 0x8080808080808080ULL;
+
+public:
+	static constexpr std::size_t WIDTH = 8;
+
+	using Mask = BitMask<uint64_t, WIDTH, 3>;
+
+	explicit Group(const int8_t *p) noexcept
+		:ctrl(FromLE64(LoadUnaligned<uint64_t>(p))) {}
+
+	/**
+	 * Find all slots whose control byte equals the given value.
+	 * This may have false positives (after a real match), which
+	 * is harmless because the caller compares the keys anyway.
+	 */
+	Mask Match(int8_t value) const noexcept {
+		const uint64_t x = ctrl ^ (LSBS * static_cast<uint8_t>(value));
+		return Mask{(x - LSBS) & ~x & MSBS};
+	}
+
+	Mask MatchEmpty() const noexcept {
+		/* EMPTY is the only value with the sign bit set and
+		   bit 1 clear */
+		return Mask{ctrl & ~(ctrl << 6) & MSBS};
+	}
+
+	Mask MatchEmptyOrDeleted() const noexcept {
+		return Mask{ctrl & MSBS};
+	}
+};
+
+#endif
+
+/**
+ * Mix the bits of the hash value, so both the lower bits (which
+ * select the position) and the 7 bits in the control bytes are
+ * usable even with a weak hash function (e.g. std::hash<int>, which
+ * is the identity function).
+ */
+[[gnu::const]] [[gnu::always_inline]]
+constexpr std::size_t
+Mix(std::size_t hash) noexcept
+{
+	if constexpr (sizeof(std::size_t) >= 8) {
+		const uint64_t h = static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ULL;
+		return static_cast<std::size_t>(h ^ (h >> 32));
+	} else {
+		const uint32_t h = static_cast<uint32_t>(hash) * 0x9e3779b9U;
+		return h ^ (h >> 16);
+	}
+}
+
+/**
+ * The part of the (mixed) hash which selects the position.
+ */
+constexpr std::size_t
+H1(std::size_t hash) noexcept
+{
+	return hash >> 7;
+}
+
+/**
+ * The part of the (mixed) hash which is stored in the control byte.
+ */
+constexpr int8_t
+H2(std::size_t hash) noexcept
+{
+	return static_cast<int8_t>(hash & 0x7f);
+}
+
+/**
+ * The open-addressing hash table.  Slots are copied with memcpy()
+ * semantics when the table grows, therefore the slot type must be
+ * trivially copyable (and so pointers to slots are invalidated).
+ *
+ * @param Operators a class which contains functions `hash`, `equal`
+ * and `get_key` (which gets the key from a slot)
+ */
+template<typename Slot, typename Operators>
+requires std::is_trivially_copyable_v<Slot>
+class Table {
+	[[no_unique_address]]
+	Operators ops;
+
+	/**
+	 * The control bytes: #capacity plus Group::WIDTH.  The last
+	 * Group::WIDTH bytes mirror the first ones, so a #Group can
+	 * be loaded at any position without wrapping around.  This
+	 * allocation also contains the #slots.
+	 */
+	int8_t *ctrl = nullptr;
+
+	Slot *slots = nullptr;
+
+	/**
+	 * The number of slots: either zero or a power of two which is
+	 * at least Group::WIDTH.
+	 */
+	std::size_t capacity = 0;
+
+	std::size_t n_items = 0;
+
+	/**
+	 * The number of items which can be inserted before the table
+	 * needs to grow.  Deleted slots count as used (they get
+	 * cleaned up by the next Rehash()), so there are always
+	 * empty slots which terminate a probe sequence.
+	 */
+	std::size_t growth_left = 0;
+
+	static constexpr std::align_val_t ALIGNMENT{std::max(alignof(Slot), Group::WIDTH)};
+
+public:
+	Table() noexcept = default;
+
+	explicit Table(const Operators &_ops) noexcept
+		:ops(_ops) {}
+
+	Table(Table &&src) noexcept
+		:ops(std::move(src.ops)),
+		 ctrl(std::exchange(src.ctrl, nullptr)),
+		 slots(std::exchange(src.slots, nullptr)),
+		 capacity(std::exchange(src.capacity, 0)),
+		 n_items(std::exchange(src.n_items, 0)),
+		 growth_left(std::exchange(src.growth_left, 0)) {}
+
+	~Table() noexcept {
+		Deallocate(ctrl);
+	}
+
+	Table &operator=(Table &&src) noexcept {
+		using std::swap;
+		swap(ops, src.ops);
+		swap(ctrl, src.ctrl);
+		swap(slots, src.slots);
+		swap(capacity, src.capacity);
+		swap(n_items, src.n_items);
+		swap(growth_left, src.growth_left);
+		return *this;
+	}
+
+	constexpr const Operators &GetOperators() const noexcept {
+		return ops;
+	}
+
+	constexpr bool empty() const noexcept {
+		return n_items == 0;
+	}
+
+	constexpr std::size_t size() const noexcept {
+		return n_items;
+	}
+
+	void clear() noexcept {
+		if (capacity == 0)
+			return;
+
+		std::memset(ctrl, EMPTY, capacity + Group::WIDTH);
+		n_items = 0;
+		growth_left = MaxLoad(capacity);
+	}
+
+	/**
+	 * Make room for at least the given number of items.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	void reserve(std::size_t n) {
+		if (n > MaxLoad(capacity))
+			Rehash(CapacityFor(n));
+	}
+
+	[[gnu::pure]]
+	Slot *Find(const auto &key) const noexcept {
+		return Find(key, Mix(ops.hash(key)));
+	}
+
+	/**
+	 * Look up the given key.  If it does not exist yet, allocate
+	 * a slot for it.  The new slot is uninitialized and must be
+	 * initialized by the caller (e.g. using std::construct_at())
+	 * before any other method is called.
+	 *
+	 * Throws std::bad_alloc on error.
+	 *
+	 * @return the slot and true if it is new
+	 */
+	std::pair<Slot *, bool> FindOrPrepareInsert(const auto &key) {
+		const std::size_t hash = Mix(ops.hash(key));
+		if (Slot *slot = Find(key, hash))
+			return {slot, false};
+
+		return {PrepareInsert(hash), true};
+	}
+
+	void Erase(Slot &slot) noexcept {
+		const std::size_t i = &slot - slots;
+		assert(i < capacity);
+		assert(ctrl[i] >= 0);
+
+		--n_items;
+
+		/* if every window of Group::WIDTH slots around this
+		   one contains an empty slot, no probe sequence has
+		   ever continued past this slot, and it can be
+		   marked empty instead of leaving a tombstone */
+		const std::size_t mask = capacity - 1;
+		const auto empty_after = Group{ctrl + i}.MatchEmpty();
+		const auto empty_before = Group{ctrl + ((i - Group::WIDTH) & mask)}.MatchEmpty();
+		if (empty_before && empty_after &&
+		    empty_after.Lowest() + empty_before.LeadingZeros() < Group::WIDTH) {
+			SetCtrl(i, EMPTY);
+			++growth_left;
+		} else
+			SetCtrl(i, DELETED);
+	}
+
+	void ForEach(auto &&f) {
+		for (std::size_t i = 0; i < capacity; ++i)
+			if (ctrl[i] >= 0)
+				f(slots[i]);
+	}
+
+	void ForEach(auto &&f) const {
+		for (std::size_t i = 0; i < capacity; ++i)
+			if (ctrl[i] >= 0)
+				f(std::as_const(slots[i]));
+	}
+
+private:
+	/**
+	 * The maximum number of items (7/8 of the capacity).
+	 */
+	static constexpr std::size_t MaxLoad(std::size_t capacity) noexcept {
+		return capacity - capacity / 8;
+	}
+
+	static constexpr std::size_t CapacityFor(std::size_t n) noexcept {
+		return std::max(std::bit_ceil(n + n / 7 + 1), Group::WIDTH);
+	}
+
+	static constexpr std::size_t SlotOffset(std::size_t capacity) noexcept {
+		return (capacity + Group::WIDTH + alignof(Slot) - 1) & ~(alignof(Slot) - 1);
+	}
+
+	static void Deallocate(int8_t *p) noexcept {
+		if (p != nullptr)
+			::operator delete(p, ALIGNMENT);
+	}
+
+	[[gnu::pure]]
+	Slot *Find(const auto &key, std::size_t hash) const noexcept {
+		if (capacity == 0)
+			return nullptr;
+
+		const std::size_t mask = capacity - 1;
+		const int8_t h2 = H2(hash);
+
+		for (std::size_t offset = H1(hash) & mask, step = Group::WIDTH;;
+		     offset = (offset + step) & mask, step += Group::WIDTH) {
+			const Group group{ctrl + offset};
+
+			for (auto m = group.Match(h2); m; m.ClearLowest()) {
+				Slot &slot = slots[(offset + m.Lowest()) & mask];
+				if (ops.equal(key, ops.get_key(slot))) [[likely]]
+					return &slot;
+			}
+
+			if (group.MatchEmpty()) [[likely]]
+				return nullptr;
+		}
+	}
+
+	/**
+	 * Find the first empty or deleted slot in the probe sequence
+	 * of the given hash.
+	 */
+	[[gnu::pure]]
+	std::size_t FindFirstNonFull(std::size_t hash) const noexcept {
+		assert(capacity > 0);
+
+		const std::size_t mask = capacity - 1;
+
+		for (std::size_t offset = H1(hash) & mask, step = Group::WIDTH;;
+		     offset = (offset + step) & mask, step += Group::WIDTH) {
+			if (const auto m = Group{ctrl + offset}.MatchEmptyOrDeleted())
+				return (offset + m.Lowest()) & mask;
+		}
+	}
+
+	void SetCtrl(std::size_t i, int8_t value) noexcept {
+		ctrl[i] = value;
+
+		if (i < Group::WIDTH)
+			/* update the mirror */
+			ctrl[capacity + i] = value;
+	}
+
+	Slot *PrepareInsert(std::size_t hash) {
+		if (growth_left == 0) [[unlikely]] {
+			/* if there are many tombstones, rehash at
+			   the same capacity to get rid of them */
+			if (capacity > 0 && n_items <= MaxLoad(capacity) / 2)
+				Rehash(capacity);
+			else
+				Rehash(std::max(capacity * 2, Group::WIDTH));
+		}
+
+		const std::size_t i = FindFirstNonFull(hash);
+		growth_left -= ctrl[i] == EMPTY;
+		SetCtrl(i, H2(hash));
+		++n_items;
+		return slots + i;
+	}
+
+	void Rehash(std::size_t new_capacity) {
+		assert(std::has_single_bit(new_capacity));
+		assert(new_capacity >= Group::WIDTH);
+		assert(MaxLoad(new_capacity) >= n_items);
+
+		int8_t *const old_ctrl = ctrl;
+		Slot *const old_slots = slots;
+		const std::size_t old_capacity = capacity;
+
+		void *p = ::operator new(SlotOffset(new_capacity) + new_capacity * sizeof(Slot),
+					 ALIGNMENT);
+		ctrl = static_cast<int8_t *>(p);
+		slots = reinterpret_cast<Slot *>(static_cast<std::byte *>(p) + SlotOffset(new_capacity));
+		capacity = new_capacity;
+		std::memset(ctrl, EMPTY, capacity + Group::WIDTH);
+
+		for (std::size_t i = 0; i < old_capacity; ++i) {
+			if (old_ctrl[i] < 0)
+				continue;
+
+			const std::size_t hash = Mix(ops.hash(ops.get_key(old_slots[i])));
+			const std::size_t j = FindFirstNonFull(hash);
+			SetCtrl(j, H2(hash));
+			std::construct_at(slots + j, old_slots[i]);
+		}
+
+		growth_left = MaxLoad(capacity) - n_items;
+
+		Deallocate(old_ctrl);
+	}
+};
+
+} // namespace SwissTable
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+/*
+ * Implementation of Wang Yi's "wyhash" (final version 4.2), a fast
+ * 64-bit hash function which processes 8 bytes at a time.
+ * https://github.com/wangyi-fudan/wyhash (public domain)
+ *
+ * Unlike djb_hash() and the FNV functions, it takes a seed; with a
+ * secret random seed (see system/HashSeed.hxx), it is hard for an
+ * attacker to construct many keys with the same hash (but it is not
+ * a cryptographic hash function).
+ */
+
+#pragma once
+
+#include "ByteOrder.hxx"
+#include "Unaligned.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace WyHashDetail {
+
+static constexpr uint64_t SECRET[] = {
+	0x2d358dccaa6c78a5ULL,
+	0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL,
+	0x4d5a2da51de1aa47ULL,
+};
+
+/**
+ * 64x64 to 128 bit multiplication; returns the lower half in #a and
+ * the upper half in #b.
+ */
+[[gnu::always_inline]]
+static inline void
+Mum(uint64_t &a, uint64_t &b) noexcept
+{
+#ifdef __SIZEOF_INT128__
+	__extension__ typedef unsigned __int128 uint128_t;
+
+	const uint128_t r = static_cast<uint128_t>(a) * b;
+	a = static_cast<uint64_t>(r);
+	b = static_cast<uint64_t>(r >> 64);
+#else
+	const uint64_t ha = a >> 32, hb = b >> 32;
+	const uint64_t la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+	const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	const uint64_t t = rl + (rm0 << 32);
+	uint64_t c = t < rl;
+	const uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	a = lo;
+	b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+[[gnu::always_inline]]
+static inline uint64_t
+Mix(uint64_t a, uint64_t b) noexcept
+{
+	Mum(a, b);
+	return a ^ b;
+}
+
+[[gnu::always_inline]]
+static inline uint64_t
+Read8(const std::byte *p) noexcept
+{
+	return FromLE64(LoadUnaligned<uint64_t>(p));
+}
+
+[[gnu::always_inline]]
+static inline uint64_t
+Read4(const std::byte *p) noexcept
+{
+	return FromLE32(LoadUnaligned<uint32_t>(p));
+}
+
+/**
+ * Read 1 to 3 bytes.
+ */
+[[gnu::always_inline]]
+static inline uint64_t
+Read3(const std::byte *p, std::size_t k) noexcept
+{
+	return (static_cast<uint64_t>(p[0]) << 16) |
+		(static_cast<uint64_t>(p[k >> 1]) << 8) |
+		static_cast<uint64_t>(p[k - 1]);
+}
+
+} // namespace WyHashDetail
+
+[[nodiscard]] [[gnu::pure]] [[gnu::hot]]
+inline uint64_t
+WyHash(std::span<const std::byte> src, uint64_t seed=0) noexcept
+{
+	using namespace WyHashDetail;
+
+	const std::byte *p = src.data();
+	const std::size_t len = src.size();
+
+	seed ^= Mix(seed ^ SECRET[0], SECRET[1]);
+
+	uint64_t a, b;
+	if (len <= 16) [[likely]] {
+		if (len >= 4) [[likely]] {
+			/* two (possibly overlapping) 4 byte reads
+			   from each end */
+			const std::size_t o = (len >> 3) << 2;
+			a = (Read4(p) << 32) | Read4(p + o);
+			b = (Read4(p + len - 4) << 32) | Read4(p + len - 4 - o);
+		} else if (len > 0) [[likely]] {
+			a = Read3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		std::size_t i = len;
+		if (i >= 48) [[unlikely]] {
+			/* three independent lanes */
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = Mix(Read8(p) ^ SECRET[1], Read8(p + 8) ^ seed);
+				see1 = Mix(Read8(p + 16) ^ SECRET[2], Read8(p + 24) ^ see1);
+				see2 = Mix(Read8(p + 32) ^ SECRET[3], Read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i >= 48);
+
+			seed ^= see1 ^ see2;
+		}
+
+		while (i > 16) {
+			seed = Mix(Read8(p) ^ SECRET[1], Read8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+
+		/* the last 16 bytes (may overlap with the previous
+		   block) */
+		a = Read8(p + i - 16);
+		b = Read8(p + i - 8);
+	}
+
+	a ^= SECRET[1];
+	b ^= seed;
+	Mum(a, b);
+	return Mix(a ^ SECRET[0] ^ len, b ^ SECRET[1]);
+}
+
+[[nodiscard]] [[gnu::pure]] [[gnu::hot]]
+inline uint64_t
+WyHash(std::string_view src, uint64_t seed=0) noexcept
+{
+	return WyHash(std::as_bytes(std::span{src}), seed);
+}
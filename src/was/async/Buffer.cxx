@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "Buffer.hxx"
+
+#include <algorithm>
+
+namespace Was {
+
+std::span<std::byte>
+Buffer::Write()
+{
+	const std::size_t limit = length != UNKNOWN_SIZE
+		? length
+		: MAX_SIZE;
+
+	if (fill == limit)
+		return {};
+
+	if (fill == storage.size()) {
+		/* allocate the announced length at once or double
+		   the buffer size */
+		const std::size_t new_size = length != UNKNOWN_SIZE
+			? length
+			: std::clamp(storage.size() * 2, INITIAL_SIZE, MAX_SIZE);
+
+		const auto new_storage = pool.Allocate(new_size);
+		if (fill > 0)
+			std::copy_n(storage.data(), fill, new_storage.data());
+
+		if (storage.data() != nullptr)
+			BufferPool::Free(storage.data());
+
+		storage = new_storage;
+	}
+
+	return storage.subspan(fill, std::min(storage.size(), limit) - fill);
+}
+
+DisposableBuffer
+Buffer::ToDisposableBuffer() noexcept
+{
+	if (storage.data() == nullptr) {
+		/* nothing was allocated (empty body); return a
+		   non-nullptr pointer anyway */
+		static constexpr std::byte empty{};
+		return {ToNopPointer(&empty), 0};
+	}
+
+	return {
+		DisposablePointer{std::exchange(storage, {}).data(), Dispose},
+		std::exchange(fill, 0),
+	};
+}
+
+} // namespace Was
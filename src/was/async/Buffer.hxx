@@ -4,24 +4,48 @@
 
 #pragma once
 
+#include "BufferPool.hxx"
 #include "util/DisposableBuffer.hxx"
 
-#include <array>
 #include <span>
+#include <utility>
 
 namespace Was {
 
+/**
+ * Collects a body received from the WAS pipe.  Its memory is
+ * allocated from a #BufferPool according to the announced length; as
+ * long as the length is unknown, it starts small and grows as data
+ * arrives.
+ */
 class Buffer {
-	static constexpr std::size_t MAX_SIZE = 256 * 1024;
+	static constexpr std::size_t MAX_SIZE = BufferPool::MAX_SIZE;
 	static constexpr std::size_t UNKNOWN_SIZE = ~std::size_t{};
 
+	/**
+	 * The initial allocation if the length is not yet known.
+	 */
+	static constexpr std::size_t INITIAL_SIZE = 16384;
+
+	BufferPool &pool;
+
+	std::span<std::byte> storage;
+
 	std::size_t length = UNKNOWN_SIZE;
 	std::size_t fill = 0;
 
-	using Array = std::array<std::byte, MAX_SIZE>;
-	Array buffer;
-
 public:
+	explicit Buffer(BufferPool &_pool=BufferPool::GetDefault()) noexcept
+		:pool(_pool) {}
+
+	~Buffer() noexcept {
+		if (storage.data() != nullptr)
+			BufferPool::Free(storage.data());
+	}
+
+	Buffer(const Buffer &) = delete;
+	Buffer &operator=(const Buffer &) = delete;
+
 	static constexpr std::size_t max_size() noexcept {
 		return MAX_SIZE;
 	}
@@ -31,7 +55,8 @@ public:
 	}
 
 	bool SetLength(std::size_t _length) noexcept {
-		if (length != UNKNOWN_SIZE || _length > MAX_SIZE)
+		if (length != UNKNOWN_SIZE || _length > MAX_SIZE ||
+		    _length < fill)
 			return false;
 
 		length = _length;
@@ -42,26 +67,31 @@ public:
 		return fill == length;
 	}
 
-	constexpr std::span<std::byte> Write() noexcept {
-		return {&buffer[fill], MAX_SIZE - fill};
-	}
+	/**
+	 * Returns a writable buffer, allocating or growing the
+	 * storage if necessary.  If the length is known, the
+	 * returned buffer is limited to the remaining length.
+	 *
+	 * Throws std::bad_alloc on error.
+	 *
+	 * @return the writable buffer; empty if the maximum size has
+	 * been reached
+	 */
+	std::span<std::byte> Write();
 
 	void Append(std::size_t nbytes) noexcept {
 		fill += nbytes;
 	}
 
-	static void Dispose(void *ptr) noexcept {
-		auto &buffer = *(Array *)ptr;
-		auto &ib = ContainerCast(buffer, &Buffer::buffer);
-		delete &ib;
-	}
+	/**
+	 * Transfer ownership of the storage to a #DisposableBuffer.
+	 * After returning, this object is empty.
+	 */
+	DisposableBuffer ToDisposableBuffer() noexcept;
 
-	DisposablePointer ToDisposablePointer() noexcept {
-		return {&buffer, Dispose};
-	}
-
-	DisposableBuffer ToDisposableBuffer() noexcept {
-		return {ToDisposablePointer(), fill};
+private:
+	static void Dispose(void *ptr) noexcept {
+		BufferPool::Free(ptr);
 	}
 };
 
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "BufferPool.hxx"
+
+#include <bit>
+#include <cassert>
+#include <new>
+
+namespace Was {
+
+/**
+ * The header which precedes each buffer.
+ */
+struct alignas(std::max_align_t) BufferPool::Chunk {
+	BufferPool &pool;
+
+	/**
+	 * The next item in the free list.
+	 */
+	Chunk *next = nullptr;
+
+	const unsigned size_class;
+
+	Chunk(BufferPool &_pool, unsigned _size_class) noexcept
+		:pool(_pool), size_class(_size_class) {}
+
+	static constexpr std::size_t GetSize(unsigned size_class) noexcept {
+		return MIN_SIZE << size_class;
+	}
+
+	std::size_t GetSize() const noexcept {
+		return GetSize(size_class);
+	}
+
+	std::byte *GetData() noexcept {
+		return reinterpret_cast<std::byte *>(this + 1);
+	}
+
+	static Chunk &FromData(void *p) noexcept {
+		return *(reinterpret_cast<Chunk *>(p) - 1);
+	}
+
+	static Chunk *New(BufferPool &pool, unsigned size_class) {
+		void *p = ::operator new(sizeof(Chunk) + GetSize(size_class));
+		return new(p) Chunk(pool, size_class);
+	}
+
+	void Delete() noexcept {
+		this->~Chunk();
+		::operator delete(this);
+	}
+};
+
+static constexpr unsigned
+GetSizeClass(std::size_t size) noexcept
+{
+	if (size <= BufferPool::MIN_SIZE)
+		return 0;
+
+	return std::bit_width(size - 1) - std::bit_width(BufferPool::MIN_SIZE - 1);
+}
+
+static_assert(GetSizeClass(1) == 0);
+static_assert(GetSizeClass(BufferPool::MIN_SIZE) == 0);
+static_assert(GetSizeClass(BufferPool::MIN_SIZE + 1) == 1);
+static_assert(GetSizeClass(BufferPool::MAX_SIZE) == 6);
+
+BufferPool::~BufferPool() noexcept
+{
+	Compress();
+
+	assert(netto_size == 0);
+}
+
+namespace {
+
+/**
+ * Holds the default #BufferPool without ever destroying it: buffers
+ * may still be in use during static destruction (e.g. owned by
+ * other static objects), and freeing them after the pool has been
+ * destroyed would be a use-after-free.
+ */
+union DefaultBufferPool {
+	BufferPool pool;
+
+	constexpr DefaultBufferPool() noexcept :pool() {}
+	~DefaultBufferPool() noexcept {}
+};
+
+} // anonymous namespace
+
+/* constant-initialized (i.e. ready before any thread starts) instead
+   of a function-local static, because we build with
+   -fno-threadsafe-statics */
+static constinit DefaultBufferPool default_buffer_pool;
+
+BufferPool &
+BufferPool::GetDefault() noexcept
+{
+	return default_buffer_pool.pool;
+}
+
+std::span<std::byte>
+BufferPool::Allocate(std::size_t size)
+{
+	assert(size <= MAX_SIZE);
+
+	const unsigned size_class = GetSizeClass(size);
+	const std::size_t chunk_size = Chunk::GetSize(size_class);
+
+	{
+		const std::scoped_lock lock{mutex};
+
+		netto_size += chunk_size;
+
+		auto &list = free_lists[size_class];
+		if (list.head != nullptr) {
+			Chunk *chunk = list.head;
+			list.head = chunk->next;
+			--list.n;
+			++n_hits;
+			return {chunk->GetData(), chunk_size};
+		}
+
+		++n_misses;
+		brutto_size += chunk_size;
+	}
+
+	/* allocate outside of the lock */
+
+	try {
+		return {Chunk::New(*this, size_class)->GetData(), chunk_size};
+	} catch (...) {
+		const std::scoped_lock lock{mutex};
+		netto_size -= chunk_size;
+		brutto_size -= chunk_size;
+		throw;
+	}
+}
+
+inline void
+BufferPool::Free(Chunk &chunk) noexcept
+{
+	const std::size_t chunk_size = chunk.GetSize();
+
+	{
+		const std::scoped_lock lock{mutex};
+
+		assert(netto_size >= chunk_size);
+		netto_size -= chunk_size;
+
+		auto &list = free_lists[chunk.size_class];
+		if ((list.n + 1) * chunk_size <= MAX_CACHED_PER_CLASS) {
+			chunk.next = list.head;
+			list.head = &chunk;
+			++list.n;
+			return;
+		}
+
+		brutto_size -= chunk_size;
+	}
+
+	chunk.Delete();
+}
+
+void
+BufferPool::Free(void *p) noexcept
+{
+	assert(p != nullptr);
+
+	auto &chunk = Chunk::FromData(p);
+	chunk.pool.Free(chunk);
+}
+
+void
+BufferPool::Compress() noexcept
+{
+	Chunk *chunks = nullptr;
+
+	{
+		const std::scoped_lock lock{mutex};
+
+		for (auto &list : free_lists) {
+			while (list.head != nullptr) {
+				Chunk *chunk = list.head;
+				list.head = chunk->next;
+				brutto_size -= chunk->GetSize();
+
+				chunk->next = chunks;
+				chunks = chunk;
+			}
+
+			list.n = 0;
+		}
+	}
+
+	while (chunks != nullptr) {
+		Chunk *chunk = chunks;
+		chunks = chunk->next;
+		chunk->Delete();
+	}
+}
+
+BufferPool::Stats
+BufferPool::GetStats() const noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	return {
+		.allocator = {
+			.brutto_size = brutto_size,
+			.netto_size = netto_size,
+		},
+		.hits = n_hits,
+		.misses = n_misses,
+	};
+}
+
+} // namespace Was
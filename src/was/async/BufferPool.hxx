@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "memory/AllocatorStats.hxx"
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <span>
+
+namespace Was {
+
+/**
+ * A recycling allocator for WAS body buffers (see #Buffer).  Buffers
+ * are rounded up to a power of two between #MIN_SIZE and #MAX_SIZE;
+ * freed buffers are kept in a per-size free list, which avoids
+ * touching fresh pages for each request.
+ *
+ * This class is thread-safe, because a body may be disposed in a
+ * different thread than the one which has received it.
+ */
+class BufferPool {
+	struct Chunk;
+
+public:
+	static constexpr std::size_t MIN_SIZE = 4096;
+	static constexpr std::size_t MAX_SIZE = 256 * 1024;
+
+private:
+	static constexpr std::size_t N_CLASSES = 7;
+	static_assert(MIN_SIZE << (N_CLASSES - 1) == MAX_SIZE);
+
+	/**
+	 * Don't keep more than this number of bytes per size class
+	 * in the free list; the rest is returned to the heap.
+	 */
+	static constexpr std::size_t MAX_CACHED_PER_CLASS = 1024 * 1024;
+
+	mutable std::mutex mutex;
+
+	struct FreeList {
+		Chunk *head = nullptr;
+		std::size_t n = 0;
+	};
+
+	std::array<FreeList, N_CLASSES> free_lists;
+
+	/**
+	 * Bytes allocated from the heap (in use and cached).
+	 */
+	std::size_t brutto_size = 0;
+
+	/**
+	 * Bytes handed out to callers.
+	 */
+	std::size_t netto_size = 0;
+
+	/**
+	 * Number of Allocate() calls which were served from a free
+	 * list and which needed a heap allocation.
+	 */
+	std::size_t n_hits = 0, n_misses = 0;
+
+public:
+	struct Stats {
+		AllocatorStats allocator;
+		std::size_t hits, misses;
+	};
+
+	constexpr BufferPool() noexcept = default;
+	~BufferPool() noexcept;
+
+	BufferPool(const BufferPool &) = delete;
+	BufferPool &operator=(const BufferPool &) = delete;
+
+	/**
+	 * The pool used by #Buffer.  It is never destroyed, so
+	 * buffers may outlive all other static objects.
+	 */
+	[[gnu::const]]
+	static BufferPool &GetDefault() noexcept;
+
+	/**
+	 * Allocate a buffer with at least the given size.
+	 *
+	 * Throws std::bad_alloc on error.
+	 *
+	 * @param size the minimum size; must not be larger than
+	 * #MAX_SIZE
+	 * @return the buffer, which may be larger than requested
+	 */
+	std::span<std::byte> Allocate(std::size_t size);
+
+	/**
+	 * Return a buffer obtained from Allocate() (of any
+	 * #BufferPool instance) to its pool.
+	 */
+	static void Free(void *p) noexcept;
+
+	/**
+	 * Free all cached buffers.
+	 */
+	void Compress() noexcept;
+
+	[[gnu::pure]]
+	Stats GetStats() const noexcept;
+
+private:
+	void Free(Chunk &chunk) noexcept;
+};
+
+} // namespace Was
@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "ClientPool.hxx"
+#include "SimpleClient.hxx"
+#include "Socket.hxx"
+#include "event/Loop.hxx"
+#include "net/SocketProtocolError.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/Cancellable.hxx"
+#include "util/DeleteDisposer.hxx"
+
+#include <cassert>
+
+namespace Was {
+
+class ClientPool::Connection final
+	: public IntrusiveListHook<>, SimpleClientHandler
+{
+	ClientPool &pool;
+
+public:
+	SimpleClient client;
+
+	/**
+	 * Is this connection in ClientPool::busy (or in
+	 * ClientPool::idle)?
+	 */
+	bool is_busy = false;
+
+	Connection(ClientPool &_pool, WasSocket &&socket) noexcept
+		:pool(_pool),
+		 client(_pool.GetEventLoop(), std::move(socket), *this) {}
+
+private:
+	/* virtual methods from class SimpleClientHandler */
+	void OnWasError(std::exception_ptr) noexcept override {
+		pool.RemoveConnection(*this);
+	}
+
+	void OnWasClosed() noexcept override {
+		pool.RemoveConnection(*this);
+	}
+
+	void OnWasStopped() noexcept override {
+		pool.OnConnectionIdle(*this);
+	}
+};
+
+class ClientPool::Request final
+	: public IntrusiveListHook<>, public Cancellable, SimpleResponseHandler
+{
+	ClientPool &pool;
+
+	SimpleResponseHandler &handler;
+
+	const Event::TimePoint start_time;
+
+	/**
+	 * The connection this request was sent on; nullptr while the
+	 * request is queued.
+	 */
+	Connection *connection = nullptr;
+
+	CancellablePointer cancel_ptr;
+
+	/**
+	 * The request; moved to the #SimpleClient by Start().
+	 */
+	SimpleRequest request;
+
+public:
+	Request(ClientPool &_pool, SimpleRequest &&_request,
+		SimpleResponseHandler &_handler) noexcept
+		:pool(_pool), handler(_handler),
+		 start_time(_pool.GetEventLoop().SteadyNow()),
+		 request(std::move(_request)) {}
+
+	void Start(Connection &_connection) noexcept {
+		assert(connection == nullptr);
+
+		connection = &_connection;
+		connection->client.SendRequest(std::move(request), *this, cancel_ptr);
+	}
+
+	/**
+	 * Fail this (queued) request and destroy it.
+	 */
+	void Fail(std::exception_ptr error) noexcept {
+		assert(connection == nullptr);
+
+		pool.OnRequestDone(start_time, false);
+
+		auto &_handler = handler;
+		delete this;
+		_handler.OnWasError(std::move(error));
+	}
+
+private:
+	/* virtual methods from class SimpleResponseHandler */
+	void OnWasResponse(SimpleResponse &&response) noexcept override {
+		assert(connection != nullptr);
+
+		pool.OnRequestDone(start_time, true);
+		pool.OnConnectionIdle(*connection);
+
+		auto &_handler = handler;
+		delete this;
+		_handler.OnWasResponse(std::move(response));
+	}
+
+	void OnWasError(std::exception_ptr error) noexcept override {
+		assert(connection != nullptr);
+
+		pool.OnRequestDone(start_time, false);
+
+		/* after a premature response body, the connection
+		   can be reused; after other errors, it is going to
+		   be removed by Connection::OnWasError() */
+		if (connection->client.IsIdle())
+			pool.OnConnectionIdle(*connection);
+
+		auto &_handler = handler;
+		delete this;
+		_handler.OnWasError(std::move(error));
+	}
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override {
+		if (connection == nullptr) {
+			/* still queued */
+			pool.queue.erase(pool.queue.iterator_to(*this));
+		} else {
+			/* this sends STOP; the connection remains
+			   busy until the peer has acknowledged it
+			   (Connection::OnWasStopped()) */
+			cancel_ptr.Cancel();
+		}
+
+		delete this;
+	}
+};
+
+ClientPool::ClientPool(EventLoop &event_loop,
+		       UniqueSocketDescriptor multi_socket,
+		       ClientPoolHandler &_handler,
+		       std::size_t _max_connections) noexcept
+	:multi_client(event_loop, std::move(multi_socket), *this),
+	 handler(_handler),
+	 max_connections(_max_connections),
+	 defer_dispatch(event_loop, BIND_THIS_METHOD(Dispatch))
+{
+	assert(max_connections > 0);
+}
+
+ClientPool::~ClientPool() noexcept
+{
+	/* all requests must have been canceled */
+	assert(queue.empty());
+
+	idle.clear_and_dispose(DeleteDisposer{});
+	busy.clear_and_dispose(DeleteDisposer{});
+}
+
+ClientPoolStats
+ClientPool::GetStats() const noexcept
+{
+	return {
+		.n_connections = idle.size() + busy.size(),
+		.n_busy = busy.size(),
+		.queue_depth = queue.size(),
+		.n_requests = n_requests,
+		.n_errors = n_errors,
+		.total_latency = total_latency,
+		.max_latency = max_latency,
+	};
+}
+
+ClientPool::Connection *
+ClientPool::GetIdleConnection()
+{
+	if (!idle.empty())
+		return &idle.front();
+
+	if (disconnected || busy.size() >= max_connections)
+		return nullptr;
+
+	auto *connection = new Connection(*this, multi_client.Connect());
+	idle.push_front(*connection);
+	return connection;
+}
+
+inline void
+ClientPool::Start(Connection &connection, Request &request) noexcept
+{
+	assert(!connection.is_busy);
+	assert(connection.client.IsIdle());
+
+	idle.erase(idle.iterator_to(connection));
+	busy.push_back(connection);
+	connection.is_busy = true;
+
+	request.Start(connection);
+}
+
+void
+ClientPool::OnConnectionIdle(Connection &connection) noexcept
+{
+	assert(connection.is_busy);
+
+	busy.erase(busy.iterator_to(connection));
+
+	/* LIFO: the most recently used connection is reused first,
+	   because its process is most likely to be "warm" */
+	idle.push_front(connection);
+	connection.is_busy = false;
+
+	if (!queue.empty())
+		defer_dispatch.Schedule();
+}
+
+void
+ClientPool::RemoveConnection(Connection &connection) noexcept
+{
+	auto &list = connection.is_busy ? busy : idle;
+	list.erase_and_dispose(list.iterator_to(connection), DeleteDisposer{});
+
+	if (!queue.empty())
+		/* retry with a new connection */
+		defer_dispatch.Schedule();
+}
+
+void
+ClientPool::OnRequestDone(Event::TimePoint start_time, bool success) noexcept
+{
+	++n_requests;
+	if (!success)
+		++n_errors;
+
+	const auto latency = GetEventLoop().SteadyNow() - start_time;
+	total_latency += latency;
+	if (latency > max_latency)
+		max_latency = latency;
+}
+
+void
+ClientPool::AbortQueue(std::exception_ptr error) noexcept
+{
+	while (!queue.empty())
+		queue.pop_front().Fail(error);
+}
+
+void
+ClientPool::SendRequest(SimpleRequest &&request,
+			SimpleResponseHandler &response_handler,
+			CancellablePointer &cancel_ptr) noexcept
+{
+	auto *r = new Request(*this, std::move(request), response_handler);
+	cancel_ptr = *r;
+
+	queue.push_back(*r);
+	Dispatch();
+}
+
+void
+ClientPool::Dispatch() noexcept
+{
+	while (!queue.empty()) {
+		Connection *connection;
+
+		try {
+			connection = GetIdleConnection();
+		} catch (...) {
+			if (busy.empty())
+				/* no connection can become available;
+				   fail all requests */
+				AbortQueue(std::current_exception());
+
+			/* else: wait for a busy connection */
+			return;
+		}
+
+		if (connection == nullptr) {
+			if (disconnected && busy.empty())
+				AbortQueue(std::make_exception_ptr(SocketClosedPrematurelyError{}));
+
+			return;
+		}
+
+		Start(*connection, queue.pop_front());
+	}
+}
+
+void
+ClientPool::OnMultiClientDisconnect() noexcept
+{
+	disconnected = true;
+	Dispatch();
+	handler.OnWasPoolDisconnect();
+}
+
+void
+ClientPool::OnMultiClientError(std::exception_ptr error) noexcept
+{
+	disconnected = true;
+	AbortQueue(error);
+	handler.OnWasPoolError(std::move(error));
+}
+
+} // namespace Was
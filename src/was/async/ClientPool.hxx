@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "MultiClient.hxx"
+#include "event/Chrono.hxx"
+#include "event/DeferEvent.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+class CancellablePointer;
+class UniqueSocketDescriptor;
+
+namespace Was {
+
+struct SimpleRequest;
+class SimpleResponseHandler;
+
+class ClientPoolHandler {
+public:
+	/**
+	 * The Multi-WAS process has closed its socket; no new
+	 * connections can be established.
+	 */
+	virtual void OnWasPoolDisconnect() noexcept = 0;
+
+	/**
+	 * An error has occurred on the Multi-WAS socket.
+	 */
+	virtual void OnWasPoolError(std::exception_ptr error) noexcept = 0;
+};
+
+struct ClientPoolStats {
+	/**
+	 * The number of open connections (idle, busy and stopping).
+	 */
+	std::size_t n_connections;
+
+	/**
+	 * The number of connections handling a request or waiting
+	 * for the PREMATURE after a canceled request.
+	 */
+	std::size_t n_busy;
+
+	/**
+	 * The number of requests waiting for a connection.
+	 */
+	std::size_t queue_depth;
+
+	/**
+	 * The number of requests which have been completed
+	 * (successfully or not) and of those which have failed.
+	 */
+	uint_least64_t n_requests, n_errors;
+
+	/**
+	 * The sum and the maximum of the latencies (from
+	 * ClientPool::SendRequest() until the response has been
+	 * received) of all completed requests.
+	 */
+	Event::Duration total_latency, max_latency;
+
+	Event::Duration GetAverageLatency() const noexcept {
+		return n_requests > 0
+			? total_latency / static_cast<Event::Duration::rep>(n_requests)
+			: Event::Duration{};
+	}
+};
+
+/**
+ * Manages a number of #SimpleClient connections to one Multi-WAS
+ * process (created on demand with MultiClient::Connect()).  Since
+ * each WAS connection handles only one request at a time, requests
+ * are dispatched to idle connections; if all connections are busy and
+ * the limit has been reached, requests are queued.
+ *
+ * A connection whose request was canceled is reused after the peer
+ * has acknowledged the STOP.
+ */
+class ClientPool final : MultiClientHandler {
+	class Connection;
+	class Request;
+
+	MultiClient multi_client;
+
+	ClientPoolHandler &handler;
+
+	const std::size_t max_connections;
+
+	using ConnectionList =
+		IntrusiveList<Connection, IntrusiveListBaseHookTraits<Connection>,
+			      IntrusiveListOptions{.constant_time_size = true}>;
+
+	ConnectionList idle, busy;
+
+	using RequestList =
+		IntrusiveList<Request, IntrusiveListBaseHookTraits<Request>,
+			      IntrusiveListOptions{.constant_time_size = true}>;
+
+	/**
+	 * Requests waiting for a connection.
+	 */
+	RequestList queue;
+
+	/**
+	 * Dispatches queued requests after a connection has become
+	 * idle.  This is deferred to avoid sending a new request from
+	 * inside #SimpleClient's response handler.
+	 */
+	DeferEvent defer_dispatch;
+
+	uint_least64_t n_requests = 0, n_errors = 0;
+
+	Event::Duration total_latency{}, max_latency{};
+
+	/**
+	 * Has the Multi-WAS socket failed?  If yes, no new
+	 * connections will be established.
+	 */
+	bool disconnected = false;
+
+public:
+	/**
+	 * @param max_connections the maximum number of concurrent
+	 * WAS connections (= concurrent requests)
+	 */
+	ClientPool(EventLoop &event_loop, UniqueSocketDescriptor multi_socket,
+		   ClientPoolHandler &_handler,
+		   std::size_t _max_connections) noexcept;
+
+	~ClientPool() noexcept;
+
+	ClientPool(const ClientPool &) = delete;
+	ClientPool &operator=(const ClientPool &) = delete;
+
+	auto &GetEventLoop() const noexcept {
+		return defer_dispatch.GetEventLoop();
+	}
+
+	std::size_t GetQueueDepth() const noexcept {
+		return queue.size();
+	}
+
+	[[gnu::pure]]
+	ClientPoolStats GetStats() const noexcept;
+
+	/**
+	 * Send a request on an idle connection or queue it until one
+	 * becomes available.  The response (or the error) is
+	 * delivered to the given handler, unless the operation is
+	 * canceled.
+	 */
+	void SendRequest(SimpleRequest &&request,
+			 SimpleResponseHandler &response_handler,
+			 CancellablePointer &cancel_ptr) noexcept;
+
+private:
+	/**
+	 * Obtain an idle connection, establishing a new one if the
+	 * limit permits.
+	 *
+	 * Throws if a new connection could not be established.
+	 *
+	 * @return nullptr if all connections are busy
+	 */
+	Connection *GetIdleConnection();
+
+	/**
+	 * Send the request on the given idle connection.
+	 */
+	void Start(Connection &connection, Request &request) noexcept;
+
+	/**
+	 * Called by #Connection when it has become idle again.
+	 */
+	void OnConnectionIdle(Connection &connection) noexcept;
+
+	/**
+	 * Called by #Connection after it has failed; destroys it.
+	 */
+	void RemoveConnection(Connection &connection) noexcept;
+
+	void OnRequestDone(Event::TimePoint start_time, bool success) noexcept;
+
+	/**
+	 * Fail all queued requests with the given error.
+	 */
+	void AbortQueue(std::exception_ptr error) noexcept;
+
+	void Dispatch() noexcept;
+
+	/* virtual methods from class MultiClientHandler */
+	void OnMultiClientDisconnect() noexcept override;
+	void OnMultiClientError(std::exception_ptr error) noexcept override;
+};
+
+} // namespace Was
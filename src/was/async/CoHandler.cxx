@@ -11,7 +11,9 @@
 
 namespace Was {
 
-class CoSimpleRequestHandler::Request final : Cancellable {
+namespace {
+
+class CoRequest final : Cancellable {
 	SimpleServer &server;
 
 	Co::Task<SimpleResponse> task;
@@ -21,7 +23,7 @@ class CoSimpleRequestHandler::Request final : Cancellable {
 	bool result = true, starting = true, complete = false;
 
 public:
-	Request(SimpleServer &_server, Co::Task<SimpleResponse> &&_task) noexcept
+	CoRequest(SimpleServer &_server, Co::Task<SimpleResponse> &&_task) noexcept
 		:server(_server),
 		 task(std::move(_task)) {}
 
@@ -98,14 +100,19 @@ private:
 	}
 };
 
-bool
-CoSimpleRequestHandler::OnRequest(SimpleServer &server,
-				  SimpleRequest &&request,
-				  CancellablePointer &cancel_ptr) noexcept
+} // anonymous namespace
+
+/**
+ * Create the coroutine (by invoking the given function) and start a
+ * #CoRequest for it.
+ */
+template<typename F>
+static bool
+StartCoRequest(SimpleServer &server, CancellablePointer &cancel_ptr,
+	       F &&create_task) noexcept
 {
 	try {
-		auto *r = new Request(server,
-				      OnCoRequest(std::move(request)));
+		auto *r = new CoRequest(server, create_task());
 		return r->Start(cancel_ptr);
 	} catch (const Was::NotFound &e) {
 		SimpleResponse response;
@@ -120,4 +127,24 @@ CoSimpleRequestHandler::OnRequest(SimpleServer &server,
 	}
 }
 
+bool
+CoSimpleRequestHandler::OnRequest(SimpleServer &server,
+				  SimpleRequest &&request,
+				  CancellablePointer &cancel_ptr) noexcept
+{
+	return StartCoRequest(server, cancel_ptr, [&]{
+		return OnCoRequest(std::move(request));
+	});
+}
+
+bool
+CoCompactRequestHandler::OnCompactRequest(SimpleServer &server,
+					  CompactRequest &&request,
+					  CancellablePointer &cancel_ptr) noexcept
+{
+	return StartCoRequest(server, cancel_ptr, [&]{
+		return OnCoRequest(std::move(request));
+	});
+}
+
 } // namespace Was
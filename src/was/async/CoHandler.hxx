@@ -11,8 +11,6 @@ namespace Co { template <typename T> class Task; }
 namespace Was {
 
 class CoSimpleRequestHandler : public SimpleRequestHandler {
-	class Request;
-
 public:
 	bool OnRequest(SimpleServer &server,
 		       SimpleRequest &&request,
@@ -22,4 +20,18 @@ protected:
 	virtual Co::Task<SimpleResponse> OnCoRequest(SimpleRequest request) = 0;
 };
 
+/**
+ * Like #CoSimpleRequestHandler, but the coroutine receives a
+ * #CompactRequest.
+ */
+class CoCompactRequestHandler : public CompactRequestHandler {
+public:
+	bool OnCompactRequest(SimpleServer &server,
+			      CompactRequest &&request,
+			      CancellablePointer &cancel_ptr) noexcept final;
+
+protected:
+	virtual Co::Task<SimpleResponse> OnCoRequest(CompactRequest request) = 0;
+};
+
 } // namespace Was
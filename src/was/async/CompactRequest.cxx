@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "CompactRequest.hxx"
+#include "SimpleHandler.hxx"
+#include "util/CharUtil.hxx"
+#include "util/MimeType.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+using std::string_view_literals::operator""sv;
+
+namespace Was {
+
+struct CompactRequest::Arena::Block {
+	Block *previous;
+
+	/**
+	 * Most requests fit into one block of this size.
+	 */
+	static constexpr std::size_t DEFAULT_SIZE = 4096 - 64;
+
+	char *GetData() noexcept {
+		return reinterpret_cast<char *>(this + 1);
+	}
+};
+
+CompactRequest::Arena::~Arena() noexcept
+{
+	while (head != nullptr) {
+		Block *block = head;
+		head = block->previous;
+		::operator delete(block);
+	}
+}
+
+std::string_view
+CompactRequest::Arena::Dup(std::string_view src)
+{
+	if (src.empty())
+		return {"", 0};
+
+	if (src.size() > available) {
+		const std::size_t size = std::max(src.size(),
+						  Block::DEFAULT_SIZE);
+		void *p = ::operator new(sizeof(Block) + size);
+		head = new(p) Block{head};
+		position = head->GetData();
+		available = size;
+	}
+
+	char *dest = position;
+	std::memcpy(dest, src.data(), src.size());
+	position += src.size();
+	available -= src.size();
+	return {dest, src.size()};
+}
+
+/**
+ * A case-insensitive order for header names.  Names are ordered by
+ * length first (which decides most comparisons cheaply), and names
+ * of equal length are compared byte by byte; the strings do not
+ * need to be null-terminated.
+ */
+[[gnu::pure]]
+static int
+CompareIgnoreCase(std::string_view a, std::string_view b) noexcept
+{
+	if (a.size() != b.size())
+		return a.size() < b.size() ? -1 : 1;
+
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		const auto ca = static_cast<unsigned char>(ToLowerASCII(a[i]));
+		const auto cb = static_cast<unsigned char>(ToLowerASCII(b[i]));
+		if (ca != cb)
+			return ca < cb ? -1 : 1;
+	}
+
+	return 0;
+}
+
+static constexpr auto header_less = [](const CompactRequest::Pair &a,
+				       const CompactRequest::Pair &b) noexcept {
+	return CompareIgnoreCase(a.first, b.first) < 0;
+};
+
+static constexpr auto parameter_less = [](const CompactRequest::Pair &a,
+					  const CompactRequest::Pair &b) noexcept {
+	return a.first < b.first;
+};
+
+void
+CompactRequest::AddHeader(std::string_view name, std::string_view value)
+{
+	if (headers.empty())
+		headers.reserve(16);
+
+	const auto n = Dup(name);
+	headers.emplace_back(n, Dup(value));
+}
+
+void
+CompactRequest::AddParameter(std::string_view name, std::string_view value)
+{
+	if (parameters.empty())
+		parameters.reserve(8);
+
+	const auto n = Dup(name);
+	parameters.emplace_back(n, Dup(value));
+}
+
+void
+CompactRequest::Finish() noexcept
+{
+	std::stable_sort(headers.begin(), headers.end(), header_less);
+	std::stable_sort(parameters.begin(), parameters.end(), parameter_less);
+}
+
+std::span<const CompactRequest::Pair>
+CompactRequest::GetHeaders(std::string_view name) const noexcept
+{
+	const auto [begin, end] = std::equal_range(headers.begin(), headers.end(),
+						   Pair{name, {}}, header_less);
+	return {begin, end};
+}
+
+std::string_view
+CompactRequest::GetHeader(std::string_view name) const noexcept
+{
+	const auto r = GetHeaders(name);
+	return r.empty() ? std::string_view{} : r.front().second;
+}
+
+std::string_view
+CompactRequest::GetParameter(std::string_view name) const noexcept
+{
+	const auto i = std::lower_bound(parameters.begin(), parameters.end(),
+					Pair{name, {}}, parameter_less);
+	return i != parameters.end() && i->first == name
+		? i->second
+		: std::string_view{};
+}
+
+bool
+CompactRequest::IsContentType(const std::string_view expected) const noexcept
+{
+	const auto value = GetHeader("content-type"sv);
+	return value.data() != nullptr &&
+		GetMimeTypeBase(value) == expected;
+}
+
+SimpleRequest
+CompactRequest::ToSimpleRequest() &&
+{
+	SimpleRequest request;
+	request.remote_host = remote_host;
+	request.method = method;
+	request.uri = uri;
+	request.script_name = script_name;
+	request.path_info = path_info;
+	request.query_string = query_string;
+
+	for (const auto &[name, value] : headers)
+		request.headers.emplace(name, value);
+
+	for (const auto &[name, value] : parameters)
+		request.parameters.emplace(name, value);
+
+	request.body = std::move(body);
+	request.body_stream = body_stream;
+	return request;
+}
+
+} // namespace Was
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "http/Method.hxx"
+#include "util/DisposableBuffer.hxx"
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Was {
+
+struct SimpleRequest;
+
+/**
+ * A lightweight alternative to #SimpleRequest.  All strings are
+ * copied into one arena owned by this object (usually one single
+ * allocation for the whole request), and headers and parameters are
+ * flat vectors of std::string_view pairs which are sorted by
+ * Finish().
+ *
+ * Moving this object does not invalidate the strings.
+ */
+class CompactRequest {
+	/**
+	 * A bump allocator for the strings of one request.
+	 */
+	class Arena {
+		struct Block;
+
+		Block *head = nullptr;
+
+		char *position = nullptr;
+		std::size_t available = 0;
+
+	public:
+		Arena() noexcept = default;
+
+		Arena(Arena &&src) noexcept
+			:head(std::exchange(src.head, nullptr)),
+			 position(std::exchange(src.position, nullptr)),
+			 available(std::exchange(src.available, 0)) {}
+
+		~Arena() noexcept;
+
+		Arena &operator=(Arena &&src) noexcept {
+			using std::swap;
+			swap(head, src.head);
+			swap(position, src.position);
+			swap(available, src.available);
+			return *this;
+		}
+
+		/**
+		 * Throws std::bad_alloc on error.
+		 */
+		std::string_view Dup(std::string_view src);
+	};
+
+	Arena arena;
+
+public:
+	using Pair = std::pair<std::string_view, std::string_view>;
+
+	HttpMethod method = HttpMethod::GET;
+
+	std::string_view remote_host;
+	std::string_view uri;
+	std::string_view script_name, path_info, query_string;
+
+	/**
+	 * Sorted by name length and then by name (case-insensitive);
+	 * headers with the same name are kept in the order they were
+	 * received.
+	 */
+	std::vector<Pair> headers;
+
+	/**
+	 * Sorted by name.
+	 */
+	std::vector<Pair> parameters;
+
+	DisposableBuffer body;
+
+	/**
+	 * If true, then the request body is not in #body; it must
+	 * be read with SimpleServer::ReadBody() (see
+	 * CompactRequestHandler::WantStreamBody()).
+	 */
+	bool body_stream = false;
+
+	CompactRequest() noexcept = default;
+	CompactRequest(CompactRequest &&) noexcept = default;
+	CompactRequest &operator=(CompactRequest &&) noexcept = default;
+
+	/**
+	 * Copy a string into this object's arena.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	std::string_view Dup(std::string_view src) {
+		return arena.Dup(src);
+	}
+
+	/**
+	 * Throws std::bad_alloc on error.
+	 */
+	void AddHeader(std::string_view name, std::string_view value);
+
+	/**
+	 * Throws std::bad_alloc on error.
+	 */
+	void AddParameter(std::string_view name, std::string_view value);
+
+	/**
+	 * Sort headers and parameters.  This must be called after
+	 * all of them have been added and before the lookup methods
+	 * can be used.
+	 */
+	void Finish() noexcept;
+
+	/**
+	 * Look up the first header with the given name
+	 * (case-insensitive).
+	 *
+	 * @return the value or a std::string_view with nullptr data
+	 * if there is no such header
+	 */
+	[[gnu::pure]]
+	std::string_view GetHeader(std::string_view name) const noexcept;
+
+	/**
+	 * Look up all headers with the given name
+	 * (case-insensitive).
+	 */
+	[[gnu::pure]]
+	std::span<const Pair> GetHeaders(std::string_view name) const noexcept;
+
+	/**
+	 * Look up the parameter with the given name.  If it was
+	 * specified more than once, the first one is returned.
+	 *
+	 * @return the value or a std::string_view with nullptr data
+	 * if there is no such parameter
+	 */
+	[[gnu::pure]]
+	std::string_view GetParameter(std::string_view name) const noexcept;
+
+	/**
+	 * Compare the base of the Content-Type header with the given
+	 * expected value.
+	 */
+	[[gnu::pure]]
+	bool IsContentType(std::string_view expected) const noexcept;
+
+	/**
+	 * Convert to a #SimpleRequest (for handlers which use the
+	 * classic API), moving the body.
+	 *
+	 * Throws std::bad_alloc on error.
+	 */
+	SimpleRequest ToSimpleRequest() &&;
+};
+
+} // namespace Was
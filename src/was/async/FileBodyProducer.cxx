@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "FileBodyProducer.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h> // for splice()
+
+namespace Was {
+
+std::size_t
+FileBodyProducer::WriteBody(FileDescriptor pipe, uint_least64_t max_length)
+{
+	constexpr uint_least64_t max_splice = 1 << 30;
+
+	const auto nbytes = splice(fd.Get(), &offset,
+				   pipe.Get(), nullptr,
+				   std::min(max_length, max_splice),
+				   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	if (nbytes < 0) {
+		if (errno == EAGAIN)
+			/* the pipe is full */
+			return 0;
+
+		throw MakeErrno("Failed to splice file to WAS pipe");
+	}
+
+	if (nbytes == 0)
+		throw std::runtime_error("Premature end of file");
+
+	return nbytes;
+}
+
+} // namespace Was
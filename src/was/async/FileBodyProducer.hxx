@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "SimpleHandler.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <sys/types.h> // for off_t
+
+namespace Was {
+
+/**
+ * A #SimpleBodyProducer which sends a portion of a regular file
+ * using splice(), without copying the data to userspace.
+ */
+class FileBodyProducer final : public SimpleBodyProducer {
+	UniqueFileDescriptor fd;
+
+	off_t offset;
+
+	const uint_least64_t length;
+
+public:
+	FileBodyProducer(UniqueFileDescriptor &&_fd,
+			 off_t _offset, uint_least64_t _length) noexcept
+		:fd(std::move(_fd)), offset(_offset), length(_length) {}
+
+	/* virtual methods from class SimpleBodyProducer */
+	uint_least64_t GetLength() const noexcept override {
+		return length;
+	}
+
+	std::size_t WriteBody(FileDescriptor pipe,
+			      uint_least64_t max_length) override;
+};
+
+} // namespace Was
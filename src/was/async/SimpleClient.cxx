@@ -10,6 +10,7 @@
 #include "util/Unaligned.hxx"
 
 #include <array>
+#include <utility> // for std::exchange()
 
 namespace Was {
 
@@ -66,6 +67,7 @@ SimpleClient::SendRequest(SimpleRequest &&request,
 			  CancellablePointer &cancel_ptr) noexcept
 {
 	assert(state == State::IDLE);
+	assert(!stopping);
 
 	cancel_ptr = *this;
 	response_handler = &_response_handler;
@@ -81,11 +83,29 @@ SimpleClient::SendRequest(SimpleRequest &&request,
 	return true;
 }
 
+void
+SimpleClient::SubmitResponse() noexcept
+{
+	state = State::IDLE;
+
+	if (stopping) {
+		/* this is the response to a canceled request;
+		   discard it, but remember how much of the body was
+		   consumed for the PREMATURE packet which is going
+		   to follow */
+		stop_received += response.body.size();
+		response = {};
+		return;
+	}
+
+	std::exchange(response_handler, nullptr)->OnWasResponse(std::move(response));
+}
+
 void
 SimpleClient::Closed() noexcept
 {
-	if (state != State::IDLE)
-		response_handler->OnWasError(std::make_exception_ptr(SocketClosedPrematurelyError{}));
+	if (response_handler != nullptr)
+		std::exchange(response_handler, nullptr)->OnWasError(std::make_exception_ptr(SocketClosedPrematurelyError{}));
 
 	Close();
 	handler.OnWasClosed();
@@ -94,8 +114,8 @@ SimpleClient::Closed() noexcept
 void
 SimpleClient::AbortError(std::exception_ptr error) noexcept
 {
-	if (state != State::IDLE)
-		response_handler->OnWasError(error);
+	if (response_handler != nullptr)
+		std::exchange(response_handler, nullptr)->OnWasError(error);
 
 	Close();
 	handler.OnWasError(error);
@@ -127,6 +147,11 @@ SimpleClient::OnWasControlPacket(enum was_command cmd,
 		return false;
 
 	case WAS_COMMAND_HEADER:
+		if (stopping)
+			/* ignore the response to the canceled
+			   request */
+			break;
+
 		if (state != State::HEADERS) {
 			AbortProtocolError("misplaced HEADER packet");
 			return false;
@@ -143,6 +168,9 @@ SimpleClient::OnWasControlPacket(enum was_command cmd,
 		break;
 
 	case WAS_COMMAND_STATUS:
+		if (stopping)
+			break;
+
 		if (state != State::HEADERS) {
 			AbortProtocolError("misplaced STATUS packet");
 			return false;
@@ -169,8 +197,7 @@ SimpleClient::OnWasControlPacket(enum was_command cmd,
 			return false;
 		}
 
-		state = State::IDLE;
-		response_handler->OnWasResponse(std::move(response));
+		SubmitResponse();
 		break;
 
 	case WAS_COMMAND_DATA:
@@ -219,16 +246,33 @@ SimpleClient::OnWasControlPacket(enum was_command cmd,
 		}
 
 		try {
-			input.Premature(LoadUnaligned<uint64_t>(payload.data()));
+			const auto length = LoadUnaligned<uint64_t>(payload.data());
+			if (input.IsActive() || !stopping) {
+				input.Premature(length);
+			} else {
+				/* the canceled response body may
+				   have been received (and discarded)
+				   completely already */
+				if (length < stop_received)
+					throw SocketProtocolError{"Malformed PREMATURE packet"};
+
+				input.Discard(length - stop_received);
+			}
 		} catch (...) {
 			AbortError(std::current_exception());
 			return false;
 		}
 
-		if (stopping)
-			stopping = true;
-		else
-			response_handler->OnWasError(std::make_exception_ptr(std::runtime_error{"Premature end of response body"}));
+		state = State::IDLE;
+
+		if (stopping) {
+			/* recovered from STOP; this connection can
+			   be used again */
+			stopping = false;
+			stop_received = 0;
+			handler.OnWasStopped();
+		} else
+			std::exchange(response_handler, nullptr)->OnWasError(std::make_exception_ptr(std::runtime_error{"Premature end of response body"}));
 		return true;
 
 	case WAS_COMMAND_METRIC:
@@ -243,10 +287,8 @@ SimpleClient::OnWasControlDrained() noexcept
 {
 	if (state == State::BODY) {
 		response.body = input.CheckComplete();
-		if (response.body) {
-			state = State::IDLE;
-			response_handler->OnWasResponse(std::move(response));
-		}
+		if (response.body)
+			SubmitResponse();
 	}
 
 	return true;
@@ -280,8 +322,7 @@ SimpleClient::OnWasInput(DisposableBuffer body) noexcept
 	assert(state == State::BODY);
 
 	response.body = std::move(body);
-	state = State::IDLE;
-	response_handler->OnWasResponse(std::move(response));
+	SubmitResponse();
 }
 
 void
@@ -305,7 +346,12 @@ SimpleClient::OnWasOutputError(std::exception_ptr error) noexcept
 void
 SimpleClient::Cancel() noexcept
 {
-	assert(state != State::IDLE);
+	assert(response_handler != nullptr);
+
+	/* clear the handler first, because a send error below
+	   invokes AbortError(), which must not report to the
+	   canceled request */
+	response_handler = nullptr;
 
 	if (output.IsActive()) {
 		if (!control.SendUint64(WAS_COMMAND_PREMATURE,
@@ -319,7 +365,7 @@ SimpleClient::Cancel() noexcept
 		return;
 
 	stopping = true;
-	state = State::IDLE;
+	stop_received = 0;
 }
 
 } // namespace Was
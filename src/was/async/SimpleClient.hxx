@@ -10,6 +10,7 @@
 #include "SimpleOutput.hxx"
 #include "util/Cancellable.hxx"
 
+#include <cstdint>
 #include <exception>
 
 struct WasSocket;
@@ -20,6 +21,13 @@ class SimpleClientHandler {
 public:
 	virtual void OnWasError(std::exception_ptr error) noexcept = 0;
 	virtual void OnWasClosed() noexcept = 0;
+
+	/**
+	 * The peer has acknowledged the STOP which was sent after a
+	 * request was canceled, and the connection can be used for
+	 * the next request.
+	 */
+	virtual void OnWasStopped() noexcept {}
 };
 
 class SimpleResponseHandler {
@@ -53,8 +61,18 @@ class SimpleClient final
 		BODY,
 	} state = State::IDLE;
 
+	/**
+	 * A request was canceled and STOP was sent; waiting for
+	 * PREMATURE.  Until then, the response is discarded.
+	 */
 	bool stopping = false;
 
+	/**
+	 * The number of response body bytes which have been consumed
+	 * (and discarded) while #stopping.
+	 */
+	uint_least64_t stop_received;
+
 public:
 	SimpleClient(EventLoop &event_loop, WasSocket &&socket,
 		     SimpleClientHandler &_handler) noexcept;
@@ -73,11 +91,24 @@ public:
 		return stopping;
 	}
 
+	/**
+	 * Can SendRequest() be called?
+	 */
+	bool IsIdle() const noexcept {
+		return state == State::IDLE && !stopping;
+	}
+
 	bool SendRequest(SimpleRequest &&request,
 			 SimpleResponseHandler &_response_handler,
 			 CancellablePointer &cancel_ptr) noexcept;
 
 private:
+	/**
+	 * The response is complete; pass it to the
+	 * #SimpleResponseHandler (unless the request was canceled).
+	 */
+	void SubmitResponse() noexcept;
+
 	void Closed() noexcept;
 
 	/**
@@ -3,8 +3,11 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "SimpleHandler.hxx"
+#include "SimpleServer.hxx"
 #include "util/MimeType.hxx"
 
+#include <new> // for std::bad_alloc
+
 using std::string_view_literals::operator""sv;
 
 namespace Was {
@@ -17,4 +20,22 @@ SimpleRequest::IsContentType(const std::string_view expected) const noexcept
 		GetMimeTypeBase(i->second) == expected;
 }
 
+bool
+SimpleRequestHandler::OnCompactRequest(SimpleServer &server,
+				       CompactRequest &&request,
+				       CancellablePointer &cancel_ptr) noexcept
+{
+	SimpleRequest simple;
+
+	try {
+		simple = std::move(request).ToSimpleRequest();
+	} catch (const std::bad_alloc &) {
+		return server.SendResponse({
+			.status = HttpStatus::INTERNAL_SERVER_ERROR,
+		});
+	}
+
+	return OnRequest(server, std::move(simple), cancel_ptr);
+}
+
 } // namespace Was
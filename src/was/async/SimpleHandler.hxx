@@ -4,14 +4,20 @@
 
 #pragma once
 
+#include "CompactRequest.hxx"
 #include "http/Method.hxx"
 #include "http/Status.hxx"
 #include "util/DisposableBuffer.hxx"
 
+#include <cstdint>
+#include <exception> // for std::exception_ptr
 #include <map>
+#include <memory>
+#include <span>
 #include <string>
 
 class CancellablePointer;
+class FileDescriptor;
 
 namespace Was {
 
@@ -24,6 +30,13 @@ struct SimpleRequest {
 	std::multimap<std::string, std::string, std::less<>> headers;
 	DisposableBuffer body;
 
+	/**
+	 * If true, then the request body is not in #body; it must
+	 * be read with SimpleServer::ReadBody() (see
+	 * CompactRequestHandler::WantStreamBody()).
+	 */
+	bool body_stream = false;
+
 	/**
 	 * Compare the base of the Content-Type header with the given
 	 * expected value.
@@ -32,11 +45,47 @@ struct SimpleRequest {
 	bool IsContentType(const std::string_view expected) const noexcept;
 };
 
+/**
+ * Generates a response body incrementally (see
+ * SimpleResponse::body_producer), which allows sending bodies of
+ * arbitrary size without having them in memory.
+ */
+class SimpleBodyProducer {
+public:
+	virtual ~SimpleBodyProducer() noexcept = default;
+
+	/**
+	 * @return the total length of the body
+	 */
+	virtual uint_least64_t GetLength() const noexcept = 0;
+
+	/**
+	 * Write more body data to the given (non-blocking) pipe,
+	 * e.g. with splice().
+	 *
+	 * Throws on error.
+	 *
+	 * @param max_length the number of bytes which remain to be
+	 * written; this method must not write more than that
+	 * @return the number of bytes written or 0 if the pipe is
+	 * full (the method will be called again as soon as the pipe
+	 * becomes writable)
+	 */
+	virtual std::size_t WriteBody(FileDescriptor pipe,
+				      uint_least64_t max_length) = 0;
+};
+
 struct SimpleResponse {
 	HttpStatus status = HttpStatus::OK;
 	std::multimap<std::string, std::string, std::less<>> headers;
 	DisposableBuffer body;
 
+	/**
+	 * If set (and #body is not), then the body is generated by
+	 * this object.  Only supported by #SimpleServer.
+	 */
+	std::unique_ptr<SimpleBodyProducer> body_producer;
+
 	void SetTextPlain(std::string_view _body) noexcept {
 		body = {ToNopPointer(_body.data()), _body.size()};
 		headers.emplace("content-type", "text/plain");
@@ -55,7 +104,68 @@ struct SimpleResponse {
 
 class SimpleServer;
 
-class SimpleRequestHandler {
+/**
+ * Receives a streamed request body, see SimpleServer::ReadBody().
+ */
+class SimpleBodyHandler {
+public:
+	/**
+	 * Some body data has been received.
+	 *
+	 * This method (like the other ones of this class) may
+	 * destroy the #SimpleServer.
+	 *
+	 * @return the number of bytes consumed; if this is less than
+	 * the given size, then reading from the pipe pauses until
+	 * SimpleServer::ResumeBody() is called
+	 */
+	virtual std::size_t OnWasBodyData(std::span<const std::byte> src) noexcept = 0;
+
+	/**
+	 * The whole body has been received and consumed.
+	 */
+	virtual void OnWasBodyEnd() noexcept = 0;
+
+	/**
+	 * The client has aborted sending the body.
+	 */
+	virtual void OnWasBodyError(std::exception_ptr error) noexcept = 0;
+};
+
+/**
+ * The interface used by #SimpleServer to submit requests.  Most
+ * implementations derive from #SimpleRequestHandler instead; this
+ * one is for handlers which want to avoid the overhead of
+ * #SimpleRequest.
+ */
+class CompactRequestHandler {
+public:
+	/**
+	 * Shall the body of this request be streamed instead of
+	 * being received completely before the request gets
+	 * submitted?  If this returns true, then the request gets
+	 * submitted right after the headers have been received, with
+	 * `body_stream` set, and the handler needs to call
+	 * SimpleServer::ReadBody().
+	 *
+	 * This is only called for requests with a body.
+	 */
+	virtual bool WantStreamBody([[maybe_unused]] const CompactRequest &request) noexcept {
+		return false;
+	}
+
+	/**
+	 * A request was received.  The implementation shall handle it
+	 * and call SimpleServer::SendResponse().
+	 *
+	 * @return false if the #SimpleServer was closed
+	 */
+	virtual bool OnCompactRequest(SimpleServer &server,
+				      CompactRequest &&request,
+				      CancellablePointer &cancel_ptr) noexcept = 0;
+};
+
+class SimpleRequestHandler : public CompactRequestHandler {
 public:
 	/**
 	 * A request was received.  The implementation shall handle it
@@ -66,6 +176,11 @@ public:
 	virtual bool OnRequest(SimpleServer &server,
 			       SimpleRequest &&request,
 			       CancellablePointer &cancel_ptr) noexcept = 0;
+
+	/* virtual methods from class CompactRequestHandler */
+	bool OnCompactRequest(SimpleServer &server,
+			      CompactRequest &&request,
+			      CancellablePointer &cancel_ptr) noexcept final;
 };
 
 } // namespace Was
@@ -3,6 +3,7 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "SimpleInput.hxx"
+#include "SimpleHandler.hxx"
 #include "Buffer.hxx"
 #include "net/SocketProtocolError.hxx"
 #include "io/UniqueFileDescriptor.hxx"
@@ -35,17 +36,76 @@ SimpleInput::~SimpleInput() noexcept
 void
 SimpleInput::Activate() noexcept
 {
-	assert(!buffer);
+	assert(!IsActive());
 
-	buffer = std::make_unique<Buffer>();
+	buffer.emplace();
 
 	defer_read.Schedule();
 }
 
+void
+SimpleInput::ActivateStream() noexcept
+{
+	assert(!IsActive());
+
+	stream.active = true;
+	stream.received = 0;
+	stream.length = Stream::UNKNOWN_LENGTH;
+}
+
+void
+SimpleInput::SetStreamHandler(SimpleBodyHandler &_handler) noexcept
+{
+	assert(stream.active);
+	assert(stream.handler == nullptr);
+
+	stream.handler = &_handler;
+	DeferRead();
+}
+
+void
+SimpleInput::StopStream() noexcept
+{
+	if (!stream.active)
+		return;
+
+	stream.handler = nullptr;
+	event.CancelRead();
+	defer_read.Cancel();
+}
+
+void
+SimpleInput::EndStream() noexcept
+{
+	assert(stream.active);
+
+	stream.active = false;
+	stream.handler = nullptr;
+	stream.buffer.FreeIfDefined();
+
+	event.CancelRead();
+	defer_read.Cancel();
+}
+
 bool
-SimpleInput::SetLength(std::size_t length) noexcept
+SimpleInput::SetLength(uint_least64_t length) noexcept
 {
-	if (!buffer || !buffer->SetLength(length))
+	if (stream.active) {
+		if (stream.length != Stream::UNKNOWN_LENGTH ||
+		    length < stream.received)
+			return false;
+
+		stream.length = length;
+
+		if (stream.handler != nullptr && stream.received == length)
+			/* report the end of the body */
+			DeferRead();
+
+		return true;
+	}
+
+	if (!buffer || length > Buffer::max_size() ||
+	    !buffer->SetLength(static_cast<std::size_t>(length)))
 		return false;
 
 	if (buffer->IsComplete()) {
@@ -56,58 +116,167 @@ SimpleInput::SetLength(std::size_t length) noexcept
 	return true;
 }
 
+inline DisposableBuffer
+SimpleInput::ReleaseBuffer() noexcept
+{
+	assert(buffer);
+
+	auto result = buffer->ToDisposableBuffer();
+	buffer.reset();
+	return result;
+}
+
 DisposableBuffer
 SimpleInput::CheckComplete() noexcept
 {
-	assert(buffer != nullptr);
+	assert(buffer);
 
 	return buffer->IsComplete()
-		? buffer.release()->ToDisposableBuffer()
+		? ReleaseBuffer()
 		: nullptr;
 }
 
 void
-SimpleInput::Premature(std::size_t nbytes)
+SimpleInput::Discard(uint_least64_t nbytes)
+{
+	while (nbytes > 0) {
+		std::byte dummy[4096];
+		std::span<std::byte> dest = dummy;
+		if (dest.size() > nbytes)
+			dest = dest.first(static_cast<std::size_t>(nbytes));
+
+		auto n = GetPipe().Read(dest);
+		if (n < 0)
+			throw MakeErrno("Read error on WAS pipe");
+
+		if (n == 0)
+			throw std::runtime_error("Hangup on WAS pipe");
+
+		nbytes -= n;
+	}
+}
+
+bool
+SimpleInput::Premature(uint_least64_t nbytes)
 {
 	event.CancelRead();
 	defer_read.Cancel();
 
-	if (!buffer) {
+	uint_least64_t fill;
+	SimpleBodyHandler *stream_handler = nullptr;
+
+	if (stream.active) {
+		fill = stream.received;
+		stream_handler = stream.handler;
+		EndStream();
+	} else if (buffer) {
+		fill = buffer->GetFill();
+		buffer.reset();
+	} else {
 		if (nbytes == 0)
-			return;
+			return true;
 		else
 			throw SocketProtocolError{"Malformed PREMATURE packet"};
 	}
 
-	const std::size_t fill = buffer->GetFill();
-	buffer.reset();
 	if (fill > nbytes)
 		/* we have already received more data than that, which
 		   should not be possible */
 		throw SocketProtocolError{"Too much data on WAS pipe"};
 
-	std::size_t discard = nbytes - fill;
+	Discard(nbytes - fill);
 
-	while (discard > 0) {
-		std::byte dummy[4096];
-		std::span<std::byte> dest = dummy;
-		if (dest.size() > discard)
-			dest = dest.first(discard);
+	if (stream_handler != nullptr) {
+		const DestructObserver destructed{*this};
+		stream_handler->OnWasBodyError(std::make_exception_ptr(std::runtime_error{"Premature end of request body"}));
+		if (destructed)
+			return false;
+	}
 
-		auto n = GetPipe().Read(dest);
-		if (n < 0)
-			throw MakeErrno("Read error on WAS pipe");
+	return true;
+}
 
-		if (n == 0)
-			throw std::runtime_error("Hangup on WAS pipe");
+bool
+SimpleInput::SubmitStream() noexcept
+{
+	assert(stream.active);
+	assert(stream.handler != nullptr);
+
+	if (const auto r = stream.buffer.Read(); !r.empty()) {
+		const DestructObserver destructed{*this};
+		const std::size_t consumed = stream.handler->OnWasBodyData(r);
+		if (destructed)
+			/* the handler has destroyed the
+			   #SimpleServer */
+			return false;
+
+		if (stream.handler == nullptr)
+			/* StopStream() was called by the handler */
+			return false;
+
+		assert(consumed <= r.size());
+		stream.buffer.Consume(consumed);
+
+		if (consumed < r.size()) {
+			/* the handler is busy; wait for
+			   ResumeStream() */
+			event.CancelRead();
+			return false;
+		}
+	}
 
-		discard -= n;
+	if (stream.received == stream.length) {
+		auto &body_handler = *stream.handler;
+		EndStream();
+		body_handler.OnWasBodyEnd();
+		return false;
 	}
+
+	return true;
+}
+
+inline void
+SimpleInput::TryReadStream()
+{
+	assert(stream.active);
+
+	if (stream.handler == nullptr) {
+		/* stopped */
+		event.CancelRead();
+		return;
+	}
+
+	stream.buffer.AllocateIfNull();
+
+	if (auto w = stream.buffer.Write();
+	    !w.empty() && stream.received < stream.length) {
+		/* don't read more than the announced length */
+		if (stream.length != Stream::UNKNOWN_LENGTH &&
+		    w.size() > stream.length - stream.received)
+			w = w.first(stream.length - stream.received);
+
+		const auto nbytes = GetPipe().Read(w);
+		if (nbytes > 0) {
+			stream.buffer.Append(nbytes);
+			stream.received += nbytes;
+		} else if (nbytes == 0)
+			throw std::runtime_error("Hangup on WAS pipe");
+		else if (errno != EAGAIN)
+			throw MakeErrno("Read error on WAS pipe");
+	}
+
+	if (SubmitStream())
+		event.ScheduleRead();
 }
 
 void
 SimpleInput::TryRead()
 {
+	if (stream.active) {
+		TryReadStream();
+		return;
+	}
+
 	assert(buffer);
 
 	auto w = buffer->Write();
@@ -131,8 +300,9 @@ SimpleInput::TryRead()
 		event.CancelRead();
 		defer_read.Cancel();
 
-		handler.OnWasInput(buffer.release()->ToDisposableBuffer());
-	}
+		handler.OnWasInput(ReleaseBuffer());
+	} else
+		event.ScheduleRead();
 }
 
 void
@@ -147,7 +317,7 @@ try {
 		return;
 	}
 
-	assert(buffer);
+	assert(IsActive());
 
 	TryRead();
 } catch (...) {
@@ -157,7 +327,7 @@ try {
 void
 SimpleInput::OnDeferredRead() noexcept
 try {
-	assert(buffer);
+	assert(IsActive());
 
 	TryRead();
 } catch (...) {
@@ -6,16 +6,21 @@
 
 #include "event/PipeEvent.hxx"
 #include "event/DeferEvent.hxx"
+#include "Buffer.hxx"
+#include "DefaultFifoBuffer.hxx"
+#include "util/DestructObserver.hxx"
 
+#include <cassert>
+#include <cstdint>
 #include <exception> // for std::exception_ptr
-#include <memory>
+#include <optional>
 
 class UniqueFileDescriptor;
 class DisposableBuffer;
 
 namespace Was {
 
-class Buffer;
+class SimpleBodyHandler;
 
 class SimpleInputHandler {
 public:
@@ -24,13 +29,44 @@ public:
 	virtual void OnWasInputError(std::exception_ptr error) noexcept = 0;
 };
 
-class SimpleInput final {
+/**
+ * Receives the request/response body from the WAS input pipe.
+ *
+ * The #SimpleBodyHandler (streaming mode) may destroy this object
+ * from inside its callbacks; this is detected with a
+ * #DestructObserver.
+ */
+class SimpleInput final : DestructAnchor {
 	PipeEvent event;
 	DeferEvent defer_read;
 
 	SimpleInputHandler &handler;
 
-	std::unique_ptr<Buffer> buffer;
+	std::optional<Buffer> buffer;
+
+	/**
+	 * State for the streaming mode (see ActivateStream()).
+	 */
+	struct Stream {
+		/**
+		 * The handler which receives the data; nullptr
+		 * until SetStreamHandler() gets called and after
+		 * StopStream().
+		 */
+		SimpleBodyHandler *handler = nullptr;
+
+		/**
+		 * Data which has been read from the pipe but not yet
+		 * consumed by the #handler.
+		 */
+		DefaultFifoBuffer buffer;
+
+		static constexpr uint_least64_t UNKNOWN_LENGTH = ~uint_least64_t{};
+
+		uint_least64_t received = 0, length = UNKNOWN_LENGTH;
+
+		bool active = false;
+	} stream;
 
 public:
 	SimpleInput(EventLoop &event_loop, UniqueFileDescriptor pipe,
@@ -47,19 +83,71 @@ public:
 	}
 
 	bool IsActive() const noexcept {
-		return buffer != nullptr;
+		return buffer || stream.active;
 	}
 
 	void Activate() noexcept;
 
-	bool SetLength(std::size_t length) noexcept;
+	/**
+	 * Like Activate(), but stream the body to a
+	 * #SimpleBodyHandler instead of collecting it in a buffer.
+	 * Reading begins when SetStreamHandler() is called.  This
+	 * allows bodies of arbitrary size with bounded memory.
+	 */
+	void ActivateStream() noexcept;
+
+	void SetStreamHandler(SimpleBodyHandler &_handler) noexcept;
+
+	/**
+	 * Resume reading after SimpleBodyHandler::OnWasBodyData()
+	 * has not consumed all data.
+	 */
+	void ResumeStream() noexcept {
+		assert(stream.handler != nullptr);
+
+		DeferRead();
+	}
+
+	/**
+	 * Stop delivering stream data to the handler.  The stream
+	 * remains active until Premature() is called (after the peer
+	 * has responded to our STOP).
+	 */
+	void StopStream() noexcept;
+
+	/**
+	 * Is the stream active, i.e. has not yet been received
+	 * completely?
+	 */
+	bool IsStreaming() const noexcept {
+		return stream.active;
+	}
+
+	bool SetLength(uint_least64_t length) noexcept;
 
 	DisposableBuffer CheckComplete() noexcept;
 
 	/**
+	 * Handle a PREMATURE packet: discard the rest of the body
+	 * which is still in the pipe and, if the stream was not
+	 * stopped, report the error to the #SimpleBodyHandler.
+	 *
+	 * Throws on error.
+	 *
+	 * @return false if this object has been destroyed by the
+	 * #SimpleBodyHandler
+	 */
+	bool Premature(uint_least64_t nbytes);
+
+	/**
+	 * Read and discard the given number of bytes from the pipe;
+	 * they are expected to be there already.  This is used to
+	 * recover from a canceled body which was not received with
+	 * this object.
+	 *
 	 * Throws on error.
 	 */
-	void Premature(std::size_t nbytes);
+	void Discard(uint_least64_t nbytes);
 
 private:
 	FileDescriptor GetPipe() const noexcept {
@@ -70,7 +158,21 @@ private:
 		defer_read.Schedule();
 	}
 
+	DisposableBuffer ReleaseBuffer() noexcept;
+
 	void TryRead();
+	void TryReadStream();
+
+	/**
+	 * Submit buffered data to the #SimpleBodyHandler.
+	 *
+	 * @return true if more data shall be read; false if reading
+	 * shall pause or if this object has been destroyed
+	 */
+	bool SubmitStream() noexcept;
+
+	void EndStream() noexcept;
+
 	void OnPipeReady(unsigned events) noexcept;
 	void OnDeferredRead() noexcept;
 };
@@ -3,7 +3,7 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "SimpleOutput.hxx"
-#include "Buffer.hxx"
+#include "SimpleHandler.hxx"
 #include "io/UniqueFileDescriptor.hxx"
 #include "system/Error.hxx"
 #include "util/DisposableBuffer.hxx"
@@ -28,6 +28,16 @@ SimpleOutput::~SimpleOutput() noexcept
 	event.Close();
 }
 
+uint_least64_t
+SimpleOutput::Stop() noexcept
+{
+	buffer = {};
+	producer.reset();
+	event.Cancel();
+	defer_write.Cancel();
+	return position;
+}
+
 void
 SimpleOutput::Activate(DisposableBuffer _buffer) noexcept
 {
@@ -42,6 +52,22 @@ SimpleOutput::Activate(DisposableBuffer _buffer) noexcept
 	defer_write.Schedule();
 }
 
+void
+SimpleOutput::Activate(std::unique_ptr<SimpleBodyProducer> _producer) noexcept
+{
+	assert(!IsActive());
+	assert(_producer);
+
+	position = 0;
+	remaining = _producer->GetLength();
+	if (remaining == 0)
+		return;
+
+	producer = std::move(_producer);
+
+	defer_write.Schedule();
+}
+
 void
 SimpleOutput::OnPipeReady(unsigned events) noexcept
 try {
@@ -61,9 +87,40 @@ try {
 	handler.OnWasOutputError(std::current_exception());
 }
 
+inline void
+SimpleOutput::TryWriteProducer()
+{
+	assert(producer);
+	assert(remaining > 0);
+
+	const std::size_t nbytes = producer->WriteBody(GetPipe(), remaining);
+	if (nbytes == 0) {
+		event.ScheduleWrite();
+		return;
+	}
+
+	if (nbytes > remaining)
+		throw std::runtime_error("Body producer has written too much data");
+
+	position += nbytes;
+	remaining -= nbytes;
+
+	if (remaining == 0) {
+		/* done */
+		producer.reset();
+		event.ScheduleImplicit();
+	} else
+		event.ScheduleWrite();
+}
+
 inline void
 SimpleOutput::TryWrite()
 {
+	if (producer) {
+		TryWriteProducer();
+		return;
+	}
+
 	assert(buffer);
 	assert(position < buffer.size());
 
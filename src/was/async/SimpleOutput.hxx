@@ -8,12 +8,16 @@
 #include "event/DeferEvent.hxx"
 #include "util/DisposableBuffer.hxx"
 
+#include <cstdint>
 #include <exception> // for std::exception_ptr
+#include <memory>
 
 class UniqueFileDescriptor;
 
 namespace Was {
 
+class SimpleBodyProducer;
+
 class SimpleOutputHandler {
 public:
 	virtual void OnWasOutputError(std::exception_ptr error) noexcept = 0;
@@ -27,7 +31,18 @@ class SimpleOutput final {
 
 	DisposableBuffer buffer;
 
-	std::size_t position;
+	/**
+	 * If set, then the body is generated by this object instead
+	 * of being copied from #buffer.
+	 */
+	std::unique_ptr<SimpleBodyProducer> producer;
+
+	/**
+	 * The number of bytes #producer has yet to write.
+	 */
+	uint_least64_t remaining;
+
+	uint_least64_t position;
 
 public:
 	SimpleOutput(EventLoop &event_loop, UniqueFileDescriptor pipe,
@@ -44,11 +59,19 @@ public:
 	}
 
 	bool IsActive() const noexcept {
-		return buffer;
+		return buffer || producer;
 	}
 
 	void Activate(DisposableBuffer _buffer) noexcept;
 
+	/**
+	 * Send a body generated by the given producer.  The
+	 * producer is asked to write to the pipe whenever it is
+	 * writable, until SimpleBodyProducer::GetLength() bytes have
+	 * been written.
+	 */
+	void Activate(std::unique_ptr<SimpleBodyProducer> _producer) noexcept;
+
 	/**
 	 * Set the "position" field to zero to allow calling Stop()
 	 * without Activate(), in cases where there is no request
@@ -64,11 +87,7 @@ public:
 	 * has completed (because the `position` field does not get
 	 * cleared).
 	 */
-	std::size_t Stop() noexcept {
-		buffer = {};
-		event.Cancel();
-		return position;
-	}
+	uint_least64_t Stop() noexcept;
 
 private:
 	FileDescriptor GetPipe() const noexcept {
@@ -76,6 +95,7 @@ private:
 	}
 
 	void TryWrite();
+	void TryWriteProducer();
 	void OnDeferredWrite() noexcept;
 	void OnPipeReady(unsigned events) noexcept;
 };
@@ -50,7 +50,7 @@ public:
 };
 
 static void
-RunSingle(EventLoop &event_loop, SimpleRequestHandler &request_handler)
+RunSingle(EventLoop &event_loop, CompactRequestHandler &request_handler)
 {
 	RunConnectionHandler connection_handler(event_loop);
 	Was::SimpleServer s(event_loop,
@@ -74,17 +74,17 @@ class ConnectionList final
 
 		Connection(EventLoop &event_loop, WasSocket &&socket,
 			   SimpleServerHandler &_handler,
-			   SimpleRequestHandler &_request_handler) noexcept
+			   CompactRequestHandler &_request_handler) noexcept
 			:server(event_loop, std::move(socket),
 				_handler, _request_handler) {}
 	};
 
-	SimpleRequestHandler &request_handler;
+	CompactRequestHandler &request_handler;
 
 	IntrusiveList<Connection> connections;
 
 public:
-	explicit ConnectionList(SimpleRequestHandler &_request_handler) noexcept
+	explicit ConnectionList(CompactRequestHandler &_request_handler) noexcept
 		:request_handler(_request_handler) {}
 
 	~ConnectionList() noexcept {
@@ -126,7 +126,7 @@ class MultiRunServer final
 
 public:
 	MultiRunServer(EventLoop &event_loop, UniqueSocketDescriptor &&s,
-		       SimpleRequestHandler &_request_handler) noexcept
+		       CompactRequestHandler &_request_handler) noexcept
 		:server(event_loop, std::move(s), *this),
 		 connections(_request_handler) {}
 
@@ -158,7 +158,7 @@ private:
 };
 
 static void
-RunMulti(EventLoop &event_loop, SimpleRequestHandler &request_handler)
+RunMulti(EventLoop &event_loop, CompactRequestHandler &request_handler)
 {
 	MultiRunServer server{
 		event_loop,
@@ -181,7 +181,7 @@ class MultiConnection final
 
 public:
 	MultiConnection(EventLoop &event_loop, UniqueSocketDescriptor &&s,
-			SimpleRequestHandler &_request_handler) noexcept
+			CompactRequestHandler &_request_handler) noexcept
 		:server(event_loop, std::move(s), *this),
 		 connections(_request_handler) {}
 
@@ -209,12 +209,12 @@ private:
 
 class MultiConnectionList final
 {
-	SimpleRequestHandler &request_handler;
+	CompactRequestHandler &request_handler;
 
 	IntrusiveList<MultiConnection> connections;
 
 public:
-	explicit MultiConnectionList(SimpleRequestHandler &_request_handler) noexcept
+	explicit MultiConnectionList(CompactRequestHandler &_request_handler) noexcept
 		:request_handler(_request_handler) {}
 
 	~MultiConnectionList() noexcept {
@@ -239,7 +239,7 @@ class MultiListener final
 public:
 	MultiListener(EventLoop &event_loop,
 		      UniqueSocketDescriptor &&_fd,
-		      SimpleRequestHandler &request_handler) noexcept
+		      CompactRequestHandler &request_handler) noexcept
 		:ServerSocket(event_loop, std::move(_fd)),
 		 connections(request_handler) {}
 
@@ -263,7 +263,7 @@ private:
 
 static void
 RunSystemd(EventLoop &event_loop, unsigned n,
-	   SimpleRequestHandler &request_handler)
+	   CompactRequestHandler &request_handler)
 {
 	std::forward_list<MultiListener> listeners;
 	for (unsigned i = 0; i < n; ++i)
@@ -284,7 +284,7 @@ RunSystemd(EventLoop &event_loop, unsigned n,
 } // anonymous namespace
 
 void
-Run(EventLoop &event_loop, SimpleRequestHandler &request_handler)
+Run(EventLoop &event_loop, CompactRequestHandler &request_handler)
 {
 	ShutdownListener shutdown_listener{
 		event_loop,
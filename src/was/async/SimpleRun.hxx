@@ -8,11 +8,12 @@ class EventLoop;
 
 namespace Was {
 
-class SimpleRequestHandler;
+class CompactRequestHandler;
 
 /**
  * Accept incoming WAS requests using the given #EventLoop and let the
- * given #SimpleRequestHandler handle them.
+ * given #CompactRequestHandler (e.g. a #SimpleRequestHandler) handle
+ * them.
  *
  * This function auto-detects how this process was launched:
  *
@@ -30,6 +31,6 @@ class SimpleRequestHandler;
  * asynchronously
  */
 void
-Run(EventLoop &event_loop, SimpleRequestHandler &request_handler);
+Run(EventLoop &event_loop, CompactRequestHandler &request_handler);
 
 } // namespace Was
@@ -11,11 +11,13 @@
 
 #include <array>
 
+#include <cinttypes> // for PRIuLEAST64
+
 namespace Was {
 
 SimpleServer::SimpleServer(EventLoop &event_loop, WasSocket &&socket,
 			   SimpleServerHandler &_handler,
-			   SimpleRequestHandler &_request_handler) noexcept
+			   CompactRequestHandler &_request_handler) noexcept
 	:control(event_loop, std::move(socket.control), *this),
 	 input(event_loop, std::move(socket.input), *this),
 	 output(event_loop, std::move(socket.output), *this),
@@ -36,9 +38,9 @@ SimpleServer::SubmitRequest() noexcept
 
 	request.state = Request::State::SUBMITTED;
 
-	return request_handler.OnRequest(*this,
-					 std::move(*request.request),
-					 request.cancel_ptr);
+	return request_handler.OnCompactRequest(*this,
+						std::move(*request.request),
+						request.cancel_ptr);
 }
 
 bool
@@ -47,6 +49,10 @@ SimpleServer::CancelRequest() noexcept
 	request.state = Request::State::NONE;
 	request.request.reset();
 
+	/* the request handler may be the body handler; don't let
+	   SimpleInput call it after it has been canceled */
+	input.StopStream();
+
 	if (!request.cancel_ptr)
 		return false;
 
@@ -140,32 +146,28 @@ SimpleServer::OnWasControlPacket(enum was_command cmd,
 			return false;
 		}
 
-		request.request->uri.assign((const char *)payload.data(),
-					    payload.size());
+		request.request->uri = request.request->Dup(ToStringView(payload));
 		break;
 
 	case WAS_COMMAND_SCRIPT_NAME:
 		if (request.state != Request::State::HEADERS)
 			AbortProtocolError("misplaced SCRIPT_NAME packet");
 
-		request.request->script_name.assign((const char *)payload.data(),
-						    payload.size());
+		request.request->script_name = request.request->Dup(ToStringView(payload));
 		break;
 
 	case WAS_COMMAND_PATH_INFO:
 		if (request.state != Request::State::HEADERS)
 			AbortProtocolError("misplaced PATH_INFO packet");
 
-		request.request->path_info.assign((const char *)payload.data(),
-						    payload.size());
+		request.request->path_info = request.request->Dup(ToStringView(payload));
 		break;
 
 	case WAS_COMMAND_QUERY_STRING:
 		if (request.state != Request::State::HEADERS)
 			AbortProtocolError("misplaced QUERY_STRING packet");
 
-		request.request->query_string.assign((const char *)payload.data(),
-						     payload.size());
+		request.request->query_string = request.request->Dup(ToStringView(payload));
 		break;
 
 	case WAS_COMMAND_HEADER:
@@ -176,7 +178,7 @@ SimpleServer::OnWasControlPacket(enum was_command cmd,
 
 		if (auto [name, value] = Split(ToStringView(payload), '=');
 		    value.data() != nullptr) {
-			request.request->headers.emplace(name, value);
+			request.request->AddHeader(name, value);
 		} else {
 			AbortProtocolError("malformed HEADER packet");
 			return false;
@@ -192,7 +194,7 @@ SimpleServer::OnWasControlPacket(enum was_command cmd,
 
 		if (auto [name, value] = Split(ToStringView(payload), '=');
 		    value.data() != nullptr) {
-			request.request->parameters.emplace(name, value);
+			request.request->AddParameter(name, value);
 		} else {
 			AbortProtocolError("malformed PARAMETER packet");
 			return false;
@@ -211,6 +213,7 @@ SimpleServer::OnWasControlPacket(enum was_command cmd,
 			return false;
 		}
 
+		request.request->Finish();
 		request.state = Request::State::PENDING;
 		break;
 
@@ -221,8 +224,19 @@ SimpleServer::OnWasControlPacket(enum was_command cmd,
 			return false;
 		}
 
-		input.Activate();
-		request.state = Request::State::BODY;
+		request.request->Finish();
+
+		if (request_handler.WantStreamBody(*request.request)) {
+			/* submit the request right away and let the
+			   handler read the body */
+			input.ActivateStream();
+			request.request->body_stream = true;
+			request.state = Request::State::PENDING;
+		} else {
+			input.Activate();
+			request.state = Request::State::BODY;
+		}
+
 		break;
 
 	case WAS_COMMAND_LENGTH:
@@ -265,21 +279,26 @@ SimpleServer::OnWasControlPacket(enum was_command cmd,
 			}
 
 			try {
-				input.Premature(*length_p);
+				/* this is either the response to our
+				   STOP (see SendResponse()) or the
+				   client has aborted the request body
+				   (which gets reported to the body
+				   handler) */
+				if (!input.Premature(*length_p))
+					return false;
 			} catch (...) {
 				AbortError(std::current_exception());
 				return false;
 			}
 		}
 
-		return false;
+		break;
 
 	case WAS_COMMAND_REMOTE_HOST:
 		if (request.state != Request::State::HEADERS)
 			AbortProtocolError("misplaced REMOTE_HOST packet");
 
-		request.request->remote_host.assign((const char *)payload.data(),
-						    payload.size());
+		request.request->remote_host = request.request->Dup(ToStringView(payload));
 		break;
 
 	case WAS_COMMAND_METRIC:
@@ -369,6 +388,15 @@ SimpleServer::SendResponse(SimpleResponse &&response) noexcept
 
 	request.cancel_ptr = nullptr;
 
+	if (input.IsStreaming()) {
+		/* the handler has not consumed the whole request
+		   body; ask the client to stop sending it; the rest
+		   will be discarded when PREMATURE is received */
+		input.StopStream();
+		if (!control.Send(WAS_COMMAND_STOP))
+			return false;
+	}
+
 	if (!control.SendT(WAS_COMMAND_STATUS, response.status))
 		return false;
 
@@ -380,6 +408,19 @@ SimpleServer::SendResponse(SimpleResponse &&response) noexcept
 		response.body = {};
 	}
 
+	if (response.body_producer && (response.body ||
+				       http_method_is_empty(request.method))) {
+		if (!response.body && request.method == HttpMethod::HEAD)
+			response.headers.emplace("content-length",
+						 StringFormat<64>("%" PRIuLEAST64,
+								  response.body_producer->GetLength()).c_str());
+
+		response.body_producer.reset();
+	}
+
+	if (response.body_producer && response.body_producer->GetLength() == 0)
+		response.body_producer.reset();
+
 	for (const auto &i : response.headers)
 		if (!control.SendPair(WAS_COMMAND_HEADER, i.first, i.second))
 			return false;
@@ -390,6 +431,13 @@ SimpleServer::SendResponse(SimpleResponse &&response) noexcept
 			return false;
 
 		output.Activate(std::move(response.body));
+	} else if (response.body_producer) {
+		if (!control.Send(WAS_COMMAND_DATA) ||
+		    !control.SendUint64(WAS_COMMAND_LENGTH,
+					response.body_producer->GetLength()))
+			return false;
+
+		output.Activate(std::move(response.body_producer));
 	} else {
 		if (!control.Send(WAS_COMMAND_NO_DATA))
 			return false;
@@ -35,11 +35,11 @@ class SimpleServer final
 	SimpleOutput output;
 
 	SimpleServerHandler &handler;
-	SimpleRequestHandler &request_handler;
+	CompactRequestHandler &request_handler;
 
 	struct Request {
 		HttpMethod method = HttpMethod::GET;
-		std::optional<SimpleRequest> request;
+		std::optional<CompactRequest> request;
 
 		CancellablePointer cancel_ptr{nullptr};
 
@@ -61,13 +61,13 @@ class SimpleServer final
 
 			/**
 			 * Pending call to
-			 * SimpleServerHandler::OnRequest().
+			 * CompactRequestHandler::OnCompactRequest().
 			 */
 			PENDING,
 
 			/**
 			 * Request already submitted to
-			 * SimpleServerHandler::OnRequest().
+			 * CompactRequestHandler::OnCompactRequest().
 			 */
 			SUBMITTED,
 		} state = State::NONE;
@@ -76,7 +76,7 @@ class SimpleServer final
 public:
 	SimpleServer(EventLoop &event_loop, WasSocket &&socket,
 		     SimpleServerHandler &_handler,
-		     SimpleRequestHandler &_request_handler) noexcept;
+		     CompactRequestHandler &_request_handler) noexcept;
 
 	auto &GetEventLoop() const noexcept {
 		return control.GetEventLoop();
@@ -90,6 +90,24 @@ public:
 
 	bool SendResponse(SimpleResponse &&response) noexcept;
 
+	/**
+	 * Begin reading a streamed request body (see
+	 * CompactRequest::body_stream).  The handler will be invoked
+	 * from inside the #EventLoop, never from within this method.
+	 */
+	void ReadBody(SimpleBodyHandler &body_handler) noexcept {
+		input.SetStreamHandler(body_handler);
+	}
+
+	/**
+	 * Resume reading the request body after
+	 * SimpleBodyHandler::OnWasBodyData() has not consumed all
+	 * data.
+	 */
+	void ResumeBody() noexcept {
+		input.ResumeStream();
+	}
+
 private:
 	bool SubmitRequest() noexcept;
 
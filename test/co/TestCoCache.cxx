@@ -70,6 +70,74 @@ struct ThrowSleepFactory {
 	}
 };
 
+using namespace std::chrono_literals;
+
+static std::chrono::steady_clock::time_point fake_now;
+
+/**
+ * Values expire after 10 seconds; odd values are not stored.
+ */
+struct TtlFactory : ImmediateFactory {
+	auto Now() const noexcept {
+		return fake_now;
+	}
+
+	std::chrono::steady_clock::duration GetTimeToLive(int value) const noexcept {
+		if (value % 2 != 0)
+			return {};
+
+		return 10s;
+	}
+};
+
+/**
+ * Errors are stored for 5 seconds.
+ */
+struct NegativeFactory : ThrowImmediateFactory {
+	auto Now() const noexcept {
+		return fake_now;
+	}
+
+	std::chrono::steady_clock::duration GetErrorTimeToLive(std::exception_ptr) const noexcept {
+		return 5s;
+	}
+};
+
+/**
+ * Values expire after 10 seconds and may be served stale for
+ * another 60 seconds.  The factory returns the key plus 100 times the
+ * number of invocations, and fails if #fail is set.
+ */
+struct StaleFactory {
+	EventLoop &event_loop;
+
+	bool fail = false;
+
+	explicit StaleFactory(EventLoop &_event_loop) noexcept
+		:event_loop(_event_loop) {}
+
+	Co::Task<int> operator()(int key) {
+		const int value = key + 100 * ++n_started;
+		co_await Co::Sleep(event_loop, std::chrono::milliseconds(1));
+		++n_finished;
+		if (fail)
+			throw std::runtime_error("Error");
+		co_return value;
+	}
+
+	auto Now() const noexcept {
+		return fake_now;
+	}
+
+	std::chrono::steady_clock::duration GetTimeToLive(int) const noexcept {
+		return 10s;
+	}
+
+	std::chrono::steady_clock::duration GetMaxStale() const noexcept {
+		return 60s;
+	}
+};
+
 template<typename Factory>
 using TestCache = Co::Cache<Factory, int, int, 2048, 2021>;
 
@@ -435,3 +503,159 @@ TEST(CoCache, IsCacheable)
 	ASSERT_EQ(cache.GetIfCached(3), nullptr);
 	ASSERT_EQ(*cache.GetIfCached(4), 4);
 }
+
+TEST(CoCache, Expire)
+{
+	using Factory = TtlFactory;
+	using Cache = TestCache<Factory>;
+
+	Cache cache;
+
+	n_started = n_finished = 0;
+	fake_now = {};
+
+	Work w1(cache), w2(cache);
+	w1.Start(42);
+	w2.Start(42);
+
+	ASSERT_EQ(w1.value, 42);
+	ASSERT_EQ(w2.value, 42);
+	ASSERT_EQ(n_started, 1u);
+	ASSERT_NE(cache.GetIfCached(42), nullptr);
+
+	fake_now += 9s;
+	ASSERT_NE(cache.GetIfCached(42), nullptr);
+
+	fake_now += 1s;
+	ASSERT_EQ(cache.GetIfCached(42), nullptr);
+
+	Work w3(cache);
+	w3.Start(42);
+	ASSERT_EQ(w3.value, 42);
+	ASSERT_EQ(n_started, 2u);
+	ASSERT_NE(cache.GetIfCached(42), nullptr);
+
+	/* a zero TTL means "don't store" */
+	Work w4(cache), w5(cache);
+	w4.Start(3);
+	w5.Start(3);
+	ASSERT_EQ(w4.value, 3);
+	ASSERT_EQ(w5.value, 3);
+	ASSERT_EQ(n_started, 4u);
+	ASSERT_EQ(cache.GetIfCached(3), nullptr);
+
+	const auto &stats = cache.GetStats();
+	ASSERT_EQ(stats.hits, 1u);
+	ASSERT_EQ(stats.misses, 4u);
+	ASSERT_EQ(stats.stale, 0u);
+}
+
+TEST(CoCache, Negative)
+{
+	using Factory = NegativeFactory;
+	using Cache = TestCache<Factory>;
+
+	Cache cache;
+
+	n_started = n_finished = 0;
+	fake_now = {};
+
+	Work w1(cache), w2(cache);
+	w1.Start(42);
+	w2.Start(42);
+
+	ASSERT_EQ(n_started, 1u);
+	ASSERT_TRUE(w1.error);
+	ASSERT_TRUE(w2.error);
+
+	/* errors are not returned by GetIfCached() */
+	ASSERT_EQ(cache.GetIfCached(42), nullptr);
+
+	fake_now += 5s;
+
+	Work w3(cache);
+	w3.Start(42);
+	ASSERT_EQ(n_started, 2u);
+	ASSERT_TRUE(w3.error);
+
+	const auto &stats = cache.GetStats();
+	ASSERT_EQ(stats.hits, 1u);
+	ASSERT_EQ(stats.misses, 2u);
+}
+
+TEST(CoCache, Stale)
+{
+	using Factory = StaleFactory;
+	using Cache = TestCache<Factory>;
+
+	EventLoop event_loop;
+	Cache cache(event_loop);
+
+	n_started = n_finished = 0;
+	fake_now = {};
+
+	Work w1(cache);
+	w1.Start(1);
+	event_loop.Run();
+	ASSERT_EQ(w1.value, 101);
+
+	/* expired: the stale value is returned immediately, and only
+	   one refresh is started */
+	fake_now += 20s;
+
+	Work w2(cache), w3(cache);
+	w2.Start(1);
+	w3.Start(1);
+	ASSERT_EQ(w2.value, 101);
+	ASSERT_EQ(w3.value, 101);
+	ASSERT_EQ(n_started, 2u);
+	ASSERT_EQ(n_finished, 1u);
+	ASSERT_EQ(cache.GetIfCached(1), nullptr);
+
+	event_loop.Run();
+	ASSERT_EQ(n_finished, 2u);
+	ASSERT_EQ(*cache.GetIfCached(1), 201);
+
+	/* a failed refresh keeps the stale value */
+	fake_now += 20s;
+	cache.GetFactory().fail = true;
+
+	Work w4(cache);
+	w4.Start(1);
+	ASSERT_EQ(w4.value, 201);
+	event_loop.Run();
+	ASSERT_EQ(n_started, 3u);
+	ASSERT_EQ(n_finished, 3u);
+
+	Work w5(cache);
+	w5.Start(1);
+	ASSERT_EQ(w5.value, 201);
+	cache.GetFactory().fail = false;
+	event_loop.Run();
+	ASSERT_EQ(n_started, 4u);
+	ASSERT_EQ(*cache.GetIfCached(1), 401);
+
+	/* too old to be served stale */
+	fake_now += 100s;
+
+	Work w6(cache);
+	w6.Start(1);
+	ASSERT_EQ(w6.value, -1);
+	event_loop.Run();
+	ASSERT_EQ(w6.value, 501);
+
+	const auto &stats = cache.GetStats();
+	ASSERT_EQ(stats.hits, 0u);
+	ASSERT_EQ(stats.misses, 2u);
+	ASSERT_EQ(stats.stale, 4u);
+
+	/* a pending background refresh is canceled when the cache
+	   is destroyed */
+	fake_now += 20s;
+
+	Work w7(cache);
+	w7.Start(1);
+	ASSERT_EQ(w7.value, 501);
+	ASSERT_EQ(n_started, 6u);
+	ASSERT_EQ(n_finished, 5u);
+}
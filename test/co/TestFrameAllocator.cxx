@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "co/FrameAllocator.hxx"
+#include "co/InvokeTask.hxx"
+#include "co/Task.hxx"
+#include "util/Sanitizer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(FrameAllocator, Basic)
+{
+	if (HaveAddressSanitizer())
+		GTEST_SKIP();
+
+	Co::FrameAllocator::Flush();
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), 0U);
+
+	/* frames of the same size class are reused */
+	void *a = Co::FrameAllocator::Allocate(100);
+	Co::FrameAllocator::Deallocate(a, 100);
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), 1U);
+
+	void *b = Co::FrameAllocator::Allocate(128);
+	EXPECT_EQ(b, a);
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), 0U);
+
+	/* a different size class */
+	void *c = Co::FrameAllocator::Allocate(64);
+	EXPECT_NE(c, a);
+
+	Co::FrameAllocator::Deallocate(b, 128);
+	Co::FrameAllocator::Deallocate(c, 64);
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), 2U);
+
+	/* large frames are not cached */
+	void *d = Co::FrameAllocator::Allocate(Co::FrameAllocator::MAX_SIZE + 1);
+	Co::FrameAllocator::Deallocate(d, Co::FrameAllocator::MAX_SIZE + 1);
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), 2U);
+
+	Co::FrameAllocator::Flush();
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), 0U);
+}
+
+TEST(FrameAllocator, Limit)
+{
+	if (HaveAddressSanitizer())
+		GTEST_SKIP();
+
+	Co::FrameAllocator::Flush();
+
+	std::vector<void *> v;
+	for (std::size_t i = 0; i < Co::FrameAllocator::MAX_FREE + 10; ++i)
+		v.push_back(Co::FrameAllocator::Allocate(200));
+
+	for (void *p : v)
+		Co::FrameAllocator::Deallocate(p, 200);
+
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), Co::FrameAllocator::MAX_FREE);
+
+	Co::FrameAllocator::Flush();
+}
+
+TEST(FrameAllocator, Thread)
+{
+	if (HaveAddressSanitizer())
+		GTEST_SKIP();
+
+	Co::FrameAllocator::Flush();
+
+	/* allocated in another thread, freed in this one */
+	void *p = nullptr;
+	std::thread t{[&p]{
+		p = Co::FrameAllocator::Allocate(300);
+
+		/* warm up this thread's cache; it will be freed
+		   when the thread exits */
+		Co::FrameAllocator::Deallocate(Co::FrameAllocator::Allocate(300), 300);
+	}};
+	t.join();
+
+	Co::FrameAllocator::Deallocate(p, 300);
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), 1U);
+
+	Co::FrameAllocator::Flush();
+}
+
+#ifndef CO_NO_FRAME_ALLOCATOR
+
+static Co::Task<int>
+Chain(unsigned depth)
+{
+	if (depth == 0)
+		co_return 1;
+
+	co_return 1 + co_await Chain(depth - 1);
+}
+
+static Co::InvokeTask
+RunChain(unsigned depth, int &result)
+{
+	result = co_await Chain(depth);
+}
+
+static int
+RunChainSync(unsigned depth)
+{
+	int result = -1;
+	std::exception_ptr error;
+
+	auto task = RunChain(depth, result);
+	task.Start({&error, [](void *error_p, std::exception_ptr _error) noexcept {
+		*(std::exception_ptr *)error_p = std::move(_error);
+	}});
+
+	EXPECT_FALSE(error);
+	return result;
+}
+
+TEST(FrameAllocator, Task)
+{
+	if (HaveAddressSanitizer())
+		GTEST_SKIP();
+
+	Co::FrameAllocator::Flush();
+
+	EXPECT_EQ(RunChainSync(10), 11);
+
+	/* all Task frames (but not the InvokeTask frame) were
+	   returned to the cache */
+	const std::size_t n_free = Co::FrameAllocator::GetFreeCount();
+	EXPECT_EQ(n_free, 11U);
+
+	/* the second run reuses them */
+	EXPECT_EQ(RunChainSync(10), 11);
+	EXPECT_EQ(Co::FrameAllocator::GetFreeCount(), n_free);
+
+	Co::FrameAllocator::Flush();
+}
+
+#endif
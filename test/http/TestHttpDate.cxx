@@ -3,6 +3,7 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "http/Date.hxx"
+#include "http/DateCache.hxx"
 
 #include <gtest/gtest.h>
 
@@ -20,3 +21,26 @@ TEST(HttpDate, Parse)
 	EXPECT_LE(http_date_parse("Thu, 01 Jan 1970"), std::chrono::system_clock::time_point{});
 	EXPECT_LE(http_date_parse("1970-01-01T00:00:00Z"), std::chrono::system_clock::time_point{});
 }
+
+TEST(HttpDate, Cache)
+{
+	using std::chrono::system_clock;
+
+	HttpDateCache cache;
+
+	const auto t = system_clock::from_time_t(1234567890);
+	EXPECT_EQ(cache.Format(t), "Fri, 13 Feb 2009 23:31:30 GMT");
+	EXPECT_EQ(cache.Format(t + std::chrono::milliseconds{999}), "Fri, 13 Feb 2009 23:31:30 GMT");
+	EXPECT_EQ(cache.Format(t + std::chrono::seconds{29}), "Fri, 13 Feb 2009 23:31:59 GMT");
+	EXPECT_EQ(cache.Format(t + std::chrono::seconds{30}), "Fri, 13 Feb 2009 23:32:00 GMT");
+	EXPECT_EQ(cache.Format(t + std::chrono::hours{24}), "Sat, 14 Feb 2009 23:31:30 GMT");
+	EXPECT_EQ(cache.Format(t), "Fri, 13 Feb 2009 23:31:30 GMT");
+	EXPECT_EQ(cache.Format(system_clock::time_point{}), "Thu, 01 Jan 1970 00:00:00 GMT");
+
+	ClockCache<system_clock> clock;
+	clock.Mock(t);
+	EXPECT_EQ(cache.Format(clock), "Fri, 13 Feb 2009 23:31:30 GMT");
+
+	/* the returned string is null-terminated */
+	EXPECT_STREQ(cache.Format(t).data(), "Fri, 13 Feb 2009 23:31:30 GMT");
+}
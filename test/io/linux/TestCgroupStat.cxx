@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "io/linux/CgroupStat.hxx"
+
+#include <gtest/gtest.h>
+
+using std::string_view_literals::operator""sv;
+
+TEST(CgroupStat, Cpu)
+{
+	const auto s = ParseCgroupCpuStat("usage_usec 1234567\n"
+					  "user_usec 1000000\n"
+					  "system_usec 234567\n"
+					  "core_sched.force_idle_usec 0\n"
+					  "nr_periods 10\n"
+					  "nr_throttled 3\n"
+					  "throttled_usec 42\n"
+					  "nr_bursts 0\n"
+					  "burst_usec 0\n"sv);
+	EXPECT_EQ(s.usage_usec, 1234567U);
+	EXPECT_EQ(s.user_usec, 1000000U);
+	EXPECT_EQ(s.system_usec, 234567U);
+	EXPECT_EQ(s.nr_periods, 10U);
+	EXPECT_EQ(s.nr_throttled, 3U);
+	EXPECT_EQ(s.throttled_usec, 42U);
+
+	/* missing keys and garbage */
+	const auto e = ParseCgroupCpuStat("usage_usec x\n"
+					  "user_usec\n"
+					  "system_usec 5"sv);
+	EXPECT_EQ(e.usage_usec, 0U);
+	EXPECT_EQ(e.user_usec, 0U);
+	EXPECT_EQ(e.system_usec, 5U);
+	EXPECT_EQ(e.nr_periods, 0U);
+}
+
+TEST(CgroupStat, Memory)
+{
+	const auto s = ParseCgroupMemoryStat("anon 4096\n"
+					     "file 8192\n"
+					     "kernel 1024\n"
+					     "kernel_stack 512\n"
+					     "sock 0\n"
+					     "shmem 2048\n"
+					     "file_mapped 100\n"
+					     "pgfault 77\n"
+					     "pgmajfault 7\n"sv);
+	EXPECT_EQ(s.anon, 4096U);
+	EXPECT_EQ(s.file, 8192U);
+	EXPECT_EQ(s.kernel, 1024U);
+	EXPECT_EQ(s.sock, 0U);
+	EXPECT_EQ(s.shmem, 2048U);
+	EXPECT_EQ(s.pgfault, 77U);
+	EXPECT_EQ(s.pgmajfault, 7U);
+}
+
+TEST(CgroupStat, Io)
+{
+	const auto s = ParseCgroupIoStat("8:0 rbytes=100 wbytes=200 rios=1 wios=2 dbytes=0 dios=0\n"
+					 "8:16 rbytes=1000 wbytes=2000 rios=10 wios=20 dbytes=0 dios=0\n"
+					 "253:0 rbytes=x wbytes=5\n"sv);
+	EXPECT_EQ(s.rbytes, 1100U);
+	EXPECT_EQ(s.wbytes, 2205U);
+	EXPECT_EQ(s.rios, 11U);
+	EXPECT_EQ(s.wios, 22U);
+
+	const auto e = ParseCgroupIoStat({});
+	EXPECT_EQ(e.rbytes, 0U);
+	EXPECT_EQ(e.wios, 0U);
+}
@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "lua/json/Serialize.hxx"
+#include "lua/json/ToJson.hxx"
+#include "lua/Assert.hxx"
+#include "lua/State.hxx"
+
+#include <gtest/gtest.h>
+
+#include <nlohmann/json.hpp>
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+#include <stdexcept>
+
+using namespace Lua;
+
+/**
+ * Evaluate the given Lua expression and serialize its value.
+ */
+static std::string
+Serialize(lua_State *L, const char *expression,
+	  JsonDialect dialect=JsonDialect::LEGACY)
+{
+	const ScopeCheckStack check_stack{L};
+
+	const std::string code = std::string{"return "} + expression;
+	if (luaL_dostring(L, code.c_str()) != 0)
+		throw std::runtime_error{lua_tostring(L, -1)};
+
+	std::string result;
+
+	try {
+		SerializeJson(L, -1, result, dialect);
+	} catch (...) {
+		lua_pop(L, 1);
+		throw;
+	}
+
+	lua_pop(L, 1);
+	return result;
+}
+
+/**
+ * Evaluate the given Lua expression and serialize its value the old
+ * way, with ToJson() and nlohmann::json::dump().
+ */
+static std::string
+Dump(lua_State *L, const char *expression)
+{
+	const ScopeCheckStack check_stack{L};
+
+	const std::string code = std::string{"return "} + expression;
+	if (luaL_dostring(L, code.c_str()) != 0)
+		throw std::runtime_error{lua_tostring(L, -1)};
+
+	std::string result;
+
+	try {
+		result = ToJson(L, -1).dump();
+	} catch (...) {
+		lua_pop(L, 1);
+		throw;
+	}
+
+	lua_pop(L, 1);
+	return result;
+}
+
+TEST(LuaJson, Scalar)
+{
+	const State main{luaL_newstate()};
+	const auto L = main.get();
+
+	EXPECT_EQ(Serialize(L, "nil"), "null");
+	EXPECT_EQ(Serialize(L, "true"), "1");
+	EXPECT_EQ(Serialize(L, "false"), "0");
+	EXPECT_EQ(Serialize(L, "42"), "42");
+	EXPECT_EQ(Serialize(L, "-7"), "-7");
+	EXPECT_EQ(Serialize(L, "2^53"), "9007199254740992");
+
+	/* numbers are truncated to integers */
+	EXPECT_EQ(Serialize(L, "1.5"), "1");
+	EXPECT_EQ(Serialize(L, "-0.25"), "0");
+
+	EXPECT_EQ(Serialize(L, "'foo'"), "\"foo\"");
+	EXPECT_EQ(Serialize(L, "'a\"b\\\\c\\n\\t\\1\\127'"),
+		  "\"a\\\"b\\\\c\\n\\t\\u0001\x7f\"");
+	EXPECT_EQ(Serialize(L, "'\\0'"), "\"\\u0000\"");
+	EXPECT_EQ(Serialize(L, "'\\195\\164\\240\\159\\152\\128'"),
+		  "\"\xc3\xa4\xf0\x9f\x98\x80\"");
+}
+
+TEST(LuaJson, Table)
+{
+	const State main{luaL_newstate()};
+	const auto L = main.get();
+
+	/* all tables are objects with sorted keys */
+	EXPECT_EQ(Serialize(L, "{}"), "{}");
+	EXPECT_EQ(Serialize(L, "{'x', true}"), "{\"1\":\"x\",\"2\":1}");
+	EXPECT_EQ(Serialize(L, "{a=1}"), "{\"a\":1}");
+	EXPECT_EQ(Serialize(L, "{[1.5]=1}"), "{\"1.5\":1}");
+	EXPECT_EQ(Serialize(L, "{b=2, a=1, c=3}"), "{\"a\":1,\"b\":2,\"c\":3}");
+
+	/* shared references are fine as long as there is no cycle */
+	EXPECT_EQ(Serialize(L, "(function() local t = {1} return {t, t} end)()"),
+		  "{\"1\":{\"1\":1},\"2\":{\"1\":1}}");
+}
+
+/**
+ * The output must be the same as the old ToJson().dump() path.
+ */
+TEST(LuaJson, Compatible)
+{
+	const State main{luaL_newstate()};
+	const auto L = main.get();
+
+	for (const char *expression : {
+			"{a={b={c={d=1, e={2, 3}}, f='g'}}, h={i=true}}",
+			"nil", "true", "false", "0", "-1", "3.75", "2^40",
+			"''", "'foo\\r\\b\\f\\31\\\\/'",
+			"'\\226\\130\\172'",
+			"{}", "{{}, {{1}}}", "{1, nil, 3}", "{[0]=0, 1, x={y=-2.5}}",
+			"{name='foo', list={1, 2, {x=-1.25}}, empty={}}",
+			"{[2]='number', ['2']='string'}",
+			"print", "{f=function() end}",
+			"{['b']=1, ['a']=2, ['B']=3, ['\\200']=nil, ['\\195\\164']=4}",
+		})
+		EXPECT_EQ(Serialize(L, expression), Dump(L, expression))
+			<< expression;
+}
+
+TEST(LuaJson, Standard)
+{
+	const State main{luaL_newstate()};
+	const auto L = main.get();
+
+	const auto Standard = [L](const char *expression){
+		return Serialize(L, expression, JsonDialect::STANDARD);
+	};
+
+	EXPECT_EQ(Standard("true"), "true");
+	EXPECT_EQ(Standard("false"), "false");
+	EXPECT_EQ(Standard("42"), "42");
+	EXPECT_EQ(Standard("-7"), "-7");
+	EXPECT_EQ(Standard("2^53"), "9007199254740992");
+	EXPECT_EQ(Standard("1.5"), "1.5");
+	EXPECT_EQ(Standard("-0.25"), "-0.25");
+	EXPECT_EQ(Standard("0.1"), "0.1");
+	EXPECT_EQ(Standard("1/3"), "0.3333333333333333");
+	EXPECT_EQ(Standard("2^60"), "1152921504606846976");
+	EXPECT_EQ(Standard("1e300"), "1e+300");
+	EXPECT_EQ(Standard("1/0"), "null");
+	EXPECT_EQ(Standard("0/0"), "null");
+
+	/* sequences are arrays */
+	EXPECT_EQ(Standard("{}"), "{}");
+	EXPECT_EQ(Standard("{'x', true, 2.5}"), "[\"x\",true,2.5]");
+	EXPECT_EQ(Standard("{{1, 2}, {a={3}}}"), "[[1,2],{\"a\":[3]}]");
+
+	/* tables with holes or other keys are objects */
+	EXPECT_EQ(Standard("{a=false}"), "{\"a\":false}");
+	EXPECT_EQ(Standard("{[2]=1}"), "{\"2\":1}");
+	EXPECT_EQ(Standard("{[1.5]=1}"), "{\"1.5\":1}");
+	EXPECT_EQ(Standard("{[0]=0}"), "{\"0\":0}");
+
+	/* the Lua function selects the dialect with an option */
+	InitToJson(L);
+	ASSERT_EQ(luaL_dostring(L, "return to_json({1.5, true}), "
+				"to_json({1.5, true}, {standard=true})"), 0);
+	EXPECT_STREQ(lua_tostring(L, -2), "{\"1\":1,\"2\":1}");
+	EXPECT_STREQ(lua_tostring(L, -1), "[1.5,true]");
+	lua_pop(L, 2);
+}
+
+TEST(LuaJson, Errors)
+{
+	const State main{luaL_newstate()};
+	const auto L = main.get();
+
+	EXPECT_THROW(Serialize(L, "(function() local t = {} t.self = t return t end)()"),
+		     std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "(function() local t = {} t[1] = {t} return t end)()"),
+		     std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "{[true]=1}"), std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "{[true]=1}", JsonDialect::STANDARD),
+		     std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "(function() local t = {} t[1] = {t} return t end)()",
+			       JsonDialect::STANDARD),
+		     std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "{[{}]=1}"), std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "(function() local t = {} for i = 1, 1000 do t = {t} end return t end)()"),
+		     std::invalid_argument);
+
+	/* invalid UTF-8 (nlohmann::json::dump() throws, too) */
+	EXPECT_ANY_THROW(Dump(L, "'\\200'"));
+	EXPECT_THROW(Serialize(L, "'\\200'"), std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "'\\195'"), std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "'\\192\\128'"), std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "'\\237\\160\\128'"), std::invalid_argument);
+	EXPECT_THROW(Serialize(L, "{['\\255']=1}"), std::invalid_argument);
+
+	/* the stack was restored */
+	EXPECT_EQ(lua_gettop(L), 0);
+}
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include "net/dns/Protocol.hxx"
+#include "util/PackedBigEndian.hxx"
+#include "util/SpanCast.hxx"
+
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Extract the (uncompressed) name and the type from the question
+ * section of a query generated by Dns::MakeQuery().
+ */
+inline std::pair<std::string, Dns::RecordType>
+ParseDnsQuestion(std::span<const std::byte> query)
+{
+	std::string name;
+
+	std::size_t position = sizeof(Dns::Header);
+	while (true) {
+		if (position >= query.size())
+			throw std::runtime_error{"Malformed query"};
+
+		const std::size_t length = static_cast<std::size_t>(query[position++]);
+		if (length == 0)
+			break;
+
+		if (position + length > query.size())
+			throw std::runtime_error{"Malformed query"};
+
+		if (!name.empty())
+			name.push_back('.');
+		name.append(ToStringView(query.subspan(position, length)));
+		position += length;
+	}
+
+	Dns::QuestionTail tail;
+	if (position + sizeof(tail) > query.size())
+		throw std::runtime_error{"Malformed query"};
+
+	std::memcpy(&tail, query.data() + position, sizeof(tail));
+	return {std::move(name), static_cast<Dns::RecordType>(uint_least16_t{tail.type})};
+}
+
+/**
+ * Generates DNS responses for unit tests.  Answer records must be
+ * added before authority records.
+ */
+class DnsResponseBuilder {
+	std::vector<std::byte> buffer;
+
+	uint_least16_t ancount = 0, nscount = 0;
+
+public:
+	/**
+	 * Copy the id and the question from the given query.
+	 */
+	DnsResponseBuilder(std::span<const std::byte> query,
+			   Dns::ResponseCode rcode=Dns::ResponseCode::NOERROR,
+			   uint_least16_t flags=0) {
+		Dns::Header header;
+		std::memcpy(&header, query.data(), sizeof(header));
+		header.flags = Dns::Flags::QR | Dns::Flags::RD | flags |
+			static_cast<uint_least16_t>(rcode);
+		header.qdcount = 1;
+		header.ancount = header.nscount = header.arcount = 0;
+		AppendT(header);
+
+		const auto [name, type] = ParseDnsQuestion(query);
+		AppendName(name);
+		AppendT(Dns::QuestionTail{
+				static_cast<uint_least16_t>(type),
+				Dns::CLASS_IN,
+			});
+	}
+
+	void AppendName(std::string_view name) {
+		while (!name.empty()) {
+			const auto dot = name.find('.');
+			const auto label = name.substr(0, dot);
+			buffer.push_back(static_cast<std::byte>(label.size()));
+			Append(AsBytes(label));
+
+			if (dot == name.npos)
+				break;
+			name.remove_prefix(dot + 1);
+		}
+
+		buffer.push_back(std::byte{0});
+	}
+
+	void AddAnswer(std::string_view name, Dns::RecordType type,
+		       uint_least32_t ttl, std::span<const std::byte> data) {
+		AddRecord(name, type, ttl, data);
+		++ancount;
+	}
+
+	void AddA(std::string_view name, uint_least32_t ttl,
+		  uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+		const std::byte data[]{std::byte{a}, std::byte{b}, std::byte{c}, std::byte{d}};
+		AddAnswer(name, Dns::RecordType::A, ttl, data);
+	}
+
+	void AddAAAA(std::string_view name, uint_least32_t ttl,
+		     uint16_t last) {
+		/* 2001:db8::<last> */
+		std::byte data[16]{std::byte{0x20}, std::byte{0x01}, std::byte{0x0d}, std::byte{0xb8}};
+		data[14] = static_cast<std::byte>(last >> 8);
+		data[15] = static_cast<std::byte>(last);
+		AddAnswer(name, Dns::RecordType::AAAA, ttl, data);
+	}
+
+	void AddCname(std::string_view name, uint_least32_t ttl,
+		      std::string_view target) {
+		DnsResponseBuilder tmp;
+		tmp.AppendName(target);
+		AddAnswer(name, Dns::RecordType::CNAME, ttl, tmp.buffer);
+	}
+
+	/**
+	 * Add a SOA record to the authority section.
+	 */
+	void AddSoa(std::string_view name, uint_least32_t ttl,
+		    uint_least32_t minimum) {
+		DnsResponseBuilder tmp;
+		tmp.AppendName("ns.example.com");
+		tmp.AppendName("hostmaster.example.com");
+		for (uint_least32_t i : {1U, 3600U, 600U, 86400U, minimum})
+			tmp.AppendT(PackedBE32{i});
+
+		AddRecord(name, Dns::RecordType::SOA, ttl, tmp.buffer);
+		++nscount;
+	}
+
+	std::span<const std::byte> Finish() noexcept {
+		Dns::Header header;
+		std::memcpy(&header, buffer.data(), sizeof(header));
+		header.ancount = ancount;
+		header.nscount = nscount;
+		std::memcpy(buffer.data(), &header, sizeof(header));
+		return buffer;
+	}
+
+private:
+	DnsResponseBuilder() = default;
+
+	void Append(std::span<const std::byte> src) {
+		buffer.insert(buffer.end(), src.begin(), src.end());
+	}
+
+	template<typename T>
+	void AppendT(const T &src) {
+		Append(ReferenceAsBytes(src));
+	}
+
+	void AddRecord(std::string_view name, Dns::RecordType type,
+		       uint_least32_t ttl, std::span<const std::byte> data) {
+		AppendName(name);
+		AppendT(Dns::RecordTail{
+				static_cast<uint_least16_t>(type),
+				Dns::CLASS_IN,
+				ttl,
+				static_cast<uint_least16_t>(data.size()),
+			});
+		Append(data);
+	}
+};
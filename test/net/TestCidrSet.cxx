@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "net/CidrSet.hxx"
+#include "net/MaskedSocketAddress.hxx"
+#include "net/Parser.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/IPv6Address.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+static bool
+Contains(const CidrSet &set, const char *s)
+{
+	return set.Contains(ParseSocketAddress(s, 42, false));
+}
+
+/**
+ * Construct an IPv4-mapped IPv6 address.
+ */
+static constexpr IPv6Address
+MapV4(uint8_t a, uint8_t b, uint8_t c, uint8_t d) noexcept
+{
+	return {0, 0, 0, 0, 0, 0xffff, uint16_t(a << 8 | b), uint16_t(c << 8 | d), 42};
+}
+
+TEST(CidrSet, Empty)
+{
+	CidrSet set;
+	set.Finish();
+	EXPECT_TRUE(set.empty());
+	EXPECT_FALSE(Contains(set, "192.168.1.2"));
+	EXPECT_FALSE(Contains(set, "::1"));
+}
+
+TEST(CidrSet, IPv4)
+{
+	CidrSet set;
+	set.Add("192.168.1.0/24");
+	set.Add("10.0.0.0/8");
+	set.Add("172.16.0.1");
+	set.Finish();
+
+	EXPECT_EQ(set.size(), 3U);
+
+	EXPECT_TRUE(Contains(set, "192.168.1.0"));
+	EXPECT_TRUE(Contains(set, "192.168.1.2"));
+	EXPECT_TRUE(Contains(set, "192.168.1.255"));
+	EXPECT_FALSE(Contains(set, "192.168.0.255"));
+	EXPECT_FALSE(Contains(set, "192.168.2.0"));
+	EXPECT_TRUE(Contains(set, "10.0.0.0"));
+	EXPECT_TRUE(Contains(set, "10.255.255.255"));
+	EXPECT_FALSE(Contains(set, "11.0.0.0"));
+	EXPECT_FALSE(Contains(set, "9.255.255.255"));
+	EXPECT_TRUE(Contains(set, "172.16.0.1"));
+	EXPECT_FALSE(Contains(set, "172.16.0.0"));
+	EXPECT_FALSE(Contains(set, "172.16.0.2"));
+	EXPECT_FALSE(Contains(set, "0.0.0.0"));
+	EXPECT_FALSE(Contains(set, "255.255.255.255"));
+
+	/* IPv4-mapped addresses */
+	EXPECT_TRUE(set.Contains(MapV4(192, 168, 1, 2)));
+	EXPECT_FALSE(set.Contains(MapV4(192, 168, 2, 2)));
+	EXPECT_FALSE(set.Contains(IPv6Address{0, 0, 0, 0, 0, 0, 0xc0a8, 0x0102, 42}));
+	EXPECT_FALSE(Contains(set, "::1"));
+
+	/* other address families */
+	EXPECT_FALSE(Contains(set, "@foo"));
+	EXPECT_FALSE(set.Contains(nullptr));
+}
+
+TEST(CidrSet, IPv6)
+{
+	CidrSet set;
+	set.Add("2001:db8::/32");
+	set.Add("fe80::1");
+	set.Add(MapV4(10, 0, 0, 0), 104);
+	set.Finish();
+
+	EXPECT_TRUE(Contains(set, "2001:db8::"));
+	EXPECT_TRUE(Contains(set, "2001:db8:ffff:ffff:ffff:ffff:ffff:ffff"));
+	EXPECT_FALSE(Contains(set, "2001:db9::"));
+	EXPECT_FALSE(Contains(set, "2001:db7:ffff:ffff:ffff:ffff:ffff:ffff"));
+	EXPECT_TRUE(Contains(set, "fe80::1"));
+	EXPECT_FALSE(Contains(set, "fe80::2"));
+	EXPECT_FALSE(Contains(set, "::"));
+
+	/* an IPv4-mapped network matches plain IPv4 addresses */
+	EXPECT_TRUE(Contains(set, "10.1.2.3"));
+	EXPECT_TRUE(set.Contains(MapV4(10, 1, 2, 3)));
+	EXPECT_FALSE(Contains(set, "11.1.2.3"));
+}
+
+TEST(CidrSet, Merge)
+{
+	CidrSet set;
+	set.Add("10.0.0.0/8");
+	set.Add("10.1.0.0/16");
+	set.Add("11.0.0.0/8");
+	set.Add("12.0.0.0/9");
+	set.Add("13.0.0.1");
+	set.Finish();
+
+	/* overlapping and adjacent networks have been merged */
+	EXPECT_EQ(set.size(), 2U);
+	EXPECT_TRUE(Contains(set, "10.1.2.3"));
+	EXPECT_TRUE(Contains(set, "11.255.255.255"));
+	EXPECT_TRUE(Contains(set, "12.127.255.255"));
+	EXPECT_FALSE(Contains(set, "12.128.0.0"));
+	EXPECT_FALSE(Contains(set, "13.0.0.0"));
+	EXPECT_TRUE(Contains(set, "13.0.0.1"));
+
+	/* adding after Finish() */
+	set.Add("12.128.0.0/9");
+	set.Finish();
+	EXPECT_TRUE(Contains(set, "12.128.0.0"));
+	EXPECT_EQ(set.size(), 2U);
+
+	set.Add("::/0");
+	set.Finish();
+	EXPECT_EQ(set.size(), 1U);
+	EXPECT_TRUE(Contains(set, "::"));
+	EXPECT_TRUE(Contains(set, "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"));
+	EXPECT_TRUE(Contains(set, "1.2.3.4"));
+}
+
+TEST(CidrSet, MatchesMaskedSocketAddress)
+{
+	static constexpr const char *networks[] = {
+		"192.168.0.0/16", "192.168.1.0/24", "10.20.30.40",
+		"2001:db8::/48", "2001:db8:1::/64", "fe80::/10",
+		"0.0.0.0/1",
+	};
+
+	static constexpr const char *addresses[] = {
+		"192.168.1.1", "192.169.0.0", "10.20.30.40", "10.20.30.41",
+		"127.0.0.1", "128.0.0.0", "2001:db8::1", "2001:db8:1::1",
+		"2001:db8:2::1", "febf::1", "fec0::1", "::1",
+	};
+
+	CidrSet set;
+	std::vector<MaskedSocketAddress> list;
+	for (const char *i : networks) {
+		set.Add(i);
+		list.emplace_back(i);
+	}
+
+	set.Finish();
+
+	for (const char *i : addresses) {
+		const auto address = ParseSocketAddress(i, 42, false);
+		const bool expected = std::any_of(list.begin(), list.end(),
+						  [&address](const auto &m){
+							  return m.Matches(address);
+						  });
+		EXPECT_EQ(set.Contains(address), expected) << i;
+	}
+}
+
+TEST(CidrSet, Errors)
+{
+	CidrSet set;
+	EXPECT_THROW(set.Add("@foo"), std::runtime_error);
+	EXPECT_THROW(set.Add("192.168.1.0/33"), std::runtime_error);
+	EXPECT_THROW(set.Add("192.168.1.1/24"), std::runtime_error);
+	EXPECT_THROW(set.Add("foo"), std::runtime_error);
+	EXPECT_THROW(set.Add(ParseSocketAddress("1.2.3.4", 0, false), 40),
+		     std::runtime_error);
+}
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "DnsResponseBuilder.hxx"
+#include "net/dns/Query.hxx"
+#include "net/dns/Response.hxx"
+#include "net/dns/ResolvConf.hxx"
+#include "net/SocketProtocolError.hxx"
+#include "net/ToString.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+
+using namespace Dns;
+
+static std::span<const std::byte>
+MakeTestQuery(std::array<std::byte, MAX_QUERY_SIZE> &buffer,
+	      std::string_view name, RecordType type)
+{
+	return std::span{buffer}.first(MakeQuery(buffer, 0x1234, name, type));
+}
+
+TEST(Dns, IsValidName)
+{
+	EXPECT_TRUE(IsValidName("localhost"));
+	EXPECT_TRUE(IsValidName("www.example.com"));
+	EXPECT_TRUE(IsValidName("www.example.com."));
+	EXPECT_TRUE(IsValidName("_srv.x-y.example.com"));
+	EXPECT_FALSE(IsValidName(""));
+	EXPECT_FALSE(IsValidName("."));
+	EXPECT_FALSE(IsValidName("www..example.com"));
+	EXPECT_FALSE(IsValidName(".example.com"));
+	EXPECT_FALSE(IsValidName("www.example.com.."));
+	EXPECT_FALSE(IsValidName("foo bar"));
+	EXPECT_FALSE(IsValidName("foo/bar"));
+	EXPECT_FALSE(IsValidName(std::string(64, 'a')));
+	EXPECT_TRUE(IsValidName(std::string(63, 'a')));
+}
+
+TEST(Dns, Query)
+{
+	std::array<std::byte, MAX_QUERY_SIZE> buffer;
+	const auto query = MakeTestQuery(buffer, "www.Example.com.", RecordType::AAAA);
+
+	Header header;
+	std::memcpy(&header, query.data(), sizeof(header));
+	EXPECT_EQ(uint_least16_t{header.id}, 0x1234);
+	EXPECT_EQ(uint_least16_t{header.flags}, Flags::RD);
+	EXPECT_EQ(uint_least16_t{header.qdcount}, 1);
+	EXPECT_EQ(uint_least16_t{header.ancount}, 0);
+	EXPECT_EQ(uint_least16_t{header.arcount}, 1);
+
+	const auto [name, type] = ParseDnsQuestion(query);
+	EXPECT_EQ(name, "www.Example.com");
+	EXPECT_EQ(type, RecordType::AAAA);
+
+	EXPECT_THROW(MakeQuery(buffer, 1, "foo..bar", RecordType::A),
+		     std::invalid_argument);
+}
+
+TEST(Dns, Response)
+{
+	std::array<std::byte, MAX_QUERY_SIZE> buffer;
+	const auto query = MakeTestQuery(buffer, "www.example.com", RecordType::A);
+
+	DnsResponseBuilder b{query};
+	b.AddA("WWW.example.com", 300, 192, 0, 2, 1);
+	b.AddA("www.example.com", 60, 192, 0, 2, 2);
+	b.AddA("other.example.com", 10, 192, 0, 2, 3);
+
+	const auto response = ParseResponse(b.Finish(), "www.example.com", RecordType::A);
+	EXPECT_EQ(response.id, 0x1234);
+	EXPECT_EQ(response.rcode, ResponseCode::NOERROR);
+	EXPECT_FALSE(response.truncated);
+	ASSERT_EQ(response.addresses.size(), 2U);
+	EXPECT_EQ(ToString(response.addresses[0]), "192.0.2.1");
+	EXPECT_EQ(ToString(response.addresses[1]), "192.0.2.2");
+	EXPECT_EQ(response.ttl, std::chrono::seconds{60});
+
+	/* the question must match */
+	EXPECT_THROW(ParseResponse(b.Finish(), "www.example.org", RecordType::A),
+		     SocketProtocolError);
+	EXPECT_THROW(ParseResponse(b.Finish(), "www.example.com", RecordType::AAAA),
+		     SocketProtocolError);
+
+	/* truncated packets */
+	const auto packet = b.Finish();
+	for (std::size_t i = 0; i < packet.size(); ++i)
+		EXPECT_THROW(ParseResponse(packet.first(i), "www.example.com", RecordType::A),
+			     SocketProtocolError);
+
+	/* a query is not a response */
+	EXPECT_THROW(ParseResponse(query, "www.example.com", RecordType::A),
+		     SocketProtocolError);
+}
+
+TEST(Dns, AAAA)
+{
+	std::array<std::byte, MAX_QUERY_SIZE> buffer;
+	const auto query = MakeTestQuery(buffer, "www.example.com", RecordType::AAAA);
+
+	DnsResponseBuilder b{query};
+	b.AddAAAA("www.example.com", 300, 1);
+
+	const auto response = ParseResponse(b.Finish(), "www.example.com", RecordType::AAAA);
+	ASSERT_EQ(response.addresses.size(), 1U);
+	EXPECT_EQ(ToString(response.addresses[0]), "2001:db8::1");
+	EXPECT_EQ(response.ttl, std::chrono::seconds{300});
+}
+
+TEST(Dns, Cname)
+{
+	std::array<std::byte, MAX_QUERY_SIZE> buffer;
+	const auto query = MakeTestQuery(buffer, "alias.example.com", RecordType::A);
+
+	DnsResponseBuilder b{query};
+	b.AddCname("alias.example.com", 30, "alias2.example.com");
+	b.AddCname("alias2.example.com", 300, "www.example.com");
+	b.AddA("www.example.com", 60, 192, 0, 2, 1);
+
+	const auto response = ParseResponse(b.Finish(), "alias.example.com", RecordType::A);
+	ASSERT_EQ(response.addresses.size(), 1U);
+	EXPECT_EQ(ToString(response.addresses[0]), "192.0.2.1");
+
+	/* the minimum TTL of the whole chain */
+	EXPECT_EQ(response.ttl, std::chrono::seconds{30});
+}
+
+TEST(Dns, Negative)
+{
+	std::array<std::byte, MAX_QUERY_SIZE> buffer;
+	const auto query = MakeTestQuery(buffer, "nx.example.com", RecordType::A);
+
+	{
+		DnsResponseBuilder b{query, ResponseCode::NXDOMAIN};
+		b.AddSoa("example.com", 300, 60);
+
+		const auto response = ParseResponse(b.Finish(), "nx.example.com", RecordType::A);
+		EXPECT_EQ(response.rcode, ResponseCode::NXDOMAIN);
+		EXPECT_TRUE(response.addresses.empty());
+		EXPECT_EQ(response.ttl, std::chrono::seconds{60});
+	}
+
+	/* NODATA: the SOA TTL is lower than its MINIMUM field */
+	{
+		DnsResponseBuilder b{query};
+		b.AddSoa("example.com", 20, 60);
+
+		const auto response = ParseResponse(b.Finish(), "nx.example.com", RecordType::A);
+		EXPECT_EQ(response.rcode, ResponseCode::NOERROR);
+		EXPECT_TRUE(response.addresses.empty());
+		EXPECT_EQ(response.ttl, std::chrono::seconds{20});
+	}
+
+	/* no SOA */
+	{
+		DnsResponseBuilder b{query, ResponseCode::NXDOMAIN};
+
+		const auto response = ParseResponse(b.Finish(), "nx.example.com", RecordType::A);
+		EXPECT_TRUE(response.addresses.empty());
+		EXPECT_FALSE(response.ttl);
+	}
+}
+
+TEST(Dns, Truncated)
+{
+	std::array<std::byte, MAX_QUERY_SIZE> buffer;
+	const auto query = MakeTestQuery(buffer, "big.example.com", RecordType::A);
+
+	DnsResponseBuilder b{query, ResponseCode::NOERROR, Flags::TC};
+
+	const auto response = ParseResponse(b.Finish(), "big.example.com", RecordType::A);
+	EXPECT_TRUE(response.truncated);
+	EXPECT_TRUE(response.addresses.empty());
+}
+
+TEST(Dns, ResolvConf)
+{
+	const auto c = ParseResolvConf(R"(# comment
+search example.com
+nameserver 192.0.2.53
+nameserver   2001:db8::53
+; another comment
+nameserver garbage
+options ndots:2 timeout:3 attempts:4 rotate
+nameserver 192.0.2.54
+nameserver 192.0.2.55
+)");
+
+	ASSERT_EQ(c.nameservers.size(), 3U);
+	EXPECT_EQ(ToString(c.nameservers[0]), "192.0.2.53:53");
+	EXPECT_EQ(ToString(c.nameservers[1]), "[2001:db8::53]:53");
+	EXPECT_EQ(ToString(c.nameservers[2]), "192.0.2.54:53");
+	EXPECT_EQ(c.timeout, std::chrono::seconds{3});
+	EXPECT_EQ(c.attempts, 4U);
+	EXPECT_EQ(c.ndots, 2U);
+	ASSERT_EQ(c.search.size(), 1U);
+	EXPECT_EQ(c.search[0], "example.com");
+
+	const auto s = ParseResolvConf(R"(search example.com
+domain example.org
+search a.example. b.example  c.example
+)");
+	ASSERT_EQ(s.search.size(), 3U);
+	EXPECT_EQ(s.search[0], "a.example");
+	EXPECT_EQ(s.search[1], "b.example");
+	EXPECT_EQ(s.search[2], "c.example");
+
+	const auto empty = ParseResolvConf("");
+	ASSERT_EQ(empty.nameservers.size(), 1U);
+	EXPECT_EQ(ToString(empty.nameservers[0]), "127.0.0.1:53");
+	EXPECT_EQ(empty.timeout, std::chrono::seconds{5});
+	EXPECT_EQ(empty.attempts, 2U);
+	EXPECT_EQ(empty.ndots, 1U);
+	EXPECT_TRUE(empty.search.empty());
+}
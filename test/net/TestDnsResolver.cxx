@@ -0,0 +1,510 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "DnsResponseBuilder.hxx"
+#include "event/net/dns/Resolver.hxx"
+#include "event/Loop.hxx"
+#include "event/SocketEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/IPv4Address.hxx"
+#include "net/StaticSocketAddress.hxx"
+#include "net/TimeoutError.hxx"
+#include "net/ToString.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/Cancellable.hxx"
+#include "util/PrintException.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Dns;
+
+/**
+ * A minimal DNS server on 127.0.0.1 (UDP and TCP on the same port)
+ * which answers from a hard-coded zone.
+ */
+class StubDnsServer {
+	SocketEvent udp, tcp_listener, tcp_connection;
+
+	AllocatedSocketAddress address;
+
+public:
+	/**
+	 * The number of queries received for each name.
+	 */
+	std::map<std::string, unsigned, std::less<>> n_queries;
+
+	explicit StubDnsServer(EventLoop &event_loop)
+		:udp(event_loop, BIND_THIS_METHOD(OnUdpReady)),
+		 tcp_listener(event_loop, BIND_THIS_METHOD(OnListenerReady)),
+		 tcp_connection(event_loop, BIND_THIS_METHOD(OnTcpReady))
+	{
+		UniqueSocketDescriptor fd;
+		if (!fd.CreateNonBlock(AF_INET, SOCK_DGRAM, 0) ||
+		    !fd.Bind(IPv4Address{127, 0, 0, 1, 0}))
+			throw std::runtime_error{"Failed to bind UDP socket"};
+
+		address = fd.GetLocalAddress();
+		udp.Open(fd.Release());
+		udp.ScheduleRead();
+
+		if (!fd.CreateNonBlock(AF_INET, SOCK_STREAM, 0) ||
+		    !fd.SetReuseAddress() ||
+		    !fd.Bind(address) || !fd.Listen(4))
+			throw std::runtime_error{"Failed to bind TCP socket"};
+
+		tcp_listener.Open(fd.Release());
+		tcp_listener.ScheduleRead();
+	}
+
+	~StubDnsServer() noexcept {
+		udp.Close();
+		tcp_listener.Close();
+		tcp_connection.Close();
+	}
+
+	SocketAddress GetAddress() const noexcept {
+		return address;
+	}
+
+	unsigned GetQueries(std::string_view name) const noexcept {
+		auto i = n_queries.find(name);
+		return i != n_queries.end() ? i->second : 0;
+	}
+
+private:
+	std::optional<std::vector<std::byte>> Respond(std::span<const std::byte> query,
+						      bool tcp);
+
+	void OnUdpReady(unsigned) noexcept;
+	void OnListenerReady(unsigned) noexcept;
+	void OnTcpReady(unsigned) noexcept;
+};
+
+std::optional<std::vector<std::byte>>
+StubDnsServer::Respond(std::span<const std::byte> query, bool tcp)
+{
+	const auto [name, type] = ParseDnsQuestion(query);
+	++n_queries[name];
+
+	const bool aaaa = type == RecordType::AAAA;
+
+	DnsResponseBuilder b{query};
+
+	if (name == "www.example.com") {
+		if (aaaa)
+			b.AddAAAA(name, 60, 1);
+		else
+			b.AddA(name, 60, 192, 0, 2, 1);
+	} else if (name == "v4.example.com") {
+		if (aaaa)
+			b.AddSoa("example.com", 60, 10);
+		else
+			b.AddA(name, 60, 192, 0, 2, 4);
+	} else if (name == "alias.example.com") {
+		b.AddCname(name, 60, "www.example.com");
+		if (aaaa)
+			b.AddAAAA("www.example.com", 60, 1);
+		else
+			b.AddA("www.example.com", 60, 192, 0, 2, 1);
+	} else if (name == "zero.example.com") {
+		if (!aaaa)
+			b.AddA(name, 0, 192, 0, 2, 5);
+	} else if (name == "big.example.com") {
+		if (!tcp) {
+			b = DnsResponseBuilder{query, ResponseCode::NOERROR, Flags::TC};
+		} else if (!aaaa) {
+			for (unsigned i = 1; i <= 100; ++i)
+				b.AddA(name, 60, 192, 0, 2, i);
+		}
+	} else if (name == "partial.example.com") {
+		if (aaaa)
+			b = DnsResponseBuilder{query, ResponseCode::SERVFAIL};
+		else
+			b.AddA(name, 600, 192, 0, 2, 6);
+	} else if (name == "fail.example.com") {
+		b = DnsResponseBuilder{query, ResponseCode::SERVFAIL};
+	} else if (name == "silent.example.com") {
+		return std::nullopt;
+	} else {
+		b = DnsResponseBuilder{query, ResponseCode::NXDOMAIN};
+		b.AddSoa("example.com", 300, 60);
+	}
+
+	const auto response = b.Finish();
+	return std::vector<std::byte>{response.begin(), response.end()};
+}
+
+void
+StubDnsServer::OnUdpReady(unsigned) noexcept
+try {
+	std::array<std::byte, 1024> buffer;
+	StaticSocketAddress from;
+	const auto nbytes = udp.GetSocket().ReadNoWait(buffer, from);
+	if (nbytes <= 0)
+		return;
+
+	if (const auto response = Respond(std::span{buffer}.first(nbytes), false))
+		(void)udp.GetSocket().WriteNoWait(*response, from);
+} catch (...) {
+	PrintException(std::current_exception());
+}
+
+void
+StubDnsServer::OnListenerReady(unsigned) noexcept
+{
+	auto fd = tcp_listener.GetSocket().AcceptNonBlock();
+	if (!fd.IsDefined())
+		return;
+
+	tcp_connection.Close();
+	tcp_connection.Open(fd);
+	tcp_connection.ScheduleRead();
+}
+
+void
+StubDnsServer::OnTcpReady(unsigned) noexcept
+try {
+	/* assume the whole query arrives at once */
+	std::array<std::byte, 1024> buffer;
+	const auto nbytes = tcp_connection.GetSocket().ReadNoWait(buffer);
+	if (nbytes < 2) {
+		tcp_connection.Close();
+		return;
+	}
+
+	if (auto response = Respond(std::span{buffer}.first(nbytes).subspan(2), true)) {
+		const PackedBE16 length(response->size());
+		response->insert(response->begin(),
+				 ReferenceAsBytes(length).begin(),
+				 ReferenceAsBytes(length).end());
+		(void)tcp_connection.GetSocket().Send(*response);
+	}
+
+	tcp_connection.Close();
+} catch (...) {
+	PrintException(std::current_exception());
+}
+
+struct Result final : ResolveHostnameHandler {
+	EventLoop *event_loop;
+
+	std::vector<std::string> addresses;
+	std::exception_ptr error;
+	bool done = false;
+
+	explicit Result(EventLoop &_event_loop) noexcept
+		:event_loop(&_event_loop) {}
+
+	void Wait() noexcept {
+		if (!done)
+			event_loop->Run();
+	}
+
+	/* virtual methods from ResolveHostnameHandler */
+	void OnResolveHostname(std::span<const SocketAddress> _addresses) noexcept override {
+		EXPECT_FALSE(done);
+		done = true;
+		for (const SocketAddress i : _addresses)
+			addresses.emplace_back(ToString(i));
+		event_loop->Break();
+	}
+
+	void OnResolveHostnameError(std::exception_ptr _error) noexcept override {
+		EXPECT_FALSE(done);
+		done = true;
+		error = std::move(_error);
+		event_loop->Break();
+	}
+};
+
+struct Instance {
+	EventLoop event_loop;
+	StubDnsServer server{event_loop};
+	Resolver resolver;
+
+	explicit Instance(std::vector<std::string> search={})
+		:resolver(event_loop, MakeConfig(server.GetAddress(),
+						 std::move(search))) {}
+
+	static ResolvConf MakeConfig(SocketAddress address,
+				     std::vector<std::string> &&search) {
+		ResolvConf config;
+		config.nameservers.emplace_back(address);
+		config.timeout = std::chrono::seconds{1};
+		config.attempts = 1;
+		config.search = std::move(search);
+		return config;
+	}
+
+	Result Resolve(std::string_view name, unsigned port=0,
+		       int family=AF_UNSPEC) noexcept {
+		Result result{event_loop};
+		CancellablePointer cancel_ptr;
+		resolver.ResolveHostname(name, port, family, result, cancel_ptr);
+		result.Wait();
+		return result;
+	}
+};
+
+static bool
+IsHostNotFound(std::exception_ptr error) noexcept
+{
+	try {
+		std::rethrow_exception(std::move(error));
+	} catch (const HostNotFoundError &) {
+		return true;
+	} catch (...) {
+		return false;
+	}
+}
+
+TEST(DnsResolver, Basic)
+{
+	Instance instance;
+
+	auto r = instance.Resolve("www.example.com", 80, AF_INET);
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 1U);
+	EXPECT_EQ(r.addresses[0], "192.0.2.1:80");
+
+	r = instance.Resolve("www.example.com", 443, AF_INET6);
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 1U);
+	EXPECT_EQ(r.addresses[0], "[2001:db8::1]:443");
+
+	/* IPv6 first */
+	r = instance.Resolve("www.example.com", 80);
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 2U);
+	EXPECT_EQ(r.addresses[0], "[2001:db8::1]:80");
+	EXPECT_EQ(r.addresses[1], "192.0.2.1:80");
+
+	/* a host without IPv6 address */
+	r = instance.Resolve("v4.example.com");
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 1U);
+	EXPECT_EQ(r.addresses[0], "192.0.2.4");
+
+	r = instance.Resolve("v4.example.com", 0, AF_INET6);
+	EXPECT_TRUE(IsHostNotFound(r.error));
+
+	r = instance.Resolve("alias.example.com", 0, AF_INET);
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 1U);
+	EXPECT_EQ(r.addresses[0], "192.0.2.1");
+
+	r = instance.Resolve("nx.example.com");
+	EXPECT_TRUE(IsHostNotFound(r.error));
+}
+
+TEST(DnsResolver, Numeric)
+{
+	Instance instance;
+
+	auto r = instance.Resolve("192.0.2.7", 80);
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 1U);
+	EXPECT_EQ(r.addresses[0], "192.0.2.7:80");
+
+	r = instance.Resolve("2001:db8::7", 80);
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 1U);
+	EXPECT_EQ(r.addresses[0], "[2001:db8::7]:80");
+
+	r = instance.Resolve("192.0.2.7", 80, AF_INET6);
+	EXPECT_TRUE(IsHostNotFound(r.error));
+
+	r = instance.Resolve("foo bar");
+	EXPECT_TRUE(r.error);
+
+	EXPECT_TRUE(instance.server.n_queries.empty());
+}
+
+TEST(DnsResolver, Cache)
+{
+	Instance instance;
+
+	auto r = instance.Resolve("www.example.com", 80, AF_INET);
+	ASSERT_FALSE(r.error);
+	EXPECT_EQ(instance.server.GetQueries("www.example.com"), 1U);
+	EXPECT_EQ(instance.resolver.GetCacheSize(), 1U);
+
+	/* cache hits are delivered synchronously; the name is
+	   case-insensitive and the trailing dot is ignored */
+	for (const char *name : {"www.example.com", "WWW.Example.COM", "www.example.com."}) {
+		Result result{instance.event_loop};
+		CancellablePointer cancel_ptr;
+		instance.resolver.ResolveHostname(name, 8080, AF_INET,
+						  result, cancel_ptr);
+		ASSERT_TRUE(result.done);
+		ASSERT_FALSE(result.error);
+		ASSERT_EQ(result.addresses.size(), 1U);
+		EXPECT_EQ(result.addresses[0], "192.0.2.1:8080");
+	}
+
+	EXPECT_EQ(instance.server.GetQueries("www.example.com"), 1U);
+
+	/* a different family is a different cache item */
+	r = instance.Resolve("www.example.com", 80, AF_INET6);
+	ASSERT_FALSE(r.error);
+	EXPECT_EQ(instance.server.GetQueries("www.example.com"), 2U);
+
+	/* negative caching */
+	r = instance.Resolve("nx.example.com");
+	EXPECT_TRUE(IsHostNotFound(r.error));
+	r = instance.Resolve("nx.example.com");
+	EXPECT_TRUE(IsHostNotFound(r.error));
+	EXPECT_EQ(instance.server.GetQueries("nx.example.com"), 2U);
+
+	/* TTL=0 is not cached */
+	r = instance.Resolve("zero.example.com", 0, AF_INET);
+	ASSERT_FALSE(r.error);
+	r = instance.Resolve("zero.example.com", 0, AF_INET);
+	ASSERT_FALSE(r.error);
+	EXPECT_EQ(instance.server.GetQueries("zero.example.com"), 2U);
+
+	instance.resolver.FlushCache();
+	EXPECT_EQ(instance.resolver.GetCacheSize(), 0U);
+	r = instance.Resolve("www.example.com", 80, AF_INET);
+	ASSERT_FALSE(r.error);
+	EXPECT_EQ(instance.server.GetQueries("www.example.com"), 3U);
+}
+
+TEST(DnsResolver, Coalesce)
+{
+	Instance instance;
+
+	std::vector<Result> results;
+	results.reserve(3);
+	CancellablePointer cancel_ptr[3];
+
+	for (unsigned i = 0; i < 3; ++i) {
+		auto &result = results.emplace_back(instance.event_loop);
+		instance.resolver.ResolveHostname("www.example.com", 80 + i,
+						  AF_INET, result,
+						  cancel_ptr[i]);
+		EXPECT_FALSE(result.done);
+	}
+
+	/* cancel one of them */
+	cancel_ptr[1].Cancel();
+
+	results[2].Wait();
+
+	EXPECT_TRUE(results[0].done);
+	EXPECT_FALSE(results[1].done);
+	EXPECT_TRUE(results[2].done);
+	ASSERT_EQ(results[0].addresses.size(), 1U);
+	EXPECT_EQ(results[0].addresses[0], "192.0.2.1:80");
+	ASSERT_EQ(results[2].addresses.size(), 1U);
+	EXPECT_EQ(results[2].addresses[0], "192.0.2.1:82");
+
+	EXPECT_EQ(instance.server.GetQueries("www.example.com"), 1U);
+}
+
+TEST(DnsResolver, CancelFillsCache)
+{
+	Instance instance;
+
+	{
+		Result result{instance.event_loop};
+		CancellablePointer cancel_ptr;
+		instance.resolver.ResolveHostname("www.example.com", 80,
+						  AF_INET, result, cancel_ptr);
+		cancel_ptr.Cancel();
+	}
+
+	/* the canceled lookup completes in the background */
+	auto r = instance.Resolve("www.example.com", 80, AF_INET);
+	ASSERT_FALSE(r.error);
+	EXPECT_EQ(instance.server.GetQueries("www.example.com"), 1U);
+	EXPECT_EQ(instance.resolver.GetCacheSize(), 1U);
+}
+
+TEST(DnsResolver, Tcp)
+{
+	Instance instance;
+
+	auto r = instance.Resolve("big.example.com", 80, AF_INET);
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 100U);
+	EXPECT_EQ(r.addresses.front(), "192.0.2.1:80");
+	EXPECT_EQ(r.addresses.back(), "192.0.2.100:80");
+
+	/* one UDP and one TCP query */
+	EXPECT_EQ(instance.server.GetQueries("big.example.com"), 2U);
+}
+
+TEST(DnsResolver, Errors)
+{
+	Instance instance;
+
+	auto r = instance.Resolve("fail.example.com", 0, AF_INET);
+	ASSERT_TRUE(r.error);
+	EXPECT_FALSE(IsHostNotFound(r.error));
+
+	/* errors are not cached */
+	EXPECT_EQ(instance.resolver.GetCacheSize(), 0U);
+
+	r = instance.Resolve("silent.example.com", 0, AF_INET);
+	ASSERT_TRUE(r.error);
+	EXPECT_THROW(std::rethrow_exception(r.error), TimeoutError);
+}
+
+TEST(DnsResolver, Partial)
+{
+	Instance instance;
+
+	/* the AAAA query fails, but the A record is delivered */
+	auto r = instance.Resolve("partial.example.com");
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 1U);
+	EXPECT_EQ(r.addresses[0], "192.0.2.6");
+	EXPECT_EQ(instance.resolver.GetCacheSize(), 1U);
+}
+
+TEST(DnsResolver, Search)
+{
+	Instance instance{{"nx.example.com", "example.com"}};
+
+	/* fewer dots than "ndots": search domains first */
+	auto r = instance.Resolve("www", 80, AF_INET);
+	ASSERT_FALSE(r.error);
+	ASSERT_EQ(r.addresses.size(), 1U);
+	EXPECT_EQ(r.addresses[0], "192.0.2.1:80");
+	EXPECT_EQ(instance.server.GetQueries("www.nx.example.com"), 1U);
+	EXPECT_EQ(instance.server.GetQueries("www.example.com"), 1U);
+	EXPECT_EQ(instance.server.GetQueries("www"), 0U);
+
+	/* enough dots: as-is first */
+	r = instance.Resolve("v4.example.com", 0, AF_INET);
+	ASSERT_FALSE(r.error);
+	EXPECT_EQ(instance.server.GetQueries("v4.example.com"), 1U);
+	EXPECT_EQ(instance.server.GetQueries("v4.example.com.nx.example.com"), 0U);
+
+	/* all candidates are tried */
+	r = instance.Resolve("nx", 0, AF_INET);
+	EXPECT_TRUE(IsHostNotFound(r.error));
+	EXPECT_EQ(instance.server.GetQueries("nx.nx.example.com"), 1U);
+	EXPECT_EQ(instance.server.GetQueries("nx.example.com"), 1U);
+	EXPECT_EQ(instance.server.GetQueries("nx"), 1U);
+
+	/* absolute names are not qualified */
+	r = instance.Resolve("www.", 0, AF_INET);
+	EXPECT_TRUE(IsHostNotFound(r.error));
+	EXPECT_EQ(instance.server.GetQueries("www"), 1U);
+	EXPECT_EQ(instance.server.GetQueries("www.example.com"), 1U);
+
+	/* an error stops the search */
+	r = instance.Resolve("fail", 0, AF_INET);
+	ASSERT_TRUE(r.error);
+	EXPECT_FALSE(IsHostNotFound(r.error));
+}
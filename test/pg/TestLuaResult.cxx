@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "lua/pg/Result.hxx"
+#include "lua/Assert.hxx"
+#include "lua/State.hxx"
+#include "pg/Result.hxx"
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lualib.h>
+}
+
+#include <cmath>
+#include <stdexcept>
+
+#include <string.h>
+
+using namespace Lua;
+
+/**
+ * Build a synthetic text-format #PGresult with columns of various
+ * types, without a database connection.
+ */
+static Pg::Result
+MakeResult()
+{
+	static constexpr Oid BOOLOID = 16, INT8OID = 20, INT2OID = 21,
+		INT4OID = 23, TEXTOID = 25, FLOAT8OID = 701;
+
+	PGresult *result = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+	if (result == nullptr)
+		throw std::bad_alloc{};
+
+	Pg::Result r{result};
+
+	PGresAttDesc attrs[] = {
+		{const_cast<char *>("b"), 0, 0, 0, BOOLOID, 1, -1},
+		{const_cast<char *>("i2"), 0, 0, 0, INT2OID, 2, -1},
+		{const_cast<char *>("i4"), 0, 0, 0, INT4OID, 4, -1},
+		{const_cast<char *>("i8"), 0, 0, 0, INT8OID, 8, -1},
+		{const_cast<char *>("f"), 0, 0, 0, FLOAT8OID, 8, -1},
+		{const_cast<char *>("t"), 0, 0, 0, TEXTOID, -1, -1},
+	};
+
+	if (!PQsetResultAttrs(result, std::size(attrs), attrs))
+		throw std::runtime_error{"PQsetResultAttrs() failed"};
+
+	static constexpr const char *rows[][std::size(attrs)] = {
+		{"t", "42", "42", "1", "1.5", "x"},
+		{"f", "-32768", "-2147483648", "9007199254740993", "NaN", nullptr},
+		{nullptr, "32767", "2147483647", "-9223372036854775808", "-Infinity", "y"},
+	};
+
+	for (std::size_t row = 0; row < std::size(rows); ++row) {
+		for (std::size_t column = 0; column < std::size(attrs); ++column) {
+			const char *value = rows[row][column];
+
+			/* a length of -1 means NULL */
+			if (!PQsetvalue(result, row, column,
+					const_cast<char *>(value),
+					value != nullptr ? strlen(value) : -1))
+				throw std::runtime_error{"PQsetvalue() failed"};
+		}
+	}
+
+	return r;
+}
+
+/**
+ * Push a new "pg.Result" object and store it in the global variable
+ * "r".
+ */
+static void
+SetResult(lua_State *L)
+{
+	const ScopeCheckStack check_stack{L};
+
+	InitPgResult(L);
+	NewPgResult(L, MakeResult());
+	lua_setglobal(L, "r");
+}
+
+/**
+ * Execute the given Lua chunk, which returns one value, and leave that
+ * value on the stack.
+ */
+static void
+Execute(lua_State *L, const char *code)
+{
+	if (luaL_dostring(L, code) != 0)
+		throw std::runtime_error{lua_tostring(L, -1)};
+}
+
+static std::string
+ExecuteString(lua_State *L, const char *code)
+{
+	const ScopeCheckStack check_stack{L};
+
+	Execute(L, code);
+	std::string result = lua_tostring(L, -1);
+	lua_pop(L, 1);
+	return result;
+}
+
+TEST(LuaPgResult, FetchAllTyped)
+{
+	const Lua::State main{luaL_newstate()};
+	lua_State *const L = main.get();
+	luaL_openlibs(L);
+	SetResult(L);
+
+	Execute(L, "all = r:fetchall() return #all");
+	EXPECT_EQ(lua_tointeger(L, -1), 3);
+	lua_pop(L, 1);
+
+	/* bool */
+	EXPECT_EQ(ExecuteString(L, "return type(all[1].b) .. ':' .. tostring(all[1].b)"), "boolean:true");
+	EXPECT_EQ(ExecuteString(L, "return type(all[2].b) .. ':' .. tostring(all[2].b)"), "boolean:false");
+
+	/* NULL is nil */
+	EXPECT_EQ(ExecuteString(L, "return type(all[3].b)"), "nil");
+	EXPECT_EQ(ExecuteString(L, "return type(all[2].t)"), "nil");
+
+	/* int2 and int4 are numbers, including the limits */
+	EXPECT_EQ(ExecuteString(L, "return type(all[1].i2) .. ':' .. tostring(all[1].i2)"), "number:42");
+	EXPECT_EQ(ExecuteString(L, "return tostring(all[2].i2) .. ',' .. tostring(all[3].i2)"), "-32768,32767");
+	EXPECT_EQ(ExecuteString(L, "return type(all[1].i4) .. ':' .. tostring(all[1].i4)"), "number:42");
+	EXPECT_EQ(ExecuteString(L, "return string.format('%d,%d', all[2].i4, all[3].i4)"), "-2147483648,2147483647");
+
+	/* int8 is always a string, even if it would fit into a
+	   lua_Number, so a column has only one Lua type and no
+	   precision is lost */
+	EXPECT_EQ(ExecuteString(L, "return type(all[1].i8) .. ':' .. all[1].i8"), "string:1");
+	EXPECT_EQ(ExecuteString(L, "return all[2].i8"), "9007199254740993");
+	EXPECT_EQ(ExecuteString(L, "return all[3].i8"), "-9223372036854775808");
+
+	/* float, including PostgreSQL's special values */
+	Execute(L, "return all[1].f, all[2].f, all[3].f");
+	EXPECT_EQ(lua_type(L, -3), LUA_TNUMBER);
+	EXPECT_EQ(lua_tonumber(L, -3), 1.5);
+	EXPECT_TRUE(std::isnan(lua_tonumber(L, -2)));
+	EXPECT_EQ(lua_tonumber(L, -1), -INFINITY);
+	lua_pop(L, 3);
+
+	/* text */
+	EXPECT_EQ(ExecuteString(L, "return type(all[1].t) .. ':' .. all[1].t"), "string:x");
+	EXPECT_EQ(ExecuteString(L, "return all[3].t"), "y");
+
+	/* all rows have been consumed */
+	EXPECT_EQ(ExecuteString(L, "return tostring(#r:fetchall())"), "0");
+}
+
+TEST(LuaPgResult, FetchAllNumerical)
+{
+	const Lua::State main{luaL_newstate()};
+	lua_State *const L = main.get();
+	luaL_openlibs(L);
+	SetResult(L);
+
+	/* fetch only the first row */
+	EXPECT_EQ(ExecuteString(L, R"(
+local first = r:fetchall('n', 1)
+local row = first[1]
+return #first .. ' ' .. #row .. ' ' .. tostring(row[1]) .. ' ' ..
+  row[2] .. ' ' .. row[3] .. ' ' .. type(row[4]) .. ' ' .. row[5] .. ' ' .. row[6]
+)"), "1 6 true 42 42 string 1.5 x");
+
+	/* the rest; NULL leaves a hole in the row */
+	EXPECT_EQ(ExecuteString(L, R"(
+local rest = r:fetchall('n')
+return #rest .. ' ' .. tostring(rest[1][6]) .. ' ' .. tostring(rest[2][1]) .. ' ' .. rest[2][4]
+)"), "2 nil nil -9223372036854775808");
+}
+
+TEST(LuaPgResult, FetchAllErrors)
+{
+	const Lua::State main{luaL_newstate()};
+	lua_State *const L = main.get();
+	luaL_openlibs(L);
+	SetResult(L);
+
+	EXPECT_THROW(Execute(L, "return r:fetchall('x')"), std::runtime_error);
+	lua_settop(L, 0);
+	EXPECT_THROW(Execute(L, "return r:fetchall('a', -1)"), std::runtime_error);
+	lua_settop(L, 0);
+
+	/* errors don't consume rows */
+	EXPECT_EQ(ExecuteString(L, "return tostring(#r:fetchall())"), "3");
+}
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "thread/EventLoopGroup.hxx"
+#include "event/DeferEvent.hxx"
+#include "util/BindMethod.hxx"
+
+#include <gtest/gtest.h>
+
+#include <latch>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+static std::vector<unsigned>
+GetAllowedCpus() noexcept
+{
+	cpu_set_t cpu_set;
+	if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) < 0)
+		return {};
+
+	std::vector<unsigned> result;
+	for (unsigned i = 0; i < CPU_SETSIZE; ++i)
+		if (CPU_ISSET(i, &cpu_set))
+			result.push_back(i);
+	return result;
+}
+
+/**
+ * Runs in one #EventLoop of the group and records the affinity of
+ * the thread running it.
+ */
+class AffinityProbe {
+	DeferEvent defer;
+	std::latch &done;
+
+public:
+	cpu_set_t affinity;
+
+	AffinityProbe(EventLoop &event_loop, std::latch &_done) noexcept
+		:defer(event_loop, BIND_THIS_METHOD(OnDeferred)),
+		 done(_done)
+	{
+		CPU_ZERO(&affinity);
+		defer.Schedule();
+	}
+
+private:
+	void OnDeferred() noexcept {
+		pthread_getaffinity_np(pthread_self(), sizeof(affinity), &affinity);
+		done.count_down();
+	}
+};
+
+/**
+ * Start the group, wait until each thread has recorded its affinity
+ * and compare it with EventLoopGroup::GetCpus().
+ */
+static void
+CheckAffinity(EventLoopGroup &group)
+{
+	const auto cpus = group.GetCpus();
+	ASSERT_EQ(cpus.size(), group.size());
+
+	std::latch done{static_cast<std::ptrdiff_t>(group.size())};
+
+	std::vector<std::unique_ptr<AffinityProbe>> probes;
+	for (std::size_t i = 0; i < group.size(); ++i)
+		probes.emplace_back(std::make_unique<AffinityProbe>(group.GetEventLoop(i),
+								    done));
+
+	group.Start();
+	done.wait();
+	group.Stop();
+	group.Join();
+
+	for (std::size_t i = 0; i < group.size(); ++i) {
+		EXPECT_EQ(CPU_COUNT(&probes[i]->affinity), 1);
+		EXPECT_TRUE(CPU_ISSET(cpus[i], &probes[i]->affinity));
+	}
+}
+
+TEST(EventLoopGroup, OnePerCpu)
+{
+	const auto allowed = GetAllowedCpus();
+	ASSERT_FALSE(allowed.empty());
+
+	EventLoopGroup group;
+	ASSERT_EQ(group.size(), allowed.size());
+
+	/* each allowed CPU gets exactly one thread */
+	const auto cpus = group.GetCpus();
+	EXPECT_EQ(std::set<unsigned>(cpus.begin(), cpus.end()),
+		  std::set<unsigned>(allowed.begin(), allowed.end()));
+
+	CheckAffinity(group);
+}
+
+TEST(EventLoopGroup, MoreThreadsThanCpus)
+{
+	const auto allowed = GetAllowedCpus();
+	ASSERT_FALSE(allowed.empty());
+
+	EventLoopGroup group(allowed.size() * 2 + 1);
+
+	/* wraps around the list of allowed CPUs */
+	const auto cpus = group.GetCpus();
+	for (std::size_t i = 0; i < cpus.size(); ++i)
+		EXPECT_EQ(cpus[i], allowed[i % allowed.size()]);
+
+	CheckAffinity(group);
+}
+
+/**
+ * Simulate a restricted cpuset by allowing only the highest CPU:
+ * all threads must be pinned to it (and not to CPU 0, which is not
+ * allowed unless it is the only one).
+ */
+TEST(EventLoopGroup, RestrictedAffinity)
+{
+	cpu_set_t old_affinity;
+	ASSERT_EQ(sched_getaffinity(0, sizeof(old_affinity), &old_affinity), 0);
+
+	const unsigned cpu = GetAllowedCpus().back();
+
+	cpu_set_t restricted;
+	CPU_ZERO(&restricted);
+	CPU_SET(cpu, &restricted);
+	ASSERT_EQ(sched_setaffinity(0, sizeof(restricted), &restricted), 0);
+
+	{
+		EventLoopGroup group(3);
+		ASSERT_EQ(group.size(), 3U);
+
+		for (const unsigned i : group.GetCpus())
+			EXPECT_EQ(i, cpu);
+
+		CheckAffinity(group);
+	}
+
+	ASSERT_EQ(sched_setaffinity(0, sizeof(old_affinity), &old_affinity), 0);
+}
+
+TEST(EventLoopGroup, NotPinned)
+{
+	EventLoopGroup group(2, false);
+	EXPECT_EQ(group.size(), 2U);
+	EXPECT_TRUE(group.GetCpus().empty());
+
+	group.Start();
+	group.Stop();
+	group.Join();
+}
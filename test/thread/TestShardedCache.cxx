@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "thread/ShardedCache.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(ShardedCache, Basic)
+{
+	ShardedCache<int, int, 4, 8, 7> cache;
+
+	EXPECT_FALSE(cache.Get(1));
+
+	cache.Put(1, 10);
+	cache.Put(2, 20);
+	EXPECT_EQ(cache.Get(1), 10);
+	EXPECT_EQ(cache.Get(2), 20);
+
+	/* replace */
+	cache.Put(1, 11);
+	EXPECT_EQ(cache.Get(1), 11);
+
+	int visited = 0;
+	EXPECT_TRUE(cache.Visit(2, [&visited](int value){ visited = value; }));
+	EXPECT_EQ(visited, 20);
+	EXPECT_FALSE(cache.Visit(3, [](int){ FAIL(); }));
+
+	cache.Remove(1);
+	EXPECT_FALSE(cache.Get(1));
+	EXPECT_EQ(cache.Get(2), 20);
+
+	for (int i = 0; i < 16; ++i)
+		cache.Put(i, i * 10);
+
+	cache.RemoveIf([](int key, int){ return key % 2 != 0; });
+
+	unsigned n = 0;
+	cache.ForEach([&n](int key, int value){
+		EXPECT_EQ(key % 2, 0);
+		EXPECT_EQ(value, key * 10);
+		++n;
+	});
+	EXPECT_EQ(n, 8U);
+
+	cache.Clear();
+	EXPECT_FALSE(cache.Get(0));
+}
+
+TEST(ShardedCache, Eviction)
+{
+	/* 4 shards with 2 items each */
+	ShardedCache<int, int, 4, 2, 3> cache;
+
+	for (int i = 0; i < 100; ++i)
+		cache.Put(i, i);
+
+	unsigned n = 0;
+	cache.ForEach([&n](int key, int value){
+		EXPECT_EQ(key, value);
+		++n;
+	});
+
+	EXPECT_LE(n, 8U);
+
+	/* the last item is always there */
+	EXPECT_EQ(cache.Get(99), 99);
+}
+
+TEST(ShardedCache, Threads)
+{
+	static constexpr unsigned N_THREADS = 4;
+	static constexpr int N_KEYS = 1000;
+
+	auto cache = std::make_unique<ShardedCache<int, int, 8, 1024, 1021>>();
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < N_THREADS; ++t)
+		threads.emplace_back([&cache, t]{
+			for (unsigned round = 0; round < 10; ++round) {
+				for (int i = t; i < N_KEYS; i += N_THREADS)
+					cache->Put(i, i * 3);
+
+				/* read the other threads' keys, too */
+				for (int i = 0; i < N_KEYS; ++i) {
+					if (auto value = cache->Get(i)) {
+						EXPECT_EQ(*value, i * 3);
+					}
+				}
+			}
+		});
+
+	for (auto &i : threads)
+		i.join();
+
+	for (int i = 0; i < N_KEYS; ++i)
+		EXPECT_EQ(cache->Get(i), i * 3);
+}
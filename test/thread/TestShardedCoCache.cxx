@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "thread/ShardedCoCache.hxx"
+#include "co/Task.hxx"
+#include "co/InvokeTask.hxx"
+#include "event/co/Sleep.hxx"
+#include "event/Loop.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+/**
+ * The #EventLoop of the current thread (for the factories).
+ */
+static thread_local constinit EventLoop *current_event_loop = nullptr;
+
+static std::atomic_uint n_calls;
+
+struct ImmediateFactory {
+	Co::Task<int> operator()(int key) noexcept {
+		++n_calls;
+		co_return key * 2;
+	}
+};
+
+struct SleepFactory {
+	Co::Task<int> operator()(int key) noexcept {
+		++n_calls;
+		co_await Co::Sleep(*current_event_loop, 10ms);
+		co_return key * 2;
+	}
+};
+
+template<typename Factory>
+using TestCache = ShardedCoCache<Factory, int, int, 4, 16, 13>;
+
+template<typename Cache>
+class Work {
+	typename Cache::Client &client;
+
+	Co::InvokeTask invoke_task;
+
+public:
+	std::optional<int> value;
+	std::exception_ptr error;
+	bool done = false;
+
+	explicit Work(typename Cache::Client &_client) noexcept
+		:client(_client) {}
+
+	void Start(int key) noexcept {
+		invoke_task = Run(key);
+		invoke_task.Start(BIND_THIS_METHOD(OnCompletion));
+	}
+
+	/**
+	 * Run the #EventLoop until the work is done.
+	 */
+	void Wait() noexcept {
+		if (!done)
+			client.GetEventLoop().Run();
+	}
+
+private:
+	Co::InvokeTask Run(int key) {
+		value = co_await client.Get(key);
+	}
+
+	void OnCompletion(std::exception_ptr _error) noexcept {
+		error = std::move(_error);
+		done = true;
+		client.GetEventLoop().Break();
+	}
+};
+
+TEST(ShardedCoCache, Local)
+{
+	using Cache = TestCache<ImmediateFactory>;
+
+	n_calls = 0;
+
+	EventLoop event_loop;
+	current_event_loop = &event_loop;
+
+	Cache cache;
+	Cache::Client client{cache, event_loop};
+
+	Work<Cache> work{client};
+	work.Start(3);
+	work.Wait();
+	EXPECT_TRUE(work.done);
+	EXPECT_FALSE(work.error);
+	EXPECT_EQ(work.value, 6);
+	EXPECT_EQ(n_calls, 1U);
+	EXPECT_EQ(cache.GetIfCached(3), 6);
+
+	/* cache hit: completes synchronously */
+	Work<Cache> work2{client};
+	work2.Start(3);
+	EXPECT_TRUE(work2.done);
+	EXPECT_EQ(work2.value, 6);
+	EXPECT_EQ(n_calls, 1U);
+
+	/* removed: the factory is called again */
+	cache.Remove(3);
+	Work<Cache> work3{client};
+	work3.Start(3);
+	work3.Wait();
+	EXPECT_EQ(work3.value, 6);
+	EXPECT_EQ(n_calls, 2U);
+}
+
+/**
+ * Two threads request the same key concurrently; the factory runs
+ * only once, in the thread which requested first.
+ */
+TEST(ShardedCoCache, CrossThread)
+{
+	using Cache = TestCache<SleepFactory>;
+
+	n_calls = 0;
+
+	EventLoop event_loop;
+	current_event_loop = &event_loop;
+
+	Cache cache;
+	Cache::Client client{cache, event_loop};
+
+	Work<Cache> work{client};
+	work.Start(21);
+	EXPECT_FALSE(work.done);
+	EXPECT_EQ(n_calls, 1U);
+
+	std::promise<void> joined;
+	std::optional<int> thread_value;
+	std::exception_ptr thread_error;
+
+	std::thread thread{[&]{
+		EventLoop thread_event_loop;
+		current_event_loop = &thread_event_loop;
+
+		Cache::Client thread_client{cache, thread_event_loop};
+		Work<Cache> thread_work{thread_client};
+		thread_work.Start(21);
+		joined.set_value();
+
+		thread_work.Wait();
+		thread_value = thread_work.value;
+		thread_error = thread_work.error;
+	}};
+
+	joined.get_future().wait();
+	work.Wait();
+	thread.join();
+
+	EXPECT_FALSE(work.error);
+	EXPECT_EQ(work.value, 42);
+	EXPECT_FALSE(thread_error);
+	EXPECT_EQ(thread_value, 42);
+	EXPECT_EQ(n_calls, 1U);
+	EXPECT_EQ(cache.GetIfCached(21), 42);
+}
+
+/**
+ * The thread which runs the factory exits before it finishes; the
+ * other thread gets an error.
+ */
+TEST(ShardedCoCache, ClientDestroyed)
+{
+	using Cache = TestCache<SleepFactory>;
+
+	n_calls = 0;
+
+	EventLoop event_loop;
+	current_event_loop = &event_loop;
+
+	Cache cache;
+	Cache::Client client{cache, event_loop};
+
+	std::promise<void> started, joined;
+
+	std::thread thread{[&]{
+		EventLoop thread_event_loop;
+		current_event_loop = &thread_event_loop;
+
+		Cache::Client thread_client{cache, thread_event_loop};
+		Work<Cache> thread_work{thread_client};
+		thread_work.Start(5);
+		started.set_value();
+
+		/* exit without running the EventLoop */
+		joined.get_future().wait();
+	}};
+
+	started.get_future().wait();
+
+	Work<Cache> work{client};
+	work.Start(5);
+	joined.set_value();
+
+	work.Wait();
+	thread.join();
+
+	EXPECT_TRUE(work.error);
+	EXPECT_FALSE(work.value);
+	EXPECT_EQ(n_calls, 1U);
+	EXPECT_FALSE(cache.GetIfCached(5));
+}
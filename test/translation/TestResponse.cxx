@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "translation/server/Response.hxx"
+#include "translation/server/FinishedResponse.hxx"
+#include "io/Iovec.hxx"
+#include "util/SpanCast.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+using namespace Translation::Server;
+
+static void
+BuildResponse(Response &response, std::span<const std::byte> large) noexcept
+{
+	response.Status(HttpStatus::OK);
+	response.ExternalPacket(TranslationCommand::PATH,
+				AsBytes(std::string_view{"/small"}));
+	response.ExternalPacket(TranslationCommand::WRITE_FILE, large);
+	response.ExternalPacket(TranslationCommand::SETENV,
+				AllocatedArray<std::byte>{large});
+	response.VaryHost();
+}
+
+static std::string
+Flatten(const FinishedResponse &src) noexcept
+{
+	std::string result;
+	for (const auto &i : src.GetVector())
+		result.append(ToStringView(ToSpan(i)));
+	return result;
+}
+
+TEST(TranslationResponse, FinishVector)
+{
+	const std::string large(Response::MIN_EXTERNAL_SIZE * 2, 'x');
+
+	Response r1;
+	BuildResponse(r1, AsBytes(large));
+	const auto f1 = r1.Finish();
+	const std::unique_ptr<std::byte[]> f1_buffer{f1.data()};
+
+	Response r2{Response::GetPacketSize(large.size()) * 2};
+	BuildResponse(r2, AsBytes(large));
+	auto f2 = r2.FinishVector();
+
+	/* BEGIN+STATUS+PATH+header, WRITE_FILE payload, header,
+	   SETENV payload, VARY+END */
+	EXPECT_EQ(f2.GetVector().size(), 5U);
+	EXPECT_EQ(Flatten(f2), ToStringView(f1));
+
+	/* consume in odd steps */
+	const std::size_t total = f1.size();
+	std::size_t consumed = 0;
+	while (!f2.empty()) {
+		const std::size_t n = std::min<std::size_t>(total - consumed, 1000);
+		consumed += n;
+		f2.Consume(n);
+		EXPECT_EQ(Flatten(f2), ToStringView(f1).substr(consumed));
+	}
+
+	EXPECT_EQ(consumed, total);
+}
+
+TEST(TranslationResponse, Revert)
+{
+	const std::string large(Response::MIN_EXTERNAL_SIZE, 'y');
+
+	Response r1;
+	r1.Status(HttpStatus::OK);
+	const auto f1 = r1.Finish();
+	const std::unique_ptr<std::byte[]> f1_buffer{f1.data()};
+
+	Response r2;
+	r2.Status(HttpStatus::OK);
+	const auto m = r2.Mark();
+	r2.ExternalPacket(TranslationCommand::WRITE_FILE, AsBytes(large));
+	r2.ExternalPacket(TranslationCommand::SETENV,
+			  AllocatedArray<std::byte>{AsBytes(large)});
+	r2.Revert(m);
+	const auto f2 = r2.FinishVector();
+
+	EXPECT_EQ(f2.GetVector().size(), 1U);
+	EXPECT_EQ(Flatten(f2), ToStringView(f1));
+}
+
+TEST(TranslationResponse, WriteFile)
+{
+	const std::string large(Response::MIN_EXTERNAL_SIZE, 'z');
+
+	for (const std::size_t length : {std::size_t{3}, large.size()}) {
+		const std::string_view contents{large.data(), length};
+
+		Response r1;
+		r1.Execute("/bin/true").MountNamespace()
+			.WriteFile("/etc/foo", contents);
+		const auto f1 = r1.Finish();
+		const std::unique_ptr<std::byte[]> f1_buffer{f1.data()};
+
+		Response r2;
+		r2.Execute("/bin/true").MountNamespace()
+			.WriteFile("/etc/foo",
+				   AllocatedArray<std::byte>{AsBytes(contents)});
+		const auto f2 = r2.FinishVector();
+
+		/* only the large contents are a separate fragment */
+		EXPECT_EQ(f2.GetVector().size(),
+			  length < Response::MIN_EXTERNAL_SIZE ? 1U : 3U);
+		EXPECT_EQ(Flatten(f2), ToStringView(f1));
+	}
+}
@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "translation/server/ResponseCache.hxx"
+#include "translation/server/Response.hxx"
+#include "translation/server/FinishedResponse.hxx"
+#include "net/PeerCredentials.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+using namespace Translation::Server;
+using std::string_view_literals::operator""sv;
+
+namespace {
+
+static constexpr ResponseCache::Peer peer{1000, 1000};
+
+/**
+ * Owns the return value of Response::Finish().
+ */
+struct Packets {
+	std::unique_ptr<std::byte[]> buffer;
+	std::span<const std::byte> all;
+
+	explicit Packets(Response &response) noexcept {
+		const auto f = response.Finish();
+		buffer.reset(f.data());
+		all = f;
+	}
+
+	/**
+	 * Without the END packet (which is what the #Connection
+	 * passes as request).
+	 */
+	std::span<const std::byte> WithoutEnd() const noexcept {
+		return all.first(all.size() - sizeof(TranslationHeader));
+	}
+};
+
+static Packets
+MakeRequest(std::string_view uri, std::string_view host) noexcept
+{
+	Response r;
+	r.Packet(TranslationCommand::URI, uri);
+	r.Packet(TranslationCommand::HOST, host);
+	return Packets{r};
+}
+
+} // anonymous namespace
+
+TEST(TranslationResponseCache, Basic)
+{
+	const Event::TimePoint now{};
+
+	ResponseCache cache{{}};
+
+	const auto request = MakeRequest("/foo"sv, "a"sv);
+	EXPECT_TRUE(cache.Get(request.WithoutEnd(), peer, now).empty());
+
+	/* not cacheable: no MAX_AGE and no default TTL */
+	cache.Put(request.WithoutEnd(), peer, Packets{Response{}.Status(HttpStatus::OK)}.all, now);
+	EXPECT_TRUE(cache.Get(request.WithoutEnd(), peer, now).empty());
+
+	const Packets response{Response{}.MaxAge(60).Status(HttpStatus::OK)};
+	cache.Put(request.WithoutEnd(), peer, response.all, now);
+
+	const auto hit = cache.Get(request.WithoutEnd(), peer, now);
+	EXPECT_TRUE(std::ranges::equal(hit, response.all));
+
+	/* HOST is not part of the key because there is no VARY */
+	EXPECT_FALSE(cache.Get(MakeRequest("/foo"sv, "b"sv).WithoutEnd(), peer, now).empty());
+	EXPECT_TRUE(cache.Get(MakeRequest("/bar"sv, "a"sv).WithoutEnd(), peer, now).empty());
+
+	/* expired */
+	EXPECT_TRUE(cache.Get(request.WithoutEnd(), peer, now + std::chrono::seconds{61}).empty());
+	EXPECT_TRUE(cache.Get(request.WithoutEnd(), peer, now).empty());
+
+	EXPECT_EQ(cache.GetStats().hits, 2U);
+	EXPECT_EQ(cache.GetStats().stores, 1U);
+}
+
+TEST(TranslationResponseCache, Vary)
+{
+	const Event::TimePoint now{};
+
+	ResponseCache cache{{.default_ttl = std::chrono::minutes{1}}};
+
+	const Packets response{Response{}.VaryHost().Status(HttpStatus::OK)};
+	cache.Put(MakeRequest("/foo"sv, "a"sv).WithoutEnd(), peer, response.all, now);
+
+	EXPECT_FALSE(cache.Get(MakeRequest("/foo"sv, "a"sv).WithoutEnd(), peer, now).empty());
+	EXPECT_TRUE(cache.Get(MakeRequest("/foo"sv, "b"sv).WithoutEnd(), peer, now).empty());
+
+	/* a different URI with a response that does not depend on
+	   HOST */
+	const Packets response2{Response{}.Status(HttpStatus::NOT_FOUND)};
+	cache.Put(MakeRequest("/bar"sv, "a"sv).WithoutEnd(), peer, response2.all, now);
+
+	EXPECT_TRUE(std::ranges::equal(cache.Get(MakeRequest("/bar"sv, "b"sv).WithoutEnd(), peer, now),
+				       response2.all));
+	EXPECT_TRUE(std::ranges::equal(cache.Get(MakeRequest("/foo"sv, "a"sv).WithoutEnd(), peer, now),
+				       response.all));
+}
+
+TEST(TranslationResponseCache, Peer)
+{
+	const Event::TimePoint now{};
+
+	ResponseCache cache{{.default_ttl = std::chrono::minutes{1}}};
+
+	const auto request = MakeRequest("/foo"sv, "a"sv);
+	const Packets response{Response{}.Status(HttpStatus::OK)};
+	cache.Put(request.WithoutEnd(), peer, response.all, now);
+
+	EXPECT_FALSE(cache.Get(request.WithoutEnd(), peer, now).empty());
+
+	/* responses are not shared with other uids/gids */
+	EXPECT_TRUE(cache.Get(request.WithoutEnd(), {1001, 1000}, now).empty());
+	EXPECT_TRUE(cache.Get(request.WithoutEnd(), {1000, 1001}, now).empty());
+	EXPECT_TRUE(cache.Get(request.WithoutEnd(),
+			      ResponseCache::Peer::From(SocketPeerCredentials::Undefined()),
+			      now).empty());
+}
+
+TEST(TranslationResponseCache, Invalidate)
+{
+	const Event::TimePoint now{};
+
+	ResponseCache cache{{.default_ttl = std::chrono::minutes{1}}};
+
+	const Packets response{Response{}.Status(HttpStatus::OK)};
+	cache.Put(MakeRequest("/foo"sv, "a"sv).WithoutEnd(), peer, response.all, now);
+	cache.Put(MakeRequest("/bar"sv, "b"sv).WithoutEnd(), peer, response.all, now);
+
+	cache.Invalidate(TranslationCommand::HOST, std::as_bytes(std::span{"a"sv}));
+	EXPECT_TRUE(cache.Get(MakeRequest("/foo"sv, "a"sv).WithoutEnd(), peer, now).empty());
+	EXPECT_FALSE(cache.Get(MakeRequest("/bar"sv, "b"sv).WithoutEnd(), peer, now).empty());
+
+	cache.Flush();
+	EXPECT_TRUE(cache.Get(MakeRequest("/bar"sv, "b"sv).WithoutEnd(), peer, now).empty());
+	EXPECT_EQ(cache.GetTotalSize(), 0U);
+}
+
+TEST(TranslationResponseCache, Vector)
+{
+	const Event::TimePoint now{};
+
+	ResponseCache cache{{}};
+
+	const auto request = MakeRequest("/foo"sv, "a"sv);
+
+	/* a large payload which becomes a separate buffer */
+	static constexpr std::array<std::byte, 4096> big{};
+
+	/* not cacheable (no MAX_AGE and no default TTL) */
+	{
+		Response r;
+		r.ExternalPacket(TranslationCommand::WRITE_FILE, big);
+		r.Status(HttpStatus::OK);
+		const auto f = r.FinishVector();
+		ASSERT_GT(f.GetVector().size(), 1U);
+
+		cache.Put(request.WithoutEnd(), peer, f.GetVector(), now);
+		EXPECT_EQ(cache.GetStats().stores, 0U);
+	}
+
+	Response r;
+	r.MaxAge(60).VaryHost();
+	r.ExternalPacket(TranslationCommand::WRITE_FILE, big);
+	r.Status(HttpStatus::OK);
+	const auto f = r.FinishVector();
+	ASSERT_GT(f.GetVector().size(), 1U);
+
+	std::vector<std::byte> flat;
+	for (const auto &i : f.GetVector()) {
+		const auto *p = static_cast<const std::byte *>(i.iov_base);
+		flat.insert(flat.end(), p, p + i.iov_len);
+	}
+
+	cache.Put(request.WithoutEnd(), peer, f.GetVector(), now);
+	EXPECT_EQ(cache.GetStats().stores, 1U);
+
+	/* MAX_AGE and VARY were parsed from the fragments */
+	EXPECT_TRUE(std::ranges::equal(cache.Get(request.WithoutEnd(), peer, now),
+				       flat));
+	EXPECT_TRUE(cache.Get(MakeRequest("/foo"sv, "b"sv).WithoutEnd(), peer, now).empty());
+	EXPECT_TRUE(cache.Get(request.WithoutEnd(), peer, now + std::chrono::seconds{61}).empty());
+}
+
+TEST(TranslationResponseCache, ExpiredVary)
+{
+	const Event::TimePoint now{};
+
+	ResponseCache cache{{}};
+
+	const auto request = MakeRequest("/foo"sv, "a"sv);
+
+	/* a fresh response with an empty VARY mask */
+	const Packets fresh{Response{}.MaxAge(600).Status(HttpStatus::OK)};
+	cache.Put(request.WithoutEnd(), peer, fresh.all, now);
+
+	/* a short-lived response with another VARY mask, which is
+	   looked up first (most recently used) */
+	const Packets stale{Response{}.MaxAge(10).VaryHost().Status(HttpStatus::NOT_FOUND)};
+	cache.Put(request.WithoutEnd(), peer, stale.all, now);
+
+	const auto later = now + std::chrono::seconds{60};
+	EXPECT_TRUE(std::ranges::equal(cache.Get(request.WithoutEnd(), peer, later),
+				       fresh.all));
+}
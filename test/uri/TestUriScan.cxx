@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "uri/Scan.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+static constexpr UriCharClass all_classes[] = {
+	UriCharClass::UNRESERVED,
+	UriCharClass::PCHAR,
+	UriCharClass::PATH,
+	UriCharClass::QUERY,
+};
+
+/**
+ * Compare SkipUriChars() with SkipUriCharsScalar() for every byte
+ * value at every position of strings of various lengths (to cover
+ * the SIMD loops and their tails).
+ */
+TEST(UriScan, Differential)
+{
+	for (const auto c : all_classes) {
+		for (std::size_t length = 0; length <= 80; ++length) {
+			std::string s(length, 'a');
+			ASSERT_EQ(SkipUriChars(c, s), length);
+
+			for (std::size_t position = 0; position < length; ++position) {
+				for (unsigned ch = 0; ch < 0x100; ++ch) {
+					s[position] = static_cast<char>(ch);
+					ASSERT_EQ(SkipUriChars(c, s),
+						  SkipUriCharsScalar(c, s))
+						<< "class=" << unsigned(c)
+						<< " length=" << length
+						<< " position=" << position
+						<< " ch=" << ch;
+				}
+
+				s[position] = 'a';
+			}
+		}
+	}
+}
+
+TEST(UriScan, Basic)
+{
+	EXPECT_EQ(SkipUriChars(UriCharClass::UNRESERVED, "foo-bar_baz.~/x"), 13U);
+	EXPECT_EQ(SkipUriChars(UriCharClass::PCHAR, "foo%20bar:@!$/x"), 13U);
+	EXPECT_EQ(SkipUriChars(UriCharClass::PATH, "foo/bar%20/baz?x"), 14U);
+	EXPECT_EQ(SkipUriChars(UriCharClass::QUERY, "a=b&c=d/e?f#g"), 11U);
+	EXPECT_EQ(SkipUriChars(UriCharClass::QUERY, "\x80\xff"), 0U);
+}
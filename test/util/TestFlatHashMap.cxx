@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "util/FlatHashMap.hxx"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+namespace {
+
+/**
+ * A hash function which maps everything to the same value, so all
+ * keys collide.
+ */
+struct BadHash {
+	constexpr std::size_t operator()(int) const noexcept {
+		return 42;
+	}
+};
+
+} // anonymous namespace
+
+TEST(FlatHashMap, Basic)
+{
+	FlatHashMap<int, int> map;
+
+	EXPECT_TRUE(map.empty());
+	EXPECT_EQ(map.size(), 0U);
+	EXPECT_EQ(map.find(1), nullptr);
+	EXPECT_FALSE(map.erase(1));
+
+	{
+		auto [item, inserted] = map.insert(1, 10);
+		EXPECT_TRUE(inserted);
+		EXPECT_EQ(item->key, 1);
+		EXPECT_EQ(item->value, 10);
+	}
+
+	{
+		auto [item, inserted] = map.insert(1, 11);
+		EXPECT_FALSE(inserted);
+		EXPECT_EQ(item->value, 10);
+	}
+
+	map.insert(2, 20);
+	map.insert_or_assign(3, 30);
+	map.insert_or_assign(1, 11);
+
+	EXPECT_FALSE(map.empty());
+	EXPECT_EQ(map.size(), 3U);
+	ASSERT_NE(map.find(1), nullptr);
+	EXPECT_EQ(map.find(1)->value, 11);
+	ASSERT_NE(map.find(2), nullptr);
+	EXPECT_EQ(map.find(2)->value, 20);
+	EXPECT_TRUE(map.contains(3));
+	EXPECT_FALSE(map.contains(4));
+
+	EXPECT_EQ(map[4], 0);
+	map[4] = 40;
+	EXPECT_EQ(map.find(4)->value, 40);
+	EXPECT_EQ(map.size(), 4U);
+
+	EXPECT_TRUE(map.erase(2));
+	EXPECT_FALSE(map.erase(2));
+	EXPECT_EQ(map.find(2), nullptr);
+	EXPECT_EQ(map.size(), 3U);
+
+	map.erase(*map.find(1));
+	EXPECT_EQ(map.find(1), nullptr);
+	EXPECT_EQ(map.size(), 2U);
+
+	int sum = 0;
+	map.for_each([&sum](const auto &item){ sum += item.value; });
+	EXPECT_EQ(sum, 70);
+
+	map.clear();
+	EXPECT_TRUE(map.empty());
+	EXPECT_EQ(map.find(3), nullptr);
+	EXPECT_EQ(map.find(4), nullptr);
+}
+
+TEST(FlatHashMap, Collisions)
+{
+	FlatHashMap<int, int, BadHash> map;
+
+	for (int i = 0; i < 100; ++i)
+		ASSERT_TRUE(map.insert(i, i * 2).second);
+
+	for (int i = 0; i < 100; ++i) {
+		ASSERT_NE(map.find(i), nullptr);
+		EXPECT_EQ(map.find(i)->value, i * 2);
+	}
+
+	/* erase every other one; the remaining ones must still be
+	   found behind the tombstones */
+	for (int i = 0; i < 100; i += 2)
+		ASSERT_TRUE(map.erase(i));
+
+	EXPECT_EQ(map.size(), 50U);
+
+	for (int i = 0; i < 100; ++i)
+		EXPECT_EQ(map.contains(i), i % 2 != 0);
+}
+
+TEST(FlatHashMap, RemoveIf)
+{
+	FlatHashMap<int, int> map;
+	for (int i = 0; i < 1000; ++i)
+		map.insert(i, i);
+
+	EXPECT_EQ(map.remove_if([](const auto &item){ return item.value % 3 == 0; }),
+		  334U);
+	EXPECT_EQ(map.size(), 666U);
+
+	for (int i = 0; i < 1000; ++i)
+		EXPECT_EQ(map.contains(i), i % 3 != 0);
+}
+
+/**
+ * Compare with std::map after many random insertions and deletions.
+ */
+TEST(FlatHashMap, Random)
+{
+	FlatHashMap<uint32_t, uint32_t> map;
+	std::map<uint32_t, uint32_t> reference;
+
+	std::mt19937 rng{42};
+	std::uniform_int_distribution<uint32_t> key_dist{0, 2000};
+
+	for (unsigned i = 0; i < 100000; ++i) {
+		const uint32_t key = key_dist(rng);
+
+		if (rng() % 3 == 0) {
+			EXPECT_EQ(map.erase(key), reference.erase(key) > 0);
+		} else {
+			map.insert_or_assign(key, i);
+			reference[key] = i;
+		}
+	}
+
+	EXPECT_EQ(map.size(), reference.size());
+
+	for (const auto &[key, value] : reference) {
+		const auto *item = map.find(key);
+		ASSERT_NE(item, nullptr);
+		EXPECT_EQ(item->value, value);
+	}
+
+	std::size_t n = 0;
+	map.for_each([&](const auto &item){
+		EXPECT_TRUE(reference.contains(item.key));
+		++n;
+	});
+	EXPECT_EQ(n, reference.size());
+}
+
+TEST(FlatHashMap, Reserve)
+{
+	FlatHashMap<int, int> map;
+	map.reserve(1000);
+
+	map.insert(1, 1);
+	const auto *item = map.find(1);
+
+	/* no rehash, so the pointer remains valid */
+	for (int i = 2; i <= 1000; ++i)
+		map.insert(i, i);
+
+	EXPECT_EQ(map.find(1), item);
+	EXPECT_EQ(map.size(), 1000U);
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "util/FlatPointerSet.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/StringWithHash.hxx"
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <string>
+
+namespace {
+
+struct Item {
+	std::string name;
+	StringWithHash key;
+
+	explicit Item(const char *_name) noexcept
+		:name(_name), key(name) {}
+
+	struct GetKey {
+		constexpr StringWithHash operator()(const Item &item) const noexcept {
+			return item.key;
+		}
+	};
+
+	struct Hash {
+		constexpr std::size_t operator()(const StringWithHash &key) const noexcept {
+			return key.hash;
+		}
+	};
+};
+
+using ItemSet = FlatPointerSet<Item,
+			       IntrusiveHashSetOperators<Item, Item::GetKey,
+							 Item::Hash,
+							 std::equal_to<StringWithHash>>>;
+
+} // anonymous namespace
+
+TEST(FlatPointerSet, Basic)
+{
+	Item a{"a"}, b{"b"}, c{"c"}, a2{"a"};
+
+	ItemSet set;
+	EXPECT_TRUE(set.empty());
+	EXPECT_EQ(set.find(a.key), nullptr);
+
+	EXPECT_EQ(set.insert(a), std::make_pair(&a, true));
+	EXPECT_EQ(set.insert(b), std::make_pair(&b, true));
+	EXPECT_EQ(set.insert(a2), std::make_pair(&a, false));
+	EXPECT_EQ(set.size(), 2U);
+
+	EXPECT_EQ(set.find(StringWithHash{"a"}), &a);
+	EXPECT_EQ(set.find(StringWithHash{"b"}), &b);
+	EXPECT_EQ(set.find(StringWithHash{"c"}), nullptr);
+	EXPECT_TRUE(set.contains(a2.key));
+	EXPECT_FALSE(set.contains(c.key));
+
+	set.erase(a);
+	EXPECT_EQ(set.find(a.key), nullptr);
+	EXPECT_EQ(set.size(), 1U);
+
+	EXPECT_EQ(set.insert(a2), std::make_pair(&a2, true));
+	EXPECT_EQ(set.find(a.key), &a2);
+
+	EXPECT_EQ(set.erase_key(StringWithHash{"b"}), &b);
+	EXPECT_EQ(set.erase_key(StringWithHash{"b"}), nullptr);
+	EXPECT_EQ(set.size(), 1U);
+
+	set.clear();
+	EXPECT_TRUE(set.empty());
+	EXPECT_EQ(set.find(a.key), nullptr);
+}
+
+TEST(FlatPointerSet, Many)
+{
+	std::list<Item> items;
+	for (unsigned i = 0; i < 1000; ++i)
+		items.emplace_back(std::to_string(i).c_str());
+
+	ItemSet set;
+	for (auto &i : items)
+		ASSERT_TRUE(set.insert(i).second);
+
+	EXPECT_EQ(set.size(), items.size());
+
+	for (const auto &i : items)
+		EXPECT_EQ(set.find(StringWithHash{i.name}), &i);
+
+	std::size_t n = 0;
+	set.for_each([&n](const Item &){ ++n; });
+	EXPECT_EQ(n, items.size());
+
+	EXPECT_EQ(set.remove_and_dispose_if([](const Item &i){ return i.name.size() < 3; },
+					    [](Item *){}),
+		  100U);
+	EXPECT_EQ(set.size(), 900U);
+
+	for (const auto &i : items)
+		EXPECT_EQ(set.contains(StringWithHash{i.name}), i.name.size() >= 3);
+}
+
+TEST(FlatPointerSet, ClearAndDispose)
+{
+	ItemSet set;
+	set.insert(*new Item("x"));
+	set.insert(*new Item("y"));
+
+	set.clear_and_dispose(DeleteDisposer{});
+	EXPECT_TRUE(set.empty());
+}
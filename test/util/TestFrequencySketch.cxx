@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// author: Max Kellermann <max.kellermann@gmail.com>
+
+#include "util/FrequencySketch.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(FrequencySketch, Basic)
+{
+	FrequencySketch<64> sketch;
+	EXPECT_EQ(sketch.Get(1), 0U);
+
+	sketch.Increment(1);
+	EXPECT_EQ(sketch.Get(1), 1U);
+
+	for (unsigned i = 0; i < 4; ++i)
+		sketch.Increment(2);
+	EXPECT_EQ(sketch.Get(2), 4U);
+	EXPECT_EQ(sketch.Get(1), 1U);
+
+	/* counters saturate */
+	for (unsigned i = 0; i < 100; ++i)
+		sketch.Increment(3);
+	EXPECT_EQ(sketch.Get(3), 15U);
+
+	sketch.Clear();
+	EXPECT_EQ(sketch.Get(1), 0U);
+	EXPECT_EQ(sketch.Get(2), 0U);
+	EXPECT_EQ(sketch.Get(3), 0U);
+}
+
+TEST(FrequencySketch, Aging)
+{
+	FrequencySketch<64> sketch;
+
+	for (unsigned i = 0; i < 8; ++i)
+		sketch.Increment(42);
+	EXPECT_EQ(sketch.Get(42), 8U);
+
+	/* after 10 increments per word, all counters are halved */
+	for (std::size_t i = 1000; sketch.Get(42) == 8; ++i)
+		sketch.Increment(i);
+
+	EXPECT_EQ(sketch.Get(42), 4U);
+}
+
+TEST(FrequencySketch, Estimate)
+{
+	FrequencySketch<1024> sketch;
+
+	/* a count-min sketch never underestimates (until aging) */
+	for (std::size_t i = 0; i < 1000; ++i)
+		for (std::size_t j = 0; j < i % 8; ++j)
+			sketch.Increment(i);
+
+	unsigned n_exact = 0;
+	for (std::size_t i = 0; i < 1000; ++i) {
+		EXPECT_GE(sketch.Get(i), i % 8);
+		if (sketch.Get(i) == i % 8)
+			++n_exact;
+	}
+
+	EXPECT_GT(n_exact, 900U);
+}
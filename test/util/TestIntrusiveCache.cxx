@@ -252,3 +252,77 @@ TEST(IntrusiveCache, MemberHook)
 
 	cache.clear();
 }
+
+TEST(IntrusiveCache, WTinyLfu)
+{
+	struct Item final : IntrusiveCacheLfuHook {
+		int key;
+
+		explicit Item(int _key) noexcept
+			:key(_key) {}
+
+		struct GetKey {
+			constexpr int operator()(const Item &item) const noexcept {
+				return item.key;
+			}
+		};
+
+		struct GetSize {
+			constexpr std::size_t operator()(const Item &) const noexcept {
+				return 1;
+			}
+		};
+	};
+
+	using Operators = IntrusiveCacheOperators<Item, Item::GetKey, std::hash<int>, std::equal_to<int>, Item::GetSize, DeleteDisposer>;
+	IntrusiveCache<Item, 97, Operators,
+		       IntrusiveCacheBaseHookTraits<Item>,
+		       WTinyLfuCachePolicy<128>> cache{100};
+
+	const auto get_or_put = [&cache](int key){
+		if (cache.Get(key) == nullptr)
+			cache.Put(*new Item(key));
+	};
+
+	/* a working set which is accessed repeatedly */
+	for (unsigned i = 0; i < 5; ++i)
+		for (int key = 0; key < 50; ++key)
+			get_or_put(key);
+
+	EXPECT_EQ(cache.GetTotalSize(), 50U);
+
+	/* a scan over many one-off keys */
+	for (int key = 1000; key < 2000; ++key)
+		get_or_put(key);
+
+	EXPECT_EQ(cache.GetTotalSize(), 100U);
+
+	unsigned n = 0;
+	cache.ForEach([&n](const Item &item){
+		if (item.key < 50)
+			++n;
+	});
+
+	EXPECT_GE(n, 45U);
+
+	/* replacing an item */
+	auto *item = new Item(1);
+	cache.Put(*item);
+	EXPECT_EQ(cache.Get(1), item);
+	EXPECT_EQ(cache.GetTotalSize(), 100U);
+
+	cache.Remove(1);
+	EXPECT_EQ(cache.Get(1), nullptr);
+	EXPECT_EQ(cache.GetTotalSize(), 99U);
+
+	cache.RemoveIf([](const Item &i){
+		return i.key >= 1000;
+	});
+
+	n = 0;
+	cache.ForEach([&n](const Item &i){
+		EXPECT_LT(i.key, 1000);
+		++n;
+	});
+	EXPECT_EQ(cache.GetTotalSize(), n);
+}
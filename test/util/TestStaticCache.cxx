@@ -290,3 +290,69 @@ TEST(StaticCache, NotAssignable)
 		EXPECT_EQ(cache.Get(i)->value, i);
 	}
 }
+
+/**
+ * Look up a working set of keys a few times, then scan many one-off
+ * keys, and return how many keys of the working set survived.
+ */
+template<typename Cache>
+static unsigned
+RunScan(Cache &cache)
+{
+	const auto get_or_put = [&cache](unsigned key){
+		if (cache.Get(key) == nullptr)
+			cache.Put(key, key);
+	};
+
+	for (unsigned i = 0; i < 5; ++i)
+		for (unsigned key = 0; key < 50; ++key)
+			get_or_put(key);
+
+	for (unsigned key = 1000; key < 2000; ++key)
+		get_or_put(key);
+
+	unsigned n = 0;
+	cache.ForEach([&n](unsigned key, unsigned value){
+		EXPECT_EQ(key, value);
+		if (key < 50)
+			++n;
+	});
+
+	return n;
+}
+
+TEST(StaticCache, Scan)
+{
+	StaticCache<unsigned, unsigned, 100, 97> lru;
+	EXPECT_EQ(RunScan(lru), 0U);
+
+	StaticCache<unsigned, unsigned, 100, 97,
+		    std::hash<unsigned>, std::equal_to<unsigned>,
+		    WTinyLfuCachePolicy<>> lfu;
+	EXPECT_GE(RunScan(lfu), 45U);
+	EXPECT_TRUE(lfu.IsFull());
+
+	/* Remove() and RemoveIf() work with all segments */
+	lfu.Remove(0U);
+	EXPECT_EQ(lfu.Get(0U), nullptr);
+
+	lfu.RemoveIf([](unsigned key, unsigned){
+		return key % 2 == 0;
+	});
+
+	unsigned n = 0;
+	lfu.ForEach([&n](unsigned key, unsigned){
+		EXPECT_EQ(key % 2, 1U);
+		++n;
+	});
+	EXPECT_FALSE(lfu.IsFull());
+
+	/* refill */
+	for (unsigned key = 5000; n < 100; ++key, ++n)
+		lfu.Put(key, key);
+	EXPECT_TRUE(lfu.IsFull());
+	lfu.Put(1U << 20, 0U);
+
+	lfu.Clear();
+	EXPECT_TRUE(lfu.IsEmpty());
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "util/WyHash.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <set>
+#include <string>
+
+TEST(WyHash, Regression)
+{
+	/* values calculated with this implementation; they must
+	   never change, or else hashes differ between versions */
+	EXPECT_EQ(WyHash(std::string_view{}, 0), 0x93228a4de0eec5a2ULL);
+	EXPECT_EQ(WyHash("a", 1), 0xc5bac3db178713c4ULL);
+	EXPECT_EQ(WyHash("abc", 2), 0xa97f2f7b1d9b3314ULL);
+	EXPECT_EQ(WyHash("message digest", 3), 0x786d1f1df3801df4ULL);
+	EXPECT_EQ(WyHash("abcdefghijklmnopqrstuvwxyz", 4), 0xdca5a8138ad37c87ULL);
+	EXPECT_EQ(WyHash("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 5),
+		  0xb9e734f117cfaf70ULL);
+}
+
+TEST(WyHash, Seed)
+{
+	EXPECT_EQ(WyHash("foo", 42), WyHash("foo", 42));
+	EXPECT_NE(WyHash("foo", 42), WyHash("foo", 43));
+	EXPECT_NE(WyHash("foo", 42), WyHash("bar", 42));
+}
+
+TEST(WyHash, Unaligned)
+{
+	static constexpr std::string_view s = "The quick brown fox jumps over the lazy dog";
+
+	std::array<char, 64> buffer;
+	for (std::size_t offset = 0; offset < 8; ++offset) {
+		s.copy(buffer.data() + offset, s.size());
+		EXPECT_EQ(WyHash(std::string_view{buffer.data() + offset, s.size()}, 7),
+			  WyHash(s, 7));
+	}
+}
+
+/**
+ * Flipping any bit of the input changes the hash; this covers all
+ * code paths (short, medium and long inputs).
+ */
+TEST(WyHash, BitFlip)
+{
+	for (std::size_t length = 1; length <= 112; ++length) {
+		std::string s(length, 'x');
+		for (std::size_t i = 0; i < length; ++i)
+			s[i] = 'a' + (i * 7) % 26;
+
+		const auto reference = WyHash(s);
+
+		std::set<uint64_t> hashes{reference};
+		for (std::size_t i = 0; i < length; ++i) {
+			for (unsigned bit = 0; bit < 8; ++bit) {
+				s[i] ^= 1 << bit;
+				hashes.insert(WyHash(s));
+				s[i] ^= 1 << bit;
+			}
+		}
+
+		EXPECT_EQ(hashes.size(), length * 8 + 1);
+		EXPECT_EQ(WyHash(s), reference);
+	}
+}
+
+TEST(WyHash, Length)
+{
+	/* strings consisting of zeroes differ only in their length */
+	const std::string zeroes(256, '\0');
+
+	std::set<uint64_t> hashes;
+	for (std::size_t length = 0; length <= zeroes.size(); ++length)
+		hashes.insert(WyHash(std::string_view{zeroes}.substr(0, length)));
+
+	EXPECT_EQ(hashes.size(), zeroes.size() + 1);
+}
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "was/async/Buffer.hxx"
+#include "was/async/BufferPool.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+using namespace Was;
+
+static void
+Fill(Buffer &buffer, std::size_t size)
+{
+	while (size > 0) {
+		const auto w = buffer.Write();
+		ASSERT_FALSE(w.empty());
+
+		const std::size_t n = std::min(w.size(), size);
+		std::fill_n(w.begin(), n, std::byte{'x'});
+		buffer.Append(n);
+		size -= n;
+	}
+}
+
+TEST(WasBuffer, KnownLength)
+{
+	BufferPool pool;
+
+	{
+		Buffer buffer{pool};
+		ASSERT_TRUE(buffer.SetLength(100));
+
+		/* the buffer is limited to the announced length */
+		auto w = buffer.Write();
+		EXPECT_EQ(w.size(), 100U);
+
+		/* ... and only one small chunk was allocated */
+		auto stats = pool.GetStats();
+		EXPECT_EQ(stats.allocator.netto_size, BufferPool::MIN_SIZE);
+		EXPECT_EQ(stats.misses, 1U);
+
+		buffer.Append(100);
+		EXPECT_TRUE(buffer.IsComplete());
+		EXPECT_TRUE(buffer.Write().empty());
+
+		const auto body = buffer.ToDisposableBuffer();
+		EXPECT_TRUE(body);
+		EXPECT_EQ(body.size(), 100U);
+	}
+
+	/* the chunk was returned to the pool and gets reused */
+	auto stats = pool.GetStats();
+	EXPECT_EQ(stats.allocator.netto_size, 0U);
+	EXPECT_EQ(stats.allocator.brutto_size, BufferPool::MIN_SIZE);
+
+	{
+		Buffer buffer{pool};
+		ASSERT_TRUE(buffer.SetLength(BufferPool::MIN_SIZE));
+		Fill(buffer, BufferPool::MIN_SIZE);
+		EXPECT_TRUE(buffer.IsComplete());
+	}
+
+	stats = pool.GetStats();
+	EXPECT_EQ(stats.hits, 1U);
+	EXPECT_EQ(stats.misses, 1U);
+
+	pool.Compress();
+	EXPECT_EQ(pool.GetStats().allocator.brutto_size, 0U);
+}
+
+TEST(WasBuffer, UnknownLength)
+{
+	BufferPool pool;
+
+	Buffer buffer{pool};
+
+	/* grow until the maximum size is reached */
+	Fill(buffer, Buffer::max_size());
+	EXPECT_TRUE(buffer.Write().empty());
+	EXPECT_EQ(pool.GetStats().allocator.netto_size, Buffer::max_size());
+
+	EXPECT_FALSE(buffer.SetLength(Buffer::max_size() - 1));
+	ASSERT_TRUE(buffer.SetLength(Buffer::max_size()));
+	EXPECT_TRUE(buffer.IsComplete());
+
+	const auto body = buffer.ToDisposableBuffer();
+	EXPECT_EQ(body.size(), Buffer::max_size());
+	EXPECT_TRUE(std::all_of((const std::byte *)body.data(),
+				(const std::byte *)body.data() + body.size(),
+				[](std::byte b){ return b == std::byte{'x'}; }));
+}
+
+TEST(WasBuffer, Empty)
+{
+	BufferPool pool;
+
+	Buffer buffer{pool};
+	ASSERT_TRUE(buffer.SetLength(0));
+	EXPECT_TRUE(buffer.IsComplete());
+
+	const auto body = buffer.ToDisposableBuffer();
+	EXPECT_TRUE(body);
+	EXPECT_TRUE(body.empty());
+	EXPECT_EQ(pool.GetStats().misses, 0U);
+}
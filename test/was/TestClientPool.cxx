@@ -0,0 +1,293 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "was/async/ClientPool.hxx"
+#include "was/async/SimpleClient.hxx"
+#include "was/async/SimpleHandler.hxx"
+#include "was/async/SimpleMultiServer.hxx"
+#include "was/async/SimpleServer.hxx"
+#include "was/async/Socket.hxx"
+#include "event/Loop.hxx"
+#include "net/SocketPair.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/Cancellable.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <array>
+#include <list>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/**
+ * A Multi-WAS server which creates a #Was::SimpleServer for each new
+ * connection and which does not respond to requests until
+ * RespondOne() is called.
+ */
+class MyMultiServer final
+	: Was::SimpleMultiServerHandler, Was::SimpleServerHandler,
+	  Was::SimpleRequestHandler
+{
+	class Pending final : public IntrusiveListHook<>, public Cancellable {
+		MyMultiServer &parent;
+
+	public:
+		Was::SimpleServer &server;
+
+		Pending(MyMultiServer &_parent, Was::SimpleServer &_server) noexcept
+			:parent(_parent), server(_server) {}
+
+	private:
+		/* virtual methods from class Cancellable */
+		void Cancel() noexcept override {
+			++parent.n_canceled;
+			parent.pending.erase_and_dispose(parent.pending.iterator_to(*this),
+							 DeleteDisposer{});
+			parent.GetEventLoop().Break();
+		}
+	};
+
+	Was::SimpleMultiServer multi_server;
+
+	std::list<Was::SimpleServer> servers;
+
+	IntrusiveList<Pending,
+		      IntrusiveListBaseHookTraits<Pending>,
+		      IntrusiveListOptions{.constant_time_size = true}> pending;
+
+public:
+	std::size_t n_requests = 0, n_canceled = 0;
+
+	MyMultiServer(EventLoop &event_loop, UniqueSocketDescriptor &&socket) noexcept
+		:multi_server(event_loop, std::move(socket), *this) {}
+
+	~MyMultiServer() noexcept {
+		pending.clear_and_dispose(DeleteDisposer{});
+	}
+
+	EventLoop &GetEventLoop() const noexcept {
+		return multi_server.GetEventLoop();
+	}
+
+	std::size_t GetConnectionCount() const noexcept {
+		return servers.size();
+	}
+
+	std::size_t GetPendingCount() const noexcept {
+		return pending.size();
+	}
+
+	void RespondOne() noexcept {
+		assert(!pending.empty());
+
+		auto &p = pending.pop_front();
+		auto &server = p.server;
+		delete &p;
+
+		server.SendResponse({.status = HttpStatus::NO_CONTENT});
+	}
+
+private:
+	/* virtual methods from Was::SimpleMultiServerHandler */
+	void OnMultiWasNew(Was::SimpleMultiServer &,
+			   WasSocket &&socket) noexcept override {
+		Was::SimpleServerHandler &server_handler = *this;
+		Was::CompactRequestHandler &request_handler = *this;
+		servers.emplace_back(GetEventLoop(), std::move(socket),
+				     server_handler, request_handler);
+	}
+
+	void OnMultiWasError(Was::SimpleMultiServer &,
+			     std::exception_ptr) noexcept override {
+		ADD_FAILURE();
+	}
+
+	void OnMultiWasClosed(Was::SimpleMultiServer &) noexcept override {
+	}
+
+	/* virtual methods from Was::SimpleServerHandler */
+	void OnWasError(Was::SimpleServer &, std::exception_ptr) noexcept override {
+		ADD_FAILURE();
+	}
+
+	void OnWasClosed(Was::SimpleServer &) noexcept override {
+	}
+
+	/* virtual methods from Was::SimpleRequestHandler */
+	bool OnRequest(Was::SimpleServer &server, Was::SimpleRequest &&,
+		       CancellablePointer &cancel_ptr) noexcept override {
+		++n_requests;
+
+		auto *p = new Pending(*this, server);
+		pending.push_back(*p);
+		cancel_ptr = *p;
+
+		GetEventLoop().Break();
+		return true;
+	}
+};
+
+struct MyPoolHandler final : Was::ClientPoolHandler {
+	/* virtual methods from Was::ClientPoolHandler */
+	void OnWasPoolDisconnect() noexcept override {
+	}
+
+	void OnWasPoolError(std::exception_ptr) noexcept override {
+		ADD_FAILURE();
+	}
+};
+
+class MyResponseHandler final : public Was::SimpleResponseHandler {
+	EventLoop &event_loop;
+
+public:
+	std::size_t n_responses = 0, n_errors = 0;
+
+	explicit MyResponseHandler(EventLoop &_event_loop) noexcept
+		:event_loop(_event_loop) {}
+
+	/* virtual methods from Was::SimpleResponseHandler */
+	void OnWasResponse(Was::SimpleResponse &&response) noexcept override {
+		EXPECT_EQ(response.status, HttpStatus::NO_CONTENT);
+		++n_responses;
+		event_loop.Break();
+	}
+
+	void OnWasError(std::exception_ptr) noexcept override {
+		++n_errors;
+		event_loop.Break();
+	}
+};
+
+template<typename P>
+static void
+RunUntil(EventLoop &event_loop, P &&predicate)
+{
+	while (!predicate())
+		event_loop.Run();
+}
+
+static void
+SendGet(Was::ClientPool &pool, Was::SimpleResponseHandler &handler,
+	CancellablePointer &cancel_ptr)
+{
+	pool.SendRequest({
+		.method = HttpMethod::GET,
+		.uri = "/foo",
+	}, handler, cancel_ptr);
+}
+
+} // anonymous namespace
+
+TEST(WasClientPool, Queue)
+{
+	[[maybe_unused]]
+	const ScopeInitDefaultFifoBuffer init_default_fifo_buffer;
+
+	auto [for_client, for_server] = CreateSocketPairNonBlock(SOCK_SEQPACKET);
+
+	EventLoop event_loop;
+	MyMultiServer server{event_loop, std::move(for_server)};
+	MyPoolHandler pool_handler;
+	Was::ClientPool pool{event_loop, std::move(for_client), pool_handler, 2};
+	MyResponseHandler response_handler{event_loop};
+
+	std::array<CancellablePointer, 3> cancel_ptrs;
+	for (auto &i : cancel_ptrs)
+		SendGet(pool, response_handler, i);
+
+	/* two requests are dispatched, the third one is queued */
+	RunUntil(event_loop, [&]{ return server.GetPendingCount() == 2; });
+
+	auto stats = pool.GetStats();
+	EXPECT_EQ(stats.n_connections, 2U);
+	EXPECT_EQ(stats.n_busy, 2U);
+	EXPECT_EQ(stats.queue_depth, 1U);
+	EXPECT_EQ(pool.GetQueueDepth(), 1U);
+	EXPECT_EQ(stats.n_requests, 0U);
+
+	/* completing one request dispatches the queued one on the
+	   same connection */
+	server.RespondOne();
+	RunUntil(event_loop, [&]{
+		return response_handler.n_responses == 1 &&
+			server.GetPendingCount() == 2;
+	});
+
+	stats = pool.GetStats();
+	EXPECT_EQ(stats.n_connections, 2U);
+	EXPECT_EQ(stats.n_busy, 2U);
+	EXPECT_EQ(stats.queue_depth, 0U);
+	EXPECT_EQ(stats.n_requests, 1U);
+	EXPECT_EQ(server.GetConnectionCount(), 2U);
+
+	server.RespondOne();
+	server.RespondOne();
+	RunUntil(event_loop, [&]{ return response_handler.n_responses == 3; });
+
+	stats = pool.GetStats();
+	EXPECT_EQ(stats.n_connections, 2U);
+	EXPECT_EQ(stats.n_busy, 0U);
+	EXPECT_EQ(stats.queue_depth, 0U);
+	EXPECT_EQ(stats.n_requests, 3U);
+	EXPECT_EQ(stats.n_errors, 0U);
+	EXPECT_EQ(response_handler.n_errors, 0U);
+	EXPECT_GE(stats.max_latency, stats.GetAverageLatency());
+	EXPECT_EQ(server.n_requests, 3U);
+}
+
+TEST(WasClientPool, Cancel)
+{
+	[[maybe_unused]]
+	const ScopeInitDefaultFifoBuffer init_default_fifo_buffer;
+
+	auto [for_client, for_server] = CreateSocketPairNonBlock(SOCK_SEQPACKET);
+
+	EventLoop event_loop;
+	MyMultiServer server{event_loop, std::move(for_server)};
+	MyPoolHandler pool_handler;
+	Was::ClientPool pool{event_loop, std::move(for_client), pool_handler, 1};
+	MyResponseHandler response_handler{event_loop};
+
+	CancellablePointer cancel1, cancel2, cancel3;
+	SendGet(pool, response_handler, cancel1);
+	SendGet(pool, response_handler, cancel2);
+
+	RunUntil(event_loop, [&]{ return server.GetPendingCount() == 1; });
+	EXPECT_EQ(pool.GetQueueDepth(), 1U);
+
+	/* cancel the queued request */
+	cancel2.Cancel();
+	EXPECT_EQ(pool.GetQueueDepth(), 0U);
+
+	/* cancel the dispatched request; this sends STOP */
+	cancel1.Cancel();
+
+	/* the connection is still busy until the server has
+	   acknowledged the STOP, so this one gets queued */
+	SendGet(pool, response_handler, cancel3);
+	EXPECT_EQ(pool.GetQueueDepth(), 1U);
+
+	RunUntil(event_loop, [&]{
+		return server.n_canceled == 1 && server.GetPendingCount() == 1;
+	});
+
+	/* the connection was reused after the STOP */
+	auto stats = pool.GetStats();
+	EXPECT_EQ(stats.n_connections, 1U);
+	EXPECT_EQ(stats.queue_depth, 0U);
+	EXPECT_EQ(server.GetConnectionCount(), 1U);
+
+	server.RespondOne();
+	RunUntil(event_loop, [&]{ return response_handler.n_responses == 1; });
+
+	stats = pool.GetStats();
+	EXPECT_EQ(stats.n_connections, 1U);
+	EXPECT_EQ(stats.n_busy, 0U);
+	EXPECT_EQ(stats.n_requests, 1U);
+	EXPECT_EQ(response_handler.n_errors, 0U);
+	EXPECT_EQ(server.n_requests, 2U);
+}
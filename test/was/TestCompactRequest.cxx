@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "was/async/CompactRequest.hxx"
+#include "was/async/SimpleHandler.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using std::string_view_literals::operator""sv;
+
+TEST(WasCompactRequest, Lookup)
+{
+	Was::CompactRequest request;
+
+	{
+		/* the request must not refer to the caller's
+		   buffers */
+		std::string uri{"/foo"};
+		request.uri = request.Dup(uri);
+		uri = "xxxx";
+	}
+
+	request.AddHeader("Content-Type", "text/plain; charset=utf-8");
+	request.AddHeader("x-foo", "1");
+	request.AddHeader("accept", "*/*");
+	request.AddHeader("X-Foo", "2");
+	request.AddParameter("b", "2");
+	request.AddParameter("a", "1");
+	request.AddParameter("b", "3");
+	request.Finish();
+
+	/* the strings survive a move */
+	Was::CompactRequest moved = std::move(request);
+
+	EXPECT_EQ(moved.uri, "/foo"sv);
+
+	EXPECT_EQ(moved.GetHeader("accept"sv), "*/*"sv);
+	EXPECT_EQ(moved.GetHeader("ACCEPT"sv), "*/*"sv);
+	EXPECT_EQ(moved.GetHeader("accept-encoding"sv).data(), nullptr);
+	EXPECT_EQ(moved.GetHeader("accep"sv).data(), nullptr);
+
+	/* headers with the same name keep their order */
+	const auto foo = moved.GetHeaders("x-foo"sv);
+	ASSERT_EQ(foo.size(), 2U);
+	EXPECT_EQ(foo[0].second, "1"sv);
+	EXPECT_EQ(foo[1].second, "2"sv);
+
+	EXPECT_TRUE(moved.IsContentType("text/plain"sv));
+	EXPECT_FALSE(moved.IsContentType("text/html"sv));
+
+	EXPECT_EQ(moved.GetParameter("a"sv), "1"sv);
+	EXPECT_EQ(moved.GetParameter("b"sv), "2"sv);
+	EXPECT_EQ(moved.GetParameter("c"sv).data(), nullptr);
+	EXPECT_EQ(moved.GetParameter("A"sv).data(), nullptr);
+}
+
+/**
+ * Names which are not null-terminated, have the same prefix or
+ * contain null bytes.
+ */
+TEST(WasCompactRequest, HeaderNames)
+{
+	Was::CompactRequest request;
+
+	/* substrings of one buffer, so they are not null-terminated */
+	constexpr std::string_view buffer = "x-fooX-FOO-BARx-fo"sv;
+	request.AddHeader(buffer.substr(0, 5), "1");
+	request.AddHeader(buffer.substr(5, 9), "2");
+	request.AddHeader(buffer.substr(14, 4), "3");
+	request.AddHeader("a\0b"sv, "4");
+	request.AddHeader("a\0c"sv, "5");
+	request.Finish();
+
+	EXPECT_EQ(request.GetHeader("X-Foo"sv), "1"sv);
+	EXPECT_EQ(request.GetHeader("x-foo-bar"sv), "2"sv);
+	EXPECT_EQ(request.GetHeader("x-fo"sv), "3"sv);
+	EXPECT_EQ(request.GetHeader("x-f"sv).data(), nullptr);
+	EXPECT_EQ(request.GetHeader("x-foo-ba"sv).data(), nullptr);
+	EXPECT_EQ(request.GetHeader("A\0B"sv), "4"sv);
+	EXPECT_EQ(request.GetHeader("a\0c"sv), "5"sv);
+	EXPECT_EQ(request.GetHeader("a\0d"sv).data(), nullptr);
+}
+
+TEST(WasCompactRequest, Large)
+{
+	Was::CompactRequest request;
+
+	/* larger than one arena block */
+	const std::string large(10000, 'x');
+	request.AddHeader("a", "1");
+	request.AddHeader("large", large);
+	request.AddHeader("b", "2");
+	request.Finish();
+
+	EXPECT_EQ(request.GetHeader("a"sv), "1"sv);
+	EXPECT_EQ(request.GetHeader("large"sv), large);
+	EXPECT_EQ(request.GetHeader("b"sv), "2"sv);
+}
+
+TEST(WasCompactRequest, ToSimpleRequest)
+{
+	Was::CompactRequest request;
+	request.method = HttpMethod::POST;
+	request.uri = request.Dup("/foo");
+	request.AddHeader("a", "1");
+	request.AddHeader("a", "2");
+	request.AddParameter("p", "v");
+	request.Finish();
+
+	const auto simple = std::move(request).ToSimpleRequest();
+	EXPECT_EQ(simple.method, HttpMethod::POST);
+	EXPECT_EQ(simple.uri, "/foo");
+	EXPECT_EQ(simple.headers.count("a"), 2U);
+	ASSERT_EQ(simple.parameters.size(), 1U);
+	EXPECT_EQ(simple.parameters.begin()->second, "v");
+}
@@ -6,9 +6,18 @@
 #include "was/async/SimpleServer.hxx"
 #include "was/async/SimpleClient.hxx"
 #include "was/async/Socket.hxx"
+#include "was/async/FileBodyProducer.hxx"
 #include "event/Loop.hxx"
 #include "event/FineTimerEvent.hxx"
+#include "event/DeferEvent.hxx"
 #include "net/SocketProtocolError.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+#include <array>
+
+#include <sys/mman.h> // for memfd_create()
 
 #include <gtest/gtest.h>
 
@@ -311,3 +320,448 @@ TEST(WasSimpleServer, ServerClose)
 
 	EXPECT_THROW(std::rethrow_exception(client_handler.error), SocketClosedPrematurelyError);
 }
+
+namespace {
+
+/**
+ * Writes #length bytes of a pattern to the pipe.
+ */
+class PatternBodyProducer final : public Was::SimpleBodyProducer {
+	const uint_least64_t length;
+	uint_least64_t position = 0;
+
+public:
+	explicit PatternBodyProducer(uint_least64_t _length) noexcept
+		:length(_length) {}
+
+	uint_least64_t GetLength() const noexcept override {
+		return length;
+	}
+
+	std::size_t WriteBody(FileDescriptor pipe,
+			      uint_least64_t max_length) override {
+		std::array<std::byte, 3000> buffer;
+		const std::size_t n = std::min<uint_least64_t>(buffer.size(), max_length);
+		for (std::size_t i = 0; i < n; ++i)
+			buffer[i] = static_cast<std::byte>((position + i) % 251);
+
+		const auto nbytes = pipe.Write(std::span{buffer}.first(n));
+		if (nbytes < 0) {
+			if (errno == EAGAIN)
+				return 0;
+			throw MakeErrno("Failed to write");
+		}
+
+		position += nbytes;
+		return nbytes;
+	}
+};
+
+/**
+ * Streams the request body, consuming at most 1000 bytes per call
+ * and resuming later (to exercise the backpressure), and responds
+ * with a body generated by #PatternBodyProducer.
+ */
+class StreamRequestHandler final
+	: public Was::SimpleRequestHandler, Was::SimpleBodyHandler
+{
+	DeferEvent defer_resume;
+
+	Was::SimpleServer *server = nullptr;
+
+public:
+	/**
+	 * If set, then the next response body is sent from this file
+	 * with #FileBodyProducer.
+	 */
+	UniqueFileDescriptor file;
+
+	uint_least64_t received = 0;
+	bool stream = false, error = false;
+
+	static constexpr uint_least64_t RESPONSE_LENGTH = 100000;
+
+	explicit StreamRequestHandler(EventLoop &event_loop) noexcept
+		:defer_resume(event_loop, BIND_THIS_METHOD(OnDeferredResume)) {}
+
+	// virtual methods from Was::SimpleRequestHandler
+	bool WantStreamBody(const Was::CompactRequest &) noexcept override {
+		return true;
+	}
+
+	bool OnRequest(Was::SimpleServer &_server, Was::SimpleRequest &&request,
+		       CancellablePointer &) noexcept override {
+		server = &_server;
+		stream = request.body_stream;
+
+		if (!stream) {
+			Was::SimpleResponse response;
+			if (file.IsDefined())
+				response.body_producer = std::make_unique<Was::FileBodyProducer>(std::move(file),
+												  0, RESPONSE_LENGTH);
+			else
+				response.body_producer = std::make_unique<PatternBodyProducer>(RESPONSE_LENGTH);
+			return server->SendResponse(std::move(response));
+		}
+
+		server->ReadBody(*this);
+		return true;
+	}
+
+private:
+	void OnDeferredResume() noexcept {
+		server->ResumeBody();
+	}
+
+	// virtual methods from Was::SimpleBodyHandler
+	std::size_t OnWasBodyData(std::span<const std::byte> src) noexcept override {
+		for (std::size_t i = 0; i < src.size() && i < 1000; ++i)
+			if (src[i] != static_cast<std::byte>((received + i) % 251))
+				error = true;
+
+		const std::size_t n = std::min<std::size_t>(src.size(), 1000);
+		received += n;
+
+		if (n < src.size())
+			defer_resume.Schedule();
+
+		return n;
+	}
+
+	void OnWasBodyEnd() noexcept override {
+		Was::SimpleResponse response;
+		response.headers.emplace("x-received", std::to_string(received));
+		response.body_producer = std::make_unique<PatternBodyProducer>(RESPONSE_LENGTH);
+		server->SendResponse(std::move(response));
+	}
+
+	void OnWasBodyError(std::exception_ptr) noexcept override {
+		error = true;
+	}
+};
+
+static bool
+CheckPattern(std::span<const std::byte> s) noexcept
+{
+	for (std::size_t i = 0; i < s.size(); ++i)
+		if (s[i] != static_cast<std::byte>(i % 251))
+			return false;
+	return true;
+}
+
+} // anonymous namespace
+
+TEST(WasSimpleServer, Stream)
+{
+	[[maybe_unused]]
+	const ScopeInitDefaultFifoBuffer init_default_fifo_buffer;
+
+	auto [for_client, for_server] = WasSocket::CreatePair();
+
+	/* the bodies are larger than the pipe buffers */
+	for_client.input.SetNonBlocking();
+	for_client.output.SetNonBlocking();
+	for_server.input.SetNonBlocking();
+	for_server.output.SetNonBlocking();
+
+	EventLoop event_loop;
+
+	MyServerHandler server_handler;
+	StreamRequestHandler request_handler{event_loop};
+	Was::SimpleServer server{event_loop, std::move(for_server), server_handler, request_handler};
+
+	MyClientHandler client_handler;
+	Was::SimpleClient client{event_loop, std::move(for_client), client_handler};
+
+	/* a request body which is larger than Was::Buffer */
+	constexpr std::size_t request_length = 1024 * 1024;
+	const auto request_body = std::make_unique<std::byte[]>(request_length);
+	for (std::size_t i = 0; i < request_length; ++i)
+		request_body[i] = static_cast<std::byte>(i % 251);
+
+	const auto response1 = Request(client, {
+		.method = HttpMethod::POST,
+		.uri = "/foo",
+		.body = {ToNopPointer(request_body.get()), request_length},
+	});
+
+	EXPECT_TRUE(request_handler.stream);
+	EXPECT_FALSE(request_handler.error);
+	EXPECT_EQ(request_handler.received, request_length);
+	EXPECT_EQ(response1.status, HttpStatus::OK);
+	ASSERT_EQ(response1.headers.size(), 1U);
+	EXPECT_EQ(response1.headers.begin()->second, std::to_string(request_length));
+	ASSERT_EQ(response1.body.size(), StreamRequestHandler::RESPONSE_LENGTH);
+	EXPECT_TRUE(CheckPattern(response1.body));
+
+	/* no request body, response body from a producer */
+	const auto response2 = Request(client, {
+		.method = HttpMethod::GET,
+		.uri = "/foo",
+	});
+
+	EXPECT_FALSE(request_handler.stream);
+	EXPECT_EQ(response2.status, HttpStatus::OK);
+	ASSERT_EQ(response2.body.size(), StreamRequestHandler::RESPONSE_LENGTH);
+	EXPECT_TRUE(CheckPattern(response2.body));
+
+	/* response body spliced from a file */
+	{
+		UniqueFileDescriptor file{AdoptTag{}, memfd_create("TestWas", MFD_CLOEXEC)};
+		ASSERT_TRUE(file.IsDefined());
+
+		const auto pattern = std::make_unique<std::byte[]>(StreamRequestHandler::RESPONSE_LENGTH);
+		for (std::size_t i = 0; i < StreamRequestHandler::RESPONSE_LENGTH; ++i)
+			pattern[i] = static_cast<std::byte>(i % 251);
+
+		ASSERT_EQ(file.Write({pattern.get(), StreamRequestHandler::RESPONSE_LENGTH}),
+			  static_cast<ssize_t>(StreamRequestHandler::RESPONSE_LENGTH));
+
+		request_handler.file = std::move(file);
+	}
+
+	const auto response3 = Request(client, {
+		.method = HttpMethod::GET,
+		.uri = "/foo",
+	});
+
+	EXPECT_FALSE(request_handler.file.IsDefined());
+	EXPECT_EQ(response3.status, HttpStatus::OK);
+	ASSERT_EQ(response3.body.size(), StreamRequestHandler::RESPONSE_LENGTH);
+	EXPECT_TRUE(CheckPattern(response3.body));
+
+	EXPECT_FALSE(client_handler.closed);
+	EXPECT_FALSE(client_handler.error);
+	EXPECT_FALSE(server_handler.closed);
+	EXPECT_FALSE(server_handler.error);
+}
+
+namespace {
+
+/**
+ * Mirrors the request headers (looked up with
+ * CompactRequest::GetHeader()) without converting the request to a
+ * #SimpleRequest.
+ */
+struct CompactMirrorHandler final : Was::CompactRequestHandler {
+	bool OnCompactRequest(Was::SimpleServer &server,
+			      Was::CompactRequest &&request,
+			      CancellablePointer &) noexcept override {
+		Was::SimpleResponse response;
+		response.headers.emplace("x-uri", request.uri);
+
+		if (const auto hello = request.GetHeader("hello"); hello.data() != nullptr)
+			response.headers.emplace("x-hello", hello);
+
+		response.body = std::move(request.body);
+		return server.SendResponse(std::move(response));
+	}
+};
+
+} // anonymous namespace
+
+TEST(WasSimpleServer, Compact)
+{
+	[[maybe_unused]]
+	const ScopeInitDefaultFifoBuffer init_default_fifo_buffer;
+
+	auto [for_client, for_server] = WasSocket::CreatePair();
+
+	EventLoop event_loop;
+
+	MyServerHandler server_handler;
+	CompactMirrorHandler request_handler;
+	Was::SimpleServer server{event_loop, std::move(for_server), server_handler, request_handler};
+
+	MyClientHandler client_handler;
+	Was::SimpleClient client{event_loop, std::move(for_client), client_handler};
+
+	const auto response = Request(client, {
+		.method = HttpMethod::POST,
+		.uri = "/foo",
+		.headers = {
+			{"Hello", "world"},
+		},
+		.body = DisposableBuffer::Dup(std::string_view{"body"}),
+	});
+
+	EXPECT_EQ(response.status, HttpStatus::OK);
+	ASSERT_EQ(response.headers.size(), 2U);
+	EXPECT_EQ(response.headers.find("x-uri")->second, "/foo");
+	EXPECT_EQ(response.headers.find("x-hello")->second, "world");
+	EXPECT_EQ(std::string_view{response.body}, "body");
+	EXPECT_FALSE(client_handler.error);
+	EXPECT_FALSE(server_handler.error);
+}
+
+namespace {
+
+/**
+ * Streams the request body, but responds right after the first
+ * chunk (without consuming the rest), which makes the server send
+ * STOP.  Optionally, it destroys the #SimpleServer from inside
+ * OnWasBodyData() instead.
+ */
+class EarlyResponseHandler final
+	: public Was::SimpleRequestHandler, Was::SimpleBodyHandler
+{
+	EventLoop &event_loop;
+
+	Was::SimpleServer *server = nullptr;
+
+public:
+	std::unique_ptr<Was::SimpleServer> owned_server;
+
+	bool destroy = false, error = false;
+
+	explicit EarlyResponseHandler(EventLoop &_event_loop) noexcept
+		:event_loop(_event_loop) {}
+
+	// virtual methods from Was::SimpleRequestHandler
+	bool WantStreamBody(const Was::CompactRequest &) noexcept override {
+		return true;
+	}
+
+	bool OnRequest(Was::SimpleServer &_server, Was::SimpleRequest &&request,
+		       CancellablePointer &) noexcept override {
+		server = &_server;
+
+		if (!request.body_stream)
+			return server->SendResponse({});
+
+		server->ReadBody(*this);
+		return true;
+	}
+
+private:
+	// virtual methods from Was::SimpleBodyHandler
+	std::size_t OnWasBodyData(std::span<const std::byte>) noexcept override {
+		if (destroy) {
+			owned_server.reset();
+			event_loop.Break();
+			return 0;
+		}
+
+		server->SendResponse({.status = HttpStatus::CREATED});
+		return 0;
+	}
+
+	void OnWasBodyEnd() noexcept override {
+		error = true;
+	}
+
+	void OnWasBodyError(std::exception_ptr) noexcept override {
+		error = true;
+	}
+};
+
+} // anonymous namespace
+
+/**
+ * The server responds before the request body has been received
+ * completely; the connection must remain usable after the
+ * STOP/PREMATURE exchange.
+ */
+TEST(WasSimpleServer, EarlyResponse)
+{
+	[[maybe_unused]]
+	const ScopeInitDefaultFifoBuffer init_default_fifo_buffer;
+
+	auto [for_client, for_server] = WasSocket::CreatePair();
+
+	for_client.input.SetNonBlocking();
+	for_client.output.SetNonBlocking();
+	for_server.input.SetNonBlocking();
+	for_server.output.SetNonBlocking();
+
+	EventLoop event_loop;
+
+	MyServerHandler server_handler;
+	EarlyResponseHandler request_handler{event_loop};
+	Was::SimpleServer server{event_loop, std::move(for_server), server_handler, request_handler};
+
+	MyClientHandler client_handler;
+	Was::SimpleClient client{event_loop, std::move(for_client), client_handler};
+
+	constexpr std::size_t request_length = 1024 * 1024;
+	const auto request_body = std::make_unique<std::byte[]>(request_length);
+
+	const auto response1 = Request(client, {
+		.method = HttpMethod::POST,
+		.uri = "/foo",
+		.body = {ToNopPointer(request_body.get()), request_length},
+	});
+
+	EXPECT_EQ(response1.status, HttpStatus::CREATED);
+
+	if (client.IsStopping()) {
+		// wait some more until the server sends PREMATURE
+		DeferBreak defer{event_loop};
+		defer.ScheduleBreak();
+		event_loop.Run();
+	}
+
+	const auto response2 = Request(client, {
+		.method = HttpMethod::GET,
+		.uri = "/bar",
+	});
+
+	EXPECT_EQ(response2.status, HttpStatus::OK);
+	EXPECT_FALSE(request_handler.error);
+	EXPECT_FALSE(client_handler.closed);
+	EXPECT_FALSE(client_handler.error);
+	EXPECT_FALSE(server_handler.closed);
+	EXPECT_FALSE(server_handler.error);
+}
+
+/**
+ * The body handler destroys the #SimpleServer from inside
+ * OnWasBodyData().
+ */
+TEST(WasSimpleServer, DestroyInBodyData)
+{
+	[[maybe_unused]]
+	const ScopeInitDefaultFifoBuffer init_default_fifo_buffer;
+
+	auto [for_client, for_server] = WasSocket::CreatePair();
+
+	for_client.input.SetNonBlocking();
+	for_client.output.SetNonBlocking();
+	for_server.input.SetNonBlocking();
+	for_server.output.SetNonBlocking();
+
+	EventLoop event_loop;
+
+	MyServerHandler server_handler;
+	EarlyResponseHandler request_handler{event_loop};
+	request_handler.destroy = true;
+	request_handler.owned_server =
+		std::make_unique<Was::SimpleServer>(event_loop, std::move(for_server),
+						    server_handler, request_handler);
+
+	MyClientHandler client_handler;
+	Was::SimpleClient client{event_loop, std::move(for_client), client_handler};
+	MyResponseHandler response_handler{event_loop};
+
+	constexpr std::size_t request_length = 1024 * 1024;
+	const auto request_body = std::make_unique<std::byte[]>(request_length);
+
+	CancellablePointer cancel_ptr;
+	client.SendRequest({
+		.method = HttpMethod::POST,
+		.uri = "/foo",
+		.body = {ToNopPointer(request_body.get()), request_length},
+	}, response_handler, cancel_ptr);
+
+	event_loop.Run();
+
+	EXPECT_FALSE(request_handler.owned_server);
+	EXPECT_FALSE(request_handler.error);
+	EXPECT_FALSE(server_handler.closed);
+	EXPECT_FALSE(server_handler.error);
+
+	/* the client notices that the server is gone */
+	if (!response_handler.error)
+		event_loop.Run();
+	EXPECT_TRUE(response_handler.error);
+}